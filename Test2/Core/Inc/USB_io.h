@@ -20,7 +20,8 @@
 	//=======================================================================================================
 	//												FUNCTIONS
 	//=======================================================================================================
-	void USB_SendFrame(uint8_t *frame, uint32_t len);
+	int  USB_SendFrame(uint8_t *frame, uint32_t len);
+	void USB_FrameSent(uint8_t *frame);
 	void USB_SendBuffer(uint8_t *buf, uint32_t len);
 	void USB_SendNextChunk(void);
 
@@ -0,0 +1,131 @@
+#ifndef __AUTO_EXPOSURE_H
+#define __AUTO_EXPOSURE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "frame_bands.h"
+
+/*
+ * Exposure control in firmware, for correlation rather than for a pretty
+ * picture: exposure and gain set manually on the sensor, from the
+ * histogram of each frame.
+ *
+ * The histogram is counted as the frame is captured
+ * (AutoExposure_AttachBands()) or handed over whole
+ * (AutoExposure_Frame(), e.g. the bins of imlib_get_histogram()). From it
+ * the exposure x gain that puts the mean level at cfg.target_mean is
+ * predicted, and lowered if more than cfg.max_clipped of the pixels would
+ * then be at cfg.clip_level or above: levels are taken back through
+ * cfg.curve (the sensor gamma) to a signal proportional to exposure x
+ * gain, scaled, and passed through it again. Where the brightest pixels
+ * allowed are saturated their signal is extrapolated from those below, or
+ * after a step down from how the saturated fraction went with it; a frame
+ * saturated for the most part says little about how far down to go and
+ * takes AUTO_EXPOSURE_SATURATED_STEP. One frame with levels to go by is
+ * thus enough to land on the target; steps are limited to a factor
+ * cfg.max_step either way.
+ *
+ * Exposure is preferred to gain (noise): gain goes above cfg.min_gain
+ * (taken as 1x) only at cfg.max_exposure, exposure below cfg.max_exposure
+ * only at cfg.min_gain. Both are in the units of the sensor.
+ *
+ * New settings show from frame seq + 1 + cfg.delay on, seq the frame they
+ * were computed from. The settings of each frame are remembered, so a
+ * frame still taken with older ones gives the same settings again rather
+ * than a second correction, and dropped frames do not upset it as long as
+ * AutoExposure_SetSeq() gives the seq of each frame. Settings within
+ * cfg.tolerance of the latest are not applied again.
+ */
+
+#ifndef AUTO_EXPOSURE_MAX_DELAY
+#define AUTO_EXPOSURE_MAX_DELAY      3U
+#endif
+
+/* Settings remembered: those in flight and the one in effect */
+#define AUTO_EXPOSURE_HISTORY        (AUTO_EXPOSURE_MAX_DELAY + 2U)
+
+/* Exposure x gain scale for a frame saturated for the most part */
+#ifndef AUTO_EXPOSURE_SATURATED_STEP
+#define AUTO_EXPOSURE_SATURATED_STEP 0.25f
+#endif
+
+typedef enum
+{
+    AUTO_EXPOSURE_OK = 0,
+    AUTO_EXPOSURE_ERROR = -1,           /* The sensor refused the settings, or no room for the consumer */
+    AUTO_EXPOSURE_INVALID_PARAM = -2
+} AutoExposure_Status;
+
+typedef struct
+{
+    float     target_mean;      /* Mean level, 0 .. 255 */
+    float     max_clipped;      /* Fraction of the pixels allowed at clip_level or above */
+    uint32_t  clip_level;       /* 1 .. 255 */
+    const uint8_t *curve;       /* Level out of each signal level 0 .. 255, increasing; 0 = linear */
+    float     tolerance;        /* Relative change of exposure x gain not worth applying */
+    float     max_step;         /* Largest factor of exposure x gain from one frame, > 1 */
+    uint32_t  min_exposure;
+    uint32_t  max_exposure;
+    uint32_t  min_gain;         /* 1x */
+    uint32_t  max_gain;
+    uint32_t  delay;            /* Frames after the next still taken with the previous settings */
+} auto_exposure_config_t;
+
+/* Sets exposure and gain on the sensor; 0 on success */
+typedef int (*auto_exposure_apply_fn)(void *ctx, uint32_t exposure, uint32_t gain);
+
+typedef struct
+{
+    uint32_t  from_seq;         /* First frame taken with them */
+    uint32_t  exposure;
+    uint32_t  gain;
+} auto_exposure_setting_t;
+
+typedef struct
+{
+    auto_exposure_config_t   cfg;
+    auto_exposure_apply_fn   apply;
+    void                    *apply_ctx;
+
+    uint8_t                  curve[256];    /* cfg.curve, copied */
+    float                    signal[256];   /* Signal of the middle of each level */
+
+    auto_exposure_setting_t  history[AUTO_EXPOSURE_HISTORY];   /* Oldest first */
+    uint32_t                 settings;
+
+    uint32_t                 hist[256];     /* Of the frame being captured */
+    uint32_t                 pixels;        /* Counted into it */
+    uint32_t                 width;
+    uint32_t                 seq;           /* Of the next frame */
+
+    float                    saturated;     /* Fraction at 255 at saturated_total */
+    float                    saturated_total;
+    float                    prev_saturated;    /* The same at the settings before */
+    float                    prev_saturated_total;
+
+    /* Last frame, for the debugger */
+    float                    mean;
+    float                    clipped;
+    uint32_t                 settled;       /* Frames in a row needing no change */
+    uint32_t                 frames;
+    uint32_t                 applied;
+    uint32_t                 errors;
+} auto_exposure_t;
+
+int  AutoExposure_Init(auto_exposure_t *ae, const auto_exposure_config_t *cfg,
+                       auto_exposure_apply_fn apply, void *apply_ctx,
+                       uint32_t exposure, uint32_t gain);
+int  AutoExposure_AttachBands(auto_exposure_t *ae, frame_bands_t *fb);
+void AutoExposure_SetSeq(auto_exposure_t *ae, uint32_t seq);
+int  AutoExposure_Frame(auto_exposure_t *ae, const uint32_t hist[256], uint32_t pixels);
+void AutoExposure_Get(const auto_exposure_t *ae, uint32_t *exposure, uint32_t *gain);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AUTO_EXPOSURE_H */
@@ -0,0 +1,121 @@
+#ifndef __CAPTURE_RING_H
+#define __CAPTURE_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Ownership of a ring of frame buffers between the camera interface and
+ * the task processing frames, so capture goes on while a frame is
+ * processed.
+ *
+ * Each buffer (slot) is in one state:
+ *
+ *   FREE      nobody's
+ *   FILLING   the DMA is capturing into it (at most one slot)
+ *   READY     a complete frame, the newest (at most one slot)
+ *   HELD      with the consumer, until CaptureRing_Release()
+ *
+ * CaptureRing_FrameDone() is the frame-end interrupt: the FILLING slot
+ * becomes READY, an older READY frame nobody took is dropped, and the
+ * returned buffer is the one to capture into next: a FREE slot, else the
+ * READY frame itself is given up (dropped) rather than stopping capture.
+ * Only when the consumer holds every other slot does capture stall
+ * (FrameDone() returns 0); the Release() that frees a slot then returns
+ * it to restart capture with. CaptureRing_Acquire() always hands out the
+ * newest complete frame.
+ *
+ * With one slot this is capture suspended while the frame is processed;
+ * with two, frames completing while the consumer holds one are dropped;
+ * with three, the consumer can hold one and never stall capture.
+ *
+ * The consumer may also start on the frame still being captured:
+ * CaptureRing_Filling() returns it with the lines captured so far
+ * (counted by CaptureRing_LineDone() from the line interrupt) and the seq
+ * it will have. Those lines are only read, and the work on them only
+ * counts if Acquire() then returns that seq.
+ *
+ * FrameDone() and LineDone() run with the consumer calls excluded (an
+ * interrupt, or under os.lock on a host); the consumer calls take os.lock
+ * themselves. Latency is frame end to Acquire(), in os.now_us()
+ * microseconds.
+ */
+
+#ifndef CAPTURE_RING_MAX_SLOTS
+#define CAPTURE_RING_MAX_SLOTS   4U
+#endif
+
+typedef enum
+{
+    CAPTURE_RING_OK = 0,
+    CAPTURE_RING_INVALID_PARAM = -2,
+    CAPTURE_RING_EMPTY = -3             /* No complete frame yet */
+} CaptureRing_Status;
+
+typedef enum
+{
+    CAPTURE_SLOT_FREE = 0,
+    CAPTURE_SLOT_FILLING,
+    CAPTURE_SLOT_READY,
+    CAPTURE_SLOT_HELD
+} CaptureRing_SlotState;
+
+typedef struct
+{
+    void      (*lock)(void *ctx);
+    void      (*unlock)(void *ctx);
+    uint32_t  (*now_us)(void *ctx);
+    void      *ctx;
+} capture_ring_os_t;
+
+/* A frame with the consumer */
+typedef struct
+{
+    uint8_t   *data;
+    uint32_t   seq;             /* Frames completed before it */
+    uint32_t   done_us;         /* Frame end */
+    uint32_t   slot;
+} capture_frame_t;
+
+typedef struct
+{
+    uint32_t captured;          /* Frames completed */
+    uint32_t consumed;          /* Frames acquired */
+    uint32_t dropped;           /* Completed, never acquired */
+    uint32_t stalls;            /* Times capture stopped for want of a buffer */
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint64_t latency_sum_us;
+} capture_ring_stats_t;
+
+typedef struct
+{
+    capture_ring_os_t     os;
+    uint8_t              *buf[CAPTURE_RING_MAX_SLOTS];
+    uint8_t               state[CAPTURE_RING_MAX_SLOTS];
+    uint32_t              seq[CAPTURE_RING_MAX_SLOTS];
+    uint32_t              done_us[CAPTURE_RING_MAX_SLOTS];
+    uint32_t              count;
+    int32_t               filling;      /* Slot, -1 when capture is stopped */
+    int32_t               ready;        /* Slot, -1 when none */
+    uint32_t              lines;        /* Of the filling slot */
+    capture_ring_stats_t  stats;
+} capture_ring_t;
+
+int      CaptureRing_Init(capture_ring_t *r, const capture_ring_os_t *os, uint8_t *const *bufs, uint32_t count);
+uint8_t *CaptureRing_Start(capture_ring_t *r);
+uint8_t *CaptureRing_FrameDone(capture_ring_t *r);
+uint32_t CaptureRing_LineDone(capture_ring_t *r);
+int      CaptureRing_Filling(capture_ring_t *r, capture_frame_t *f, uint32_t *lines);
+int      CaptureRing_Acquire(capture_ring_t *r, capture_frame_t *f);
+uint8_t *CaptureRing_Release(capture_ring_t *r, const capture_frame_t *f);
+void     CaptureRing_GetStats(capture_ring_t *r, capture_ring_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAPTURE_RING_H */
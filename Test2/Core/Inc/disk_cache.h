@@ -0,0 +1,94 @@
+#ifndef __DISK_CACHE_H
+#define __DISK_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Sector cache between FatFs and the card (user_diskio.c).
+ *
+ * The cache holds lines of line_sectors consecutive sectors, aligned to
+ * line_sectors; make a line the cluster size of the card, or a divisor of
+ * it. A read miss that starts where the previous one ended loads the rest
+ * of its line and the next ahead lines: sequential file reads then reach
+ * the card a few lines at a time, in one open stream, and FAT / directory
+ * sectors are served from memory in between. Other misses load only the
+ * sectors asked for.
+ *
+ * Writes are kept (write-back) and reach the card on DiskCache_Flush(),
+ * when their line is evicted, or when a bypassing access overlaps them;
+ * dirty sectors that are consecutive go out in one write, lines in
+ * ascending order. Transfers of a line or more bypass the cache.
+ */
+
+#define DISK_CACHE_SECTOR        512U
+#define DISK_CACHE_MAX_LINE      64U     /* Sectors per line: one bit each in a uint64_t */
+#define DISK_CACHE_NO_LINE       0xFFFFFFFFUL
+
+#define DISK_CACHE_BYTES(lines, line_sectors)   ((uint32_t)(lines) * (line_sectors) * DISK_CACHE_SECTOR)
+
+typedef enum
+{
+    DISK_CACHE_OK = 0,
+    DISK_CACHE_ERROR = -1,
+    DISK_CACHE_INVALID_PARAM = -2
+} DiskCache_Status;
+
+/* The card: 0 = OK */
+typedef struct
+{
+    int   (*read)(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count);
+    int   (*write)(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count);
+    void  *ctx;
+} disk_cache_dev_t;
+
+typedef struct
+{
+    uint32_t  base;             /* First sector, DISK_CACHE_NO_LINE when free */
+    uint32_t  used;             /* LRU stamp */
+    uint64_t  valid;            /* Sectors holding card data (or newer) */
+    uint64_t  dirty;            /* Sectors newer than the card */
+    uint8_t  *data;
+} disk_cache_line_t;
+
+typedef struct
+{
+    uint32_t hits;              /* Sectors read from the cache */
+    uint32_t misses;            /* Sectors read that had to be loaded */
+    uint32_t ahead;             /* Sectors loaded ahead of a sequential read */
+    uint32_t bypassed;          /* Sectors moved straight between FatFs and the card */
+    uint32_t written;           /* Sectors written by FatFs into the cache */
+    uint32_t flushed;           /* Dirty sectors written to the card */
+    uint32_t dev_reads;         /* Read calls to the card */
+    uint32_t dev_writes;        /* Write calls to the card */
+    uint32_t evictions;
+    uint32_t errors;
+} disk_cache_stats_t;
+
+typedef struct
+{
+    disk_cache_dev_t    dev;
+    disk_cache_line_t  *lines;
+    uint32_t            count;
+    uint32_t            line_sectors;
+    uint32_t            ahead;          /* Lines read ahead */
+    uint32_t            stamp;
+    uint32_t            next_miss;      /* Sector where a sequential miss would fall */
+    disk_cache_stats_t  stats;
+} disk_cache_t;
+
+int  DiskCache_Init(disk_cache_t *c, const disk_cache_dev_t *dev, disk_cache_line_t *lines,
+                    uint32_t count, uint32_t line_sectors, uint8_t *mem, uint32_t ahead);
+int  DiskCache_Read(disk_cache_t *c, uint8_t *dst, uint32_t sector, uint32_t count);
+int  DiskCache_Write(disk_cache_t *c, const uint8_t *src, uint32_t sector, uint32_t count);
+int  DiskCache_Flush(disk_cache_t *c);
+void DiskCache_GetStats(const disk_cache_t *c, disk_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DISK_CACHE_H */
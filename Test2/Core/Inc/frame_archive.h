@@ -0,0 +1,52 @@
+#ifndef __FRAME_ARCHIVE_H
+#define __FRAME_ARCHIVE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Camera frames archived as grayscale JPEG (jpeg_y8.h), one after the
+ * other in a pre-allocated file that is written around again when full.
+ *
+ * FrameArchive_Save() encodes the frame in 8-row bands straight from the
+ * frame buffer into two output buffers of FRAME_ARCHIVE_OUT_BYTES. Each
+ * full one goes to the SD writer task (sd_writer_rtos.h, a BLOCK stream)
+ * while the other is filled; the caller only waits when the card falls
+ * two buffers behind. The frame buffer is free again when Save() returns.
+ * Each frame ends with a flush of the stream, so the newest image is whole
+ * on the card once the writer gets to it, not with the next saved frame.
+ * A frame is skipped (FRAME_ARCHIVE_BUSY) while the previous one is still
+ * being written. Images start with SOI and end with EOI, so the file is
+ * split back into frames by scanning for those markers.
+ *
+ * Call FrameArchive_Init() between SdWriterRTOS_Init() and
+ * SdWriterRTOS_Start(); Save() from one task only.
+ */
+
+#ifndef FRAME_ARCHIVE_OUT_BYTES
+#define FRAME_ARCHIVE_OUT_BYTES     8192U
+#endif
+
+#ifndef FRAME_ARCHIVE_WAIT_MS
+#define FRAME_ARCHIVE_WAIT_MS       500U        /* Longest wait for the card */
+#endif
+
+typedef enum
+{
+    FRAME_ARCHIVE_OK = 0,
+    FRAME_ARCHIVE_ERROR = -1,
+    FRAME_ARCHIVE_INVALID_PARAM = -2,
+    FRAME_ARCHIVE_BUSY = -3             /* The previous frame is still being written */
+} FrameArchive_Status;
+
+int FrameArchive_Init(const char *path, uint32_t bytes, uint32_t quality);
+int FrameArchive_Save(const uint8_t *frame, uint32_t w, uint32_t h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FRAME_ARCHIVE_H */
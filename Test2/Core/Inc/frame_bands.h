@@ -0,0 +1,68 @@
+#ifndef __FRAME_BANDS_H
+#define __FRAME_BANDS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * A Y8 frame handed to its consumers a band of rows at a time, as the
+ * DCMI delivers them, instead of all at once after the frame end.
+ *
+ * Each consumer attached with FrameBands_Attach() gets begin() with the
+ * frame, then band() for rows 0 .. band_rows - 1, band_rows ..
+ * 2 * band_rows - 1 and so on in order (the last band may be shorter),
+ * then end(). Per-row work (window and convert, row FFTs, statistics,
+ * JPEG blocks with band_rows a multiple of 8) thus runs during the
+ * readout, and only what needs the whole frame is left for its end.
+ *
+ * FrameBands_Begin() starts a frame, FrameBands_Lines() passes on the
+ * bands complete within the first lines rows, FrameBands_End() the rest
+ * and closes the frame. A Begin() before End() abandons the frame: the
+ * consumers see begin() again, for the new one. Consumers are called in
+ * the order attached, from the task calling these functions.
+ */
+
+#ifndef FRAME_BANDS_MAX_CONSUMERS
+#define FRAME_BANDS_MAX_CONSUMERS   4U
+#endif
+
+typedef enum
+{
+    FRAME_BANDS_OK = 0,
+    FRAME_BANDS_ERROR = -1,             /* No room for another consumer */
+    FRAME_BANDS_INVALID_PARAM = -2
+} FrameBands_Status;
+
+typedef struct
+{
+    void  (*begin)(void *ctx, const uint8_t *frame, uint32_t width, uint32_t height);   /* Optional */
+    void  (*band)(void *ctx, const uint8_t *rows, uint32_t row0, uint32_t count);
+    void  (*end)(void *ctx);                                                           /* Optional */
+    void  *ctx;
+} frame_band_consumer_t;
+
+typedef struct
+{
+    frame_band_consumer_t  consumer[FRAME_BANDS_MAX_CONSUMERS];
+    uint32_t               consumers;
+    uint32_t               width;
+    uint32_t               height;
+    uint32_t               band_rows;
+    const uint8_t         *frame;       /* 0 between frames */
+    uint32_t               rows;        /* Passed on so far */
+} frame_bands_t;
+
+int      FrameBands_Init(frame_bands_t *fb, uint32_t width, uint32_t height, uint32_t band_rows);
+int      FrameBands_Attach(frame_bands_t *fb, const frame_band_consumer_t *consumer);
+void     FrameBands_Begin(frame_bands_t *fb, const uint8_t *frame);
+uint32_t FrameBands_Lines(frame_bands_t *fb, uint32_t lines);
+void     FrameBands_End(frame_bands_t *fb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FRAME_BANDS_H */
@@ -53,7 +53,8 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
-
+HAL_StatusTypeDef PSRAM_Write(uint32_t addr, uint8_t *data, uint32_t size);
+HAL_StatusTypeDef PSRAM_Read(uint32_t addr, uint8_t *data, uint32_t size);
 /* USER CODE END EFP */
 
 /* Private defines -----------------------------------------------------------*/
@@ -0,0 +1,68 @@
+#ifndef __MAP_SD_H
+#define __MAP_SD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ff.h"
+#include "map_file.h"
+#include "map_index.h"
+
+/*
+ * On-target reader for the tiled reference map (.MAP, see map_file.h).
+ *
+ * MapSD_Open() reads the header block once; after that every tile is one
+ * f_lseek() and one contiguous f_read() at an offset computed from the
+ * header, with no index lookup and no scanning. Record sizes are multiples
+ * of the sector size and records start on sector boundaries, so FatFs
+ * transfers whole sectors straight into the caller's buffer.
+ *
+ * Tile buffers come from the caller (MapSD_TileBytes() bytes, 32-byte
+ * aligned for the data cache). Pass with_spectrum = 0 to read only the
+ * header and pixels of a record.
+ *
+ * Tiles of a packed map (MAP_FILE_PACKED) are returned unpacked: the first
+ * sector of the record is read, then only the sectors holding the rest of
+ * the packed pixels, streamed MAP_SD_PACK_CHUNK bytes at a time through
+ * the decoder (tile_codec.h) straight into buf. Over the polled SPI card a
+ * byte costs thousands of cycles and unpacking it a few tens, so the read
+ * time drops by about the compression ratio.
+ *
+ * MapSD_LoadIndex() builds the in-RAM spatial index (map_index.h) from the
+ * map's tile index once at boot.
+ */
+
+#ifndef MAP_SD_PACK_CHUNK
+#define MAP_SD_PACK_CHUNK      (4U * MAP_FILE_ALIGN)
+#endif
+
+typedef enum
+{
+    MAP_SD_OK = 0,
+    MAP_SD_ERROR = -1,
+    MAP_SD_BAD_FILE = -2,
+    MAP_SD_INVALID_PARAM = -3
+} MapSD_Status;
+
+typedef struct
+{
+    FIL               fp;
+    map_file_header_t hdr;
+} map_sd_t;
+
+int      MapSD_Open(map_sd_t *m, const char *path);
+void     MapSD_Close(map_sd_t *m);
+uint32_t MapSD_TileBytes(const map_sd_t *m, int with_spectrum);
+int      MapSD_ReadTile(map_sd_t *m, uint32_t level, uint32_t tx, uint32_t ty,
+                        void *buf, uint32_t bytes, map_tile_view_t *view);
+int      MapSD_ReadIndex(map_sd_t *m, uint32_t level, uint32_t first, uint32_t count,
+                         map_tile_entry_t *entries);
+int      MapSD_LoadIndex(map_sd_t *m, map_index_t *idx, uint64_t *bits, uint32_t bytes,
+                         uint8_t min_contrast);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAP_SD_H */
@@ -0,0 +1,110 @@
+#ifndef __NAV_H
+#define __NAV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "visual_odometry.h"
+#include "frame_bands.h"
+
+/*
+ * Camera navigation: one position fix per DCMI frame.
+ *
+ * Frames are tracked against the previous one (visual_odometry.h) and
+ * re-anchored on the reference map every NAV_ANCHOR_EVERY frames, or when
+ * tracking is lost, by correlating the frame against the 3x3 stored tiles
+ * (.SPT, NAV_TILE_N) around the current estimate with
+ * SpectrumCache_CorrelateBatch(). The tiles are those written by
+ * tools/spectrum_tile_gen with step NAV_TILE_STEP into NAV_TILE_DIR on the
+ * card. Before the first fix the estimate is NAV_START_X, NAV_START_Y.
+ *
+ * Increments and anchors whose peak-to-sidelobe ratio is below
+ * NAV_MIN_TRACK_PSR / NAV_MIN_ANCHOR_PSR are rejected. Each failed anchor
+ * widens the tile search by one ring (processed 9 tiles per batch), up to
+ * NAV_MAX_SEARCH_RADIUS rings around the estimate; a good anchor resets it
+ * to the 3x3 neighbourhood.
+ *
+ * Tiles are read through the PSRAM cache (spectrum_cache.h). After each
+ * frame the tiles within NAV_PREFETCH_RADIUS rings (or the current search
+ * radius, if wider) of the position are queued for prefetching, so an
+ * anchor over an area already flown, or just reached, does not touch the
+ * card.
+ *
+ * Attached to the frame bands of the camera (Nav_AttachBands()), the
+ * tracking transform runs on the rows as they are captured, and
+ * Nav_ProcessFrame() at the frame end only finishes it.
+ *
+ * Nav_ProcessFrame() runs in the camera task; Nav_GetPosition() may be
+ * called from any task.
+ */
+
+#ifndef NAV_TRACK_N
+#define NAV_TRACK_N            128U
+#endif
+
+#ifndef NAV_TRACK_POOL
+#define NAV_TRACK_POOL         2U
+#endif
+
+#ifndef NAV_TILE_N
+#define NAV_TILE_N             128U
+#endif
+
+#ifndef NAV_TILE_STEP
+#define NAV_TILE_STEP          64
+#endif
+
+#ifndef NAV_TILE_DIR
+#define NAV_TILE_DIR           "SPT"
+#endif
+
+#ifndef NAV_ANCHOR_EVERY
+#define NAV_ANCHOR_EVERY       10U
+#endif
+
+#ifndef NAV_MIN_TRACK_PSR
+#define NAV_MIN_TRACK_PSR      8.0f
+#endif
+
+#ifndef NAV_MIN_ANCHOR_PSR
+#define NAV_MIN_ANCHOR_PSR     8.0f
+#endif
+
+#ifndef NAV_MAX_SEARCH_RADIUS
+#define NAV_MAX_SEARCH_RADIUS  3
+#endif
+
+#ifndef NAV_PREFETCH_RADIUS
+#define NAV_PREFETCH_RADIUS    1
+#endif
+
+#ifndef NAV_START_X
+#define NAV_START_X            0.0f
+#endif
+
+#ifndef NAV_START_Y
+#define NAV_START_Y            0.0f
+#endif
+
+/* Ring log (ring_log.h) record type of a position_fix_t */
+#define NAV_LOG_FIX            1U
+
+typedef enum
+{
+    NAV_OK = 0,
+    NAV_ERROR = -1
+} Nav_Status;
+
+int  Nav_Init(void);
+int  Nav_AttachBands(frame_bands_t *fb);
+int  Nav_ProcessFrame(const uint8_t *frame, uint32_t width, uint32_t height);
+void Nav_GetPosition(position_fix_t *pos);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __NAV_H */
@@ -97,6 +97,15 @@ typedef struct
   uint32_t Config_NightMode;
 } OV5640_Capabilities_t;
 
+typedef struct
+{
+  uint16_t Width;       /*!< Output width in pixels, a multiple of 4                     */
+  uint16_t Height;      /*!< Output height in lines, a multiple of 2                     */
+  int16_t  OffsetX;     /*!< Window centre right of the field centre, in output pixels   */
+  int16_t  OffsetY;     /*!< Window centre below the field centre, in output lines       */
+  uint32_t Decimation;  /*!< Array pixels per output pixel and how: OV5640_SUBSAMPLE_2x2 .. */
+} OV5640_Window_t;
+
 typedef struct
 {
   int32_t (*Init)(OV5640_Object_t *, uint32_t, uint32_t);
@@ -126,6 +135,7 @@ typedef struct
   */
 #define OV5640_OK                      (0)
 #define OV5640_ERROR                   (-1)
+#define OV5640_TIMEOUT                 (-2)
 /**
   * @brief  OV5640 Features Parameters
   */
@@ -151,6 +161,14 @@ typedef struct
 #define OV5640_POLARITY_VSYNC_LOW       0x01U /* Signal Active Low          */
 #define OV5640_POLARITY_VSYNC_HIGH      0x00U /* Signal Active High         */
 
+/* Window decimation (OV5640_SetWindow): the sensor reads every other array
+   pixel (subsampling) or averages 2x2 (binning); the 4x4 modes also have the
+   ISP scale 2:1, the array to pixel ratio of the resolutions above */
+#define OV5640_SUBSAMPLE_2x2            0x00U   /* 2x2, sensor skipping       */
+#define OV5640_BINNING_2x2              0x01U   /* 2x2, sensor binning        */
+#define OV5640_SUBSAMPLE_4x4            0x02U   /* 4x4, skipping + ISP scale  */
+#define OV5640_BINNING_4x4              0x03U   /* 4x4, binning + ISP scale   */
+
 /* Mirror/Flip */
 #define OV5640_MIRROR_FLIP_NONE         0x00U   /* Set camera normal mode     */
 #define OV5640_FLIP                     0x01U   /* Set camera flip config     */
@@ -223,6 +241,13 @@ int32_t OV5640_MirrorFlipConfig(OV5640_Object_t *pObj, uint32_t Config);
 int32_t OV5640_ZoomConfig(OV5640_Object_t *pObj, uint32_t Zoom);
 int32_t OV5640_SetResolution(OV5640_Object_t *pObj, uint32_t Resolution);
 int32_t OV5640_GetResolution(OV5640_Object_t *pObj, uint32_t *Resolution);
+int32_t OV5640_SetWindow(OV5640_Object_t *pObj, const OV5640_Window_t *pWindow);
+int32_t OV5640_GetWindow(OV5640_Object_t *pObj, OV5640_Window_t *pWindow);
+int32_t OV5640_WaitAutoExposure(OV5640_Object_t *pObj, uint32_t Timeout);
+int32_t OV5640_SetExposure(OV5640_Object_t *pObj, uint32_t Exposure, uint32_t Gain);
+int32_t OV5640_GetExposure(OV5640_Object_t *pObj, uint32_t *Exposure, uint32_t *Gain);
+int32_t OV5640_GetMaxExposure(OV5640_Object_t *pObj, uint32_t *Exposure);
+int32_t OV5640_GetGammaCurve(OV5640_Object_t *pObj, uint8_t *Curve);
 int32_t OV5640_SetPixelFormat(OV5640_Object_t *pObj, uint32_t PixelFormat);
 int32_t OV5640_GetPixelFormat(OV5640_Object_t *pObj, uint32_t *PixelFormat);
 int32_t OV5640_SetPolarities(OV5640_Object_t *pObj, uint32_t PclkPolarity, uint32_t HrefPolarity,
@@ -14,6 +14,10 @@ extern "C" {
 //=======================================================================================================
 extern I2C_HandleTypeDef hi2c1;
 
+// Bound on a transfer, in ms: 10 plus a byte time at 100 kHz (~0.1 ms) per data
+// byte, rounded up, so a stuck bus fails the call instead of hanging the boot
+#define OV5640_IO_TIMEOUT(len)  (10U + (((uint32_t)(len) + 9U) / 10U))
+
 //=======================================================================================================
 //												FUNCTIONS
 //=======================================================================================================
@@ -0,0 +1,134 @@
+#ifndef __RING_LOG_H
+#define __RING_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Append-only ring of fixed-size records over a contiguous run of sectors
+ * (ring_log_sd.c reserves one as a file), for telemetry written faster
+ * than a FatFs file could take it: no FAT or directory update, ever.
+ *
+ * Sector 0 of the region is the header (ring_log_header_t). Its id seeds
+ * the CRC of every record, so records left in the region by an earlier
+ * ring, or any other data, never pass as this ring's. Sectors 1 ..
+ * sectors - 1 hold RING_LOG_PER_SECTOR records each, in order, wrapping
+ * around at the end. Every record carries a sequence number one above the
+ * previous record's, and a CRC-32.
+ *
+ * Records gather in a buffer of buf_sectors sectors and go to the card in
+ * one multi-sector write when it is full (a cluster: one CMD25 stream),
+ * or on RingLog_Flush(), which writes the partly filled sector too; that
+ * one is written again, with more records, by the next write.
+ *
+ * RingLog_SinkPut() / RingLog_SinkFlush() make a ring the sink of a
+ * writer stream (sd_writer.h): its producers queue records and the writer
+ * task appends them.
+ *
+ * RingLog_Open() finds the newest record with a binary search over the
+ * first record of each sector (sequence numbers run up to the newest one,
+ * and are older or invalid after it): about log2(sectors) sector reads.
+ * Appending continues after it.
+ */
+
+#define RING_LOG_SECTOR         512U
+#define RING_LOG_RECORD         64U
+#define RING_LOG_PER_SECTOR     (RING_LOG_SECTOR / RING_LOG_RECORD)
+#define RING_LOG_PAYLOAD        48U
+
+#define RING_LOG_MAGIC          0x474F4C52UL    /* "RLOG" */
+#define RING_LOG_VERSION        1U
+#define RING_LOG_RECORD_MAGIC   0xA55AU
+
+/* Record types; the rest are free for the application */
+#define RING_LOG_TEXT           0U              /* payload: len characters */
+
+typedef enum
+{
+    RING_LOG_OK = 0,
+    RING_LOG_ERROR = -1,
+    RING_LOG_INVALID_PARAM = -2,
+    RING_LOG_NO_RING = -3           /* No valid header in the region */
+} RingLog_Status;
+
+/* The card: 0 = OK. sync, if any, makes written sectors durable. */
+typedef struct
+{
+    int   (*read)(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count);
+    int   (*write)(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count);
+    int   (*sync)(void *ctx);
+    void  *ctx;
+} ring_log_dev_t;
+
+typedef struct
+{
+    uint32_t magic;             /* RING_LOG_MAGIC */
+    uint16_t version;           /* RING_LOG_VERSION */
+    uint16_t record;            /* RING_LOG_RECORD */
+    uint32_t id;                /* Seeds the record CRCs */
+    uint32_t sectors;           /* Of the region, header included */
+    uint32_t crc;               /* CRC-32 of the fields above */
+} ring_log_header_t;
+
+typedef struct
+{
+    uint16_t magic;             /* RING_LOG_RECORD_MAGIC */
+    uint8_t  type;
+    uint8_t  len;               /* Payload bytes used */
+    uint32_t seq;
+    uint32_t time_ms;
+    uint8_t  payload[RING_LOG_PAYLOAD];
+    uint32_t crc;               /* CRC-32 of the record up to here, seeded with the ring id */
+} ring_log_record_t;
+
+typedef struct
+{
+    uint32_t appended;
+    uint32_t writes;            /* Multi-sector writes */
+    uint32_t sectors_written;
+    uint32_t wraps;
+    uint32_t open_reads;        /* Sector reads of the last RingLog_Open() */
+    uint32_t errors;
+} ring_log_stats_t;
+
+typedef struct
+{
+    ring_log_dev_t      dev;
+    uint32_t            base;           /* First sector of the region (the header) */
+    uint32_t            sectors;        /* Record sectors: region - 1 */
+    uint32_t            id;
+
+    uint8_t            *buf;
+    uint32_t            buf_sectors;
+    uint32_t            buf_first;      /* Record sector held by buf[0] */
+    uint32_t            buf_records;    /* Records in buf */
+    uint32_t            buf_written;    /* Records of buf already on the card */
+
+    uint32_t            next_seq;
+    ring_log_stats_t    stats;
+} ring_log_t;
+
+/* Called oldest record first; returns 0 to go on */
+typedef int (*ring_log_visit_fn)(void *ctx, const ring_log_record_t *rec);
+
+int  RingLog_Init(ring_log_t *log, const ring_log_dev_t *dev, uint32_t base, uint32_t sectors,
+                  uint8_t *buf, uint32_t buf_sectors);
+int  RingLog_Format(ring_log_t *log, uint32_t id);
+int  RingLog_Open(ring_log_t *log);
+int  RingLog_Append(ring_log_t *log, uint8_t type, uint32_t time_ms, const void *payload, uint32_t len);
+int  RingLog_Flush(ring_log_t *log);
+int  RingLog_SinkPut(void *ctx, const uint8_t *src, uint32_t len);
+int  RingLog_SinkFlush(void *ctx);
+int  RingLog_ForEach(ring_log_t *log, ring_log_visit_fn fn, void *ctx);
+void RingLog_GetStats(const ring_log_t *log, ring_log_stats_t *stats);
+
+int  RingLog_CheckRecord(const ring_log_record_t *rec, uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RING_LOG_H */
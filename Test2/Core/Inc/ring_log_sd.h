@@ -0,0 +1,33 @@
+#ifndef __RING_LOG_SD_H
+#define __RING_LOG_SD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ring_log.h"
+#include "sd_region.h"
+
+/*
+ * A ring log (ring_log.h) in a file of a mounted FatFs volume, reserved
+ * as one contiguous region (sd_region.h): logging never changes FAT or
+ * directory, and mixes safely with file access from other tasks. The ring
+ * itself belongs to one task at a time.
+ *
+ * A file without a valid ring header gets a new, empty ring named id.
+ */
+
+typedef struct
+{
+    ring_log_t   log;
+    sd_region_t  region;
+} ring_log_sd_t;
+
+int RingLogSD_Open(ring_log_sd_t *rl, const char *path, uint32_t bytes, uint8_t *buf, uint32_t buf_sectors,
+                   uint32_t id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RING_LOG_SD_H */
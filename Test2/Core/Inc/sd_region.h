@@ -0,0 +1,50 @@
+#ifndef __SD_REGION_H
+#define __SD_REGION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "ff.h"
+
+/*
+ * A file of a mounted FatFs volume reserved as one contiguous run of
+ * sectors, for writers that go around FatFs (ring_log_sd.h, sd_writer).
+ *
+ * SdRegion_Reserve() creates the file bytes long with f_expand() on first
+ * use, or takes it as it is, provided it is still contiguous. The file is
+ * closed again; the region's sectors are then read and written straight
+ * through the disk I/O layer, so FAT and directory never change. Each
+ * access holds the volume's lock (_FS_REENTRANT), so it mixes safely with
+ * file access from other tasks. Read / Write / Sync take the region as
+ * ctx and absolute sector numbers.
+ */
+
+typedef enum
+{
+    SD_REGION_OK = 0,
+    SD_REGION_ERROR = -1,
+    SD_REGION_INVALID_PARAM = -2,
+    SD_REGION_FRAGMENTED = -3           /* The file exists but is not contiguous */
+} SdRegion_Status;
+
+typedef struct
+{
+    FATFS     *fs;
+    uint32_t   base;            /* First sector */
+    uint32_t   sectors;
+    uint32_t   cluster;         /* Sectors per cluster; base is on a cluster boundary */
+} sd_region_t;
+
+int SdRegion_Reserve(sd_region_t *r, const char *path, uint32_t bytes);
+int SdRegion_Read(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count);
+int SdRegion_Write(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count);
+int SdRegion_Sync(void *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_REGION_H */
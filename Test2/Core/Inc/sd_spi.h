@@ -5,31 +5,35 @@
 extern "C" {
 #endif
 
-#include "main.h"
 #include <stdint.h>
 
 /*
- * Configure these names to match your CubeMX-generated handles/pins.
- *
- * Example:
- *   SPI_HandleTypeDef hspi1;
- *   #define SD_SPI_HANDLE hspi1
- *
- *   #define SD_CS_GPIO_Port GPIOB
- *   #define SD_CS_Pin       GPIO_PIN_0
+ * The driver only speaks the SD protocol; the SPI port, chip select and
+ * time base come from an sd_spi_bus_t. On target that is sd_spi_hal.c
+ * (SPI3, DMA per block); on the host a mock card (tools/sd_mock.h).
  */
+typedef struct
+{
+    void     (*select)(void *ctx, int on);                            /* Chip select, asserted when on */
+    uint8_t  (*xchg)(void *ctx, uint8_t out);                         /* One byte each way */
+    int      (*receive)(void *ctx, uint8_t *dst, uint32_t bytes);     /* Clock 0xFF, keep MISO; 0 = OK */
+    int      (*transmit)(void *ctx, const uint8_t *src, uint32_t bytes); /* MISO ignored; 0 = OK */
+    uint32_t (*now_ms)(void *ctx);
+    void     *ctx;
+} sd_spi_bus_t;
 
-extern SPI_HandleTypeDef hspi3;
-
-#define SD_SPI_HANDLE      hspi3
-
-#ifndef SD_CS_GPIO_Port
-#error "Define SD_CS_GPIO_Port in main.h or before including sd_spi.h"
-#endif
+/* receive / transmit may be 0: the block is then moved with xchg() */
 
-#ifndef SD_CS_Pin
-#error "Define SD_CS_Pin in main.h or before including sd_spi.h"
-#endif
+typedef struct
+{
+    uint32_t commands;          /* Command frames sent */
+    uint32_t read_blocks;
+    uint32_t write_blocks;
+    uint32_t read_streams;      /* CMD18 issued */
+    uint32_t write_streams;     /* CMD25 issued */
+    uint32_t joined;            /* Calls continuing an open stream */
+    uint32_t errors;
+} sd_spi_stats_t;
 
 typedef enum
 {
@@ -38,12 +42,16 @@ typedef enum
     SD_SPI_TIMEOUT = -2
 } SD_SPI_Status;
 
+void SD_SPI_SetBus(const sd_spi_bus_t *bus);
+
 /* Public API used by FatFs user_diskio.c */
 int SD_SPI_Init(void);
 int SD_SPI_ReadBlocks(uint8_t *buff, uint32_t sector, uint32_t count);
 int SD_SPI_WriteBlocks(const uint8_t *buff, uint32_t sector, uint32_t count);
+int SD_SPI_Sync(void);
 uint32_t SD_SPI_GetSectorCount(void);
 void SD_SPI_ReleaseBus(void);
+void SD_SPI_GetStats(sd_spi_stats_t *stats);
 
 #ifdef __cplusplus
 }
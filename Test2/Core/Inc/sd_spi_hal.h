@@ -0,0 +1,50 @@
+#ifndef __SD_SPI_HAL_H
+#define __SD_SPI_HAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "sd_spi.h"
+
+/*
+ * Configure these names to match your CubeMX-generated handles/pins.
+ *
+ * Example:
+ *   SPI_HandleTypeDef hspi1;
+ *   #define SD_SPI_HANDLE hspi1
+ *
+ *   #define SD_CS_GPIO_Port GPIOB
+ *   #define SD_CS_Pin       GPIO_PIN_0
+ */
+
+extern SPI_HandleTypeDef hspi3;
+
+#define SD_SPI_HANDLE      hspi3
+
+#ifndef SD_CS_GPIO_Port
+#error "Define SD_CS_GPIO_Port in main.h or before including sd_spi_hal.h"
+#endif
+
+#ifndef SD_CS_Pin
+#error "Define SD_CS_Pin in main.h or before including sd_spi_hal.h"
+#endif
+
+/*
+ * Blocks go over DMA1 stream 1 (RX) and stream 2 (TX) while the scheduler
+ * runs, the calling task sleeping meanwhile; before that (FatFs is first
+ * mounted from main()) each block is one polled transfer. Set to 0 to
+ * always poll.
+ */
+#ifndef SD_SPI_HAL_DMA
+#define SD_SPI_HAL_DMA     1
+#endif
+
+int SD_SPI_HAL_Init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_SPI_HAL_H */
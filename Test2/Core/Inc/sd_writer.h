@@ -0,0 +1,181 @@
+#ifndef __SD_WRITER_H
+#define __SD_WRITER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Background writer: producers hand buffers to a writer task and go on,
+ * the task puts them on the card.
+ *
+ * A stream is a pre-allocated region of the card (sd_region.h), written
+ * from its start and, with wrap, around again. SdWriter_Submit() queues a
+ * buffer on a stream without copying it; the producer gets it back
+ * through its release function once it is on the card, or was dropped.
+ * Each stream has its own bounded queue (depth buffers waiting, and the
+ * one being written), and its own backpressure policy when that is full:
+ *
+ *   SD_WRITER_BLOCK        the producer waits for room, up to its timeout
+ *   SD_WRITER_DROP_OLDEST  the oldest waiting buffer is released unwritten
+ *                          (SD_WRITER_DROPPED), the new one takes its place
+ *
+ * The writer takes buffers oldest first across streams. Writes are
+ * cluster-aligned: whole clusters of a buffer go to the card straight
+ * from it, at most SD_WRITER_MAX_RUN clusters per call so other card
+ * users get their turn, and the rest is gathered in the stream's cluster
+ * buffer (stage) with what follows it. SdWriter_Flush() queues a marker
+ * that writes out the sectors gathered so far (a partly filled one is
+ * written again, completed, later). When the queues run empty the writer
+ * syncs the card (dev.sync).
+ *
+ * A sink stream (SdWriter_AddSink()) has no region: its buffers go, in
+ * order, to a device with a layout of its own, e.g. a ring log taking
+ * records (RingLog_SinkPut()), and a flush marker calls its flush. The
+ * device then belongs to the writer task.
+ *
+ * The module is portable: locking and waiting go through sd_writer_os_t
+ * (FreeRTOS in sd_writer_rtos.c, POSIX threads in tools/), the card
+ * through sd_writer_dev_t.
+ */
+
+#ifndef SD_WRITER_MAX_STREAMS
+#define SD_WRITER_MAX_STREAMS   4U
+#endif
+
+#ifndef SD_WRITER_MAX_RUN
+#define SD_WRITER_MAX_RUN       8U      /* Clusters per card call */
+#endif
+
+#define SD_WRITER_SECTOR        512U
+#define SD_WRITER_FOREVER       0xFFFFFFFFUL
+
+typedef enum
+{
+    SD_WRITER_OK = 0,
+    SD_WRITER_ERROR = -1,
+    SD_WRITER_INVALID_PARAM = -2,
+    SD_WRITER_FULL = -3,            /* Queue full (BLOCK stream, timeout): not queued */
+    SD_WRITER_DROPPED = -4,         /* Released unwritten to make room */
+    SD_WRITER_END = -5              /* The stream's region is full (no wrap) */
+} SdWriter_Status;
+
+typedef enum
+{
+    SD_WRITER_BLOCK = 0,
+    SD_WRITER_DROP_OLDEST = 1
+} SdWriter_Policy;
+
+/* Events the writer and producers wait on */
+typedef enum
+{
+    SD_WRITER_EV_WORK = 0,          /* A buffer was queued */
+    SD_WRITER_EV_SPACE = 1          /* A queue slot was freed */
+} SdWriter_Event;
+
+/*
+ * lock / unlock: a mutex. wait: until event is signalled (binary: signals
+ * while nobody waits leave one pending), 0 if it was, nonzero on timeout.
+ */
+typedef struct
+{
+    void  (*lock)(void *ctx);
+    void  (*unlock)(void *ctx);
+    int   (*wait)(void *ctx, int event, uint32_t timeout_ms);
+    void  (*signal)(void *ctx, int event);
+    void  *ctx;
+} sd_writer_os_t;
+
+/* The card: 0 = OK. Sectors are absolute. */
+typedef struct
+{
+    int   (*write)(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count);
+    int   (*sync)(void *ctx);
+    void  *ctx;
+} sd_writer_dev_t;
+
+/* A sink: put takes one buffer, flush makes what was put durable; 0 = OK */
+typedef struct
+{
+    int   (*put)(void *ctx, const uint8_t *src, uint32_t len);
+    int   (*flush)(void *ctx);
+    void  *ctx;
+} sd_writer_sink_t;
+
+/* The buffer data is free again: written (SD_WRITER_OK), dropped or failed */
+typedef void (*sd_writer_release_fn)(void *ctx, const uint8_t *data, int status);
+
+typedef struct
+{
+    const uint8_t        *data;         /* 0: flush marker */
+    uint32_t              len;
+    sd_writer_release_fn  release;
+    void                 *ctx;
+    uint32_t              ticket;       /* Submission order across streams */
+} sd_writer_job_t;
+
+typedef struct
+{
+    uint32_t submitted;
+    uint32_t written;           /* Buffers on the card */
+    uint32_t dropped;
+    uint32_t rejected;          /* SD_WRITER_FULL */
+    uint32_t waits;             /* Times a BLOCK producer had to wait */
+    uint32_t max_queued;
+    uint64_t bytes;
+    uint32_t writes;            /* Card calls */
+    uint32_t sectors;
+    uint32_t wraps;
+    uint32_t errors;
+} sd_writer_stream_stats_t;
+
+typedef struct
+{
+    sd_writer_dev_t           dev;
+    sd_writer_sink_t          sink;         /* put == 0 but for a sink stream */
+    uint32_t                  base;         /* First sector, on a cluster boundary */
+    uint32_t                  clusters;     /* Whole clusters of the region */
+    uint32_t                  cluster;      /* Sectors per cluster (or a power-of-two part of one) */
+    SdWriter_Policy           policy;
+    int                       wrap;
+
+    uint8_t                  *stage;        /* One cluster */
+    uint32_t                  stage_fill;   /* Bytes */
+    uint32_t                  stage_written;/* Sectors of the stage on the card */
+    uint32_t                  pos;          /* Cluster the stage will be written to */
+    int                       unsynced;     /* Written since the last dev.sync */
+
+    sd_writer_job_t          *jobs;
+    uint32_t                  depth;
+    uint32_t                  head;
+    uint32_t                  queued;
+    sd_writer_stream_stats_t  stats;
+} sd_writer_stream_t;
+
+typedef struct
+{
+    sd_writer_os_t       os;
+    sd_writer_stream_t  *streams[SD_WRITER_MAX_STREAMS];
+    uint32_t             count;
+    uint32_t             ticket;
+} sd_writer_t;
+
+int  SdWriter_Init(sd_writer_t *w, const sd_writer_os_t *os);
+int  SdWriter_AddStream(sd_writer_t *w, sd_writer_stream_t *s, const sd_writer_dev_t *dev, uint32_t base,
+                        uint32_t sectors, uint32_t cluster, uint8_t *stage, sd_writer_job_t *jobs, uint32_t depth,
+                        SdWriter_Policy policy, int wrap);
+int  SdWriter_AddSink(sd_writer_t *w, sd_writer_stream_t *s, const sd_writer_sink_t *sink,
+                      sd_writer_job_t *jobs, uint32_t depth, SdWriter_Policy policy);
+int  SdWriter_Submit(sd_writer_t *w, sd_writer_stream_t *s, const uint8_t *data, uint32_t len,
+                     sd_writer_release_fn release, void *ctx, uint32_t timeout_ms);
+int  SdWriter_Flush(sd_writer_t *w, sd_writer_stream_t *s, uint32_t timeout_ms);
+int  SdWriter_Service(sd_writer_t *w, uint32_t timeout_ms);
+void SdWriter_GetStats(sd_writer_t *w, const sd_writer_stream_t *s, sd_writer_stream_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_WRITER_H */
@@ -0,0 +1,43 @@
+#ifndef __SD_WRITER_RTOS_H
+#define __SD_WRITER_RTOS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "sd_region.h"
+#include "sd_writer.h"
+
+/*
+ * The background writer (sd_writer.h) as a FreeRTOS task, writing to
+ * files of the mounted FatFs volume reserved as contiguous regions
+ * (sd_region.h).
+ *
+ * SdWriterRTOS_Init(), then SdWriterRTOS_AddFile() for each stream, then
+ * SdWriterRTOS_Start(). Producers then use SdWriter_Submit() and
+ * SdWriter_Flush() on SdWriterRTOS_Writer() from any task; release
+ * functions run in the writer task. Its priority should be below that of
+ * the producers, which then only wait for the card when a BLOCK queue is
+ * full.
+ */
+
+#ifndef SD_WRITER_RTOS_STACK
+#define SD_WRITER_RTOS_STACK    512U        /* Words */
+#endif
+
+#ifndef SD_WRITER_RTOS_IDLE_MS
+#define SD_WRITER_RTOS_IDLE_MS  100U        /* Sync period when idle */
+#endif
+
+int          SdWriterRTOS_Init(void);
+int          SdWriterRTOS_AddFile(sd_writer_stream_t *s, sd_region_t *r, const char *path, uint32_t bytes,
+                                  uint8_t *stage, uint32_t stage_sectors, sd_writer_job_t *jobs, uint32_t depth,
+                                  SdWriter_Policy policy, int wrap);
+int          SdWriterRTOS_Start(uint32_t priority);
+sd_writer_t *SdWriterRTOS_Writer(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_WRITER_RTOS_H */
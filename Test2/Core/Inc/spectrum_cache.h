@@ -0,0 +1,70 @@
+#ifndef __SPECTRUM_CACHE_H
+#define __SPECTRUM_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "spectrum_sd.h"
+#include "tile_cache.h"
+
+/*
+ * Reference spectra (.SPT) cached in the QSPI PSRAM in front of the card.
+ *
+ * Tile (tx, ty) is the file DIR/TTTTUUUU.SPT written by
+ * tools/spectrum_tile_gen. SpectrumCache_Open() makes it resident (see
+ * tile_cache.h: LRU, fixed slots sized for float spectra of the FFT size
+ * given to SpectrumCache_Init()) and SpectrumCache_CorrelateBatch() streams
+ * the spectra out of the PSRAM exactly as SpectrumSD_CorrelateBatch() does
+ * out of the files. Missing tiles are remembered as missing.
+ *
+ * SpectrumCache_Prefetch() queues tiles that are likely to be needed soon;
+ * SpectrumCache_Service() loads them and is meant for a task of lower
+ * priority than the one correlating, so the card is read while that task
+ * waits for its next frame. All functions are thread safe. Service()
+ * reads the card without holding the cache: a load in progress delays an
+ * Open() or a correlation by one PSRAM page write at most, not by a tile.
+ * It keeps a second file open alongside a miss, within _FS_LOCK 2.
+ */
+
+#ifndef SPECTRUM_CACHE_BASE
+#define SPECTRUM_CACHE_BASE        0U
+#endif
+
+#ifndef SPECTRUM_CACHE_BYTES
+#define SPECTRUM_CACHE_BYTES       (8U * 1024U * 1024U)     /* APS6404L */
+#endif
+
+#ifndef SPECTRUM_CACHE_MAX_SLOTS
+#define SPECTRUM_CACHE_MAX_SLOTS   256U
+#endif
+
+/* Fewest slots that keep a 9-tile batch resident while prefetching */
+#define SPECTRUM_CACHE_MIN_SLOTS   16U
+
+/* APS6404L page: bursts are split so that none crosses one */
+#define SPECTRUM_CACHE_PAGE        1024U
+
+/* Slot for a tile of FFT size n, any quantisation */
+#define SPECTRUM_CACHE_SLOT_BYTES(n) \
+    ((((uint32_t)sizeof(spectrum_tile_header_t) + ((uint32_t)(n) * FFT_REAL_ROW_FLOATS(n) * (uint32_t)sizeof(float))) + \
+      SPECTRUM_CACHE_PAGE - 1U) & ~(SPECTRUM_CACHE_PAGE - 1U))
+
+#ifndef SPECTRUM_CACHE_BOUNCE_BYTES
+#define SPECTRUM_CACHE_BOUNCE_BYTES  4096U
+#endif
+
+int      SpectrumCache_Init(const char *dir, uint32_t n);
+int      SpectrumCache_Open(uint32_t tx, uint32_t ty, spectrum_tile_header_t *hdr, uint32_t *slot);
+int      SpectrumCache_CorrelateBatch(phase_corr_t *pc, const image_t *frame, const uint32_t *slots,
+                                      const spectrum_tile_header_t *hdrs, uint32_t count,
+                                      phase_corr_result_t *results, uint32_t *best);
+void     SpectrumCache_Prefetch(uint32_t tx, uint32_t ty);
+uint32_t SpectrumCache_Service(uint32_t max);
+void     SpectrumCache_GetStats(tile_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPECTRUM_CACHE_H */
@@ -0,0 +1,46 @@
+#ifndef __SPECTRUM_SD_H
+#define __SPECTRUM_SD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ff.h"
+#include "phase_corr.h"
+#include "phase_corr_batch.h"
+#include "spectrum_tile.h"
+
+/*
+ * On-target loader for precomputed reference spectra (.SPT, see
+ * spectrum_tile.h). The file is streamed through FatFs in chunks of
+ * SPECTRUM_SD_CHUNK_ROWS spectrum rows straight into the cross-power step,
+ * so the full reference spectrum never needs to be in RAM.
+ */
+
+#ifndef SPECTRUM_SD_CHUNK_ROWS
+#define SPECTRUM_SD_CHUNK_ROWS     8U
+#endif
+
+typedef enum
+{
+    SPECTRUM_SD_OK = 0,
+    SPECTRUM_SD_ERROR = -1,
+    SPECTRUM_SD_BAD_FILE = -2,
+    SPECTRUM_SD_REJECTED = -3           /* Correlation below the pc confidence threshold */
+} SpectrumSD_Status;
+
+int SpectrumSD_Open(FIL *fp, const char *path, spectrum_tile_header_t *hdr);
+int SpectrumSD_Correlate(phase_corr_t *pc, const image_t *frame, FIL *fp,
+                         const spectrum_tile_header_t *hdr, phase_corr_result_t *result);
+int SpectrumSD_CorrelateSource(phase_corr_t *pc, const image_t *frame, const spectrum_source_t *src,
+                               const spectrum_tile_header_t *hdrs, uint32_t count,
+                               phase_corr_result_t *results, uint32_t *best);
+int SpectrumSD_CorrelateBatch(phase_corr_t *pc, const image_t *frame, FIL *files,
+                              const spectrum_tile_header_t *hdrs, uint32_t count,
+                              phase_corr_result_t *results, uint32_t *best);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPECTRUM_SD_H */
@@ -29,9 +29,23 @@ void USB_SendBuffer(uint8_t *buf, uint32_t len)
     USB_SendNextChunk();
 }
 
-void USB_SendFrame(uint8_t *frame, uint32_t len)
+/*
+ * Called from the USB interrupt when a frame given to USB_SendFrame() is
+ * sent. Resumes the camera; the application overrides it when it owns the
+ * frame buffers.
+ */
+__weak void USB_FrameSent(uint8_t *frame)
+{
+    (void)frame;
+
+    // Resume DCMI
+    HAL_DCMI_Resume(&hdcmi);
+}
+
+// Returns 0 when the frame is being sent, -1 when a send is still going on
+int USB_SendFrame(uint8_t *frame, uint32_t len)
 {
-    if (tx_state != USB_TX_IDLE) return;  // busy
+    if (tx_state != USB_TX_IDLE) return -1;  // busy
 
     const uint8_t sync[4] = {0xAA, 0x55, 0xAA, 0x55};
 
@@ -50,6 +64,8 @@ void USB_SendFrame(uint8_t *frame, uint32_t len)
     tx_state = USB_TX_HEADER;
 
     USB_SendNextChunk();
+
+    return 0;
 }
 
 void USB_SendNextChunk(void)
@@ -69,10 +85,14 @@ void USB_SendNextChunk(void)
         else
         {
             // all done
+            const usb_tx_state_t done = tx_state;
+
             tx_state = USB_TX_IDLE;
 
-    		// Resume DCMI
-    		HAL_DCMI_Resume(&hdcmi);
+            if (done == USB_TX_PAYLOAD)
+            {
+                USB_FrameSent(payload_buf);
+            }
 
             return;
         }
@@ -0,0 +1,423 @@
+#include "auto_exposure.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Halvings of the log scale range when solving for the mean */
+#define AUTO_EXPOSURE_SOLVE_STEPS   16U
+
+
+/* Settings frame seq was taken with */
+static const auto_exposure_setting_t *AutoExposure_Setting(const auto_exposure_t *ae, uint32_t seq)
+{
+    uint32_t i = ae->settings - 1U;
+
+    while ((i > 0U) && ((int32_t)(seq - ae->history[i].from_seq) < 0))
+    {
+        i--;
+    }
+
+    return &ae->history[i];
+}
+
+
+/* Exposure x gain in exposure units at 1x */
+static float AutoExposure_Total(const auto_exposure_t *ae, const auto_exposure_setting_t *s)
+{
+    return (float)s->exposure * (float)s->gain / (float)ae->cfg.min_gain;
+}
+
+
+/* Level out of signal x (0 .. 256, beyond saturated), between the entries of the curve */
+static float AutoExposure_Level(const auto_exposure_t *ae, float x)
+{
+    if (x >= 255.0f)
+    {
+        const float top = (float)ae->curve[255];
+
+        return (x >= 256.0f) ? 255.0f : (top + ((255.0f - top) * (x - 255.0f)));
+    }
+
+    const uint32_t i = (uint32_t)x;
+
+    return (float)ae->curve[i] + (((float)ae->curve[i + 1U] - (float)ae->curve[i]) * (x - (float)i));
+}
+
+
+/* Signal giving level (0 .. 255), the inverse of AutoExposure_Level() */
+static float AutoExposure_Signal(const auto_exposure_t *ae, float level)
+{
+    uint32_t i = 0U;
+
+    while ((i < 255U) && ((float)ae->curve[i + 1U] < level))
+    {
+        i++;
+    }
+
+    const float lo = (float)ae->curve[i];
+    const float hi = (i < 255U) ? (float)ae->curve[i + 1U] : 255.0f;
+
+    if (hi <= lo)
+    {
+        return (float)i + ((level > lo) ? 1.0f : 0.0f);
+    }
+
+    const float x = (float)i + ((level - lo) / (hi - lo));
+
+    return (x > (float)i) ? x : (float)i;
+}
+
+
+/* Sum of the levels of the frame with its signal scaled by s, saturating */
+static float AutoExposure_PredictSum(const auto_exposure_t *ae, const uint32_t hist[256], float s)
+{
+    float sum = 0.0f;
+
+    for (uint32_t l = 0; l < 256U; l++)
+    {
+        if (hist[l] != 0U)
+        {
+            sum += (float)hist[l] * AutoExposure_Level(ae, ae->signal[l] * s);
+        }
+    }
+
+    return sum;
+}
+
+
+/* Signal scale putting the mean on target, within [lo, hi] */
+static float AutoExposure_SolveMean(const auto_exposure_t *ae, const uint32_t hist[256], uint32_t pixels,
+                                    float lo, float hi)
+{
+    const float want = ae->cfg.target_mean * (float)pixels;
+    float log_lo = logf(lo);
+    float log_hi = logf(hi);
+
+    if (AutoExposure_PredictSum(ae, hist, hi) <= want)
+    {
+        return hi;
+    }
+
+    if (AutoExposure_PredictSum(ae, hist, lo) >= want)
+    {
+        return lo;
+    }
+
+    for (uint32_t i = 0; i < AUTO_EXPOSURE_SOLVE_STEPS; i++)
+    {
+        const float mid = 0.5f * (log_lo + log_hi);
+
+        if (AutoExposure_PredictSum(ae, hist, expf(mid)) < want)
+        {
+            log_lo = mid;
+        }
+        else
+        {
+            log_hi = mid;
+        }
+    }
+
+    return expf(0.5f * (log_lo + log_hi));
+}
+
+
+/*
+ * Signal scale keeping all but max_clipped of the pixels below clip_level.
+ * If some of those are saturated their signal is extrapolated from the
+ * brightest unsaturated ones, as far below the saturated fraction again.
+ * After a step down from a frame not mostly saturated, with pixels still
+ * saturated, the saturated fraction is also taken as a power of exposure x
+ * gain through the two settings: bright areas apart from the rest are
+ * where extrapolation from below falls short. That step is at most
+ * AUTO_EXPOSURE_SATURATED_STEP, no more than a blind one.
+ */
+static float AutoExposure_SolveClip(const auto_exposure_t *ae, const uint32_t hist[256], uint32_t pixels,
+                                    float total)
+{
+    const float allowed = ae->cfg.max_clipped * (float)pixels;
+    const float clip = AutoExposure_Signal(ae, (float)ae->cfg.clip_level);
+    const uint32_t saturated = hist[255];
+    uint32_t above = 0U;
+    uint32_t l = 255U;
+
+    /* Brightest level that must end up below clip_level */
+    while ((l > 0U) && ((float)(above + hist[l]) <= allowed))
+    {
+        above += hist[l];
+        l--;
+    }
+
+    if (l < 255U)
+    {
+        return clip / AutoExposure_Signal(ae, (float)(l + 1U));
+    }
+
+    if ((2U * saturated) >= pixels)
+    {
+        return AUTO_EXPOSURE_SATURATED_STEP;
+    }
+
+    /* Signal of the pixel twice the saturated fraction down */
+    above = saturated;
+    l = 254U;
+
+    while ((l > 0U) && ((above + hist[l]) < (2U * saturated)))
+    {
+        above += hist[l];
+        l--;
+    }
+
+    const float top = AutoExposure_Signal(ae, 255.0f);
+    const float x = top + ((top - ae->signal[l]) * ((float)saturated - allowed) / (float)saturated);
+    float step = clip / x;
+
+    if ((ae->prev_saturated_total > (total * (1.0f + ae->cfg.tolerance))) && (ae->prev_saturated < 0.5f))
+    {
+        const float now = (float)saturated / (float)pixels;
+        float secant = (now >= ae->prev_saturated) ? AUTO_EXPOSURE_SATURATED_STEP :
+                       expf(logf(allowed / (float)saturated) * logf(ae->prev_saturated_total / total) /
+                            logf(ae->prev_saturated / now));
+
+        secant = (secant < AUTO_EXPOSURE_SATURATED_STEP) ? AUTO_EXPOSURE_SATURATED_STEP : secant;
+        step = (secant < step) ? secant : step;
+    }
+
+    return step;
+}
+
+
+int AutoExposure_Init(auto_exposure_t *ae, const auto_exposure_config_t *cfg,
+                      auto_exposure_apply_fn apply, void *apply_ctx,
+                      uint32_t exposure, uint32_t gain)
+{
+    if ((ae == 0) || (cfg == 0) || (apply == 0) ||
+        (cfg->target_mean <= 0.0f) || (cfg->target_mean >= 255.0f) ||
+        (cfg->max_clipped < 0.0f) || (cfg->max_clipped >= 1.0f) ||
+        (cfg->clip_level == 0U) || (cfg->clip_level > 255U) ||
+        (cfg->tolerance < 0.0f) || (cfg->max_step <= 1.0f) ||
+        (cfg->min_exposure == 0U) || (cfg->min_exposure > cfg->max_exposure) ||
+        (cfg->min_gain == 0U) || (cfg->min_gain > cfg->max_gain) ||
+        (cfg->delay > AUTO_EXPOSURE_MAX_DELAY))
+    {
+        return AUTO_EXPOSURE_INVALID_PARAM;
+    }
+
+    memset(ae, 0, sizeof(*ae));
+
+    ae->cfg = *cfg;
+    ae->apply = apply;
+    ae->apply_ctx = apply_ctx;
+
+    for (uint32_t l = 0; l < 256U; l++)
+    {
+        ae->curve[l] = (cfg->curve != 0) ? cfg->curve[l] : (uint8_t)l;
+
+        if ((l > 0U) && (ae->curve[l] < ae->curve[l - 1U]))
+        {
+            return AUTO_EXPOSURE_INVALID_PARAM;
+        }
+    }
+
+    ae->cfg.curve = ae->curve;
+
+    for (uint32_t l = 0; l < 256U; l++)
+    {
+        ae->signal[l] = AutoExposure_Signal(ae, (float)l + 0.5f);
+    }
+
+    exposure = (exposure < cfg->min_exposure) ? cfg->min_exposure : exposure;
+    exposure = (exposure > cfg->max_exposure) ? cfg->max_exposure : exposure;
+    gain = (gain < cfg->min_gain) ? cfg->min_gain : gain;
+    gain = (gain > cfg->max_gain) ? cfg->max_gain : gain;
+
+    ae->history[0].from_seq = 0U;
+    ae->history[0].exposure = exposure;
+    ae->history[0].gain = gain;
+    ae->settings = 1U;
+
+    /* Manual from here on, whatever the sensor was doing */
+    if (apply(apply_ctx, exposure, gain) != 0)
+    {
+        ae->errors++;
+        return AUTO_EXPOSURE_ERROR;
+    }
+
+    ae->applied++;
+
+    return AUTO_EXPOSURE_OK;
+}
+
+
+/* Seq of the next frame (the capture's frame count), when frames may be dropped */
+void AutoExposure_SetSeq(auto_exposure_t *ae, uint32_t seq)
+{
+    ae->seq = seq;
+}
+
+
+/*
+ * One frame's histogram (pixels counted in all): the settings it calls
+ * for are applied, unless within cfg.tolerance of the latest.
+ * AUTO_EXPOSURE_ERROR if the sensor refused them (tried again next frame).
+ */
+int AutoExposure_Frame(auto_exposure_t *ae, const uint32_t hist[256], uint32_t pixels)
+{
+    if ((ae == 0) || (hist == 0) || (pixels == 0U))
+    {
+        return AUTO_EXPOSURE_INVALID_PARAM;
+    }
+
+    const uint32_t seq = ae->seq++;
+    const auto_exposure_setting_t *used = AutoExposure_Setting(ae, seq);
+    const auto_exposure_setting_t *latest = &ae->history[ae->settings - 1U];
+    const float lo = 1.0f / ae->cfg.max_step;
+    uint32_t clipped = 0U;
+    float sum = 0.0f;
+
+    for (uint32_t l = 0; l < 256U; l++)
+    {
+        sum += (float)l * (float)hist[l];
+        clipped += (l >= ae->cfg.clip_level) ? hist[l] : 0U;
+    }
+
+    ae->mean = sum / (float)pixels;
+    ae->clipped = (float)clipped / (float)pixels;
+    ae->frames++;
+
+    /* Saturated fraction at these settings and at the ones before */
+    const float used_total = AutoExposure_Total(ae, used);
+
+    if (used_total != ae->saturated_total)
+    {
+        ae->prev_saturated = ae->saturated;
+        ae->prev_saturated_total = ae->saturated_total;
+        ae->saturated_total = used_total;
+    }
+
+    ae->saturated = (float)hist[255] / (float)pixels;
+
+    /* Scale of exposure x gain */
+    const float clip = AutoExposure_SolveClip(ae, hist, pixels, used_total);
+    float step = AutoExposure_SolveMean(ae, hist, pixels, lo, ae->cfg.max_step);
+
+    step = (clip < step) ? clip : step;
+    step = (step < lo) ? lo : step;
+
+    ae->settled = (fabsf(step - 1.0f) <= ae->cfg.tolerance) ? (ae->settled + 1U) : 0U;
+
+    /* Longest exposure first, then gain */
+    const float max_total = (float)ae->cfg.max_exposure * (float)ae->cfg.max_gain / (float)ae->cfg.min_gain;
+    float total = used_total * step;
+
+    total = (total < (float)ae->cfg.min_exposure) ? (float)ae->cfg.min_exposure : total;
+    total = (total > max_total) ? max_total : total;
+
+    const float latest_total = AutoExposure_Total(ae, latest);
+
+    if (fabsf(total - latest_total) <= (ae->cfg.tolerance * latest_total))
+    {
+        return AUTO_EXPOSURE_OK;
+    }
+
+    uint32_t exposure = (total < (float)ae->cfg.max_exposure) ? (uint32_t)(total + 0.5f) : ae->cfg.max_exposure;
+
+    exposure = (exposure < ae->cfg.min_exposure) ? ae->cfg.min_exposure : exposure;
+
+    uint32_t gain = (uint32_t)((total * (float)ae->cfg.min_gain / (float)exposure) + 0.5f);
+
+    gain = (gain < ae->cfg.min_gain) ? ae->cfg.min_gain : gain;
+    gain = (gain > ae->cfg.max_gain) ? ae->cfg.max_gain : gain;
+
+    if ((exposure == latest->exposure) && (gain == latest->gain))
+    {
+        return AUTO_EXPOSURE_OK;
+    }
+
+    if (ae->apply(ae->apply_ctx, exposure, gain) != 0)
+    {
+        ae->errors++;
+        return AUTO_EXPOSURE_ERROR;
+    }
+
+    ae->applied++;
+
+    /* Settings no frame to come can have been taken with are forgotten */
+    while ((ae->settings > 1U) && ((int32_t)(seq - ae->history[1].from_seq) >= 0))
+    {
+        memmove(&ae->history[0], &ae->history[1], (ae->settings - 1U) * sizeof(ae->history[0]));
+        ae->settings--;
+    }
+
+    if (ae->settings == AUTO_EXPOSURE_HISTORY)
+    {
+        memmove(&ae->history[0], &ae->history[1], (ae->settings - 1U) * sizeof(ae->history[0]));
+        ae->settings--;
+    }
+
+    ae->history[ae->settings].from_seq = seq + 1U + ae->cfg.delay;
+    ae->history[ae->settings].exposure = exposure;
+    ae->history[ae->settings].gain = gain;
+    ae->settings++;
+
+    return AUTO_EXPOSURE_OK;
+}
+
+
+/* Latest settings applied */
+void AutoExposure_Get(const auto_exposure_t *ae, uint32_t *exposure, uint32_t *gain)
+{
+    const auto_exposure_setting_t *latest = &ae->history[ae->settings - 1U];
+
+    *exposure = latest->exposure;
+    *gain = latest->gain;
+}
+
+
+static void AutoExposure_BandBegin(void *ctx, const uint8_t *frame, uint32_t width, uint32_t height)
+{
+    auto_exposure_t *ae = (auto_exposure_t *)ctx;
+
+    (void)frame;
+    (void)height;
+    memset(ae->hist, 0, sizeof(ae->hist));
+    ae->pixels = 0U;
+    ae->width = width;
+}
+
+
+static void AutoExposure_Band(void *ctx, const uint8_t *rows, uint32_t row0, uint32_t count)
+{
+    auto_exposure_t *ae = (auto_exposure_t *)ctx;
+    const uint32_t n = count * ae->width;
+
+    (void)row0;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ae->hist[rows[i]]++;
+    }
+
+    ae->pixels += n;
+}
+
+
+static void AutoExposure_BandEnd(void *ctx)
+{
+    auto_exposure_t *ae = (auto_exposure_t *)ctx;
+
+    (void)AutoExposure_Frame(ae, ae->hist, ae->pixels);
+}
+
+
+/* Histogram of each frame counted as its bands come in, settings from it at the frame end */
+int AutoExposure_AttachBands(auto_exposure_t *ae, frame_bands_t *fb)
+{
+    const frame_band_consumer_t consumer = { AutoExposure_BandBegin, AutoExposure_Band, AutoExposure_BandEnd, ae };
+
+    if (ae == 0)
+    {
+        return AUTO_EXPOSURE_INVALID_PARAM;
+    }
+
+    return (FrameBands_Attach(fb, &consumer) == FRAME_BANDS_OK) ? AUTO_EXPOSURE_OK : AUTO_EXPOSURE_ERROR;
+}
@@ -0,0 +1,237 @@
+#include "capture_ring.h"
+
+#include <string.h>
+
+
+/* bufs: count frame buffers (1..CAPTURE_RING_MAX_SLOTS), reachable by the DMA */
+int CaptureRing_Init(capture_ring_t *r, const capture_ring_os_t *os, uint8_t *const *bufs, uint32_t count)
+{
+    if ((r == 0) || (os == 0) || (os->lock == 0) || (os->unlock == 0) || (os->now_us == 0) || (bufs == 0) ||
+        (count == 0U) || (count > CAPTURE_RING_MAX_SLOTS))
+    {
+        return CAPTURE_RING_INVALID_PARAM;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->os = *os;
+    r->count = count;
+    r->filling = -1;
+    r->ready = -1;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (bufs[i] == 0)
+        {
+            return CAPTURE_RING_INVALID_PARAM;
+        }
+
+        r->buf[i] = bufs[i];
+    }
+
+    return CAPTURE_RING_OK;
+}
+
+
+/* A FREE slot, made FILLING; -1 if none */
+static int32_t CaptureRing_Fill(capture_ring_t *r)
+{
+    r->lines = 0U;
+
+    for (uint32_t i = 0; i < r->count; i++)
+    {
+        if (r->state[i] == CAPTURE_SLOT_FREE)
+        {
+            r->state[i] = CAPTURE_SLOT_FILLING;
+            return (int32_t)i;
+        }
+    }
+
+    return -1;
+}
+
+
+/* The buffer to start capture with, before the frame interrupt is enabled */
+uint8_t *CaptureRing_Start(capture_ring_t *r)
+{
+    uint8_t *next = 0;
+
+    r->os.lock(r->os.ctx);
+
+    if (r->filling < 0)
+    {
+        r->filling = CaptureRing_Fill(r);
+    }
+
+    next = (r->filling < 0) ? 0 : r->buf[r->filling];
+
+    r->os.unlock(r->os.ctx);
+
+    return next;
+}
+
+
+/*
+ * Frame end (interrupt): returns the buffer to capture the next frame
+ * into, or 0 to stop capture until a Release() returns one.
+ */
+uint8_t *CaptureRing_FrameDone(capture_ring_t *r)
+{
+    const int32_t done = r->filling;
+
+    if (done < 0)
+    {
+        return 0;
+    }
+
+    /* An older frame nobody took makes room for this one */
+    if (r->ready >= 0)
+    {
+        r->state[r->ready] = CAPTURE_SLOT_FREE;
+        r->stats.dropped++;
+    }
+
+    r->state[done] = CAPTURE_SLOT_READY;
+    r->seq[done] = r->stats.captured++;
+    r->done_us[done] = r->os.now_us(r->os.ctx);
+    r->ready = done;
+
+    if ((r->filling = CaptureRing_Fill(r)) >= 0)
+    {
+        return r->buf[r->filling];
+    }
+
+    /* The consumer holds every other slot: give this frame up rather than stop */
+    if (r->count > 1U)
+    {
+        r->state[done] = CAPTURE_SLOT_FILLING;
+        r->ready = -1;
+        r->filling = done;
+        r->lines = 0U;
+        r->stats.dropped++;
+
+        return r->buf[done];
+    }
+
+    r->stats.stalls++;
+
+    return 0;
+}
+
+
+/* Line end (interrupt): lines of the frame being captured */
+uint32_t CaptureRing_LineDone(capture_ring_t *r)
+{
+    return (r->filling < 0) ? 0U : ++r->lines;
+}
+
+
+/*
+ * The frame being captured and its first *lines lines, to work on while
+ * the rest comes in. f->seq is the seq Acquire() will return it with.
+ */
+int CaptureRing_Filling(capture_ring_t *r, capture_frame_t *f, uint32_t *lines)
+{
+    int32_t i;
+
+    if ((r == 0) || (f == 0) || (lines == 0))
+    {
+        return CAPTURE_RING_INVALID_PARAM;
+    }
+
+    r->os.lock(r->os.ctx);
+
+    if ((i = r->filling) < 0)
+    {
+        r->os.unlock(r->os.ctx);
+        return CAPTURE_RING_EMPTY;
+    }
+
+    f->data = r->buf[i];
+    f->seq = r->stats.captured;
+    f->done_us = 0U;
+    f->slot = (uint32_t)i;
+    *lines = r->lines;
+
+    r->os.unlock(r->os.ctx);
+
+    return CAPTURE_RING_OK;
+}
+
+
+/* Take the newest complete frame */
+int CaptureRing_Acquire(capture_ring_t *r, capture_frame_t *f)
+{
+    int32_t i;
+
+    if ((r == 0) || (f == 0))
+    {
+        return CAPTURE_RING_INVALID_PARAM;
+    }
+
+    r->os.lock(r->os.ctx);
+
+    if ((i = r->ready) < 0)
+    {
+        r->os.unlock(r->os.ctx);
+        return CAPTURE_RING_EMPTY;
+    }
+
+    r->state[i] = CAPTURE_SLOT_HELD;
+    r->ready = -1;
+
+    f->data = r->buf[i];
+    f->seq = r->seq[i];
+    f->done_us = r->done_us[i];
+    f->slot = (uint32_t)i;
+
+    const uint32_t lat = r->os.now_us(r->os.ctx) - f->done_us;
+
+    r->stats.consumed++;
+    r->stats.latency_last_us = lat;
+    r->stats.latency_max_us = (lat > r->stats.latency_max_us) ? lat : r->stats.latency_max_us;
+    r->stats.latency_sum_us += lat;
+
+    r->os.unlock(r->os.ctx);
+
+    return CAPTURE_RING_OK;
+}
+
+
+/*
+ * Give a frame back. Returns the buffer to restart capture with when it
+ * had stalled, 0 otherwise.
+ */
+uint8_t *CaptureRing_Release(capture_ring_t *r, const capture_frame_t *f)
+{
+    uint8_t *next = 0;
+
+    if ((r == 0) || (f == 0) || (f->slot >= r->count))
+    {
+        return 0;
+    }
+
+    r->os.lock(r->os.ctx);
+
+    if (r->state[f->slot] == CAPTURE_SLOT_HELD)
+    {
+        r->state[f->slot] = CAPTURE_SLOT_FREE;
+
+        if (r->filling < 0)
+        {
+            r->filling = CaptureRing_Fill(r);
+            next = r->buf[r->filling];
+        }
+    }
+
+    r->os.unlock(r->os.ctx);
+
+    return next;
+}
+
+
+void CaptureRing_GetStats(capture_ring_t *r, capture_ring_stats_t *stats)
+{
+    r->os.lock(r->os.ctx);
+    *stats = r->stats;
+    r->os.unlock(r->os.ctx);
+}
@@ -0,0 +1,402 @@
+#include "disk_cache.h"
+
+#include <string.h>
+
+/* Bits i .. i + n - 1 */
+static uint64_t DiskCache_Mask(uint32_t i, uint32_t n)
+{
+    return ((n >= 64U) ? ~0ULL : ((1ULL << n) - 1ULL)) << i;
+}
+
+
+/* Length of the run of set bits starting at bit i */
+static uint32_t DiskCache_Run(uint64_t bits, uint32_t i)
+{
+    const uint64_t rest = ~(bits >> i);
+
+    return (rest == 0ULL) ? (64U - i) : (uint32_t)__builtin_ctzll(rest);
+}
+
+
+static disk_cache_line_t *DiskCache_Find(disk_cache_t *c, uint32_t base)
+{
+    for (uint32_t i = 0; i < c->count; i++)
+    {
+        if (c->lines[i].base == base)
+        {
+            return &c->lines[i];
+        }
+    }
+
+    return 0;
+}
+
+
+static void DiskCache_Touch(disk_cache_t *c, disk_cache_line_t *l)
+{
+    l->used = ++c->stamp;
+}
+
+
+/* Write out the dirty sectors of l, each run of consecutive ones at once */
+static int DiskCache_FlushLine(disk_cache_t *c, disk_cache_line_t *l)
+{
+    while (l->dirty != 0ULL)
+    {
+        const uint32_t i = (uint32_t)__builtin_ctzll(l->dirty);
+        const uint32_t n = DiskCache_Run(l->dirty, i);
+
+        if (c->dev.write(c->dev.ctx, &l->data[i * DISK_CACHE_SECTOR], l->base + i, n) != 0)
+        {
+            c->stats.errors++;
+            return DISK_CACHE_ERROR;
+        }
+
+        c->stats.dev_writes++;
+        c->stats.flushed += n;
+        l->dirty &= ~DiskCache_Mask(i, n);
+    }
+
+    return DISK_CACHE_OK;
+}
+
+
+/* A line for base: a free one, or the least recently used (written out first) */
+static disk_cache_line_t *DiskCache_Alloc(disk_cache_t *c, uint32_t base)
+{
+    disk_cache_line_t *l = &c->lines[0];
+
+    for (uint32_t i = 0; i < c->count; i++)
+    {
+        if (c->lines[i].base == DISK_CACHE_NO_LINE)
+        {
+            l = &c->lines[i];
+            break;
+        }
+
+        if (c->lines[i].used < l->used)
+        {
+            l = &c->lines[i];
+        }
+    }
+
+    if (l->base != DISK_CACHE_NO_LINE)
+    {
+        if (DiskCache_FlushLine(c, l) != DISK_CACHE_OK)
+        {
+            return 0;
+        }
+
+        c->stats.evictions++;
+    }
+
+    l->base = base;
+    l->valid = 0ULL;
+    l->dirty = 0ULL;
+
+    return l;
+}
+
+
+/* Read the sectors of mask that l does not hold yet; returns how many, or an error */
+static int32_t DiskCache_Fill(disk_cache_t *c, disk_cache_line_t *l, uint64_t mask)
+{
+    uint64_t missing = ~l->valid & mask;
+    int32_t loaded = 0;
+
+    while (missing != 0ULL)
+    {
+        const uint32_t i = (uint32_t)__builtin_ctzll(missing);
+        const uint32_t n = DiskCache_Run(missing, i);
+
+        if (c->dev.read(c->dev.ctx, &l->data[i * DISK_CACHE_SECTOR], l->base + i, n) != 0)
+        {
+            c->stats.errors++;
+            return DISK_CACHE_ERROR;
+        }
+
+        c->stats.dev_reads++;
+        l->valid |= DiskCache_Mask(i, n);
+        missing &= ~DiskCache_Mask(i, n);
+        loaded += (int32_t)n;
+    }
+
+    return loaded;
+}
+
+
+/*
+ * The line of sector, holding the n sectors from there. A miss right where
+ * the previous one ended is taken for a sequential reader: the rest of the
+ * line and the next c->ahead lines are loaded too (newer than the line in
+ * LRU order). Other misses load what was asked for only, so that scattered
+ * small reads cost the card no more than without the cache.
+ */
+static disk_cache_line_t *DiskCache_Load(disk_cache_t *c, uint32_t sector, uint32_t n)
+{
+    const uint32_t base = sector - (sector % c->line_sectors);
+    const int sequential = (sector == c->next_miss);
+    disk_cache_line_t *l = DiskCache_Find(c, base);
+
+    if ((l == 0) && ((l = DiskCache_Alloc(c, base)) == 0))
+    {
+        return 0;
+    }
+
+    DiskCache_Touch(c, l);
+
+    /* On error the line keeps what it had (it may hold dirty sectors) */
+    if (DiskCache_Fill(c, l, sequential ? DiskCache_Mask(0U, c->line_sectors)
+                                        : DiskCache_Mask(sector - base, n)) < 0)
+    {
+        return 0;
+    }
+
+    c->next_miss = sequential ? (base + c->line_sectors) : (sector + n);
+
+    for (uint32_t a = 1; sequential && (a <= c->ahead); a++)
+    {
+        const uint32_t next = base + (a * c->line_sectors);
+        disk_cache_line_t *ahead = DiskCache_Find(c, next);
+        int32_t loaded;
+
+        if ((ahead == 0) && ((ahead = DiskCache_Alloc(c, next)) == 0))
+        {
+            break;
+        }
+
+        DiskCache_Touch(c, ahead);
+
+        if ((loaded = DiskCache_Fill(c, ahead, DiskCache_Mask(0U, c->line_sectors))) < 0)
+        {
+            break;
+        }
+
+        c->stats.ahead += (uint32_t)loaded;
+        c->next_miss = next + c->line_sectors;
+    }
+
+    return l;
+}
+
+
+/*
+ * Use mem (DISK_CACHE_BYTES(count, line_sectors) bytes) as count lines.
+ * ahead lines are read ahead of a sequential reader; the cache needs two
+ * lines more than that (one is the line being read, one stays for the
+ * FAT).
+ */
+int DiskCache_Init(disk_cache_t *c, const disk_cache_dev_t *dev, disk_cache_line_t *lines,
+                   uint32_t count, uint32_t line_sectors, uint8_t *mem, uint32_t ahead)
+{
+    if ((c == 0) || (dev == 0) || (dev->read == 0) || (dev->write == 0) || (lines == 0) || (mem == 0) ||
+        (count == 0U) || (line_sectors == 0U) || (line_sectors > DISK_CACHE_MAX_LINE) ||
+        ((ahead != 0U) && ((ahead + 2U) > count)))
+    {
+        return DISK_CACHE_INVALID_PARAM;
+    }
+
+    memset(c, 0, sizeof(*c));
+
+    c->dev = *dev;
+    c->lines = lines;
+    c->count = count;
+    c->line_sectors = line_sectors;
+    c->ahead = ahead;
+    c->next_miss = DISK_CACHE_NO_LINE;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        lines[i].base = DISK_CACHE_NO_LINE;
+        lines[i].used = 0U;
+        lines[i].valid = 0ULL;
+        lines[i].dirty = 0ULL;
+        lines[i].data = &mem[i * line_sectors * DISK_CACHE_SECTOR];
+    }
+
+    return DISK_CACHE_OK;
+}
+
+
+int DiskCache_Read(disk_cache_t *c, uint8_t *dst, uint32_t sector, uint32_t count)
+{
+    if ((c == 0) || (dst == 0))
+    {
+        return DISK_CACHE_INVALID_PARAM;
+    }
+
+    if (count >= c->line_sectors)
+    {
+        if (c->dev.read(c->dev.ctx, dst, sector, count) != 0)
+        {
+            c->stats.errors++;
+            return DISK_CACHE_ERROR;
+        }
+
+        c->stats.dev_reads++;
+        c->stats.bypassed += count;
+
+        /* Sectors written but not flushed yet are newer than what was read */
+        for (uint32_t k = 0; k < c->count; k++)
+        {
+            const disk_cache_line_t *l = &c->lines[k];
+            uint64_t dirty = l->dirty;
+
+            while (dirty != 0ULL)
+            {
+                const uint32_t i = (uint32_t)__builtin_ctzll(dirty);
+                const uint32_t s = l->base + i;
+
+                dirty &= dirty - 1ULL;
+
+                if ((s >= sector) && ((s - sector) < count))
+                {
+                    memcpy(&dst[(s - sector) * DISK_CACHE_SECTOR], &l->data[i * DISK_CACHE_SECTOR],
+                           DISK_CACHE_SECTOR);
+                }
+            }
+        }
+
+        return DISK_CACHE_OK;
+    }
+
+    while (count != 0U)
+    {
+        const uint32_t base = sector - (sector % c->line_sectors);
+        const uint32_t i = sector - base;
+        const uint32_t n = ((c->line_sectors - i) < count) ? (c->line_sectors - i) : count;
+        const uint64_t need = DiskCache_Mask(i, n);
+        disk_cache_line_t *l = DiskCache_Find(c, base);
+        const uint64_t have = (l != 0) ? (l->valid & need) : 0ULL;
+
+        c->stats.hits += (uint32_t)__builtin_popcountll(have);
+        c->stats.misses += n - (uint32_t)__builtin_popcountll(have);
+
+        if (have == need)
+        {
+            DiskCache_Touch(c, l);
+        }
+        else if ((l = DiskCache_Load(c, sector, n)) == 0)
+        {
+            return DISK_CACHE_ERROR;
+        }
+
+        memcpy(dst, &l->data[i * DISK_CACHE_SECTOR], n * DISK_CACHE_SECTOR);
+
+        dst += n * DISK_CACHE_SECTOR;
+        sector += n;
+        count -= n;
+    }
+
+    return DISK_CACHE_OK;
+}
+
+
+int DiskCache_Write(disk_cache_t *c, const uint8_t *src, uint32_t sector, uint32_t count)
+{
+    if ((c == 0) || (src == 0))
+    {
+        return DISK_CACHE_INVALID_PARAM;
+    }
+
+    if (count >= c->line_sectors)
+    {
+        if (c->dev.write(c->dev.ctx, src, sector, count) != 0)
+        {
+            c->stats.errors++;
+            return DISK_CACHE_ERROR;
+        }
+
+        c->stats.dev_writes++;
+        c->stats.bypassed += count;
+
+        /* Cached copies of these sectors take the new data, now on the card */
+        for (uint32_t k = 0; k < c->count; k++)
+        {
+            disk_cache_line_t *l = &c->lines[k];
+
+            if ((l->base == DISK_CACHE_NO_LINE) || (l->base >= (sector + count)) ||
+                ((l->base + c->line_sectors) <= sector))
+            {
+                continue;
+            }
+
+            const uint32_t first = (l->base > sector) ? l->base : sector;
+            const uint32_t end = ((l->base + c->line_sectors) < (sector + count)) ?
+                                 (l->base + c->line_sectors) : (sector + count);
+            const uint64_t m = DiskCache_Mask(first - l->base, end - first);
+
+            memcpy(&l->data[(first - l->base) * DISK_CACHE_SECTOR], &src[(first - sector) * DISK_CACHE_SECTOR],
+                   (end - first) * DISK_CACHE_SECTOR);
+            l->valid |= m;
+            l->dirty &= ~m;
+        }
+
+        return DISK_CACHE_OK;
+    }
+
+    while (count != 0U)
+    {
+        const uint32_t base = sector - (sector % c->line_sectors);
+        const uint32_t i = sector - base;
+        const uint32_t n = ((c->line_sectors - i) < count) ? (c->line_sectors - i) : count;
+        const uint64_t m = DiskCache_Mask(i, n);
+        disk_cache_line_t *l = DiskCache_Find(c, base);
+
+        if ((l == 0) && ((l = DiskCache_Alloc(c, base)) == 0))
+        {
+            return DISK_CACHE_ERROR;
+        }
+
+        memcpy(&l->data[i * DISK_CACHE_SECTOR], src, n * DISK_CACHE_SECTOR);
+        l->valid |= m;
+        l->dirty |= m;
+        DiskCache_Touch(c, l);
+
+        c->stats.written += n;
+        src += n * DISK_CACHE_SECTOR;
+        sector += n;
+        count -= n;
+    }
+
+    return DISK_CACHE_OK;
+}
+
+
+/* Write every dirty sector to the card, lines in ascending sector order */
+int DiskCache_Flush(disk_cache_t *c)
+{
+    if (c == 0)
+    {
+        return DISK_CACHE_INVALID_PARAM;
+    }
+
+    for (;;)
+    {
+        disk_cache_line_t *next = 0;
+
+        for (uint32_t i = 0; i < c->count; i++)
+        {
+            if ((c->lines[i].dirty != 0ULL) && ((next == 0) || (c->lines[i].base < next->base)))
+            {
+                next = &c->lines[i];
+            }
+        }
+
+        if (next == 0)
+        {
+            return DISK_CACHE_OK;
+        }
+
+        if (DiskCache_FlushLine(c, next) != DISK_CACHE_OK)
+        {
+            return DISK_CACHE_ERROR;
+        }
+    }
+}
+
+
+void DiskCache_GetStats(const disk_cache_t *c, disk_cache_stats_t *stats)
+{
+    *stats = c->stats;
+}
@@ -0,0 +1,128 @@
+#include "frame_archive.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "jpeg_y8.h"
+#include "sd_writer_rtos.h"
+
+#define FRAME_ARCHIVE_STAGE_SECTORS  16U
+#define FRAME_ARCHIVE_DEPTH          4U      /* Both output buffers, this frame's flush and the last one's */
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t frame_archive_out[2][FRAME_ARCHIVE_OUT_BYTES];
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t frame_archive_stage[FRAME_ARCHIVE_STAGE_SECTORS * SD_WRITER_SECTOR];
+
+static sd_writer_job_t frame_archive_jobs[FRAME_ARCHIVE_DEPTH];
+static sd_writer_stream_t frame_archive_stream;
+static sd_region_t frame_archive_region;
+static jpeg_y8_t frame_archive_enc;
+static int frame_archive_ok;
+
+/* Output buffers with the writer; cleared by the writer task */
+static volatile uint8_t frame_archive_busy[2];
+static StaticSemaphore_t frame_archive_free_buf;
+static SemaphoreHandle_t frame_archive_free;
+
+
+/* Writer task: an output buffer is on the card (or failed) */
+static void FrameArchive_Release(void *ctx, const uint8_t *data, int status)
+{
+    (void)ctx;
+    (void)status;
+
+    frame_archive_busy[data == frame_archive_out[1]] = 0U;
+    (void)xSemaphoreGive(frame_archive_free);
+}
+
+
+static int FrameArchive_Emit(void *ctx, const uint8_t *data, uint32_t len)
+{
+    const uint32_t i = (data == frame_archive_out[1]) ? 1U : 0U;
+
+    (void)ctx;
+
+    frame_archive_busy[i] = 1U;
+
+    if (SdWriter_Submit(SdWriterRTOS_Writer(), &frame_archive_stream, data, len, FrameArchive_Release, 0,
+                        FRAME_ARCHIVE_WAIT_MS) != SD_WRITER_OK)
+    {
+        frame_archive_busy[i] = 0U;
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int FrameArchive_Reclaim(void *ctx, const uint8_t *data)
+{
+    const uint32_t i = (data == frame_archive_out[1]) ? 1U : 0U;
+
+    (void)ctx;
+
+    while (frame_archive_busy[i])
+    {
+        if (xSemaphoreTake(frame_archive_free, pdMS_TO_TICKS(FRAME_ARCHIVE_WAIT_MS)) != pdTRUE)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Reserve path (bytes) as a wrapping stream of the SD writer; quality 1..100 */
+int FrameArchive_Init(const char *path, uint32_t bytes, uint32_t quality)
+{
+    const jpeg_y8_sink_t sink = { FrameArchive_Emit, FrameArchive_Reclaim, 0 };
+
+    frame_archive_free = xSemaphoreCreateBinaryStatic(&frame_archive_free_buf);
+
+    if (JpegY8_Init(&frame_archive_enc, quality, frame_archive_out[0], frame_archive_out[1],
+                    FRAME_ARCHIVE_OUT_BYTES, &sink) != JPEG_Y8_OK)
+    {
+        return FRAME_ARCHIVE_INVALID_PARAM;
+    }
+
+    if (SdWriterRTOS_AddFile(&frame_archive_stream, &frame_archive_region, path, bytes, frame_archive_stage,
+                             FRAME_ARCHIVE_STAGE_SECTORS, frame_archive_jobs, FRAME_ARCHIVE_DEPTH, SD_WRITER_BLOCK,
+                             1) != SD_WRITER_OK)
+    {
+        return FRAME_ARCHIVE_ERROR;
+    }
+
+    frame_archive_ok = 1;
+
+    return FRAME_ARCHIVE_OK;
+}
+
+
+/* Encode and queue a w x h Y8 frame */
+int FrameArchive_Save(const uint8_t *frame, uint32_t w, uint32_t h)
+{
+    if (!frame_archive_ok || (frame == 0))
+    {
+        return FRAME_ARCHIVE_INVALID_PARAM;
+    }
+
+    if (frame_archive_busy[0] || frame_archive_busy[1])
+    {
+        return FRAME_ARCHIVE_BUSY;
+    }
+
+    if (JpegY8_EncodeFrame(&frame_archive_enc, frame, w, h, w) != JPEG_Y8_OK)
+    {
+        return FRAME_ARCHIVE_ERROR;
+    }
+
+    /* The image's last partial cluster to the card now, not with the next frame; a marker, no wait */
+    if (SdWriter_Flush(SdWriterRTOS_Writer(), &frame_archive_stream, 0U) != SD_WRITER_OK)
+    {
+        return FRAME_ARCHIVE_ERROR;
+    }
+
+    return FRAME_ARCHIVE_OK;
+}
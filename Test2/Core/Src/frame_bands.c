@@ -0,0 +1,100 @@
+#include "frame_bands.h"
+
+#include <string.h>
+
+
+int FrameBands_Init(frame_bands_t *fb, uint32_t width, uint32_t height, uint32_t band_rows)
+{
+    if ((fb == 0) || (width == 0U) || (height == 0U) || (band_rows == 0U))
+    {
+        return FRAME_BANDS_INVALID_PARAM;
+    }
+
+    memset(fb, 0, sizeof(*fb));
+    fb->width = width;
+    fb->height = height;
+    fb->band_rows = band_rows;
+
+    return FRAME_BANDS_OK;
+}
+
+
+int FrameBands_Attach(frame_bands_t *fb, const frame_band_consumer_t *consumer)
+{
+    if ((fb == 0) || (consumer == 0) || (consumer->band == 0))
+    {
+        return FRAME_BANDS_INVALID_PARAM;
+    }
+
+    if (fb->consumers == FRAME_BANDS_MAX_CONSUMERS)
+    {
+        return FRAME_BANDS_ERROR;
+    }
+
+    fb->consumer[fb->consumers++] = *consumer;
+
+    return FRAME_BANDS_OK;
+}
+
+
+void FrameBands_Begin(frame_bands_t *fb, const uint8_t *frame)
+{
+    fb->frame = frame;
+    fb->rows = 0U;
+
+    for (uint32_t i = 0; i < fb->consumers; i++)
+    {
+        if (fb->consumer[i].begin != 0)
+        {
+            fb->consumer[i].begin(fb->consumer[i].ctx, frame, fb->width, fb->height);
+        }
+    }
+}
+
+
+/* Pass on the bands complete within the first lines rows; returns the rows passed on so far */
+uint32_t FrameBands_Lines(frame_bands_t *fb, uint32_t lines)
+{
+    if (fb->frame == 0)
+    {
+        return 0U;
+    }
+
+    lines = (lines < fb->height) ? lines : fb->height;
+
+    while ((fb->rows < lines) && (((lines - fb->rows) >= fb->band_rows) || (lines == fb->height)))
+    {
+        const uint32_t count = ((lines - fb->rows) < fb->band_rows) ? (lines - fb->rows) : fb->band_rows;
+        const uint8_t *rows = &fb->frame[fb->rows * fb->width];
+
+        for (uint32_t i = 0; i < fb->consumers; i++)
+        {
+            fb->consumer[i].band(fb->consumer[i].ctx, rows, fb->rows, count);
+        }
+
+        fb->rows += count;
+    }
+
+    return fb->rows;
+}
+
+
+void FrameBands_End(frame_bands_t *fb)
+{
+    if (fb->frame == 0)
+    {
+        return;
+    }
+
+    (void)FrameBands_Lines(fb, fb->height);
+
+    for (uint32_t i = 0; i < fb->consumers; i++)
+    {
+        if (fb->consumer[i].end != 0)
+        {
+            fb->consumer[i].end(fb->consumer[i].ctx);
+        }
+    }
+
+    fb->frame = 0;
+}
@@ -26,13 +26,22 @@
 /* USER CODE BEGIN Includes */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "stm32h7xx_hal_qspi.h"
 
 #include "ov5640.h"
 #include "ov5640_io.h"
 #include "usb_io.h"
-#include "sd_spi.h"
+#include "sd_spi_hal.h"
+#include "nav.h"
+#include "spectrum_cache.h"
+#include "ring_log_sd.h"
+#include "sd_writer_rtos.h"
+#include "frame_archive.h"
+#include "capture_ring.h"
+#include "frame_bands.h"
+#include "auto_exposure.h"
 
 /* USER CODE END Includes */
 
@@ -93,7 +102,7 @@ const osThreadAttr_t cameraTask_attributes = {
 };
 /* USER CODE BEGIN PV */
 
-//OV5640_Object_t camera;
+static OV5640_Object_t camera;              // Exposure set from the camera task
 
 /* USER CODE END PV */
 
@@ -126,8 +135,38 @@ static int32_t I2C_DeInit(void){return 0;}
 //define WIDTH  800
 //#define HEIGHT 480
 
-#define WIDTH  640
-#define HEIGHT 480
+//#define WIDTH  640
+//#define HEIGHT 480
+
+// Correlation window: the centre of the 640x480 view at its pixel size, all
+// the sensor outputs (Camera_SetWindow())
+#define WIDTH  256
+#define HEIGHT 256
+#define CAMERA_DECIMATION OV5640_BINNING_4x4
+
+// Bring-up: reset pulse and wait before the first SCCB access (datasheet: 1 ms
+// and 20 ms)
+#define CAMERA_RESET_MS        1U
+#define CAMERA_BOOT_MS         20U
+
+// Exposure and gain set from the histogram of each frame (auto_exposure.h)
+// rather than by the sensor, whose loop aims at a pleasing, darker picture and
+// takes many frames. For contrast to correlate on, as bright as
+// CAMERA_AE_TARGET allows with at most CAMERA_AE_MAX_CLIPPED of the pixels at
+// CAMERA_AE_CLIP_LEVEL or above. Exposure in 1/16 lines up to what the frame
+// timing allows, gain in 1/16; new settings show in the frame after next. The
+// first frame is exposed short: a dark frame still tells how far to go, a
+// saturated one does not.
+#define CAMERA_AE_TARGET         160.0f
+#define CAMERA_AE_MAX_CLIPPED    0.005f
+#define CAMERA_AE_CLIP_LEVEL     250U
+#define CAMERA_AE_TOLERANCE      0.05f
+#define CAMERA_AE_MAX_STEP       256.0f
+#define CAMERA_AE_MIN_EXPOSURE   16U          // A line
+#define CAMERA_AE_MIN_GAIN       16U
+#define CAMERA_AE_MAX_GAIN       (8U * 16U)
+#define CAMERA_AE_DELAY          1U
+#define CAMERA_AE_START_EXPOSURE (16U * 16U)
 
 //#define CSIZE  2 // RGB565
 #define CSIZE  1 // Y8
@@ -135,9 +174,58 @@ static int32_t I2C_DeInit(void){return 0;}
 #define FRAME_BYTES (WIDTH * HEIGHT * CSIZE)
 #define FRAME_WORDS (FRAME_BYTES / 4)
 
+// Frame buffers the DCMI captures into in turn, a frame at a time, handed to
+// the camera task newest first (capture_ring.h). D1 holds a single 640x480
+// frame, so capture waits while it is processed; frames of 128 KB or less
+// (a window of the sensor) get three and capture never waits.
+#define CAPTURE_SLOTS ((FRAME_BYTES <= (128U * 1024U)) ? 3U : 1U)
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+uint8_t frame_buffer[CAPTURE_SLOTS][FRAME_BYTES];
+
+static capture_ring_t capture;
+static capture_ring_stats_t capture_stats;    // For the debugger
+static uint32_t capture_primask;
+
+// Rows of the frame being captured go to the band consumers (frame_bands.h) as
+// they arrive, FRAME_BAND_ROWS at a time; at the frame end only the rest is left
+#define FRAME_BAND_ROWS 32U
+
+static frame_bands_t frame_bands;
+static uint32_t frame_bands_seq;              // Capture seq of the frame in frame_bands
+
+static auto_exposure_t camera_ae;
+
+// Position fixes, logged raw to a ring in NAV.LOG (ring_log_sd.h). The ring is the sink of
+// a BLOCK stream of the SD writer: the camera task queues a record, the writer task appends it
+#define NAV_LOG_PATH          "NAV.LOG"
+#define NAV_LOG_BYTES         (1024U * 1024U)
+#define NAV_LOG_BUF_SECTORS   8U      // A cluster: one multi-block write per 64 fixes
+#define NAV_LOG_FLUSH_EVERY   16U     // Frames
+#define NAV_LOG_DEPTH         8U
+#define NAV_LOG_POOL          (NAV_LOG_DEPTH + 2U)    // Queued, being appended, being filled
+#define NAV_LOG_WAIT_MS       5U
 
 __attribute__((section(".RAM_D1"), aligned(32)))
-uint8_t frame_buffer[FRAME_BYTES];
+static uint8_t nav_log_buf[NAV_LOG_BUF_SECTORS * RING_LOG_SECTOR];
+static ring_log_sd_t nav_log;
+static int nav_log_ok;
+static sd_writer_job_t nav_log_jobs[NAV_LOG_DEPTH];
+static sd_writer_stream_t nav_log_stream;
+static ring_log_record_t nav_log_pool[NAV_LOG_POOL];
+static volatile uint8_t nav_log_busy[NAV_LOG_POOL];   // Cleared by the writer task
+
+_Static_assert(sizeof(position_fix_t) <= RING_LOG_PAYLOAD, "position_fix_t must fit a ring log record");
+
+// Every FRAME_ARCHIVE_EVERY-th frame archived as JPEG to FRAMES.JPG, around again
+// when full, through the SD writer task (frame_archive.h)
+#define FRAME_ARCHIVE_PATH      "FRAMES.JPG"
+#define FRAME_ARCHIVE_BYTES     (16U * 1024U * 1024U)
+#define FRAME_ARCHIVE_EVERY     30U
+#define FRAME_ARCHIVE_QUALITY   90U
+
+static int frame_archive_ok;
+static uint32_t frame_archive_count;
 
 //__attribute__((section(".qspi_ram")))
 //volatile uint8_t qspi_buffer[8192];
@@ -153,21 +241,218 @@ volatile FRESULT dbg_sd_res;
 extern FATFS SDFatFS;
 extern char SDPath[4];
 
+// Capture ring: the consumer side runs with interrupts masked, short and not nested
+static void Capture_Lock(void *ctx)
+{
+    const uint32_t primask = __get_PRIMASK();
+
+    (void)ctx;
+    __disable_irq();
+    capture_primask = primask;
+}
+
+static void Capture_Unlock(void *ctx)
+{
+    (void)ctx;
+    __set_PRIMASK(capture_primask);
+}
+
+// Microseconds from the cycle counter, kept across its wrap (called every frame)
+static uint32_t Capture_NowUs(void *ctx)
+{
+    static uint32_t last, us, rem;
+    const uint32_t per_us = SystemCoreClock / 1000000U;
+    const uint32_t cycles = DWT->CYCCNT;
+
+    (void)ctx;
+    rem += cycles - last;
+    last = cycles;
+    us += rem / per_us;
+    rem %= per_us;
+
+    return us;
+}
+
+static const capture_ring_os_t capture_os = { Capture_Lock, Capture_Unlock, Capture_NowUs, 0 };
+
+// Capture the next frame into buf; with none capture stays stopped
+static void Capture_Arm(uint8_t *buf)
+{
+    if (buf != 0)
+    {
+        (void)HAL_DCMI_Stop(&hdcmi);
+        (void)HAL_DCMI_Start_DMA(&hdcmi, DCMI_MODE_SNAPSHOT, (uint32_t)buf, FRAME_WORDS);
+
+        // The HAL turns these off at the end of a snapshot
+        __HAL_DCMI_ENABLE_IT(&hdcmi, DCMI_IT_LINE | DCMI_IT_VSYNC | DCMI_IT_ERR | DCMI_IT_OVR);
+    }
+}
+
+// Sensor output cut to the WIDTH x HEIGHT window, read out 4x4 like VGA so the
+// map scale holds. The DCMI crops to the window the sensor reports, so a frame
+// is exactly FRAME_BYTES whatever else comes down the bus.
+static int Camera_SetWindow(OV5640_Object_t *cam)
+{
+    const OV5640_Window_t window = { WIDTH, HEIGHT, 0, 0, CAMERA_DECIMATION };
+    OV5640_Window_t set;
+
+    if ((OV5640_SetWindow(cam, &window) != OV5640_OK) || (OV5640_GetWindow(cam, &set) != OV5640_OK) ||
+        (set.Width != WIDTH) || (set.Height != HEIGHT))
+    {
+        return -1;
+    }
+
+    // Pixel clocks per line and lines, less one
+    if ((HAL_DCMI_ConfigCrop(&hdcmi, 0U, 0U, (set.Width * CSIZE) - 1U, set.Height - 1U) != HAL_OK) ||
+        (HAL_DCMI_EnableCrop(&hdcmi) != HAL_OK))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Returns a nav log record to the pool once the writer task has appended it
+static void NavLog_Release(void *ctx, const uint8_t *data, int status)
+{
+    (void)data;
+    (void)status;
+    nav_log_busy[(ring_log_record_t *)ctx - nav_log_pool] = 0U;
+}
+
+// Queues fix for the writer task, which appends it to the ring; the camera task
+// never touches the card. 0 on success, -1 if the pool or the stream stays full.
+static int NavLog_Put(const position_fix_t *fix)
+{
+    ring_log_record_t *rec = 0;
+
+    for (uint32_t i = 0U; i < NAV_LOG_POOL; i++)
+    {
+        if (nav_log_busy[i] == 0U)
+        {
+            nav_log_busy[i] = 1U;
+            rec = &nav_log_pool[i];
+            break;
+        }
+    }
+
+    if (rec == 0)
+    {
+        return -1;
+    }
+
+    rec->type = NAV_LOG_FIX;
+    rec->len = sizeof(*fix);
+    rec->time_ms = HAL_GetTick();
+    memcpy(rec->payload, fix, sizeof(*fix));
+
+    if (SdWriter_Submit(SdWriterRTOS_Writer(), &nav_log_stream, (const uint8_t *)rec, sizeof(*rec),
+                        NavLog_Release, rec, NAV_LOG_WAIT_MS) != SD_WRITER_OK)
+    {
+        nav_log_busy[rec - nav_log_pool] = 0U;
+        return -1;
+    }
+
+    return 0;
+}
+
+// Exposure and gain to the sensor (auto_exposure.h), 0 on success
+static int Camera_ApplyExposure(void *ctx, uint32_t exposure, uint32_t gain)
+{
+    return (OV5640_SetExposure((OV5640_Object_t *)ctx, exposure, gain) == OV5640_OK) ? 0 : -1;
+}
+
+// Manual exposure from the first frame, then corrected from the histogram of
+// each frame as its bands come in (the sensor window must be set). Levels are
+// taken back through the gamma curve the ISP applies.
+static int Camera_InitExposure(OV5640_Object_t *cam)
+{
+    uint8_t gamma[256];
+    auto_exposure_config_t cfg = {
+        .target_mean = CAMERA_AE_TARGET,
+        .max_clipped = CAMERA_AE_MAX_CLIPPED,
+        .clip_level = CAMERA_AE_CLIP_LEVEL,
+        .curve = gamma,
+        .tolerance = CAMERA_AE_TOLERANCE,
+        .max_step = CAMERA_AE_MAX_STEP,
+        .min_exposure = CAMERA_AE_MIN_EXPOSURE,
+        .min_gain = CAMERA_AE_MIN_GAIN,
+        .max_gain = CAMERA_AE_MAX_GAIN,
+        .delay = CAMERA_AE_DELAY,
+    };
+
+    if ((OV5640_GetMaxExposure(cam, &cfg.max_exposure) != OV5640_OK) ||
+        (OV5640_GetGammaCurve(cam, gamma) != OV5640_OK) ||
+        (AutoExposure_Init(&camera_ae, &cfg, Camera_ApplyExposure, cam,
+                           CAMERA_AE_START_EXPOSURE, CAMERA_AE_MIN_GAIN) != AUTO_EXPOSURE_OK) ||
+        (AutoExposure_AttachBands(&camera_ae, &frame_bands) != AUTO_EXPOSURE_OK))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+// The bands of frame f within its first lines rows to the consumers
+static void Capture_Bands(const capture_frame_t *f, uint32_t lines)
+{
+    if ((frame_bands.frame != f->data) || (frame_bands_seq != f->seq))
+    {
+        AutoExposure_SetSeq(&camera_ae, f->seq);
+        FrameBands_Begin(&frame_bands, f->data);
+        frame_bands_seq = f->seq;
+    }
+
+    if (lines > frame_bands.rows)
+    {
+        // Rows the DMA wrote since, fresh from memory
+        SCB_InvalidateDCache_by_Addr((uint32_t *)&f->data[frame_bands.rows * WIDTH * CSIZE],
+                                     (int32_t)((lines - frame_bands.rows) * WIDTH * CSIZE));
+        (void)FrameBands_Lines(&frame_bands, lines);
+    }
+}
+
+//DCMI line callback
+void HAL_DCMI_LineEventCallback(DCMI_HandleTypeDef *hdcmi)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    (void)hdcmi;
+
+    // A band is in once the line after it ends (its last line has left the DCMI FIFO)
+    if (((CaptureRing_LineDone(&capture) % FRAME_BAND_ROWS) == 1U) && (cameraTaskHandle != NULL))
+    {
+        vTaskNotifyGiveFromISR(cameraTaskHandle, &xHigherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+
 //DCMI frame callback
 void HAL_DCMI_FrameEventCallback(DCMI_HandleTypeDef *hdcmi)
 {
-	__NOP();
+    (void)hdcmi;
 
-	// Suspend DCMI
-	HAL_DCMI_Suspend(hdcmi);
+    // Only buffer ownership changes here: on into the next free buffer
+    Capture_Arm(CaptureRing_FrameDone(&capture));
 
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
     // Sends a direct-to-task notification to cameraTaskHandle
-    vTaskNotifyGiveFromISR(cameraTaskHandle, &xHigherPriorityTaskWoken);
+    if (cameraTaskHandle != NULL)
+    {
+        vTaskNotifyGiveFromISR(cameraTaskHandle, &xHigherPriorityTaskWoken);
+    }
     portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
 }
 
+// USB sent the frame (USB_io.c, interrupt): back to the ring
+void USB_FrameSent(uint8_t *frame)
+{
+    const capture_frame_t sent = { frame, 0U, 0U, (uint32_t)((frame - frame_buffer[0]) / FRAME_BYTES) };
+
+    Capture_Arm(CaptureRing_Release(&capture, &sent));
+}
+
 // PSRAM_EnableQuadMode
 HAL_StatusTypeDef PSRAM_EnableQuadMode()
 {
@@ -338,8 +623,38 @@ int main(void)
   MX_SPI3_Init();
   /* USER CODE BEGIN 2 */
 
+  if (SD_SPI_HAL_Init() != SD_SPI_OK)
+  {
+	  Error_Handler();
+  }
+
  SD_TestWrite();
 
+  // Navigation (volume mounted by SD_TestWrite), tracking on the frame bands as they come in
+  if ((Nav_Init() != NAV_OK) ||
+      (FrameBands_Init(&frame_bands, WIDTH * CSIZE, HEIGHT, FRAME_BAND_ROWS) != FRAME_BANDS_OK) ||
+      (Nav_AttachBands(&frame_bands) != NAV_OK))
+  {
+	  Error_Handler();
+  }
+
+  // Telemetry ring, carried on from its newest record (a new ring gets a random id)
+  uint32_t log_id = 0U;
+  (void)HAL_RNG_GenerateRandomNumber(&hrng, &log_id);
+  nav_log_ok = (RingLogSD_Open(&nav_log, NAV_LOG_PATH, NAV_LOG_BYTES, nav_log_buf,
+                               NAV_LOG_BUF_SECTORS, log_id) == RING_LOG_OK);
+
+  // Frame archive and the ring's stream; their SD writer task starts with the other threads
+  const sd_writer_sink_t nav_log_sink = { RingLog_SinkPut, RingLog_SinkFlush, &nav_log.log };
+  const int writer_ok = (SdWriterRTOS_Init() == SD_WRITER_OK);
+
+  nav_log_ok = nav_log_ok && writer_ok &&
+               (SdWriter_AddSink(SdWriterRTOS_Writer(), &nav_log_stream, &nav_log_sink, nav_log_jobs,
+                                 NAV_LOG_DEPTH, SD_WRITER_BLOCK) == SD_WRITER_OK);
+  frame_archive_ok = writer_ok &&
+                     (FrameArchive_Init(FRAME_ARCHIVE_PATH, FRAME_ARCHIVE_BYTES,
+                                        FRAME_ARCHIVE_QUALITY) == FRAME_ARCHIVE_OK);
+
   dbg_basepri = __get_BASEPRI();   // should show 0x50 now
 
   __set_BASEPRI(0);                // temporary recovery test
@@ -356,7 +671,6 @@ int main(void)
 	  Error_Handler();
   }
 
-  OV5640_Object_t camera;
   OV5640_IO_t io_ctx;
 
   // Initialize camera object
@@ -373,9 +687,9 @@ int main(void)
 
   // Reset Camera
   HAL_GPIO_WritePin(GPIOD, CAMERA_RESET_Pin, GPIO_PIN_RESET);
-  HAL_Delay(100);
+  HAL_Delay(CAMERA_RESET_MS);
   HAL_GPIO_WritePin(GPIOD, CAMERA_RESET_Pin, GPIO_PIN_SET);
-  HAL_Delay(100);
+  HAL_Delay(CAMERA_BOOT_MS);
 
   // Register Camera IO
   OV5640_RegisterBusIO(&camera, &io_ctx);
@@ -404,27 +718,47 @@ int main(void)
 	  for (;;);
   }
 
+  // Correlation window only, DCMI crop to match
+  if (Camera_SetWindow(&camera) != 0)
+  {
+	  HAL_GPIO_WritePin(GPIOB, LED3_Pin, GPIO_PIN_SET);
+	  for (;;);
+  }
+
   // Enable colorbar mode
   //OV5640_ColorbarModeConfig(&camera, COLORBAR_MODE_ENABLE);
 
-  // Disable ACG
-  //uint8_t tmp = 0x03;
-  //ov5640_write_reg(&camera.Ctx, OV5640_AEC_PK_MANUAL, &tmp, 1);
+  // Exposure and gain by the firmware (sensor AEC/AGC off), no waiting for them to settle
+  if (Camera_InitExposure(&camera) != 0)
+  {
+	  HAL_GPIO_WritePin(GPIOB, LED3_Pin, GPIO_PIN_SET);
+	  for (;;);
+  }
 
-  /* Wait 1s to let auto-loops in the camera module converge and lead to correct exposure */
-  HAL_Delay(1000);
-  
   // Start camera
   OV5640_Start(&camera);
 
-  // Start DMA continuous mode
-  if(HAL_DCMI_Start_DMA(&hdcmi, DCMI_MODE_CONTINUOUS, (uint32_t)frame_buffer, FRAME_WORDS) != HAL_OK)
+  // Cycle counter, for the capture latency
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  // Start DMA, a frame at a time into the frame buffers in turn
   {
-	  Error_Handler();
+    uint8_t *bufs[CAPTURE_SLOTS];
+
+    for (uint32_t i = 0; i < CAPTURE_SLOTS; i++)
+    {
+      bufs[i] = frame_buffer[i];
+    }
+
+    if ((CaptureRing_Init(&capture, &capture_os, bufs, CAPTURE_SLOTS) != CAPTURE_RING_OK) ||
+        (HAL_DCMI_Start_DMA(&hdcmi, DCMI_MODE_SNAPSHOT, (uint32_t)CaptureRing_Start(&capture), FRAME_WORDS) != HAL_OK))
+    {
+      Error_Handler();
+    }
   }
 
   // Enable ITM stimulus port 0
-  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
   ITM->TCR |= ITM_TCR_ITMENA_Msk;
   ITM->TER |= (1 << 0);
 
@@ -458,6 +792,11 @@ int main(void)
 
   /* USER CODE BEGIN RTOS_THREADS */
   /* add threads, ... */
+  // SD writer, below the camera and map tasks
+  const int writer_started = (SdWriterRTOS_Start((uint32_t)osPriorityBelowNormal) == SD_WRITER_OK);
+
+  frame_archive_ok = frame_archive_ok && writer_started;
+  nav_log_ok = nav_log_ok && writer_started;
   /* USER CODE END RTOS_THREADS */
 
   /* USER CODE BEGIN RTOS_EVENTS */
@@ -910,6 +1249,8 @@ void StartDefaultTask(void *argument)
   /* Infinite loop */
   for(;;)
   {
+    // Load the map tiles queued by the camera task while it waits for a frame
+    (void)SpectrumCache_Service(1U);
     osDelay(1);
   }
   /* USER CODE END 5 */
@@ -929,9 +1270,28 @@ void StartCameraTask(void *argument)
 	/* Infinite loop */
 	for (;;)
 	{
-		// Waits a direct-to-task notification to cameraTaskHandle
+		capture_frame_t frame;
+		uint32_t lines;
+
+		// Waits a direct-to-task notification to cameraTaskHandle: a band or a frame is in
 		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
+		// The frame being captured: its bands so far, the last line may still be on its way
+		if ((CaptureRing_Filling(&capture, &frame, &lines) == CAPTURE_RING_OK) && (lines > 1U))
+		{
+			Capture_Bands(&frame, lines - 1U);
+		}
+
+		// The newest frame; older ones nobody took were dropped
+		if (CaptureRing_Acquire(&capture, &frame) != CAPTURE_RING_OK)
+		{
+			continue;
+		}
+
+		// Its remaining bands (all of them if it was not the one streamed)
+		Capture_Bands(&frame, HEIGHT);
+		FrameBands_End(&frame_bands);
+
 //		// Suspend DCMI
 //		HAL_DCMI_Suspend(&hdcmi);
 //
@@ -941,6 +1301,20 @@ void StartCameraTask(void *argument)
 		// Signal processing
 	    HAL_GPIO_TogglePin(GPIOB, LED1_Pin);
 
+	    // Position fix from this frame (tracking, re-anchored on the map tiles)
+	    if ((Nav_ProcessFrame(frame.data, WIDTH, HEIGHT) == NAV_OK) && nav_log_ok)
+	    {
+	    	position_fix_t fix;
+
+	    	Nav_GetPosition(&fix);
+	    	(void)NavLog_Put(&fix);
+
+	    	if ((fix.frame % NAV_LOG_FLUSH_EVERY) == 0U)
+	    	{
+	    		(void)SdWriter_Flush(SdWriterRTOS_Writer(), &nav_log_stream, NAV_LOG_WAIT_MS);
+	    	}
+	    }
+
 		/* Transmit image via UART with 100 ms timeout */
 	    //for(int i=0;i<FRAME_BYTES;i++)
 	    //	HAL_UART_Transmit(&huart5, &(frame_buffer[i]), 1, 100);
@@ -950,7 +1324,7 @@ void StartCameraTask(void *argument)
 	    if (hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED)
 	    {
 	    	// Invalidate the cache
-	    	SCB_InvalidateDCache_by_Addr((uint32_t*)frame_buffer, FRAME_BYTES);
+	    	SCB_InvalidateDCache_by_Addr((uint32_t*)frame.data, FRAME_BYTES);
 
             /*
              * Synthetic image test.
@@ -969,15 +1343,27 @@ void StartCameraTask(void *argument)
 			//PSRAM_Write(0,frame_buffer,FRAME_BYTES);
 			//PSRAM_Read(0,frame_buffer,FRAME_BYTES);
 
-	    	USB_SendFrame((uint8_t *)frame_buffer, FRAME_BYTES);
+	    	// Held until sent (USB_FrameSent()); a send still going on skips this frame
+	    	if (USB_SendFrame(frame.data, FRAME_BYTES) != 0)
+	    	{
+	    		Capture_Arm(CaptureRing_Release(&capture, &frame));
+	    	}
 	    	//USB_SendBuffer((uint8_t *)frame_buffer, FRAME_BYTES);
 	    }
         else
         {
-    		// Resume DCMI
-            HAL_DCMI_Resume(&hdcmi);
+            // Now and then a frame to the archive, encoded straight from the frame buffer
+            if (frame_archive_ok && ((++frame_archive_count % FRAME_ARCHIVE_EVERY) == 0U))
+            {
+                (void)FrameArchive_Save(frame.data, WIDTH, HEIGHT);
+            }
+
+            // Back to the ring
+            Capture_Arm(CaptureRing_Release(&capture, &frame));
         }
 
+        CaptureRing_GetStats(&capture, &capture_stats);
+
 		osDelay(1);
 	}
   /* USER CODE END StartCameraTask */
@@ -0,0 +1,231 @@
+#include "map_sd.h"
+
+#include <string.h>
+
+#include "tile_codec.h"
+
+/* Index entries read per f_read() by MapSD_LoadIndex(): one sector */
+#define MAP_SD_INDEX_CHUNK   (MAP_FILE_ALIGN / sizeof(map_tile_entry_t))
+
+/* Packed pixels are read into this and unpacked from it, a chunk at a time */
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t map_sd_chunk[MAP_SD_PACK_CHUNK];
+
+
+int MapSD_Open(map_sd_t *m, const char *path)
+{
+    UINT br;
+
+    if ((m == 0) || (path == 0))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    if (f_open(&m->fp, path, FA_READ) != FR_OK)
+    {
+        return MAP_SD_ERROR;
+    }
+
+    if ((f_read(&m->fp, &m->hdr, sizeof(m->hdr), &br) != FR_OK) || (br != sizeof(m->hdr)) ||
+        !MapFile_CheckHeader(&m->hdr) || (f_size(&m->fp) < m->hdr.file_bytes))
+    {
+        f_close(&m->fp);
+        return MAP_SD_BAD_FILE;
+    }
+
+    return MAP_SD_OK;
+}
+
+
+void MapSD_Close(map_sd_t *m)
+{
+    f_close(&m->fp);
+}
+
+
+/* Buffer size for MapSD_ReadTile(), with or without the spectrum */
+uint32_t MapSD_TileBytes(const map_sd_t *m, int with_spectrum)
+{
+    if (with_spectrum && ((m->hdr.flags & MAP_FILE_SPECTRA) != 0U))
+    {
+        return m->hdr.level[0].record_bytes;
+    }
+
+    return MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(m->hdr.tile);
+}
+
+
+/* tile_codec_stream_t::read, the file position being where the data continues */
+static int MapSD_ReadPacked(void *ctx, void *dst, uint32_t bytes)
+{
+    UINT br;
+
+    return ((f_read((FIL *)ctx, dst, bytes, &br) == FR_OK) && (br == bytes)) ? 0 : -1;
+}
+
+
+/*
+ * Record at offset of a packed map into buf as a plain record. Its first
+ * sector holds the header and the start of the pixels; only the sectors
+ * holding the rest of the packed pixels (and the spectrum, if bytes asks
+ * for it) are read after that.
+ */
+static int MapSD_ReadPackedRecord(map_sd_t *m, uint32_t offset, uint8_t *buf, uint32_t bytes)
+{
+    const uint32_t tile = m->hdr.tile;
+    const uint32_t so = MapFile_SpectrumOffset(tile);
+    const map_tile_header_t *th = (const map_tile_header_t *)map_sd_chunk;
+    tile_codec_stream_t s;
+    UINT br;
+
+    if ((f_lseek(&m->fp, offset) != FR_OK) ||
+        (f_read(&m->fp, map_sd_chunk, MAP_FILE_ALIGN, &br) != FR_OK) || (br != MAP_FILE_ALIGN))
+    {
+        return MAP_SD_ERROR;
+    }
+
+    /* Tiles that did not compress are stored plain */
+    if ((th->flags & MAP_TILE_PACKED) == 0U)
+    {
+        return ((f_lseek(&m->fp, offset) == FR_OK) && (f_read(&m->fp, buf, bytes, &br) == FR_OK) &&
+                (br == bytes)) ? MAP_SD_OK : MAP_SD_ERROR;
+    }
+
+    if (th->packed_bytes >= MapFile_PixelBytes(tile))
+    {
+        return MAP_SD_BAD_FILE;
+    }
+
+    memcpy(buf, map_sd_chunk, MAP_TILE_HEADER_BYTES);
+    ((map_tile_header_t *)buf)->flags &= (uint16_t)~MAP_TILE_PACKED;
+
+    TileCodec_InitStream(&s, th->packed_bytes, &map_sd_chunk[MAP_TILE_HEADER_BYTES],
+                         MAP_FILE_ALIGN - MAP_TILE_HEADER_BYTES,
+                         map_sd_chunk, sizeof(map_sd_chunk), MapSD_ReadPacked, &m->fp);
+
+    switch (TileCodec_Decode(&s, &buf[MAP_TILE_HEADER_BYTES], tile, tile))
+    {
+    case TILE_CODEC_OK:
+        break;
+
+    case TILE_CODEC_BAD_DATA:
+        return MAP_SD_BAD_FILE;
+
+    default:
+        return MAP_SD_ERROR;
+    }
+
+    if ((bytes > so) &&
+        ((f_lseek(&m->fp, offset + so) != FR_OK) ||
+         (f_read(&m->fp, &buf[so], bytes - so, &br) != FR_OK) || (br != (bytes - so))))
+    {
+        return MAP_SD_ERROR;
+    }
+
+    return MAP_SD_OK;
+}
+
+
+/*
+ * Read tile (tx, ty) of level into buf (bytes = MapSD_TileBytes()) and
+ * point view at its pixels and, if read, its spectrum.
+ */
+int MapSD_ReadTile(map_sd_t *m, uint32_t level, uint32_t tx, uint32_t ty,
+                   void *buf, uint32_t bytes, map_tile_view_t *view)
+{
+    UINT br;
+
+    if ((m == 0) || (buf == 0) || (view == 0) || (level >= m->hdr.levels) ||
+        (tx >= m->hdr.level[level].cols) || (ty >= m->hdr.level[level].rows) ||
+        (bytes < (MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(m->hdr.tile))) ||
+        (bytes > m->hdr.level[level].record_bytes))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    if ((m->hdr.flags & MAP_FILE_PACKED) != 0U)
+    {
+        const int err = MapSD_ReadPackedRecord(m, MapFile_RecordOffset(&m->hdr, level, tx, ty),
+                                               (uint8_t *)buf, bytes);
+
+        if (err != MAP_SD_OK)
+        {
+            return err;
+        }
+    }
+    else if ((f_lseek(&m->fp, MapFile_RecordOffset(&m->hdr, level, tx, ty)) != FR_OK) ||
+             (f_read(&m->fp, buf, bytes, &br) != FR_OK) || (br != bytes))
+    {
+        return MAP_SD_ERROR;
+    }
+
+    switch (MapFile_ParseRecord(&m->hdr, level, tx, ty, buf, bytes, view))
+    {
+    case MAP_FILE_OK:
+        return MAP_SD_OK;
+
+    case MAP_FILE_BAD_FILE:
+        return MAP_SD_BAD_FILE;
+
+    default:
+        return MAP_SD_INVALID_PARAM;
+    }
+}
+
+
+/* Index entries first .. first + count - 1 of level (row-major tile order) */
+int MapSD_ReadIndex(map_sd_t *m, uint32_t level, uint32_t first, uint32_t count,
+                    map_tile_entry_t *entries)
+{
+    const uint32_t bytes = count * (uint32_t)sizeof(map_tile_entry_t);
+    UINT br;
+
+    if ((m == 0) || (entries == 0) || (level >= m->hdr.levels) ||
+        ((first + count) > ((uint32_t)m->hdr.level[level].cols * m->hdr.level[level].rows)))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    if ((f_lseek(&m->fp, m->hdr.level[level].index_offset + (first * (uint32_t)sizeof(map_tile_entry_t))) != FR_OK) ||
+        (f_read(&m->fp, entries, bytes, &br) != FR_OK) || (br != bytes))
+    {
+        return MAP_SD_ERROR;
+    }
+
+    return MAP_SD_OK;
+}
+
+
+/*
+ * Build idx over bits (MapIndex_Bytes() bytes) from the tile index of every
+ * level: tiles with a contrast of at least min_contrast are usable.
+ */
+int MapSD_LoadIndex(map_sd_t *m, map_index_t *idx, uint64_t *bits, uint32_t bytes,
+                    uint8_t min_contrast)
+{
+    static map_tile_entry_t chunk[MAP_SD_INDEX_CHUNK];
+
+    if ((m == 0) || (MapIndex_Init(idx, &m->hdr, bits, bytes) != MAP_INDEX_OK))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    for (uint32_t l = 0; l < m->hdr.levels; l++)
+    {
+        const uint32_t tiles = (uint32_t)m->hdr.level[l].cols * m->hdr.level[l].rows;
+
+        for (uint32_t first = 0; first < tiles; first += MAP_SD_INDEX_CHUNK)
+        {
+            const uint32_t count = ((tiles - first) < MAP_SD_INDEX_CHUNK) ? (tiles - first) : MAP_SD_INDEX_CHUNK;
+
+            if (MapSD_ReadIndex(m, l, first, count, chunk) != MAP_SD_OK)
+            {
+                return MAP_SD_ERROR;
+            }
+
+            MapIndex_AddEntries(idx, l, first, chunk, count, min_contrast);
+        }
+    }
+
+    return MAP_SD_OK;
+}
@@ -0,0 +1,258 @@
+#include "nav.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "spectrum_cache.h"
+
+#define NAV_TILES          9U
+
+/*
+ * The tracking correlator and the tile correlator run one after the other
+ * in the camera task, so they share the cross-power/inverse buffer.
+ */
+__attribute__((section(".RAM_D2"), aligned(32)))
+static float nav_corr[PHASE_CORR_WORK_FLOATS(NAV_TRACK_N)];
+
+__attribute__((section(".RAM_D2"), aligned(32)))
+static float nav_track_spec[2][PHASE_CORR_WORK_FLOATS(NAV_TRACK_N)];
+
+__attribute__((section(".RAM_D2"), aligned(32)))
+static float nav_tile_spec[PHASE_CORR_WORK_FLOATS(NAV_TILE_N)];
+
+static phase_corr_t nav_pc_track;
+static phase_corr_t nav_pc_tile;
+static visual_odometry_t nav_vo;
+static position_fix_t nav_position;
+static int32_t nav_radius = 1;          /* Tile rings searched by the next anchor */
+static int32_t nav_prefetched[3] = { -1, -1, 0 };  /* Last prefetch: tile and radius */
+
+static image_t nav_band_frame;         /* Frame whose bands are coming in */
+
+static uint32_t nav_slots[NAV_TILES];
+static spectrum_tile_header_t nav_hdrs[NAV_TILES];
+static phase_corr_result_t nav_results[NAV_TILES];
+
+
+/* Tile column/row whose centre is nearest to map coordinate v */
+static int32_t Nav_TileIndex(float v)
+{
+    const float t = (v - (float)(NAV_TILE_N / 2U)) / (float)NAV_TILE_STEP;
+
+    return (int32_t)((t < 0.0f) ? (t - 0.5f) : (t + 0.5f));
+}
+
+
+/*
+ * Correlate the frame against the count tiles opened into nav_slots and
+ * keep the best one in *fix if it beats *best_psr.
+ */
+static void Nav_Batch(const image_t *frame, uint32_t count, position_fix_t *fix, float *best_psr)
+{
+    uint32_t best = 0U;
+    int err;
+
+    err = SpectrumCache_CorrelateBatch(&nav_pc_tile, frame, nav_slots, nav_hdrs, count, nav_results, &best);
+
+    if ((err != SPECTRUM_SD_OK) || (nav_results[best].psr <= *best_psr))
+    {
+        return;
+    }
+
+    /* frame(x) = tile(x - d): the frame centre is d before the tile centre */
+    fix->x = (float)(nav_hdrs[best].origin_x + (int32_t)(NAV_TILE_N / 2U)) - nav_results[best].sub_dx;
+    fix->y = (float)(nav_hdrs[best].origin_y + (int32_t)(NAV_TILE_N / 2U)) - nav_results[best].sub_dy;
+    fix->peak = nav_results[best].peak;
+    fix->psr = nav_results[best].psr;
+    *best_psr = fix->psr;
+}
+
+
+/*
+ * vo_absolute_fn: correlate the frame against the tiles within nav_radius
+ * of the prior, NAV_TILES at a time. Tiles missing at the map border are
+ * skipped. A miss widens the next search.
+ */
+static int Nav_Absolute(void *ctx, const image_t *frame, const position_fix_t *prior, position_fix_t *fix)
+{
+    const int32_t tx = Nav_TileIndex(prior->x);
+    const int32_t ty = Nav_TileIndex(prior->y);
+    const int32_t r = nav_radius;
+    float best_psr = -1.0f;
+    uint32_t count = 0U;
+
+    (void)ctx;
+
+    for (int32_t j = ty - r; j <= ty + r; j++)
+    {
+        for (int32_t i = tx - r; i <= tx + r; i++)
+        {
+            if ((i < 0) || (j < 0))
+            {
+                continue;
+            }
+
+            if (SpectrumCache_Open((uint32_t)i, (uint32_t)j, &nav_hdrs[count], &nav_slots[count]) == SPECTRUM_SD_OK)
+            {
+                count++;
+            }
+
+            if (count == NAV_TILES)
+            {
+                Nav_Batch(frame, count, fix, &best_psr);
+                count = 0U;
+            }
+        }
+    }
+
+    if (count != 0U)
+    {
+        Nav_Batch(frame, count, fix, &best_psr);
+    }
+
+    if (best_psr < 0.0f)
+    {
+        if (nav_radius < NAV_MAX_SEARCH_RADIUS)
+        {
+            nav_radius++;
+        }
+
+        return -1;
+    }
+
+    nav_radius = 1;
+
+    return 0;
+}
+
+
+/*
+ * Queue the tiles that the next anchor would search around pos, nearest
+ * rings first, when pos has moved to another tile or the search widened.
+ */
+static void Nav_Prefetch(const position_fix_t *pos)
+{
+    const int32_t tx = Nav_TileIndex(pos->x);
+    const int32_t ty = Nav_TileIndex(pos->y);
+    const int32_t r = (nav_radius > NAV_PREFETCH_RADIUS) ? nav_radius : NAV_PREFETCH_RADIUS;
+
+    if ((tx == nav_prefetched[0]) && (ty == nav_prefetched[1]) && (r == nav_prefetched[2]))
+    {
+        return;
+    }
+
+    nav_prefetched[0] = tx;
+    nav_prefetched[1] = ty;
+    nav_prefetched[2] = r;
+
+    for (int32_t ring = 0; ring <= r; ring++)
+    {
+        for (int32_t j = ty - ring; j <= ty + ring; j++)
+        {
+            for (int32_t i = tx - ring; i <= tx + ring; i++)
+            {
+                const int32_t di = (i > tx) ? (i - tx) : (tx - i);
+                const int32_t dj = (j > ty) ? (j - ty) : (ty - j);
+
+                if ((i >= 0) && (j >= 0) && (((di > dj) ? di : dj) == ring))
+                {
+                    SpectrumCache_Prefetch((uint32_t)i, (uint32_t)j);
+                }
+            }
+        }
+    }
+}
+
+
+int Nav_Init(void)
+{
+    const visual_odometry_config_t cfg =
+    {
+        .anchor_every = NAV_ANCHOR_EVERY,
+        .pool = NAV_TRACK_POOL,
+        .min_track_psr = NAV_MIN_TRACK_PSR,
+        .min_anchor_psr = NAV_MIN_ANCHOR_PSR,
+    };
+
+    if ((PhaseCorr_Init(&nav_pc_track, NAV_TRACK_N, nav_corr, 0) != PHASE_CORR_OK) ||
+        (PhaseCorr_Init(&nav_pc_tile, NAV_TILE_N, nav_corr, nav_tile_spec) != PHASE_CORR_OK))
+    {
+        return NAV_ERROR;
+    }
+
+    PhaseCorr_SetMinConfidence(&nav_pc_tile, NAV_MIN_ANCHOR_PSR);
+
+    if (SpectrumCache_Init(NAV_TILE_DIR, NAV_TILE_N) != SPECTRUM_SD_OK)
+    {
+        return NAV_ERROR;
+    }
+
+    if (VisualOdometry_Init(&nav_vo, &nav_pc_track, &cfg, nav_track_spec[0], nav_track_spec[1],
+                            Nav_Absolute, 0) != VISUAL_ODOMETRY_OK)
+    {
+        return NAV_ERROR;
+    }
+
+    VisualOdometry_SetPrior(&nav_vo, NAV_START_X, NAV_START_Y);
+
+    return NAV_OK;
+}
+
+
+static void Nav_BandBegin(void *ctx, const uint8_t *frame, uint32_t width, uint32_t height)
+{
+    (void)ctx;
+
+    nav_band_frame.w = (int)width;
+    nav_band_frame.h = (int)height;
+    nav_band_frame.bpp = IMAGE_BPP_GRAYSCALE;
+    nav_band_frame.pixels = (uint8_t *)frame;
+    VisualOdometry_BeginFrame(&nav_vo);
+}
+
+
+static void Nav_Band(void *ctx, const uint8_t *rows, uint32_t row0, uint32_t count)
+{
+    (void)ctx;
+    (void)rows;
+
+    (void)VisualOdometry_Rows(&nav_vo, &nav_band_frame, row0 + count);
+}
+
+
+/* Track on each band of the frame as it comes in; Nav_ProcessFrame() on the frame completes it */
+int Nav_AttachBands(frame_bands_t *fb)
+{
+    const frame_band_consumer_t consumer = { Nav_BandBegin, Nav_Band, 0, 0 };
+
+    return (FrameBands_Attach(fb, &consumer) == FRAME_BANDS_OK) ? NAV_OK : NAV_ERROR;
+}
+
+
+/* Position fix for one Y8 frame (cache already invalidated by the caller) */
+int Nav_ProcessFrame(const uint8_t *frame, uint32_t width, uint32_t height)
+{
+    image_t img = { .w = (int)width, .h = (int)height, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = (uint8_t *)frame };
+    position_fix_t pos;
+
+    if (VisualOdometry_Process(&nav_vo, &img, &pos) != VISUAL_ODOMETRY_OK)
+    {
+        return NAV_ERROR;
+    }
+
+    taskENTER_CRITICAL();
+    nav_position = pos;
+    taskEXIT_CRITICAL();
+
+    Nav_Prefetch(&pos);
+
+    return NAV_OK;
+}
+
+
+/* Latest position fix, see position_fix_t::source and ::valid */
+void Nav_GetPosition(position_fix_t *pos)
+{
+    taskENTER_CRITICAL();
+    *pos = nav_position;
+    taskEXIT_CRITICAL();
+}
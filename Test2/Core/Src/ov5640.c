@@ -37,6 +37,50 @@
   * @{
   */
 
+/**
+  * @}
+  */
+
+/** @defgroup OV5640_Private_Defines
+  * @{
+  */
+/* Field of view of the resolutions: array window read out by the common
+   sequence, ISP margins around the image, vertical blanking and the AEC
+   exposure limits it sets (max exposure = VTS - margin, in band steps) */
+#define OV5640_FIELD_X_START            0
+#define OV5640_FIELD_X_END              2623
+#define OV5640_FIELD_Y_START            4
+#define OV5640_FIELD_Y_END              1947
+#define OV5640_ISP_HOFFSET              16U
+#define OV5640_ISP_VOFFSET              6U
+#define OV5640_VTS_BLANKING             116U
+#define OV5640_EXPO_MARGIN              104U
+#define OV5640_B50_STEP                 0x127U
+#define OV5640_B60_STEP                 0xF6U
+
+/* Register tables go out in bursts of up to OV5640_BURST_MAX consecutive
+   registers, one SCCB transfer each (the address auto-increments) */
+#define OV5640_BURST_MAX                32U
+
+/* Settling after a software reset */
+#define OV5640_RESET_DELAY              5U
+
+/* Auto exposure settled: inside the stable range with exposure and gain
+   unchanged for OV5640_AEC_SETTLE_MS, polled every OV5640_AEC_POLL_MS */
+#define OV5640_AEC_POLL_MS              5U
+#define OV5640_AEC_SETTLE_MS            50U
+
+/* Manual exposure (1/16 line) and real gain (1/16) fields, and the lines of a
+   frame an exposure may take without stretching it */
+#define OV5640_EXPOSURE_MAX             0xFFFFFU
+#define OV5640_GAIN_MAX                 0x3FFU
+#define OV5640_VTS_EXPO_MARGIN          4U
+
+/* ISP gamma: GMA enable in ISP_CONTROL00, and the levels into it of the
+   outputs GAMMA_YST00..0E, the curve linear between them and up to 256 */
+#define OV5640_ISP_GAMMA_EN             0x20U
+#define OV5640_GAMMA_POINTS             15U
+
 /**
   * @}
   */
@@ -76,6 +120,8 @@ static int32_t OV5640_ReadRegWrap(void *handle, uint16_t Reg, uint8_t *Data, uin
 static int32_t OV5640_WriteRegWrap(void *handle, uint16_t Reg, uint8_t *Data, uint16_t Length);
 static int32_t OV5640_ModifyRegWrap(void *handle, uint16_t Reg, uint16_t Mask, uint8_t *Data, uint16_t Length);
 static int32_t OV5640_Delay(OV5640_Object_t *pObj, uint32_t Delay);
+static int32_t OV5640_ReadReg16(OV5640_Object_t *pObj, uint16_t Reg, uint16_t *Value);
+static int32_t OV5640_WriteTable(OV5640_Object_t *pObj, const uint16_t (*Table)[2], uint32_t Count);
 
 /**
   * @}
@@ -133,7 +179,6 @@ int32_t OV5640_RegisterBusIO(OV5640_Object_t *pObj, OV5640_IO_t *pIO)
   */
 int32_t OV5640_Init(OV5640_Object_t *pObj, uint32_t Resolution, uint32_t PixelFormat)
 {
-  uint32_t index;
   int32_t ret = OV5640_OK;
 
   /* Initialization sequence for OV5640 */
@@ -387,7 +432,6 @@ int32_t OV5640_Init(OV5640_Object_t *pObj, uint32_t Resolution, uint32_t PixelFo
     {OV5640_AEC_CTRL1F, 0x14},
     {OV5640_SYSTEM_CTROL0, 0x02},
   };
-  uint8_t tmp;
 
   if (pObj->IsInitialized == 0U)
   {
@@ -402,18 +446,7 @@ int32_t OV5640_Init(OV5640_Object_t *pObj, uint32_t Resolution, uint32_t PixelFo
     else
     {
       /* Set common parameters for all resolutions */
-      for (index = 0; index < (sizeof(OV5640_Common) / 4U) ; index++)
-      {
-        if (ret != OV5640_ERROR)
-        {
-          tmp = (uint8_t)OV5640_Common[index][1];
-
-          if (ov5640_write_reg(&pObj->Ctx, OV5640_Common[index][0], &tmp, 1) != OV5640_OK)
-          {
-            ret = OV5640_ERROR;
-          }
-        }
-      }
+      ret = OV5640_WriteTable(pObj, OV5640_Common, sizeof(OV5640_Common) / 4U);
 
       if(ret == OV5640_OK)
       {
@@ -717,8 +750,6 @@ int32_t OV5640_GetPixelFormat(OV5640_Object_t *pObj, uint32_t *PixelFormat)
 int32_t OV5640_SetResolution(OV5640_Object_t *pObj, uint32_t Resolution)
 {
   int32_t ret = OV5640_OK;
-  uint32_t index;
-  uint8_t tmp;
 
   /* Initialization sequence for WVGA resolution (800x480)*/
   static const uint16_t OV5640_WVGA[][2] =
@@ -776,69 +807,19 @@ int32_t OV5640_SetResolution(OV5640_Object_t *pObj, uint32_t Resolution)
     switch (Resolution)
     {
       case OV5640_R160x120:
-        for (index = 0; index < (sizeof(OV5640_QQVGA) / 4U); index++)
-        {
-          if (ret != OV5640_ERROR)
-          {
-            tmp = (uint8_t)OV5640_QQVGA[index][1];
-            if (ov5640_write_reg(&pObj->Ctx, OV5640_QQVGA[index][0], &tmp, 1) != OV5640_OK)
-            {
-              ret = OV5640_ERROR;
-            }
-          }
-        }
+        ret = OV5640_WriteTable(pObj, OV5640_QQVGA, sizeof(OV5640_QQVGA) / 4U);
         break;
       case OV5640_R320x240:
-        for (index = 0; index < (sizeof(OV5640_QVGA) / 4U); index++)
-        {
-          if (ret != OV5640_ERROR)
-          {
-            tmp = (uint8_t)OV5640_QVGA[index][1];
-            if (ov5640_write_reg(&pObj->Ctx, OV5640_QVGA[index][0], &tmp, 1) != OV5640_OK)
-            {
-              ret = OV5640_ERROR;
-            }
-          }
-        }
+        ret = OV5640_WriteTable(pObj, OV5640_QVGA, sizeof(OV5640_QVGA) / 4U);
         break;
       case OV5640_R480x272:
-        for (index = 0; index < (sizeof(OV5640_480x272) / 4U); index++)
-        {
-          if (ret != OV5640_ERROR)
-          {
-            tmp = (uint8_t)OV5640_480x272[index][1];
-            if (ov5640_write_reg(&pObj->Ctx, OV5640_480x272[index][0], &tmp, 1) != OV5640_OK)
-            {
-              ret = OV5640_ERROR;
-            }
-          }
-        }
+        ret = OV5640_WriteTable(pObj, OV5640_480x272, sizeof(OV5640_480x272) / 4U);
         break;
       case OV5640_R640x480:
-        for (index = 0; index < (sizeof(OV5640_VGA) / 4U); index++)
-        {
-          if (ret != OV5640_ERROR)
-          {
-            tmp = (uint8_t)OV5640_VGA[index][1];
-            if (ov5640_write_reg(&pObj->Ctx, OV5640_VGA[index][0], &tmp, 1) != OV5640_OK)
-            {
-              ret = OV5640_ERROR;
-            }
-          }
-        }
+        ret = OV5640_WriteTable(pObj, OV5640_VGA, sizeof(OV5640_VGA) / 4U);
         break;
       case OV5640_R800x480:
-        for (index = 0; index < (sizeof(OV5640_WVGA) / 4U); index++)
-        {
-          if (ret != OV5640_ERROR)
-          {
-            tmp = (uint8_t)OV5640_WVGA[index][1];
-            if (ov5640_write_reg(&pObj->Ctx, OV5640_WVGA[index][0], &tmp, 1) != OV5640_OK)
-            {
-              ret = OV5640_ERROR;
-            }
-          }
-        }
+        ret = OV5640_WriteTable(pObj, OV5640_WVGA, sizeof(OV5640_WVGA) / 4U);
         break;
       default:
         ret = OV5640_ERROR;
@@ -930,6 +911,439 @@ int32_t OV5640_GetResolution(OV5640_Object_t *pObj, uint32_t *Resolution)
   return ret;
 }
 
+/**
+  * @brief  Set the OV5640 camera output to a window of the field of view.
+  *         The window is centred on the field centre moved by OffsetX,
+  *         OffsetY and read out of the array at Decimation: the sensor outputs
+  *         Width x Height pixels and nothing else, the vertical timing (VTS)
+  *         is cut to the lines read, for a higher frame rate, and the AEC
+  *         exposure limits follow it. A 4x4 window has the pixel size of the
+  *         resolutions (OV5640_SetResolution), so { 640, 480, 0, 0,
+  *         OV5640_SUBSAMPLE_4x4 } is the VGA set up by OV5640_Init().
+  *         Camera must be stopped; mirror/flip settings are kept.
+  * @param  pObj  pointer to component object
+  * @param  pWindow  window to be configured
+  * @retval Component status, OV5640_ERROR if the window leaves the field
+  */
+int32_t OV5640_SetWindow(OV5640_Object_t *pObj, const OV5640_Window_t *pWindow)
+{
+  int32_t ret = OV5640_OK;
+  uint32_t scale;
+  uint32_t isp_width;
+  uint32_t isp_height;
+  uint32_t vts;
+  uint32_t max_expo;
+  int32_t x_start;
+  int32_t x_end;
+  int32_t y_start;
+  int32_t y_end;
+  uint8_t tmp;
+
+  if ((pWindow->Width == 0U) || ((pWindow->Width % 4U) != 0U) ||
+      (pWindow->Height == 0U) || ((pWindow->Height % 2U) != 0U) ||
+      (pWindow->Decimation > OV5640_BINNING_4x4))
+  {
+    ret = OV5640_ERROR;
+  }
+  else
+  {
+    /* ISP input: the output size, twice it when the ISP scales 2:1 */
+    scale = ((pWindow->Decimation & OV5640_SUBSAMPLE_4x4) != 0U) ? 2U : 1U;
+    isp_width = (pWindow->Width * scale) + (2U * OV5640_ISP_HOFFSET);
+    isp_height = (pWindow->Height * scale) + (2U * OV5640_ISP_VOFFSET);
+
+    /* Array window: the ISP input with its margins, 2 array pixels per sensor pixel */
+    x_start = ((OV5640_FIELD_X_START + OV5640_FIELD_X_END + 1) / 2) +
+              ((int32_t)pWindow->OffsetX * 2 * (int32_t)scale) - (int32_t)isp_width;
+    x_end = x_start + (2 * (int32_t)isp_width) - 1;
+    y_start = ((OV5640_FIELD_Y_START + OV5640_FIELD_Y_END + 1) / 2) +
+              ((int32_t)pWindow->OffsetY * 2 * (int32_t)scale) - (int32_t)isp_height;
+    y_end = y_start + (2 * (int32_t)isp_height) - 1;
+
+    if ((x_start < OV5640_FIELD_X_START) || (x_end > OV5640_FIELD_X_END) ||
+        (y_start < OV5640_FIELD_Y_START) || (y_end > OV5640_FIELD_Y_END))
+    {
+      ret = OV5640_ERROR;
+    }
+    else
+    {
+      /* Frame: the sensor lines read plus the blanking of the common sequence */
+      vts = isp_height + OV5640_VTS_BLANKING;
+      max_expo = vts - OV5640_EXPO_MARGIN;
+
+      /* Window sequence, in register order for four bursts: timing 0x3800..0x3815 (HTS as the
+         common sequence sets it) and the AEC limits; the band limits are whole bands within the max
+         exposure, at least one */
+      const uint16_t OV5640_Window[][2] =
+      {
+        {OV5640_TIMING_HS_HIGH, (uint16_t)((uint32_t)x_start >> 8U)},
+        {OV5640_TIMING_HS_LOW, (uint16_t)((uint32_t)x_start & 0xFFU)},
+        {OV5640_TIMING_VS_HIGH, (uint16_t)((uint32_t)y_start >> 8U)},
+        {OV5640_TIMING_VS_LOW, (uint16_t)((uint32_t)y_start & 0xFFU)},
+        {OV5640_TIMING_HW_HIGH, (uint16_t)((uint32_t)x_end >> 8U)},
+        {OV5640_TIMING_HW_LOW, (uint16_t)((uint32_t)x_end & 0xFFU)},
+        {OV5640_TIMING_VH_HIGH, (uint16_t)((uint32_t)y_end >> 8U)},
+        {OV5640_TIMING_VH_LOW, (uint16_t)((uint32_t)y_end & 0xFFU)},
+        {OV5640_TIMING_DVPHO_HIGH, (uint16_t)(pWindow->Width >> 8U)},
+        {OV5640_TIMING_DVPHO_LOW, (uint16_t)(pWindow->Width & 0xFFU)},
+        {OV5640_TIMING_DVPVO_HIGH, (uint16_t)(pWindow->Height >> 8U)},
+        {OV5640_TIMING_DVPVO_LOW, (uint16_t)(pWindow->Height & 0xFFU)},
+        {OV5640_TIMING_HTS_HIGH, 0x07},
+        {OV5640_TIMING_HTS_LOW, 0x90},
+        {OV5640_TIMING_VTS_HIGH, (uint16_t)(vts >> 8U)},
+        {OV5640_TIMING_VTS_LOW, (uint16_t)(vts & 0xFFU)},
+        {OV5640_TIMING_HOFFSET_HIGH, 0x00},
+        {OV5640_TIMING_HOFFSET_LOW, OV5640_ISP_HOFFSET},
+        {OV5640_TIMING_VOFFSET_HIGH, 0x00},
+        {OV5640_TIMING_VOFFSET_LOW, OV5640_ISP_VOFFSET},
+        {OV5640_TIMING_X_INC, 0x31},
+        {OV5640_TIMING_Y_INC, 0x31},
+        {OV5640_AEC_CTRL02, (uint16_t)(max_expo >> 8U)},
+        {OV5640_AEC_CTRL03, (uint16_t)(max_expo & 0xFFU)},
+        {OV5640_AEC_CTRL0D, (uint16_t)((max_expo >= OV5640_B60_STEP) ? (max_expo / OV5640_B60_STEP) : 1U)},
+        {OV5640_AEC_CTRL0E, (uint16_t)((max_expo >= OV5640_B50_STEP) ? (max_expo / OV5640_B50_STEP) : 1U)},
+        {OV5640_AEC_MAX_EXPO_HIGH, (uint16_t)(max_expo >> 8U)},
+        {OV5640_AEC_MAX_EXPO_LOW, (uint16_t)(max_expo & 0xFFU)},
+      };
+
+      ret = OV5640_WriteTable(pObj, OV5640_Window, sizeof(OV5640_Window) / 4U);
+
+      /* Binning: bit 0 of TC_REG20 (vertical) and of TC_REG21 (horizontal) */
+      if (ret == OV5640_OK)
+      {
+        if (ov5640_read_reg(&pObj->Ctx, OV5640_TIMING_TC_REG20, &tmp, 1) != OV5640_OK)
+        {
+          ret = OV5640_ERROR;
+        }
+        else
+        {
+          tmp = (uint8_t)((tmp & 0xFEU) | (pWindow->Decimation & OV5640_BINNING_2x2));
+          if (ov5640_write_reg(&pObj->Ctx, OV5640_TIMING_TC_REG20, &tmp, 1) != OV5640_OK)
+          {
+            ret = OV5640_ERROR;
+          }
+          else if (ov5640_read_reg(&pObj->Ctx, OV5640_TIMING_TC_REG21, &tmp, 1) != OV5640_OK)
+          {
+            ret = OV5640_ERROR;
+          }
+          else
+          {
+            tmp = (uint8_t)((tmp & 0xFEU) | (pWindow->Decimation & OV5640_BINNING_2x2));
+            if (ov5640_write_reg(&pObj->Ctx, OV5640_TIMING_TC_REG21, &tmp, 1) != OV5640_OK)
+            {
+              ret = OV5640_ERROR;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Get the OV5640 camera output window, as set by OV5640_SetWindow()
+  *         or by a resolution of the same pixel size (VGA).
+  * @param  pObj  pointer to component object
+  * @param  pWindow  window configured
+  * @retval Component status, OV5640_ERROR if the timing is not such a window
+  */
+int32_t OV5640_GetWindow(OV5640_Object_t *pObj, OV5640_Window_t *pWindow)
+{
+  int32_t ret = OV5640_OK;
+  uint16_t x_start;
+  uint16_t x_end;
+  uint16_t y_start;
+  uint16_t y_end;
+  uint16_t x_offset;
+  uint16_t y_offset;
+  uint16_t width;
+  uint16_t height;
+  uint32_t isp_width;
+  uint32_t isp_height;
+  uint32_t scale;
+  uint8_t x_inc;
+  uint8_t y_inc;
+  uint8_t tmp3820;
+  uint8_t tmp3821;
+
+  if ((OV5640_ReadReg16(pObj, OV5640_TIMING_HS_HIGH, &x_start) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_HW_HIGH, &x_end) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_VS_HIGH, &y_start) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_VH_HIGH, &y_end) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_HOFFSET_HIGH, &x_offset) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_VOFFSET_HIGH, &y_offset) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_DVPHO_HIGH, &width) != OV5640_OK) ||
+      (OV5640_ReadReg16(pObj, OV5640_TIMING_DVPVO_HIGH, &height) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_TIMING_X_INC, &x_inc, 1) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_TIMING_Y_INC, &y_inc, 1) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_TIMING_TC_REG20, &tmp3820, 1) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_TIMING_TC_REG21, &tmp3821, 1) != OV5640_OK))
+  {
+    ret = OV5640_ERROR;
+  }
+  else if ((x_inc != 0x31U) || (y_inc != 0x31U) || (x_end <= x_start) || (y_end <= y_start) ||
+           ((tmp3820 & 0x01U) != (tmp3821 & 0x01U)) || (width == 0U) || (height == 0U))
+  {
+    ret = OV5640_ERROR;
+  }
+  else
+  {
+    /* ISP input: the sensor output (half the array window) less the margins */
+    isp_width = ((uint32_t)x_end - x_start + 1U) / 2U;
+    isp_height = ((uint32_t)y_end - y_start + 1U) / 2U;
+    isp_width = (isp_width > (2U * x_offset)) ? (isp_width - (2U * x_offset)) : 0U;
+    isp_height = (isp_height > (2U * y_offset)) ? (isp_height - (2U * y_offset)) : 0U;
+    scale = isp_width / width;
+
+    if (((scale != 1U) && (scale != 2U)) || (isp_width != (scale * width)) || (isp_height != (scale * height)))
+    {
+      ret = OV5640_ERROR;
+    }
+    else
+    {
+      pWindow->Width = width;
+      pWindow->Height = height;
+      pWindow->OffsetX = (int16_t)((((int32_t)x_start + (int32_t)x_end + 1) / 2 -
+                                    ((OV5640_FIELD_X_START + OV5640_FIELD_X_END + 1) / 2)) / (2 * (int32_t)scale));
+      pWindow->OffsetY = (int16_t)((((int32_t)y_start + (int32_t)y_end + 1) / 2 -
+                                    ((OV5640_FIELD_Y_START + OV5640_FIELD_Y_END + 1) / 2)) / (2 * (int32_t)scale));
+      pWindow->Decimation = ((scale == 2U) ? OV5640_SUBSAMPLE_4x4 : OV5640_SUBSAMPLE_2x2) |
+                            (tmp3821 & OV5640_BINNING_2x2);
+    }
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Wait for the OV5640 auto exposure to settle: the average level
+  *         (AVG_READOUT) within the AEC stable range, exposure and gain
+  *         unchanged for OV5640_AEC_SETTLE_MS. Camera must be streaming.
+  *         Returns at once if exposure and gain are manual.
+  * @param  pObj  pointer to component object
+  * @param  Timeout  longest wait, in milliseconds
+  * @retval Component status, OV5640_TIMEOUT if not settled within Timeout
+  */
+int32_t OV5640_WaitAutoExposure(OV5640_Object_t *pObj, uint32_t Timeout)
+{
+  int32_t ret = OV5640_TIMEOUT;
+  uint32_t tickstart;
+  uint32_t settled_since = 0;
+  uint32_t index;
+  uint32_t moved;
+  uint8_t manual;
+  uint8_t range[2];
+  uint8_t level;
+  uint8_t state[5];
+  uint8_t last[5] = {0};
+
+  tickstart = (uint32_t)pObj->IO.GetTick();
+
+  /* Stable range: AEC_CTRL0F high limit, AEC_CTRL10 low limit */
+  if ((ov5640_read_reg(&pObj->Ctx, OV5640_AEC_PK_MANUAL, &manual, 1) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_AEC_CTRL0F, range, 2) != OV5640_OK))
+  {
+    ret = OV5640_ERROR;
+  }
+  else if ((manual & 0x03U) == 0x03U)
+  {
+    ret = OV5640_OK;
+  }
+  else
+  {
+    moved = 1U;
+
+    while ((ret == OV5640_TIMEOUT) && (((uint32_t)pObj->IO.GetTick() - tickstart) < Timeout))
+    {
+      /* Exposure 0x3500..0x3502 and gain 0x350A..0x350B, a transfer each */
+      if ((ov5640_read_reg(&pObj->Ctx, OV5640_AVG_READOUT, &level, 1) != OV5640_OK) ||
+          (ov5640_read_reg(&pObj->Ctx, OV5640_AEC_PK_EXPOSURE_19_16, &state[0], 3) != OV5640_OK) ||
+          (ov5640_read_reg(&pObj->Ctx, OV5640_AEC_PK_REAL_GAIN_9_8, &state[3], 2) != OV5640_OK))
+      {
+        ret = OV5640_ERROR;
+      }
+      else
+      {
+        moved |= ((level < range[1]) || (level > range[0])) ? 1U : 0U;
+
+        for (index = 0; index < 5U; index++)
+        {
+          moved |= (state[index] != last[index]) ? 1U : 0U;
+          last[index] = state[index];
+        }
+
+        if (moved != 0U)
+        {
+          settled_since = (uint32_t)pObj->IO.GetTick();
+          moved = 0U;
+        }
+        else if (((uint32_t)pObj->IO.GetTick() - settled_since) >= OV5640_AEC_SETTLE_MS)
+        {
+          ret = OV5640_OK;
+        }
+
+        if (ret == OV5640_TIMEOUT)
+        {
+          (void)OV5640_Delay(pObj, OV5640_AEC_POLL_MS);
+        }
+      }
+    }
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Set exposure and gain by hand, the auto exposure and gain off:
+  *         two transfers, 0x3500..0x3503 and 0x350A..0x350B.
+  * @param  pObj  pointer to component object
+  * @param  Exposure  exposure time in 1/16 lines, up to OV5640_GetMaxExposure()
+  *         without lowering the frame rate
+  * @param  Gain  real gain in 1/16, 16 = 1x
+  * @retval Component status
+  */
+int32_t OV5640_SetExposure(OV5640_Object_t *pObj, uint32_t Exposure, uint32_t Gain)
+{
+  int32_t ret;
+  uint16_t regs[6][2];
+
+  if ((Exposure > OV5640_EXPOSURE_MAX) || (Gain > OV5640_GAIN_MAX))
+  {
+    ret = OV5640_ERROR;
+  }
+  else
+  {
+    regs[0][0] = OV5640_AEC_PK_EXPOSURE_19_16;
+    regs[0][1] = (uint16_t)((Exposure >> 16U) & 0x0FU);
+    regs[1][0] = OV5640_AEC_PK_EXPOSURE_HIGH;
+    regs[1][1] = (uint16_t)((Exposure >> 8U) & 0xFFU);
+    regs[2][0] = OV5640_AEC_PK_EXPOSURE_LOW;
+    regs[2][1] = (uint16_t)(Exposure & 0xFFU);
+    regs[3][0] = OV5640_AEC_PK_MANUAL;
+    regs[3][1] = 0x03U;
+    regs[4][0] = OV5640_AEC_PK_REAL_GAIN_9_8;
+    regs[4][1] = (uint16_t)((Gain >> 8U) & 0x03U);
+    regs[5][0] = OV5640_AEC_PK_REAL_GAIN_LOW;
+    regs[5][1] = (uint16_t)(Gain & 0xFFU);
+
+    ret = OV5640_WriteTable(pObj, (const uint16_t (*)[2])regs, 6U);
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Get the exposure and gain in use, set by hand or by the auto exposure
+  * @param  pObj  pointer to component object
+  * @param  Exposure  exposure time in 1/16 lines
+  * @param  Gain  real gain in 1/16, 16 = 1x
+  * @retval Component status
+  */
+int32_t OV5640_GetExposure(OV5640_Object_t *pObj, uint32_t *Exposure, uint32_t *Gain)
+{
+  int32_t ret = OV5640_OK;
+  uint8_t state[5];
+
+  if ((ov5640_read_reg(&pObj->Ctx, OV5640_AEC_PK_EXPOSURE_19_16, &state[0], 3) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_AEC_PK_REAL_GAIN_9_8, &state[3], 2) != OV5640_OK))
+  {
+    ret = OV5640_ERROR;
+  }
+  else
+  {
+    *Exposure = (((uint32_t)state[0] & 0x0FU) << 16U) | ((uint32_t)state[1] << 8U) | (uint32_t)state[2];
+    *Gain = (((uint32_t)state[3] & 0x03U) << 8U) | (uint32_t)state[4];
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Get the longest exposure the frame timing (VTS) leaves room for
+  * @param  pObj  pointer to component object
+  * @param  Exposure  exposure time in 1/16 lines
+  * @retval Component status
+  */
+int32_t OV5640_GetMaxExposure(OV5640_Object_t *pObj, uint32_t *Exposure)
+{
+  int32_t ret;
+  uint16_t vts;
+
+  ret = OV5640_ReadReg16(pObj, OV5640_TIMING_VTS_HIGH, &vts);
+
+  if ((ret == OV5640_OK) && (vts <= OV5640_VTS_EXPO_MARGIN))
+  {
+    ret = OV5640_ERROR;
+  }
+
+  if (ret == OV5640_OK)
+  {
+    *Exposure = ((uint32_t)vts - OV5640_VTS_EXPO_MARGIN) * 16U;
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Get the ISP gamma curve: the output level of each level into it,
+  *         identity with the gamma off
+  * @param  pObj  pointer to component object
+  * @param  Curve  256 output levels
+  * @retval Component status
+  */
+int32_t OV5640_GetGammaCurve(OV5640_Object_t *pObj, uint8_t *Curve)
+{
+  static const uint16_t knee[OV5640_GAMMA_POINTS + 2U] =
+  {
+    0, 4, 8, 16, 32, 40, 48, 56, 64, 72, 80, 96, 112, 144, 176, 208, 256
+  };
+  int32_t ret = OV5640_OK;
+  uint32_t index;
+  uint32_t seg = 0;
+  uint32_t level;
+  uint16_t out[OV5640_GAMMA_POINTS + 2U];
+  uint8_t isp;
+  uint8_t yst[OV5640_GAMMA_POINTS];
+
+  if ((ov5640_read_reg(&pObj->Ctx, OV5640_ISP_CONTROL00, &isp, 1) != OV5640_OK) ||
+      (ov5640_read_reg(&pObj->Ctx, OV5640_GAMMA_YST00, yst, OV5640_GAMMA_POINTS) != OV5640_OK))
+  {
+    ret = OV5640_ERROR;
+  }
+  else
+  {
+    out[0] = 0;
+    out[OV5640_GAMMA_POINTS + 1U] = 256;
+
+    for (index = 0; index < OV5640_GAMMA_POINTS; index++)
+    {
+      out[index + 1U] = ((isp & OV5640_ISP_GAMMA_EN) != 0U) ? yst[index] : knee[index + 1U];
+    }
+
+    for (index = 0; index < 256U; index++)
+    {
+      while (index >= knee[seg + 1U])
+      {
+        seg++;
+      }
+
+      level = out[seg];
+
+      if (out[seg + 1U] > out[seg])
+      {
+        level += (((uint32_t)out[seg + 1U] - out[seg]) * (index - knee[seg]) + ((knee[seg + 1U] - knee[seg]) / 2U)) /
+                 (knee[seg + 1U] - knee[seg]);
+      }
+
+      Curve[index] = (uint8_t)((level > 255U) ? 255U : level);
+    }
+  }
+
+  return ret;
+}
+
 /**
   * @brief  Set OV5640 camera PCLK, HREF and VSYNC Polarities
   * @param  pObj  pointer to component object
@@ -1017,7 +1431,7 @@ int32_t OV5640_ReadID(OV5640_Object_t *pObj, uint32_t *Id)
   }
   else
   {
-    (void)OV5640_Delay(pObj, 500);
+    (void)OV5640_Delay(pObj, OV5640_RESET_DELAY);
 
     if (ov5640_read_reg(&pObj->Ctx, OV5640_CHIP_ID_HIGH_BYTE, &tmp, 1) != OV5640_OK)
     {
@@ -2203,6 +2617,77 @@ static int32_t OV5640_Delay(OV5640_Object_t *pObj, uint32_t Delay)
   return OV5640_OK;
 }
 
+/**
+  * @brief  Read a 16-bit value held in a HIGH/LOW register pair
+  * @param  pObj  pointer to component object
+  * @param  Reg  address of the HIGH register, the LOW one follows
+  * @param  Value  value read
+  * @retval Component status
+  */
+static int32_t OV5640_ReadReg16(OV5640_Object_t *pObj, uint16_t Reg, uint16_t *Value)
+{
+  int32_t ret;
+  uint8_t tmp;
+
+  if (ov5640_read_reg(&pObj->Ctx, Reg, &tmp, 1) != OV5640_OK)
+  {
+    ret = OV5640_ERROR;
+  }
+  else
+  {
+    *Value = (uint16_t)tmp << 8U;
+
+    if (ov5640_read_reg(&pObj->Ctx, Reg + 1U, &tmp, 1) != OV5640_OK)
+    {
+      ret = OV5640_ERROR;
+    }
+    else
+    {
+      *Value |= tmp;
+      ret = OV5640_OK;
+    }
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Write a register table in table order, each run of consecutive
+  *         registers (up to OV5640_BURST_MAX) in one auto-increment transfer
+  * @param  pObj  pointer to component object
+  * @param  Table  {register, value} pairs
+  * @param  Count  number of pairs
+  * @retval Component status
+  */
+static int32_t OV5640_WriteTable(OV5640_Object_t *pObj, const uint16_t (*Table)[2], uint32_t Count)
+{
+  int32_t ret = OV5640_OK;
+  uint32_t index = 0;
+  uint32_t length;
+  uint8_t burst[OV5640_BURST_MAX];
+
+  while ((ret == OV5640_OK) && (index < Count))
+  {
+    length = 0;
+
+    do
+    {
+      burst[length] = (uint8_t)Table[index + length][1];
+      length++;
+    } while ((length < OV5640_BURST_MAX) && ((index + length) < Count) &&
+             (Table[index + length][0] == (uint16_t)(Table[index + length - 1U][0] + 1U)));
+
+    if (ov5640_write_reg(&pObj->Ctx, Table[index][0], burst, (uint16_t)length) != OV5640_OK)
+    {
+      ret = OV5640_ERROR;
+    }
+
+    index += length;
+  }
+
+  return ret;
+}
+
 /**
   * @brief  Wrap component ReadReg to Bus Read function
   * @param  handle  Component object handle
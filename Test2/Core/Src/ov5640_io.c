@@ -8,7 +8,7 @@ int32_t OV5640_IO_ReadReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint16
 							I2C_MEMADD_SIZE_16BIT,
 							pData,
 							Length,
-							HAL_MAX_DELAY);
+							OV5640_IO_TIMEOUT(Length));
 }
 
 int32_t OV5640_IO_WriteReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint16_t Length)
@@ -19,5 +19,5 @@ int32_t OV5640_IO_WriteReg(uint16_t DevAddr, uint16_t Reg, uint8_t *pData, uint1
                             I2C_MEMADD_SIZE_16BIT,
                             pData,
 							Length,
-							HAL_MAX_DELAY);
+							OV5640_IO_TIMEOUT(Length));
 }
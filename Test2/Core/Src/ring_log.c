@@ -0,0 +1,433 @@
+#include "ring_log.h"
+
+#include <stddef.h>
+#include <string.h>
+
+_Static_assert(sizeof(ring_log_record_t) == RING_LOG_RECORD, "ring_log_record_t must fill RING_LOG_RECORD");
+
+
+/* CRC-32 (IEEE, reflected), a nibble at a time */
+static uint32_t RingLog_Crc(uint32_t crc, const void *data, uint32_t bytes)
+{
+    static const uint32_t table[16] =
+    {
+        0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL,
+        0x4DB26158UL, 0x5005713CUL, 0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+        0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+    };
+    const uint8_t *p = (const uint8_t *)data;
+
+    crc = ~crc;
+
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ table[crc & 0x0FU];
+        crc = (crc >> 4) ^ table[crc & 0x0FU];
+    }
+
+    return ~crc;
+}
+
+
+static uint32_t RingLog_RecordCrc(const ring_log_record_t *rec, uint32_t id)
+{
+    return RingLog_Crc(id, rec, (uint32_t)offsetof(ring_log_record_t, crc));
+}
+
+
+/* 1 if rec is a record of the ring named id */
+int RingLog_CheckRecord(const ring_log_record_t *rec, uint32_t id)
+{
+    return (rec->magic == RING_LOG_RECORD_MAGIC) && (rec->len <= RING_LOG_PAYLOAD) &&
+           (rec->crc == RingLog_RecordCrc(rec, id));
+}
+
+
+/* Record sectors of buf that can be filled before the end of the region */
+static uint32_t RingLog_Window(const ring_log_t *log)
+{
+    const uint32_t left = log->sectors - log->buf_first;
+
+    return (left < log->buf_sectors) ? left : log->buf_sectors;
+}
+
+
+static int RingLog_ReadSector(ring_log_t *log, uint8_t *dst, uint32_t sector)
+{
+    if (log->dev.read(log->dev.ctx, dst, log->base + 1U + sector, 1U) != 0)
+    {
+        log->stats.errors++;
+        return RING_LOG_ERROR;
+    }
+
+    return RING_LOG_OK;
+}
+
+
+/* Write the sectors of buf holding records not on the card yet, in one go */
+static int RingLog_WriteBuf(ring_log_t *log)
+{
+    const uint32_t first = log->buf_written / RING_LOG_PER_SECTOR;
+    const uint32_t end = (log->buf_records + RING_LOG_PER_SECTOR - 1U) / RING_LOG_PER_SECTOR;
+
+    if (log->buf_written == log->buf_records)
+    {
+        return RING_LOG_OK;
+    }
+
+    if (log->dev.write(log->dev.ctx, &log->buf[first * RING_LOG_SECTOR], log->base + 1U + log->buf_first + first,
+                       end - first) != 0)
+    {
+        log->stats.errors++;
+        return RING_LOG_ERROR;
+    }
+
+    log->stats.writes++;
+    log->stats.sectors_written += end - first;
+    log->buf_written = log->buf_records;
+
+    return RING_LOG_OK;
+}
+
+
+/* Start an empty buffer at record sector first */
+static void RingLog_Restart(ring_log_t *log, uint32_t first)
+{
+    if (first >= log->sectors)
+    {
+        first = 0U;
+        log->stats.wraps++;
+    }
+
+    log->buf_first = first;
+    log->buf_records = 0U;
+    log->buf_written = 0U;
+    memset(log->buf, 0, log->buf_sectors * RING_LOG_SECTOR);
+}
+
+
+/*
+ * The region is sectors sectors from base (header included, at least two);
+ * buf (buf_sectors * RING_LOG_SECTOR bytes, word aligned) is the write
+ * buffer. RingLog_Format() or RingLog_Open() follows.
+ */
+int RingLog_Init(ring_log_t *log, const ring_log_dev_t *dev, uint32_t base, uint32_t sectors,
+                 uint8_t *buf, uint32_t buf_sectors)
+{
+    if ((log == 0) || (dev == 0) || (dev->read == 0) || (dev->write == 0) || (buf == 0) ||
+        (sectors < 2U) || (buf_sectors == 0U))
+    {
+        return RING_LOG_INVALID_PARAM;
+    }
+
+    memset(log, 0, sizeof(*log));
+
+    log->dev = *dev;
+    log->base = base;
+    log->sectors = sectors - 1U;
+    log->buf = buf;
+    log->buf_sectors = buf_sectors;
+
+    RingLog_Restart(log, 0U);
+    log->stats.wraps = 0U;
+
+    return RING_LOG_OK;
+}
+
+
+/* A new, empty ring named id: records of any earlier one no longer count */
+int RingLog_Format(ring_log_t *log, uint32_t id)
+{
+    ring_log_header_t h = { RING_LOG_MAGIC, RING_LOG_VERSION, RING_LOG_RECORD, id, log->sectors + 1U, 0U };
+
+    h.crc = RingLog_Crc(0U, &h, (uint32_t)offsetof(ring_log_header_t, crc));
+
+    RingLog_Restart(log, 0U);
+    memcpy(log->buf, &h, sizeof(h));
+
+    if ((log->dev.write(log->dev.ctx, log->buf, log->base, 1U) != 0) ||
+        ((log->dev.sync != 0) && (log->dev.sync(log->dev.ctx) != 0)))
+    {
+        log->stats.errors++;
+        return RING_LOG_ERROR;
+    }
+
+    memset(log->buf, 0, RING_LOG_SECTOR);
+    log->id = id;
+    log->next_seq = 0U;
+
+    return RING_LOG_OK;
+}
+
+
+/* Sequence number of the first record of sector s in *seq; 0 if it has none */
+static int RingLog_Probe(ring_log_t *log, uint32_t s, uint32_t *seq)
+{
+    const ring_log_record_t *rec = (const ring_log_record_t *)log->buf;
+
+    if (RingLog_ReadSector(log, log->buf, s) != RING_LOG_OK)
+    {
+        return -1;
+    }
+
+    log->stats.open_reads++;
+
+    if (!RingLog_CheckRecord(rec, log->id))
+    {
+        return 0;
+    }
+
+    *seq = rec->seq;
+
+    return 1;
+}
+
+
+/* Read the header, find the newest record and continue after it */
+int RingLog_Open(ring_log_t *log)
+{
+    const ring_log_header_t *h = (const ring_log_header_t *)log->buf;
+    const ring_log_record_t *rec = (const ring_log_record_t *)log->buf;
+    uint32_t seq0 = 0U;
+    uint32_t seq = 0U;
+    uint32_t last;
+    int found;
+
+    log->stats.open_reads = 0U;
+
+    if (log->dev.read(log->dev.ctx, log->buf, log->base, 1U) != 0)
+    {
+        log->stats.errors++;
+        return RING_LOG_ERROR;
+    }
+
+    if ((h->magic != RING_LOG_MAGIC) || (h->version != RING_LOG_VERSION) || (h->record != RING_LOG_RECORD) ||
+        (h->sectors != (log->sectors + 1U)) ||
+        (h->crc != RingLog_Crc(0U, h, (uint32_t)offsetof(ring_log_header_t, crc))))
+    {
+        return RING_LOG_NO_RING;
+    }
+
+    log->id = h->id;
+
+    /*
+     * Sector 0 holds the first records of the present lap. Without them the
+     * ring is empty, unless the last sector holds records: then sector 0
+     * was torn while starting a new lap.
+     */
+    if ((found = RingLog_Probe(log, 0U, &seq0)) < 0)
+    {
+        return RING_LOG_ERROR;
+    }
+
+    if (found)
+    {
+        uint32_t lo = 0U;                   /* Has records of this lap */
+        uint32_t hi = log->sectors;         /* Past the last one that has */
+
+        while ((hi - lo) > 1U)
+        {
+            const uint32_t mid = lo + (hi - lo) / 2U;
+
+            if ((found = RingLog_Probe(log, mid, &seq)) < 0)
+            {
+                return RING_LOG_ERROR;
+            }
+
+            if (found && ((int32_t)(seq - seq0) >= 0))
+            {
+                lo = mid;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        last = lo;
+    }
+    else
+    {
+        if ((found = RingLog_Probe(log, log->sectors - 1U, &seq)) < 0)
+        {
+            return RING_LOG_ERROR;
+        }
+
+        if (!found)
+        {
+            RingLog_Restart(log, 0U);
+            log->next_seq = 0U;
+            return RING_LOG_OK;
+        }
+
+        last = log->sectors - 1U;
+    }
+
+    /* The newest record: the end of the run of consecutive ones in sector last */
+    if (RingLog_ReadSector(log, log->buf, last) != RING_LOG_OK)
+    {
+        return RING_LOG_ERROR;
+    }
+
+    log->stats.open_reads++;
+    seq = rec[0].seq;
+
+    uint32_t n = 1U;
+
+    while ((n < RING_LOG_PER_SECTOR) && RingLog_CheckRecord(&rec[n], log->id) && (rec[n].seq == (seq + n)))
+    {
+        n++;
+    }
+
+    log->next_seq = seq + n;
+
+    if (n == RING_LOG_PER_SECTOR)
+    {
+        RingLog_Restart(log, last + 1U);
+    }
+    else
+    {
+        /* Keep the newest records; what follows them is of an older lap */
+        memset(&log->buf[n * RING_LOG_RECORD], 0, (log->buf_sectors * RING_LOG_SECTOR) - (n * RING_LOG_RECORD));
+        log->buf_first = last;
+        log->buf_records = n;
+        log->buf_written = n;
+    }
+
+    return RING_LOG_OK;
+}
+
+
+/* Add a record; the buffer goes to the card when it is full */
+int RingLog_Append(ring_log_t *log, uint8_t type, uint32_t time_ms, const void *payload, uint32_t len)
+{
+    ring_log_record_t *rec;
+
+    if ((log == 0) || (len > RING_LOG_PAYLOAD) || ((payload == 0) && (len != 0U)))
+    {
+        return RING_LOG_INVALID_PARAM;
+    }
+
+    rec = (ring_log_record_t *)&log->buf[log->buf_records * RING_LOG_RECORD];
+
+    memset(rec, 0, sizeof(*rec));
+    rec->magic = RING_LOG_RECORD_MAGIC;
+    rec->type = type;
+    rec->len = (uint8_t)len;
+    rec->seq = log->next_seq++;
+    rec->time_ms = time_ms;
+    if (len != 0U)
+    {
+        memcpy(rec->payload, payload, len);
+    }
+    rec->crc = RingLog_RecordCrc(rec, log->id);
+
+    log->buf_records++;
+    log->stats.appended++;
+
+    if (log->buf_records == (RingLog_Window(log) * RING_LOG_PER_SECTOR))
+    {
+        const int res = RingLog_WriteBuf(log);
+
+        RingLog_Restart(log, log->buf_first + RingLog_Window(log));
+
+        return res;
+    }
+
+    return RING_LOG_OK;
+}
+
+
+/* Put the records appended so far on the card */
+int RingLog_Flush(ring_log_t *log)
+{
+    if (log == 0)
+    {
+        return RING_LOG_INVALID_PARAM;
+    }
+
+    if (RingLog_WriteBuf(log) != RING_LOG_OK)
+    {
+        return RING_LOG_ERROR;
+    }
+
+    if ((log->dev.sync != 0) && (log->dev.sync(log->dev.ctx) != 0))
+    {
+        log->stats.errors++;
+        return RING_LOG_ERROR;
+    }
+
+    return RING_LOG_OK;
+}
+
+
+/*
+ * Sink put of a writer stream (sd_writer_sink_t), ctx the ring: src is a
+ * ring_log_record_t of which type, len, time_ms and the payload are used.
+ */
+int RingLog_SinkPut(void *ctx, const uint8_t *src, uint32_t len)
+{
+    ring_log_record_t rec;
+
+    if ((src == 0) || (len != sizeof(rec)))
+    {
+        return RING_LOG_INVALID_PARAM;
+    }
+
+    memcpy(&rec, src, sizeof(rec));
+
+    return RingLog_Append((ring_log_t *)ctx, rec.type, rec.time_ms, rec.payload, rec.len);
+}
+
+
+/* Sink flush of a writer stream: RingLog_Flush() */
+int RingLog_SinkFlush(void *ctx)
+{
+    return RingLog_Flush((ring_log_t *)ctx);
+}
+
+
+/*
+ * Every record in the ring, oldest first: the sectors after the newest
+ * one, around to it. Records still in the buffer are included. Reads one
+ * sector at a time into a 512-byte stack buffer.
+ */
+int RingLog_ForEach(ring_log_t *log, ring_log_visit_fn fn, void *ctx)
+{
+    uint32_t sector[RING_LOG_SECTOR / sizeof(uint32_t)];
+    const uint32_t held = (log->buf_records + RING_LOG_PER_SECTOR - 1U) / RING_LOG_PER_SECTOR;
+    const uint32_t newest = (held != 0U) ? (log->buf_first + held - 1U)
+                                         : ((log->buf_first + log->sectors - 1U) % log->sectors);
+
+    for (uint32_t k = 1; k <= log->sectors; k++)
+    {
+        const uint32_t s = (newest + k) % log->sectors;
+        const ring_log_record_t *rec = (const ring_log_record_t *)sector;
+
+        if ((s >= log->buf_first) && (s < (log->buf_first + held)))
+        {
+            rec = (const ring_log_record_t *)&log->buf[(s - log->buf_first) * RING_LOG_SECTOR];
+        }
+        else if (RingLog_ReadSector(log, (uint8_t *)sector, s) != RING_LOG_OK)
+        {
+            return RING_LOG_ERROR;
+        }
+
+        for (uint32_t i = 0; i < RING_LOG_PER_SECTOR; i++)
+        {
+            if (RingLog_CheckRecord(&rec[i], log->id) && (fn(ctx, &rec[i]) != 0))
+            {
+                return RING_LOG_OK;
+            }
+        }
+    }
+
+    return RING_LOG_OK;
+}
+
+
+void RingLog_GetStats(const ring_log_t *log, ring_log_stats_t *stats)
+{
+    *stats = log->stats;
+}
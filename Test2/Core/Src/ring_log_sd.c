@@ -0,0 +1,35 @@
+#include "ring_log_sd.h"
+
+
+/*
+ * Open (or create) the ring in path and find its newest record. bytes only
+ * sizes a new file. buf holds buf_sectors sectors: a cluster is a good
+ * size, each full buffer then goes out as one multi-block write.
+ */
+int RingLogSD_Open(ring_log_sd_t *rl, const char *path, uint32_t bytes, uint8_t *buf, uint32_t buf_sectors,
+                   uint32_t id)
+{
+    ring_log_dev_t dev = { SdRegion_Read, SdRegion_Write, SdRegion_Sync, 0 };
+    int res;
+
+    if ((rl == 0) || (bytes < (2U * RING_LOG_SECTOR)))
+    {
+        return RING_LOG_INVALID_PARAM;
+    }
+
+    if (SdRegion_Reserve(&rl->region, path, bytes) != SD_REGION_OK)
+    {
+        return RING_LOG_ERROR;
+    }
+
+    dev.ctx = &rl->region;
+
+    if ((res = RingLog_Init(&rl->log, &dev, rl->region.base, rl->region.sectors, buf, buf_sectors)) != RING_LOG_OK)
+    {
+        return res;
+    }
+
+    res = RingLog_Open(&rl->log);
+
+    return (res == RING_LOG_NO_RING) ? RingLog_Format(&rl->log, id) : res;
+}
@@ -0,0 +1,124 @@
+#include "sd_region.h"
+
+#include "diskio.h"
+
+/* One fragment: { table size, fragment length, first cluster, 0 } */
+#define SD_REGION_LINKMAP   5U
+
+
+static int SdRegion_Lock(FATFS *fs)
+{
+#if _FS_REENTRANT
+    return ff_req_grant(fs->sobj);
+#else
+    (void)fs;
+    return 1;
+#endif
+}
+
+
+static void SdRegion_Unlock(FATFS *fs)
+{
+#if _FS_REENTRANT
+    ff_rel_grant(fs->sobj);
+#else
+    (void)fs;
+#endif
+}
+
+
+/* bytes only sizes a new file */
+int SdRegion_Reserve(sd_region_t *r, const char *path, uint32_t bytes)
+{
+    DWORD map[SD_REGION_LINKMAP] = { SD_REGION_LINKMAP };
+    FIL f;
+
+    if ((r == 0) || (path == 0) || (bytes == 0U))
+    {
+        return SD_REGION_INVALID_PARAM;
+    }
+
+    if (f_open(&f, path, FA_OPEN_ALWAYS | FA_READ | FA_WRITE) != FR_OK)
+    {
+        return SD_REGION_ERROR;
+    }
+
+    if ((f_size(&f) == 0U) && (f_expand(&f, bytes, 1) != FR_OK))
+    {
+        f_close(&f);
+        return SD_REGION_ERROR;
+    }
+
+    /* The cluster map of a contiguous file has a single fragment */
+    f.cltbl = map;
+
+    if (f_lseek(&f, CREATE_LINKMAP) != FR_OK)
+    {
+        f_close(&f);
+        return SD_REGION_ERROR;
+    }
+
+    r->fs = f.obj.fs;
+    r->cluster = r->fs->csize;
+    r->base = r->fs->database + (map[2] - 2U) * r->cluster;
+    r->sectors = (uint32_t)(f_size(&f) / _MIN_SS);
+
+    if (f_close(&f) != FR_OK)
+    {
+        return SD_REGION_ERROR;
+    }
+
+    return (map[0] == 4U) ? SD_REGION_OK : SD_REGION_FRAGMENTED;
+}
+
+
+int SdRegion_Read(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count)
+{
+    FATFS *fs = ((const sd_region_t *)ctx)->fs;
+    DRESULT res;
+
+    if (!SdRegion_Lock(fs))
+    {
+        return -1;
+    }
+
+    res = disk_read(fs->drv, dst, sector, count);
+    SdRegion_Unlock(fs);
+
+    return (res == RES_OK) ? 0 : -1;
+}
+
+
+int SdRegion_Write(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count)
+{
+    FATFS *fs = ((const sd_region_t *)ctx)->fs;
+    DRESULT res;
+
+    if (!SdRegion_Lock(fs))
+    {
+        return -1;
+    }
+
+    res = disk_write(fs->drv, src, sector, count);
+    SdRegion_Unlock(fs);
+
+    return (res == RES_OK) ? 0 : -1;
+}
+
+
+/* Data written so far reaches the card (the diskio cache is written back) */
+int SdRegion_Sync(void *ctx)
+{
+    FATFS *fs = ((const sd_region_t *)ctx)->fs;
+    DRESULT res;
+
+    if (!SdRegion_Lock(fs))
+    {
+        return -1;
+    }
+
+    res = disk_ioctl(fs->drv, CTRL_SYNC, 0);
+    SdRegion_Unlock(fs);
+
+    return (res == RES_OK) ? 0 : -1;
+}
@@ -9,12 +9,20 @@
  * - NSS pulse disabled
  * - MasterKeepIOState enabled on STM32H7
  * - Slow clock during initialization, about 200–400 kHz
+ *
+ * Reads and writes always use the multi-block commands (CMD18 / CMD25) and
+ * leave the stream open when they return: a call that continues where the
+ * previous one stopped sends no command at all. Any other access, sync or
+ * release ends the stream first (CMD12, or the stop token).
  */
 
 #define SD_SPI_DUMMY_BYTE      0xFFU
 #define SD_SPI_BLOCK_SIZE      512U
 #define SD_SPI_TIMEOUT_MS      5000U
 
+/* Bytes polled between two looks at the clock */
+#define SD_SPI_POLL_RUN        32U
+
 /* SD commands: command index only. 0x40 is added in SD_SendCommand(). */
 #define CMD0    (0U)
 #define CMD1    (1U)
@@ -37,65 +45,46 @@
 
 #define DATA_ACCEPTED              0x05U
 
+typedef enum
+{
+    SD_STREAM_NONE = 0,
+    SD_STREAM_READ,
+    SD_STREAM_WRITE
+} sd_stream_t;
+
+static const sd_spi_bus_t *sd_bus = 0;
+
 static uint8_t sd_is_initialized = 0U;
 static uint8_t sd_is_sdhc = 0U;
 static uint32_t sd_sector_count = 0U;
 
-/* Debug variables */
-volatile uint32_t dbg_read_sector = 0;
-volatile uint32_t dbg_read_count = 0;
-volatile uint32_t dbg_read_addr = 0;
-volatile uint8_t  dbg_read_cmd_r = 0xFF;
-volatile uint8_t  dbg_read_result = 0xFF;
-volatile uint8_t  dbg_is_sdhc = 0;
-
-volatile uint8_t  dbg_first_token = 0xFF;
-volatile uint8_t  dbg_final_token = 0xFF;
-volatile uint32_t dbg_token_retry = 0;
-volatile uint8_t  dbg_receive_result = 0xFF;
-
-volatile uint8_t dbg_cmd58_r = 0xFF;
-volatile uint8_t dbg_ocr0 = 0xFF;
-volatile uint8_t dbg_ocr1 = 0xFF;
-volatile uint8_t dbg_ocr2 = 0xFF;
-volatile uint8_t dbg_ocr3 = 0xFF;
-
-volatile HAL_StatusTypeDef dbg_spi_status = HAL_OK;
-volatile uint8_t dbg_spi_tx = 0xFF;
-volatile uint8_t dbg_spi_rx = 0xFF;
+/* Open multi-block stream and the sector it continues at */
+static sd_stream_t sd_stream = SD_STREAM_NONE;
+static uint32_t sd_stream_next = 0U;
+
+static sd_spi_stats_t sd_stats;
 
 static void SD_CS_Low(void)
 {
-    HAL_GPIO_WritePin(SD_CS_GPIO_Port, SD_CS_Pin, GPIO_PIN_RESET);
+    sd_bus->select(sd_bus->ctx, 1);
 }
 
 
 static void SD_CS_High(void)
 {
-    HAL_GPIO_WritePin(SD_CS_GPIO_Port, SD_CS_Pin, GPIO_PIN_SET);
+    sd_bus->select(sd_bus->ctx, 0);
 }
 
 
-static uint8_t SPI_TxRx(uint8_t data)
+static inline uint8_t SPI_TxRx(uint8_t data)
 {
-    uint8_t rx = 0xFFU;
-
-    dbg_spi_tx = data;
-
-    dbg_spi_status = HAL_SPI_TransmitReceive(&SD_SPI_HANDLE,
-                                             &data,
-                                             &rx,
-                                             1U,
-                                             SD_SPI_TIMEOUT_MS);
-
-    dbg_spi_rx = rx;
+    return sd_bus->xchg(sd_bus->ctx, data);
+}
 
-    if (dbg_spi_status != HAL_OK)
-    {
-        return 0xFFU;
-    }
 
-    return rx;
+static inline uint32_t SD_Now(void)
+{
+    return sd_bus->now_ms(sd_bus->ctx);
 }
 
 
@@ -110,19 +99,19 @@ static void SPI_SendDummyClocks(uint32_t count)
 
 static uint8_t SD_WaitReady(uint32_t timeout_ms)
 {
-    uint32_t start = HAL_GetTick();
-    uint8_t r;
+    uint32_t start = SD_Now();
 
     do
     {
-        r = SPI_TxRx(SD_SPI_DUMMY_BYTE);
-
-        if (r == 0xFFU)
+        for (uint32_t i = 0; i < SD_SPI_POLL_RUN; i++)
         {
-            return 1U;
+            if (SPI_TxRx(SD_SPI_DUMMY_BYTE) == 0xFFU)
+            {
+                return 1U;
+            }
         }
 
-    } while ((HAL_GetTick() - start) < timeout_ms);
+    } while ((SD_Now() - start) < timeout_ms);
 
     return 0U;
 }
@@ -133,21 +122,25 @@ static uint8_t SD_SendCommand(uint8_t cmd, uint32_t arg)
     uint8_t crc;
     uint8_t response = 0xFFU;
 
-    SD_CS_High();
-    SPI_TxRx(SD_SPI_DUMMY_BYTE);
+    /* CMD12 goes out in the middle of a read stream, with the card selected */
+    if (cmd != CMD12)
+    {
+        SD_CS_High();
+        SPI_TxRx(SD_SPI_DUMMY_BYTE);
 
-    SD_CS_Low();
-    SPI_TxRx(SD_SPI_DUMMY_BYTE);
+        SD_CS_Low();
+        SPI_TxRx(SD_SPI_DUMMY_BYTE);
 
-    /*
-     * For normal commands after initialization, wait until card is ready.
-     * For CMD0 this is not required.
-     */
-    if (cmd != CMD0)
-    {
-        if (!SD_WaitReady(SD_SPI_TIMEOUT_MS))
+        /*
+         * For normal commands after initialization, wait until card is ready.
+         * For CMD0 this is not required.
+         */
+        if (cmd != CMD0)
         {
-            return 0xFFU;
+            if (!SD_WaitReady(SD_SPI_TIMEOUT_MS))
+            {
+                return 0xFFU;
+            }
         }
     }
 
@@ -169,6 +162,13 @@ static uint8_t SD_SendCommand(uint8_t cmd, uint32_t arg)
     }
 
     SPI_TxRx(crc);
+    sd_stats.commands++;
+
+    if (cmd == CMD12)
+    {
+        /* Stuff byte, still part of the aborted block */
+        SPI_TxRx(SD_SPI_DUMMY_BYTE);
+    }
 
     for (uint32_t i = 0; i < 10U; i++)
     {
@@ -187,44 +187,36 @@ static uint8_t SD_SendCommand(uint8_t cmd, uint32_t arg)
 static uint8_t SD_ReceiveDataBlock(uint8_t *buff, uint32_t len)
 {
     uint8_t token = 0xFFU;
-    uint32_t start = HAL_GetTick();
-    uint32_t retry = 0U;
-
-    dbg_first_token = 0xFFU;
-    dbg_final_token = 0xFFU;
-    dbg_token_retry = 0U;
-    dbg_receive_result = 0xAAU;
+    uint32_t start = SD_Now();
 
+    /* Anything but 0xFF ends the wait: the start token or an error token */
     do
     {
-        token = SPI_TxRx(SD_SPI_DUMMY_BYTE);
-
-        if (retry == 0U)
+        for (uint32_t i = 0; (i < SD_SPI_POLL_RUN) && (token == 0xFFU); i++)
         {
-            dbg_first_token = token;
+            token = SPI_TxRx(SD_SPI_DUMMY_BYTE);
         }
 
-        retry++;
-        dbg_final_token = token;
-        dbg_token_retry = retry;
-
-        if (token == TOKEN_START_BLOCK_SINGLE)
-        {
-            dbg_receive_result = 1U;
-            break;
-        }
-
-    } while ((HAL_GetTick() - start) < SD_SPI_TIMEOUT_MS);
+    } while ((token == 0xFFU) && ((SD_Now() - start) < SD_SPI_TIMEOUT_MS));
 
     if (token != TOKEN_START_BLOCK_SINGLE)
     {
-        dbg_receive_result = 2U;
         return 0U;
     }
 
-    for (uint32_t i = 0; i < len; i++)
+    if (sd_bus->receive != 0)
     {
-        buff[i] = SPI_TxRx(SD_SPI_DUMMY_BYTE);
+        if (sd_bus->receive(sd_bus->ctx, buff, len) != 0)
+        {
+            return 0U;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < len; i++)
+        {
+            buff[i] = SPI_TxRx(SD_SPI_DUMMY_BYTE);
+        }
     }
 
     /* Discard CRC */
@@ -251,9 +243,19 @@ static uint8_t SD_TransmitDataBlock(const uint8_t *buff, uint8_t token)
         return 1U;
     }
 
-    for (uint32_t i = 0; i < SD_SPI_BLOCK_SIZE; i++)
+    if (sd_bus->transmit != 0)
     {
-        SPI_TxRx(buff[i]);
+        if (sd_bus->transmit(sd_bus->ctx, buff, SD_SPI_BLOCK_SIZE) != 0)
+        {
+            return 0U;
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < SD_SPI_BLOCK_SIZE; i++)
+        {
+            SPI_TxRx(buff[i]);
+        }
     }
 
     /* Dummy CRC */
@@ -271,6 +273,64 @@ static uint8_t SD_TransmitDataBlock(const uint8_t *buff, uint8_t token)
 }
 
 
+/*
+ * End the open stream, if any: CMD12 after a read, the stop token after a
+ * write, then wait until the card has finished. Deselects the card.
+ */
+static uint8_t SD_CloseStream(void)
+{
+    uint8_t ok = 1U;
+
+    if (sd_stream == SD_STREAM_READ)
+    {
+        /* The R1 of CMD12 may carry flags of the block being aborted */
+        (void)SD_SendCommand(CMD12, 0U);
+        ok = SD_WaitReady(SD_SPI_TIMEOUT_MS);
+    }
+    else if (sd_stream == SD_STREAM_WRITE)
+    {
+        ok = SD_TransmitDataBlock(0, TOKEN_STOP_TRAN);
+
+        /* Busy starts one byte after the stop token */
+        SPI_TxRx(SD_SPI_DUMMY_BYTE);
+        ok = ok && SD_WaitReady(SD_SPI_TIMEOUT_MS);
+    }
+    else
+    {
+        return 1U;
+    }
+
+    sd_stream = SD_STREAM_NONE;
+
+    SD_CS_High();
+    SPI_TxRx(SD_SPI_DUMMY_BYTE);
+
+    return ok;
+}
+
+
+/* Give up on the current transfer */
+static int SD_Fail(void)
+{
+    (void)SD_CloseStream();
+
+    SD_CS_High();
+    SPI_TxRx(SD_SPI_DUMMY_BYTE);
+
+    sd_stats.errors++;
+
+    return SD_SPI_ERROR;
+}
+
+
+/* Bus to use from the next SD_SPI_Init() on */
+void SD_SPI_SetBus(const sd_spi_bus_t *bus)
+{
+    sd_bus = bus;
+    sd_is_initialized = 0U;
+}
+
+
 static uint32_t SD_GetCSDCapacity(void)
 {
     uint8_t csd[16];
@@ -336,9 +396,15 @@ int SD_SPI_Init(void)
     uint8_t r;
     uint8_t ocr[4];
 
+    if (sd_bus == 0)
+    {
+        return SD_SPI_ERROR;
+    }
+
     sd_is_initialized = 0U;
     sd_is_sdhc = 0U;
     sd_sector_count = 0U;
+    sd_stream = SD_STREAM_NONE;
 
     SD_CS_High();
     SPI_SendDummyClocks(10U);
@@ -371,7 +437,7 @@ int SD_SPI_Init(void)
             return SD_SPI_ERROR;
         }
 
-        uint32_t start = HAL_GetTick();
+        uint32_t start = SD_Now();
 
         do
         {
@@ -399,7 +465,7 @@ int SD_SPI_Init(void)
                 break;
             }
 
-        } while ((HAL_GetTick() - start) < SD_SPI_TIMEOUT_MS);
+        } while ((SD_Now() - start) < SD_SPI_TIMEOUT_MS);
 
         if (r != 0x00U)
         {
@@ -407,7 +473,6 @@ int SD_SPI_Init(void)
         }
 
         r = SD_SendCommand(CMD58, 0U);
-        dbg_cmd58_r = r;
 
         if (r != 0x00U)
         {
@@ -424,11 +489,6 @@ int SD_SPI_Init(void)
         SD_CS_High();
         SPI_TxRx(SD_SPI_DUMMY_BYTE);
 
-        dbg_ocr0 = ocr[0];
-        dbg_ocr1 = ocr[1];
-        dbg_ocr2 = ocr[2];
-        dbg_ocr3 = ocr[3];
-
         if (ocr[0] & 0x40U)
         {
             sd_is_sdhc = 1U;
@@ -440,7 +500,7 @@ int SD_SPI_Init(void)
         SD_CS_High();
         SPI_TxRx(SD_SPI_DUMMY_BYTE);
 
-        uint32_t start = HAL_GetTick();
+        uint32_t start = SD_Now();
 
         do
         {
@@ -469,11 +529,11 @@ int SD_SPI_Init(void)
                 r = r55;
             }
 
-        } while ((HAL_GetTick() - start) < SD_SPI_TIMEOUT_MS);
+        } while ((SD_Now() - start) < SD_SPI_TIMEOUT_MS);
 
         if (r != 0x00U)
         {
-            start = HAL_GetTick();
+            start = SD_Now();
 
             do
             {
@@ -486,7 +546,7 @@ int SD_SPI_Init(void)
                     break;
                 }
 
-            } while ((HAL_GetTick() - start) < SD_SPI_TIMEOUT_MS);
+            } while ((SD_Now() - start) < SD_SPI_TIMEOUT_MS);
         }
 
         if (r != 0x00U)
@@ -517,80 +577,50 @@ int SD_SPI_Init(void)
 }
 
 
+/*
+ * Read count sectors. Joins the open read stream when sector is where it
+ * stopped, otherwise ends whatever stream is open and starts a new one.
+ */
 int SD_SPI_ReadBlocks(uint8_t *buff, uint32_t sector, uint32_t count)
 {
     if ((!sd_is_initialized) || (buff == 0) || (count == 0U))
     {
-        dbg_read_result = 10U;
         return SD_SPI_ERROR;
     }
 
-    uint32_t addr = sd_is_sdhc ? sector : (sector * SD_SPI_BLOCK_SIZE);
-
-    dbg_read_sector = sector;
-    dbg_read_count = count;
-    dbg_read_addr = addr;
-    dbg_is_sdhc = sd_is_sdhc;
-
-    if (count == 1U)
+    if ((sd_stream == SD_STREAM_READ) && (sector == sd_stream_next))
     {
-        dbg_read_cmd_r = SD_SendCommand(CMD17, addr);
-
-        if (dbg_read_cmd_r != 0U)
-        {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            dbg_read_result = 1U;
-            return SD_SPI_ERROR;
-        }
-
-        if (!SD_ReceiveDataBlock(buff, SD_SPI_BLOCK_SIZE))
-        {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            dbg_read_result = 2U;
-            return SD_SPI_ERROR;
-        }
-
-        SD_CS_High();
-        SPI_TxRx(SD_SPI_DUMMY_BYTE);
-
-        dbg_read_result = 0U;
-        return SD_SPI_OK;
+        sd_stats.joined++;
     }
     else
     {
-        dbg_read_cmd_r = SD_SendCommand(CMD18, addr);
+        (void)SD_CloseStream();
 
-        if (dbg_read_cmd_r != 0U)
+        if (SD_SendCommand(CMD18, sd_is_sdhc ? sector : (sector * SD_SPI_BLOCK_SIZE)) != 0U)
         {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            dbg_read_result = 3U;
-            return SD_SPI_ERROR;
+            return SD_Fail();
         }
 
-        for (uint32_t i = 0; i < count; i++)
+        sd_stream = SD_STREAM_READ;
+        sd_stats.read_streams++;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!SD_ReceiveDataBlock(buff + (i * SD_SPI_BLOCK_SIZE), SD_SPI_BLOCK_SIZE))
         {
-            if (!SD_ReceiveDataBlock(buff + (i * SD_SPI_BLOCK_SIZE), SD_SPI_BLOCK_SIZE))
-            {
-                SD_CS_High();
-                SPI_TxRx(SD_SPI_DUMMY_BYTE);
-                dbg_read_result = 4U;
-                return SD_SPI_ERROR;
-            }
+            return SD_Fail();
         }
+    }
 
-        (void)SD_SendCommand(CMD12, 0U);
-        SD_CS_High();
-        SPI_TxRx(SD_SPI_DUMMY_BYTE);
+    sd_stream_next = sector + count;
+    sd_stats.read_blocks += count;
 
-        dbg_read_result = 0U;
-        return SD_SPI_OK;
-    }
+    return SD_SPI_OK;
 }
 
 
+/* Write count sectors, joining the open write stream as reads do */
 int SD_SPI_WriteBlocks(const uint8_t *buff, uint32_t sector, uint32_t count)
 {
     if ((!sd_is_initialized) || (buff == 0) || (count == 0U))
@@ -598,62 +628,53 @@ int SD_SPI_WriteBlocks(const uint8_t *buff, uint32_t sector, uint32_t count)
         return SD_SPI_ERROR;
     }
 
-    uint32_t addr = sd_is_sdhc ? sector : (sector * SD_SPI_BLOCK_SIZE);
-
-    if (count == 1U)
+    if ((sd_stream == SD_STREAM_WRITE) && (sector == sd_stream_next))
     {
-        if (SD_SendCommand(CMD24, addr) != 0U)
-        {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            return SD_SPI_ERROR;
-        }
-
-        if (!SD_TransmitDataBlock(buff, TOKEN_START_BLOCK_SINGLE))
-        {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            return SD_SPI_ERROR;
-        }
-
-        SD_CS_High();
-        SPI_TxRx(SD_SPI_DUMMY_BYTE);
-
-        return SD_SPI_OK;
+        sd_stats.joined++;
     }
     else
     {
-        static const uint8_t dummy_block[SD_SPI_BLOCK_SIZE] = {0};
+        (void)SD_CloseStream();
 
-        if (SD_SendCommand(CMD25, addr) != 0U)
+        if (SD_SendCommand(CMD25, sd_is_sdhc ? sector : (sector * SD_SPI_BLOCK_SIZE)) != 0U)
         {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            return SD_SPI_ERROR;
+            return SD_Fail();
         }
 
-        for (uint32_t i = 0; i < count; i++)
-        {
-            if (!SD_TransmitDataBlock(buff + (i * SD_SPI_BLOCK_SIZE), TOKEN_START_BLOCK_MULTI))
-            {
-                SD_CS_High();
-                SPI_TxRx(SD_SPI_DUMMY_BYTE);
-                return SD_SPI_ERROR;
-            }
-        }
+        sd_stream = SD_STREAM_WRITE;
+        sd_stats.write_streams++;
+    }
 
-        if (!SD_TransmitDataBlock(dummy_block, TOKEN_STOP_TRAN))
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!SD_TransmitDataBlock(buff + (i * SD_SPI_BLOCK_SIZE), TOKEN_START_BLOCK_MULTI))
         {
-            SD_CS_High();
-            SPI_TxRx(SD_SPI_DUMMY_BYTE);
-            return SD_SPI_ERROR;
+            return SD_Fail();
         }
+    }
 
-        SD_CS_High();
-        SPI_TxRx(SD_SPI_DUMMY_BYTE);
+    sd_stream_next = sector + count;
+    sd_stats.write_blocks += count;
+
+    return SD_SPI_OK;
+}
 
-        return SD_SPI_OK;
+
+/* End the open stream: after this every written sector is on the card */
+int SD_SPI_Sync(void)
+{
+    if (!sd_is_initialized)
+    {
+        return SD_SPI_ERROR;
     }
+
+    if (!SD_CloseStream())
+    {
+        sd_stats.errors++;
+        return SD_SPI_ERROR;
+    }
+
+    return SD_SPI_OK;
 }
 
 
@@ -664,7 +685,19 @@ uint32_t SD_SPI_GetSectorCount(void)
 
 void SD_SPI_ReleaseBus(void)
 {
+    if (sd_bus == 0)
+    {
+        return;
+    }
+
+    (void)SD_CloseStream();
+
     SD_CS_High();
     SPI_TxRx(0xFF);
 }
 
+
+void SD_SPI_GetStats(sd_spi_stats_t *stats)
+{
+    *stats = sd_stats;
+}
@@ -0,0 +1,289 @@
+#include "sd_spi_hal.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/*
+ * sd_spi_bus_t over SPI3 and the SD_CS pin.
+ *
+ * Commands and token polling go a byte at a time; a block payload is a
+ * single transfer. With DMA the block goes through sd_spi_hal_block, which
+ * is cache-line aligned in D1 RAM, so any FatFs buffer works whatever its
+ * alignment and memory. Both DMA streams use that one buffer: a byte is
+ * always sent before the byte received in its place is written back.
+ */
+
+#define SD_SPI_HAL_TIMEOUT_MS      100U
+#define SD_SPI_HAL_BLOCK_SIZE      512U
+
+/* SPI3 and its DMA streams; may call the FreeRTOS FromISR API */
+#define SD_SPI_HAL_IRQ_PRIORITY    5U
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t sd_spi_hal_block[SD_SPI_HAL_BLOCK_SIZE];
+
+static const uint8_t sd_spi_hal_ones[SD_SPI_HAL_BLOCK_SIZE] = { [0 ... SD_SPI_HAL_BLOCK_SIZE - 1U] = 0xFFU };
+
+#if SD_SPI_HAL_DMA
+static DMA_HandleTypeDef hdma_spi3_rx;
+static DMA_HandleTypeDef hdma_spi3_tx;
+
+static volatile uint8_t sd_spi_hal_done;
+static volatile uint8_t sd_spi_hal_failed;
+static TaskHandle_t volatile sd_spi_hal_waiter;
+#endif
+
+
+static void SD_SPI_HAL_Select(void *ctx, int on)
+{
+    (void)ctx;
+
+    HAL_GPIO_WritePin(SD_CS_GPIO_Port, SD_CS_Pin, on ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
+
+
+static uint8_t SD_SPI_HAL_Xchg(void *ctx, uint8_t data)
+{
+    uint8_t rx = 0xFFU;
+
+    (void)ctx;
+
+    if (HAL_SPI_TransmitReceive(&SD_SPI_HANDLE, &data, &rx, 1U, SD_SPI_HAL_TIMEOUT_MS) != HAL_OK)
+    {
+        return 0xFFU;
+    }
+
+    return rx;
+}
+
+
+static uint32_t SD_SPI_HAL_Now(void *ctx)
+{
+    (void)ctx;
+
+    return HAL_GetTick();
+}
+
+
+#if SD_SPI_HAL_DMA
+/*
+ * Exchange sd_spi_hal_block (bytes) over DMA, sleeping until the end of
+ * transfer interrupt. Only with the scheduler running: before, BASEPRI
+ * still masks the interrupt.
+ */
+static int SD_SPI_HAL_Dma(uint32_t bytes)
+{
+    const uint32_t start = HAL_GetTick();
+    uint32_t elapsed;
+
+    /* Drop a notification left over from a transfer that timed out */
+    (void)ulTaskNotifyTake(pdTRUE, 0);
+
+    sd_spi_hal_done = 0U;
+    sd_spi_hal_failed = 0U;
+    sd_spi_hal_waiter = xTaskGetCurrentTaskHandle();
+
+    SCB_CleanDCache_by_Addr((uint32_t *)sd_spi_hal_block, (int32_t)sizeof(sd_spi_hal_block));
+
+    if (HAL_SPI_TransmitReceive_DMA(&SD_SPI_HANDLE, sd_spi_hal_block, sd_spi_hal_block, (uint16_t)bytes) != HAL_OK)
+    {
+        sd_spi_hal_waiter = 0;
+        return -1;
+    }
+
+    /* Sleep until the interrupt; a stray notification only costs another wait for the rest */
+    while (!sd_spi_hal_done)
+    {
+        elapsed = HAL_GetTick() - start;
+
+        if (elapsed >= SD_SPI_HAL_TIMEOUT_MS)
+        {
+            sd_spi_hal_waiter = 0;
+            (void)HAL_SPI_Abort(&SD_SPI_HANDLE);
+            return -1;
+        }
+
+        (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SD_SPI_HAL_TIMEOUT_MS - elapsed));
+    }
+
+    sd_spi_hal_waiter = 0;
+
+    SCB_InvalidateDCache_by_Addr((uint32_t *)sd_spi_hal_block, (int32_t)sizeof(sd_spi_hal_block));
+
+    return sd_spi_hal_failed ? -1 : 0;
+}
+
+
+static int SD_SPI_HAL_UseDma(uint32_t bytes)
+{
+    return (bytes == SD_SPI_HAL_BLOCK_SIZE) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING);
+}
+#endif
+
+
+static int SD_SPI_HAL_Receive(void *ctx, uint8_t *dst, uint32_t bytes)
+{
+    (void)ctx;
+
+    if (bytes > SD_SPI_HAL_BLOCK_SIZE)
+    {
+        return -1;
+    }
+
+#if SD_SPI_HAL_DMA
+    if (SD_SPI_HAL_UseDma(bytes))
+    {
+        memset(sd_spi_hal_block, 0xFF, bytes);
+
+        if (SD_SPI_HAL_Dma(bytes) != 0)
+        {
+            return -1;
+        }
+
+        memcpy(dst, sd_spi_hal_block, bytes);
+
+        return 0;
+    }
+#endif
+
+    return (HAL_SPI_TransmitReceive(&SD_SPI_HANDLE, sd_spi_hal_ones, dst, (uint16_t)bytes,
+                                    SD_SPI_HAL_TIMEOUT_MS) == HAL_OK) ? 0 : -1;
+}
+
+
+static int SD_SPI_HAL_Transmit(void *ctx, const uint8_t *src, uint32_t bytes)
+{
+    (void)ctx;
+
+    if (bytes > SD_SPI_HAL_BLOCK_SIZE)
+    {
+        return -1;
+    }
+
+#if SD_SPI_HAL_DMA
+    if (SD_SPI_HAL_UseDma(bytes))
+    {
+        memcpy(sd_spi_hal_block, src, bytes);
+
+        return SD_SPI_HAL_Dma(bytes);
+    }
+#endif
+
+    /* What comes back is dropped into the block buffer */
+    return (HAL_SPI_TransmitReceive(&SD_SPI_HANDLE, src, sd_spi_hal_block, (uint16_t)bytes,
+                                    SD_SPI_HAL_TIMEOUT_MS) == HAL_OK) ? 0 : -1;
+}
+
+
+static const sd_spi_bus_t sd_spi_hal_bus =
+{
+    SD_SPI_HAL_Select,
+    SD_SPI_HAL_Xchg,
+    SD_SPI_HAL_Receive,
+    SD_SPI_HAL_Transmit,
+    SD_SPI_HAL_Now,
+    0
+};
+
+
+/*
+ * Set up the DMA streams of SPI3 (if enabled) and hand the bus to the
+ * driver. Call after MX_SPI3_Init(), before FatFs mounts the card.
+ */
+int SD_SPI_HAL_Init(void)
+{
+#if SD_SPI_HAL_DMA
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_spi3_rx.Instance = DMA1_Stream1;
+    hdma_spi3_rx.Init.Request = DMA_REQUEST_SPI3_RX;
+    hdma_spi3_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_spi3_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_spi3_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_spi3_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_spi3_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_spi3_rx.Init.Mode = DMA_NORMAL;
+    hdma_spi3_rx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    hdma_spi3_rx.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+
+    hdma_spi3_tx = hdma_spi3_rx;
+    hdma_spi3_tx.Instance = DMA1_Stream2;
+    hdma_spi3_tx.Init.Request = DMA_REQUEST_SPI3_TX;
+    hdma_spi3_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+
+    if ((HAL_DMA_Init(&hdma_spi3_rx) != HAL_OK) || (HAL_DMA_Init(&hdma_spi3_tx) != HAL_OK))
+    {
+        return SD_SPI_ERROR;
+    }
+
+    __HAL_LINKDMA(&SD_SPI_HANDLE, hdmarx, hdma_spi3_rx);
+    __HAL_LINKDMA(&SD_SPI_HANDLE, hdmatx, hdma_spi3_tx);
+
+    HAL_NVIC_SetPriority(DMA1_Stream1_IRQn, SD_SPI_HAL_IRQ_PRIORITY, 0U);
+    HAL_NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, SD_SPI_HAL_IRQ_PRIORITY, 0U);
+    HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+    HAL_NVIC_SetPriority(SPI3_IRQn, SD_SPI_HAL_IRQ_PRIORITY, 0U);
+    HAL_NVIC_EnableIRQ(SPI3_IRQn);
+#endif
+
+    SD_SPI_SetBus(&sd_spi_hal_bus);
+
+    return SD_SPI_OK;
+}
+
+
+#if SD_SPI_HAL_DMA
+static void SD_SPI_HAL_Finish(uint8_t failed)
+{
+    BaseType_t woken = pdFALSE;
+    TaskHandle_t waiter = sd_spi_hal_waiter;
+
+    sd_spi_hal_failed = failed;
+    sd_spi_hal_done = 1U;
+
+    if (waiter != 0)
+    {
+        vTaskNotifyGiveFromISR(waiter, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+
+void HAL_SPI_TxRxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == &SD_SPI_HANDLE)
+    {
+        SD_SPI_HAL_Finish(0U);
+    }
+}
+
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+    if (hspi == &SD_SPI_HANDLE)
+    {
+        SD_SPI_HAL_Finish(1U);
+    }
+}
+
+
+void DMA1_Stream1_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_spi3_rx);
+}
+
+
+void DMA1_Stream2_IRQHandler(void)
+{
+    HAL_DMA_IRQHandler(&hdma_spi3_tx);
+}
+
+
+void SPI3_IRQHandler(void)
+{
+    HAL_SPI_IRQHandler(&SD_SPI_HANDLE);
+}
+#endif
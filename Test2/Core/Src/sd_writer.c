@@ -0,0 +1,435 @@
+#include "sd_writer.h"
+
+#include <string.h>
+
+
+int SdWriter_Init(sd_writer_t *w, const sd_writer_os_t *os)
+{
+    if ((w == 0) || (os == 0) || (os->lock == 0) || (os->unlock == 0) || (os->wait == 0) || (os->signal == 0))
+    {
+        return SD_WRITER_INVALID_PARAM;
+    }
+
+    memset(w, 0, sizeof(*w));
+    w->os = *os;
+
+    return SD_WRITER_OK;
+}
+
+
+/*
+ * Add stream s, before the writer runs: the region of sectors sectors from
+ * base (whole clusters of cluster sectors are used), stage a buffer of one
+ * cluster, jobs an array of depth entries.
+ */
+int SdWriter_AddStream(sd_writer_t *w, sd_writer_stream_t *s, const sd_writer_dev_t *dev, uint32_t base,
+                       uint32_t sectors, uint32_t cluster, uint8_t *stage, sd_writer_job_t *jobs, uint32_t depth,
+                       SdWriter_Policy policy, int wrap)
+{
+    if ((w == 0) || (s == 0) || (dev == 0) || (dev->write == 0) || (stage == 0) || (jobs == 0) ||
+        (depth == 0U) || (cluster == 0U) || (sectors < cluster) || (w->count == SD_WRITER_MAX_STREAMS))
+    {
+        return SD_WRITER_INVALID_PARAM;
+    }
+
+    memset(s, 0, sizeof(*s));
+
+    s->dev = *dev;
+    s->base = base;
+    s->clusters = sectors / cluster;
+    s->cluster = cluster;
+    s->policy = policy;
+    s->wrap = wrap;
+    s->stage = stage;
+    s->jobs = jobs;
+    s->depth = depth;
+
+    w->streams[w->count++] = s;
+
+    return SD_WRITER_OK;
+}
+
+
+/* Add sink stream s, before the writer runs: jobs an array of depth entries */
+int SdWriter_AddSink(sd_writer_t *w, sd_writer_stream_t *s, const sd_writer_sink_t *sink,
+                     sd_writer_job_t *jobs, uint32_t depth, SdWriter_Policy policy)
+{
+    if ((w == 0) || (s == 0) || (sink == 0) || (sink->put == 0) || (jobs == 0) || (depth == 0U) ||
+        (w->count == SD_WRITER_MAX_STREAMS))
+    {
+        return SD_WRITER_INVALID_PARAM;
+    }
+
+    memset(s, 0, sizeof(*s));
+
+    s->sink = *sink;
+    s->policy = policy;
+    s->jobs = jobs;
+    s->depth = depth;
+
+    w->streams[w->count++] = s;
+
+    return SD_WRITER_OK;
+}
+
+
+/* A buffer or flush marker of sink stream s */
+static int SdWriter_Sink(sd_writer_stream_t *s, const sd_writer_job_t *job)
+{
+    int err;
+
+    if (job->data == 0)
+    {
+        err = (s->sink.flush != 0) ? s->sink.flush(s->sink.ctx) : 0;
+    }
+    else
+    {
+        err = s->sink.put(s->sink.ctx, job->data, job->len);
+    }
+
+    if (err != 0)
+    {
+        s->stats.errors++;
+        return SD_WRITER_ERROR;
+    }
+
+    return SD_WRITER_OK;
+}
+
+
+/* Queue job on s, applying the stream's policy when it is full */
+static int SdWriter_Queue(sd_writer_t *w, sd_writer_stream_t *s, sd_writer_job_t *job, uint32_t timeout_ms)
+{
+    sd_writer_job_t dropped = { 0 };
+    int waited = 0;
+    int room;
+
+    w->os.lock(w->os.ctx);
+
+    while (s->queued == s->depth)
+    {
+        if (s->policy == SD_WRITER_DROP_OLDEST)
+        {
+            dropped = s->jobs[s->head];
+            s->head = (s->head + 1U) % s->depth;
+            s->queued--;
+            s->stats.dropped++;
+            break;
+        }
+
+        if (!waited)
+        {
+            s->stats.waits++;
+        }
+
+        /* One wait for room; timed out, the buffer is handed back */
+        if ((timeout_ms == 0U) || waited)
+        {
+            s->stats.rejected++;
+            w->os.unlock(w->os.ctx);
+            return SD_WRITER_FULL;
+        }
+
+        w->os.unlock(w->os.ctx);
+        waited = (w->os.wait(w->os.ctx, SD_WRITER_EV_SPACE, timeout_ms) == 0) ? 1 : 2;
+        w->os.lock(w->os.ctx);
+
+        if ((waited == 2) && (s->queued == s->depth))
+        {
+            s->stats.rejected++;
+            w->os.unlock(w->os.ctx);
+            return SD_WRITER_FULL;
+        }
+    }
+
+    job->ticket = w->ticket++;
+    s->jobs[(s->head + s->queued) % s->depth] = *job;
+    s->queued++;
+    s->stats.submitted++;
+    s->stats.max_queued = (s->queued > s->stats.max_queued) ? s->queued : s->stats.max_queued;
+    room = s->queued < s->depth;
+
+    w->os.unlock(w->os.ctx);
+    w->os.signal(w->os.ctx, SD_WRITER_EV_WORK);
+
+    /* Pass the wake-up on: another producer may be waiting for the room left */
+    if (waited && room)
+    {
+        w->os.signal(w->os.ctx, SD_WRITER_EV_SPACE);
+    }
+
+    if ((dropped.data != 0) && (dropped.release != 0))
+    {
+        dropped.release(dropped.ctx, dropped.data, SD_WRITER_DROPPED);
+    }
+
+    return SD_WRITER_OK;
+}
+
+
+/*
+ * Hand len bytes at data to the writer. They must stay untouched until
+ * release(ctx, data, status) is called, from the writer task, or from a
+ * later Submit() on the same stream when they are dropped. timeout_ms
+ * bounds the wait for room on a BLOCK stream (0: do not wait).
+ */
+int SdWriter_Submit(sd_writer_t *w, sd_writer_stream_t *s, const uint8_t *data, uint32_t len,
+                    sd_writer_release_fn release, void *ctx, uint32_t timeout_ms)
+{
+    sd_writer_job_t job = { data, len, release, ctx, 0U };
+
+    if ((w == 0) || (s == 0) || (data == 0) || (len == 0U))
+    {
+        return SD_WRITER_INVALID_PARAM;
+    }
+
+    return SdWriter_Queue(w, s, &job, timeout_ms);
+}
+
+
+/* Have what was submitted to s so far written out and synced, in order */
+int SdWriter_Flush(sd_writer_t *w, sd_writer_stream_t *s, uint32_t timeout_ms)
+{
+    sd_writer_job_t job = { 0, 0U, 0, 0, 0U };
+
+    if ((w == 0) || (s == 0))
+    {
+        return SD_WRITER_INVALID_PARAM;
+    }
+
+    return SdWriter_Queue(w, s, &job, timeout_ms);
+}
+
+
+/* count sectors from src to sector offset of cluster pos */
+static int SdWriter_Put(sd_writer_stream_t *s, const uint8_t *src, uint32_t offset, uint32_t count)
+{
+    if (s->dev.write(s->dev.ctx, src, s->base + (s->pos * s->cluster) + offset, count) != 0)
+    {
+        s->stats.errors++;
+        return SD_WRITER_ERROR;
+    }
+
+    s->stats.writes++;
+    s->stats.sectors += count;
+    s->unsynced = 1;
+
+    return SD_WRITER_OK;
+}
+
+
+/* Room at pos: around to the start of a wrapping stream */
+static int SdWriter_Room(sd_writer_stream_t *s)
+{
+    if (s->pos < s->clusters)
+    {
+        return SD_WRITER_OK;
+    }
+
+    if (!s->wrap)
+    {
+        s->stats.errors++;
+        return SD_WRITER_END;
+    }
+
+    s->pos = 0U;
+    s->stats.wraps++;
+
+    return SD_WRITER_OK;
+}
+
+
+/* Write the sectors of the stage not on the card yet; a partial last one is zero-padded */
+static int SdWriter_PutStage(sd_writer_stream_t *s)
+{
+    const uint32_t used = (s->stage_fill + SD_WRITER_SECTOR - 1U) / SD_WRITER_SECTOR;
+    int res;
+
+    if (used == s->stage_written)
+    {
+        return SD_WRITER_OK;
+    }
+
+    if ((res = SdWriter_Room(s)) != SD_WRITER_OK)
+    {
+        return res;
+    }
+
+    memset(&s->stage[s->stage_fill], 0, (used * SD_WRITER_SECTOR) - s->stage_fill);
+
+    if ((res = SdWriter_Put(s, &s->stage[s->stage_written * SD_WRITER_SECTOR], s->stage_written,
+                            used - s->stage_written)) != SD_WRITER_OK)
+    {
+        return res;
+    }
+
+    s->stage_written = s->stage_fill / SD_WRITER_SECTOR;
+
+    return SD_WRITER_OK;
+}
+
+
+static int SdWriter_Write(sd_writer_stream_t *s, const uint8_t *src, uint32_t len)
+{
+    const uint32_t cluster_bytes = s->cluster * SD_WRITER_SECTOR;
+    int res;
+
+    while (len != 0U)
+    {
+        if ((res = SdWriter_Room(s)) != SD_WRITER_OK)
+        {
+            return res;
+        }
+
+        if ((s->stage_fill == 0U) && (len >= cluster_bytes))
+        {
+            /* Whole clusters, straight from the buffer */
+            uint32_t n = len / cluster_bytes;
+
+            n = (n > SD_WRITER_MAX_RUN) ? SD_WRITER_MAX_RUN : n;
+            n = (n > (s->clusters - s->pos)) ? (s->clusters - s->pos) : n;
+
+            if ((res = SdWriter_Put(s, src, 0U, n * s->cluster)) != SD_WRITER_OK)
+            {
+                return res;
+            }
+
+            s->pos += n;
+            src += n * cluster_bytes;
+            len -= n * cluster_bytes;
+            continue;
+        }
+
+        const uint32_t k = ((cluster_bytes - s->stage_fill) < len) ? (cluster_bytes - s->stage_fill) : len;
+
+        memcpy(&s->stage[s->stage_fill], src, k);
+        s->stage_fill += k;
+        src += k;
+        len -= k;
+
+        if (s->stage_fill == cluster_bytes)
+        {
+            if ((res = SdWriter_PutStage(s)) != SD_WRITER_OK)
+            {
+                return res;
+            }
+
+            s->pos++;
+            s->stage_fill = 0U;
+            s->stage_written = 0U;
+        }
+    }
+
+    return SD_WRITER_OK;
+}
+
+
+static int SdWriter_Sync(sd_writer_stream_t *s)
+{
+    s->unsynced = 0;
+
+    if ((s->dev.sync != 0) && (s->dev.sync(s->dev.ctx) != 0))
+    {
+        s->stats.errors++;
+        return SD_WRITER_ERROR;
+    }
+
+    return SD_WRITER_OK;
+}
+
+
+/*
+ * Body of the writer task: write the oldest queued buffer and release it.
+ * With nothing queued, sync what was written and wait up to timeout_ms
+ * for work. Returns 1 if a buffer was taken, 0 otherwise. One task only.
+ */
+int SdWriter_Service(sd_writer_t *w, uint32_t timeout_ms)
+{
+    sd_writer_stream_t *s = 0;
+    sd_writer_job_t job;
+    int res;
+
+    if (w == 0)
+    {
+        return 0;
+    }
+
+    w->os.lock(w->os.ctx);
+
+    for (uint32_t i = 0; i < w->count; i++)
+    {
+        sd_writer_stream_t *c = w->streams[i];
+
+        if ((c->queued != 0U) &&
+            ((s == 0) || ((int32_t)(c->jobs[c->head].ticket - s->jobs[s->head].ticket) < 0)))
+        {
+            s = c;
+        }
+    }
+
+    if (s == 0)
+    {
+        w->os.unlock(w->os.ctx);
+
+        for (uint32_t i = 0; i < w->count; i++)
+        {
+            if (w->streams[i]->unsynced)
+            {
+                (void)SdWriter_Sync(w->streams[i]);
+            }
+        }
+
+        (void)w->os.wait(w->os.ctx, SD_WRITER_EV_WORK, timeout_ms);
+
+        return 0;
+    }
+
+    job = s->jobs[s->head];
+    s->head = (s->head + 1U) % s->depth;
+    s->queued--;
+
+    w->os.unlock(w->os.ctx);
+    w->os.signal(w->os.ctx, SD_WRITER_EV_SPACE);
+
+    if (s->sink.put != 0)
+    {
+        res = SdWriter_Sink(s, &job);
+
+        if (job.data != 0)
+        {
+            w->os.lock(w->os.ctx);
+            s->stats.written += (res == SD_WRITER_OK) ? 1U : 0U;
+            s->stats.bytes += (res == SD_WRITER_OK) ? job.len : 0U;
+            w->os.unlock(w->os.ctx);
+        }
+    }
+    else if (job.data == 0)
+    {
+        res = SdWriter_PutStage(s);
+        res = (res == SD_WRITER_OK) ? SdWriter_Sync(s) : res;
+    }
+    else
+    {
+        res = SdWriter_Write(s, job.data, job.len);
+
+        w->os.lock(w->os.ctx);
+        s->stats.written += (res == SD_WRITER_OK) ? 1U : 0U;
+        s->stats.bytes += (res == SD_WRITER_OK) ? job.len : 0U;
+        w->os.unlock(w->os.ctx);
+    }
+
+    if (job.release != 0)
+    {
+        job.release(job.ctx, job.data, res);
+    }
+
+    return 1;
+}
+
+
+void SdWriter_GetStats(sd_writer_t *w, const sd_writer_stream_t *s, sd_writer_stream_stats_t *stats)
+{
+    w->os.lock(w->os.ctx);
+    *stats = s->stats;
+    w->os.unlock(w->os.ctx);
+}
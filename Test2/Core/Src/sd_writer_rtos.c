@@ -0,0 +1,119 @@
+#include "sd_writer_rtos.h"
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+static sd_writer_t sd_writer;
+
+static StaticSemaphore_t sd_writer_mutex_buf;
+static SemaphoreHandle_t sd_writer_mutex;
+static StaticSemaphore_t sd_writer_event_buf[2];
+static SemaphoreHandle_t sd_writer_event[2];
+
+static StaticTask_t sd_writer_task_buf;
+static StackType_t sd_writer_stack[SD_WRITER_RTOS_STACK];
+
+
+static void SdWriterRTOS_Lock(void *ctx)
+{
+    (void)ctx;
+    (void)xSemaphoreTake(sd_writer_mutex, portMAX_DELAY);
+}
+
+
+static void SdWriterRTOS_Unlock(void *ctx)
+{
+    (void)ctx;
+    (void)xSemaphoreGive(sd_writer_mutex);
+}
+
+
+static int SdWriterRTOS_Wait(void *ctx, int event, uint32_t timeout_ms)
+{
+    const TickType_t ticks = (timeout_ms == SD_WRITER_FOREVER) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms);
+
+    (void)ctx;
+
+    return (xSemaphoreTake(sd_writer_event[event], ticks) == pdTRUE) ? 0 : -1;
+}
+
+
+/* A binary semaphore: a signal nobody waits for stays pending, once */
+static void SdWriterRTOS_Signal(void *ctx, int event)
+{
+    (void)ctx;
+    (void)xSemaphoreGive(sd_writer_event[event]);
+}
+
+
+static void SdWriterRTOS_Task(void *argument)
+{
+    (void)argument;
+
+    for (;;)
+    {
+        (void)SdWriter_Service(&sd_writer, SD_WRITER_RTOS_IDLE_MS);
+    }
+}
+
+
+int SdWriterRTOS_Init(void)
+{
+    const sd_writer_os_t os = { SdWriterRTOS_Lock, SdWriterRTOS_Unlock, SdWriterRTOS_Wait, SdWriterRTOS_Signal, 0 };
+
+    sd_writer_mutex = xSemaphoreCreateMutexStatic(&sd_writer_mutex_buf);
+    sd_writer_event[SD_WRITER_EV_WORK] = xSemaphoreCreateBinaryStatic(&sd_writer_event_buf[SD_WRITER_EV_WORK]);
+    sd_writer_event[SD_WRITER_EV_SPACE] = xSemaphoreCreateBinaryStatic(&sd_writer_event_buf[SD_WRITER_EV_SPACE]);
+
+    return SdWriter_Init(&sd_writer, &os);
+}
+
+
+/*
+ * Reserve path (bytes, created on first use) and add it as stream s,
+ * written from its start. stage holds stage_sectors sectors, a power of
+ * two: writes are aligned to it, or to the volume's cluster if that is
+ * smaller. jobs holds depth entries. stage, jobs and r must outlive the
+ * writer.
+ */
+int SdWriterRTOS_AddFile(sd_writer_stream_t *s, sd_region_t *r, const char *path, uint32_t bytes,
+                         uint8_t *stage, uint32_t stage_sectors, sd_writer_job_t *jobs, uint32_t depth,
+                         SdWriter_Policy policy, int wrap)
+{
+    const sd_writer_dev_t dev = { SdRegion_Write, SdRegion_Sync, r };
+    uint32_t unit;
+
+    if ((s == 0) || (r == 0) || (stage_sectors == 0U) || ((stage_sectors & (stage_sectors - 1U)) != 0U))
+    {
+        return SD_WRITER_INVALID_PARAM;
+    }
+
+    if (SdRegion_Reserve(r, path, bytes) != SD_REGION_OK)
+    {
+        return SD_WRITER_ERROR;
+    }
+
+    /* Clusters are a power of two sectors too: either divides the other */
+    unit = (r->cluster < stage_sectors) ? r->cluster : stage_sectors;
+
+    return SdWriter_AddStream(&sd_writer, s, &dev, r->base, r->sectors, unit, stage, jobs, depth, policy, wrap);
+}
+
+
+int SdWriterRTOS_Start(uint32_t priority)
+{
+    if (xTaskCreateStatic(SdWriterRTOS_Task, "sdWriter", SD_WRITER_RTOS_STACK, 0, (UBaseType_t)priority,
+                          sd_writer_stack, &sd_writer_task_buf) == 0)
+    {
+        return SD_WRITER_ERROR;
+    }
+
+    return SD_WRITER_OK;
+}
+
+
+sd_writer_t *SdWriterRTOS_Writer(void)
+{
+    return &sd_writer;
+}
@@ -0,0 +1,300 @@
+#include "spectrum_cache.h"
+
+#include <stdio.h>
+
+#include "main.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "fatfs.h"
+
+static tile_cache_t spectrum_cache;
+static tile_cache_entry_t spectrum_cache_entries[SPECTRUM_CACHE_MAX_SLOTS];
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t spectrum_cache_bounce[SPECTRUM_CACHE_BOUNCE_BYTES];
+
+/* The same for SpectrumCache_Service(), which copies without the mutex */
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t spectrum_cache_prefetch_bounce[SPECTRUM_CACHE_BOUNCE_BYTES];
+
+/* File being copied into the cache on a miss (mutex held) and by the prefetch */
+static FIL spectrum_cache_fp;
+static FIL spectrum_cache_prefetch_fp;
+static const char *spectrum_cache_dir;
+
+/* Cache state; PSRAM commands, taken after the first when both are */
+static StaticSemaphore_t spectrum_cache_mutex_buf;
+static SemaphoreHandle_t spectrum_cache_mutex;
+static StaticSemaphore_t spectrum_cache_psram_mutex_buf;
+static SemaphoreHandle_t spectrum_cache_psram_mutex;
+
+
+/*
+ * tile_store_t over the PSRAM, one page at most per QSPI command. Each
+ * command holds the PSRAM mutex only, so a prefetch filling a slot delays
+ * a read by one page at most.
+ */
+static int SpectrumCache_StoreRead(void *ctx, uint32_t addr, void *dst, uint32_t bytes)
+{
+    uint8_t *p = (uint8_t *)dst;
+
+    (void)ctx;
+
+    while (bytes != 0U)
+    {
+        uint32_t n = SPECTRUM_CACHE_PAGE - (addr % SPECTRUM_CACHE_PAGE);
+        HAL_StatusTypeDef st;
+
+        n = (n < bytes) ? n : bytes;
+
+        xSemaphoreTake(spectrum_cache_psram_mutex, portMAX_DELAY);
+        st = PSRAM_Read(addr, p, n);
+        xSemaphoreGive(spectrum_cache_psram_mutex);
+
+        if (st != HAL_OK)
+        {
+            return -1;
+        }
+
+        addr += n;
+        p += n;
+        bytes -= n;
+    }
+
+    return 0;
+}
+
+
+static int SpectrumCache_StoreWrite(void *ctx, uint32_t addr, const void *src, uint32_t bytes)
+{
+    const uint8_t *p = (const uint8_t *)src;
+
+    (void)ctx;
+
+    while (bytes != 0U)
+    {
+        uint32_t n = SPECTRUM_CACHE_PAGE - (addr % SPECTRUM_CACHE_PAGE);
+        HAL_StatusTypeDef st;
+
+        n = (n < bytes) ? n : bytes;
+
+        xSemaphoreTake(spectrum_cache_psram_mutex, portMAX_DELAY);
+        st = PSRAM_Write(addr, (uint8_t *)p, n);
+        xSemaphoreGive(spectrum_cache_psram_mutex);
+
+        if (st != HAL_OK)
+        {
+            return -1;
+        }
+
+        addr += n;
+        p += n;
+        bytes -= n;
+    }
+
+    return 0;
+}
+
+
+/* tile_source_t over the .SPT files, ctx the FIL: the object is header and payload */
+static int32_t SpectrumCache_SourceOpen(void *ctx, uint32_t key)
+{
+    FIL *fp = (FIL *)ctx;
+    spectrum_tile_header_t hdr;
+    char path[32];
+    FRESULT res;
+    UINT br;
+
+    snprintf(path, sizeof(path), "%s%s/%04u%04u.SPT", USERPath, spectrum_cache_dir,
+             (unsigned)(key & 0x3FFFU), (unsigned)((key >> 14) & 0x3FFFU));
+
+    res = f_open(fp, path, FA_READ);
+
+    if ((res == FR_NO_FILE) || (res == FR_NO_PATH))
+    {
+        return TILE_CACHE_ABSENT;
+    }
+
+    if (res != FR_OK)
+    {
+        return TILE_CACHE_ERROR;
+    }
+
+    if ((f_read(fp, &hdr, sizeof(hdr), &br) != FR_OK) || (br != sizeof(hdr)) ||
+        !SpectrumTile_CheckHeader(&hdr) ||
+        (f_size(fp) < (sizeof(hdr) + hdr.data_bytes)))
+    {
+        f_close(fp);
+        return TILE_CACHE_ERROR;
+    }
+
+    return (int32_t)(sizeof(hdr) + hdr.data_bytes);
+}
+
+
+static int SpectrumCache_SourceRead(void *ctx, uint32_t offset, void *dst, uint32_t bytes)
+{
+    FIL *fp = (FIL *)ctx;
+    UINT br;
+
+    if ((f_lseek(fp, offset) != FR_OK) ||
+        (f_read(fp, dst, bytes, &br) != FR_OK) || (br != bytes))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static void SpectrumCache_SourceClose(void *ctx)
+{
+    f_close((FIL *)ctx);
+}
+
+
+/*
+ * Cache the tiles of dir (on the USER volume) for FFT size n. Call before
+ * the scheduler starts; the PSRAM is only accessed once tiles are opened.
+ */
+int SpectrumCache_Init(const char *dir, uint32_t n)
+{
+    const tile_store_t store = { SpectrumCache_StoreRead, SpectrumCache_StoreWrite, 0 };
+    const tile_source_t src = { SpectrumCache_SourceOpen, SpectrumCache_SourceRead, SpectrumCache_SourceClose,
+                                &spectrum_cache_fp };
+    const uint32_t slot_bytes = SPECTRUM_CACHE_SLOT_BYTES(n);
+    uint32_t slots = SPECTRUM_CACHE_BYTES / slot_bytes;
+
+    slots = (slots < SPECTRUM_CACHE_MAX_SLOTS) ? slots : SPECTRUM_CACHE_MAX_SLOTS;
+
+    if ((dir == 0) || (n > FFT_MAX_N) || (slots < SPECTRUM_CACHE_MIN_SLOTS))
+    {
+        return SPECTRUM_SD_ERROR;
+    }
+
+    spectrum_cache_dir = dir;
+
+    if (TileCache_Init(&spectrum_cache, spectrum_cache_entries, slots, SPECTRUM_CACHE_BASE, slot_bytes,
+                       &store, &src, spectrum_cache_bounce, sizeof(spectrum_cache_bounce)) != TILE_CACHE_OK)
+    {
+        return SPECTRUM_SD_ERROR;
+    }
+
+    spectrum_cache_mutex = xSemaphoreCreateMutexStatic(&spectrum_cache_mutex_buf);
+    spectrum_cache_psram_mutex = xSemaphoreCreateMutexStatic(&spectrum_cache_psram_mutex_buf);
+
+    return SPECTRUM_SD_OK;
+}
+
+
+/*
+ * Make tile (tx, ty) resident and read its header. Returns as
+ * SpectrumSD_Open(): SPECTRUM_SD_ERROR covers missing tiles. *slot is what
+ * SpectrumCache_CorrelateBatch() takes.
+ */
+int SpectrumCache_Open(uint32_t tx, uint32_t ty, spectrum_tile_header_t *hdr, uint32_t *slot)
+{
+    int s;
+    int err;
+
+    xSemaphoreTake(spectrum_cache_mutex, portMAX_DELAY);
+
+    s = TileCache_Get(&spectrum_cache, TILE_CACHE_KEY(0U, tx, ty), 0);
+    err = (s < 0) ? TILE_CACHE_ERROR : TileCache_Read(&spectrum_cache, (uint32_t)s, 0U, hdr, sizeof(*hdr));
+
+    xSemaphoreGive(spectrum_cache_mutex);
+
+    if (err != TILE_CACHE_OK)
+    {
+        return SPECTRUM_SD_ERROR;
+    }
+
+    *slot = (uint32_t)s;
+
+    return SpectrumTile_CheckHeader(hdr) ? SPECTRUM_SD_OK : SPECTRUM_SD_BAD_FILE;
+}
+
+
+/* spectrum_source_t over cache slots; the QSPI read is polled, no read_wait */
+static int SpectrumCache_ReadStart(void *ctx, uint32_t tile, uint32_t offset, void *dst, uint32_t bytes)
+{
+    const uint32_t *slots = (const uint32_t *)ctx;
+    int err;
+
+    xSemaphoreTake(spectrum_cache_mutex, portMAX_DELAY);
+    err = TileCache_Read(&spectrum_cache, slots[tile], sizeof(spectrum_tile_header_t) + offset, dst, bytes);
+    xSemaphoreGive(spectrum_cache_mutex);
+
+    return (err == TILE_CACHE_OK) ? 0 : -1;
+}
+
+
+/* SpectrumSD_CorrelateBatch() over slots[i] / hdrs[i] from SpectrumCache_Open() */
+int SpectrumCache_CorrelateBatch(phase_corr_t *pc, const image_t *frame, const uint32_t *slots,
+                                 const spectrum_tile_header_t *hdrs, uint32_t count,
+                                 phase_corr_result_t *results, uint32_t *best)
+{
+    const spectrum_source_t src = { SpectrumCache_ReadStart, 0, (void *)slots };
+
+    return SpectrumSD_CorrelateSource(pc, frame, &src, hdrs, count, results, best);
+}
+
+
+void SpectrumCache_Prefetch(uint32_t tx, uint32_t ty)
+{
+    xSemaphoreTake(spectrum_cache_mutex, portMAX_DELAY);
+    TileCache_Prefetch(&spectrum_cache, TILE_CACHE_KEY(0U, tx, ty));
+    xSemaphoreGive(spectrum_cache_mutex);
+}
+
+
+/*
+ * Load up to max prefetched tiles; returns how many were loaded. The card
+ * is read with the mutex released (own file and bounce buffer), so an
+ * Open() or a correlation never waits for a tile it did not ask for.
+ */
+uint32_t SpectrumCache_Service(uint32_t max)
+{
+    const tile_source_t src = { SpectrumCache_SourceOpen, SpectrumCache_SourceRead, SpectrumCache_SourceClose,
+                                &spectrum_cache_prefetch_fp };
+    uint32_t done = 0U;
+
+    if (spectrum_cache_mutex == 0)
+    {
+        return 0U;
+    }
+
+    while (done < max)
+    {
+        tile_cache_load_t load;
+        int begun;
+
+        xSemaphoreTake(spectrum_cache_mutex, portMAX_DELAY);
+        begun = TileCache_ServiceBegin(&spectrum_cache, &load);
+        xSemaphoreGive(spectrum_cache_mutex);
+
+        if (!begun)
+        {
+            break;
+        }
+
+        TileCache_ServiceFill(&spectrum_cache, &load, &src, spectrum_cache_prefetch_bounce,
+                              sizeof(spectrum_cache_prefetch_bounce));
+
+        xSemaphoreTake(spectrum_cache_mutex, portMAX_DELAY);
+        TileCache_ServiceCommit(&spectrum_cache, &load);
+        xSemaphoreGive(spectrum_cache_mutex);
+
+        done++;
+    }
+
+    return done;
+}
+
+
+void SpectrumCache_GetStats(tile_cache_stats_t *stats)
+{
+    xSemaphoreTake(spectrum_cache_mutex, portMAX_DELAY);
+    TileCache_GetStats(&spectrum_cache, stats);
+    xSemaphoreGive(spectrum_cache_mutex);
+}
@@ -0,0 +1,147 @@
+#include "spectrum_sd.h"
+
+/*
+ * Raw chunk as read from the card and the same chunk expanded to float.
+ * Sized for the largest FFT so that any tile in the map can be streamed.
+ */
+#define SPECTRUM_SD_CHUNK_FLOATS   (SPECTRUM_SD_CHUNK_ROWS * FFT_REAL_ROW_FLOATS(FFT_MAX_N))
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t spectrum_raw[SPECTRUM_SD_CHUNK_FLOATS * sizeof(float)];
+
+__attribute__((section(".RAM_D1"), aligned(32)))
+static float spectrum_rows[SPECTRUM_SD_CHUNK_FLOATS];
+
+/* Second raw chunk for the double-buffered batch pipeline */
+__attribute__((section(".RAM_D1"), aligned(32)))
+static uint8_t spectrum_raw_next[SPECTRUM_SD_CHUNK_FLOATS * sizeof(float)];
+
+
+int SpectrumSD_Open(FIL *fp, const char *path, spectrum_tile_header_t *hdr)
+{
+    UINT br;
+
+    if (f_open(fp, path, FA_READ) != FR_OK)
+    {
+        return SPECTRUM_SD_ERROR;
+    }
+
+    if ((f_read(fp, hdr, sizeof(*hdr), &br) != FR_OK) || (br != sizeof(*hdr)) ||
+        !SpectrumTile_CheckHeader(hdr) ||
+        (f_size(fp) < (sizeof(*hdr) + hdr->data_bytes)))
+    {
+        f_close(fp);
+        return SPECTRUM_SD_BAD_FILE;
+    }
+
+    return SPECTRUM_SD_OK;
+}
+
+
+/*
+ * Correlate frame against the reference spectrum in an open .SPT file.
+ * Only the frame is transformed; the file position must be just after the
+ * header (as left by SpectrumSD_Open()).
+ */
+int SpectrumSD_Correlate(phase_corr_t *pc, const image_t *frame, FIL *fp,
+                         const spectrum_tile_header_t *hdr, phase_corr_result_t *result)
+{
+    const uint32_t row_bytes = SpectrumTile_RowBytes(hdr);
+    UINT br;
+
+    if ((hdr->n != pc->n) || (hdr->window != SPECTRUM_WINDOW_SQRT_HAMMING))
+    {
+        return SPECTRUM_SD_BAD_FILE;
+    }
+
+    if (PhaseCorr_Forward(pc, frame, pc->work_a) != PHASE_CORR_OK)
+    {
+        return SPECTRUM_SD_ERROR;
+    }
+
+    for (uint32_t row = 0; row < pc->n; row += SPECTRUM_SD_CHUNK_ROWS)
+    {
+        uint32_t rows = pc->n - row;
+
+        if (rows > SPECTRUM_SD_CHUNK_ROWS)
+        {
+            rows = SPECTRUM_SD_CHUNK_ROWS;
+        }
+
+        if ((f_read(fp, spectrum_raw, rows * row_bytes, &br) != FR_OK) ||
+            (br != (rows * row_bytes)))
+        {
+            return SPECTRUM_SD_ERROR;
+        }
+
+        SpectrumTile_DecodeRows(hdr, spectrum_raw, spectrum_rows, rows);
+        PhaseCorr_CrossPower(pc, spectrum_rows, row, rows);
+    }
+
+    return (PhaseCorr_FindPeak(pc, result) == PHASE_CORR_OK) ? SPECTRUM_SD_OK : SPECTRUM_SD_REJECTED;
+}
+
+
+/*
+ * spectrum_source_t over open .SPT files. The SPI card driver is polled, so
+ * the read completes inside read_start and there is no read_wait.
+ */
+static int SpectrumSD_ReadStart(void *ctx, uint32_t tile, uint32_t offset, void *dst, uint32_t bytes)
+{
+    FIL *fp = &((FIL *)ctx)[tile];
+    UINT br;
+
+    if ((f_lseek(fp, sizeof(spectrum_tile_header_t) + offset) != FR_OK) ||
+        (f_read(fp, dst, bytes, &br) != FR_OK) || (br != bytes))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Correlate frame against count candidate tiles whose spectra come from
+ * src, hdrs[i] being the header of tile i. The frame is transformed once;
+ * see phase_corr_batch.h. *best gets the index of the tile with the highest
+ * peak.
+ */
+int SpectrumSD_CorrelateSource(phase_corr_t *pc, const image_t *frame, const spectrum_source_t *src,
+                               const spectrum_tile_header_t *hdrs, uint32_t count,
+                               phase_corr_result_t *results, uint32_t *best)
+{
+    phase_corr_batch_t batch;
+    int err;
+
+    if (PhaseCorrBatch_Init(&batch, pc, src, SPECTRUM_SD_CHUNK_ROWS,
+                            spectrum_raw, spectrum_raw_next, spectrum_rows) != PHASE_CORR_BATCH_OK)
+    {
+        return SPECTRUM_SD_ERROR;
+    }
+
+    err = PhaseCorrBatch_Run(&batch, frame, hdrs, count, results, best);
+
+    if (err == PHASE_CORR_BATCH_INVALID_PARAM)
+    {
+        return SPECTRUM_SD_BAD_FILE;
+    }
+
+    if (err == PHASE_CORR_BATCH_REJECTED)
+    {
+        return SPECTRUM_SD_REJECTED;
+    }
+
+    return (err == PHASE_CORR_BATCH_OK) ? SPECTRUM_SD_OK : SPECTRUM_SD_ERROR;
+}
+
+
+/* SpectrumSD_CorrelateSource() over files[i] / hdrs[i] as left by SpectrumSD_Open() */
+int SpectrumSD_CorrelateBatch(phase_corr_t *pc, const image_t *frame, FIL *files,
+                              const spectrum_tile_header_t *hdrs, uint32_t count,
+                              phase_corr_result_t *results, uint32_t *best)
+{
+    const spectrum_source_t src = { SpectrumSD_ReadStart, 0, files };
+
+    return SpectrumSD_CorrelateSource(pc, frame, &src, hdrs, count, results, best);
+}
@@ -37,14 +37,51 @@
 #include "ff_gen_drv.h"
 
 #include "sd_spi.h"
+#include "disk_cache.h"
+#include "user_diskio.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* Sector cache in front of the card: a line is a 4 KB cluster */
+#ifndef USER_CACHE_LINES
+#define USER_CACHE_LINES          4U
+#endif
+#ifndef USER_CACHE_LINE_SECTORS
+#define USER_CACHE_LINE_SECTORS   8U
+#endif
+#ifndef USER_CACHE_AHEAD
+#define USER_CACHE_AHEAD          1U
+#endif
 
 /* Private variables ---------------------------------------------------------*/
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
 
+static disk_cache_t       user_cache;
+static disk_cache_line_t  user_cache_lines[USER_CACHE_LINES];
+static uint8_t            user_cache_mem[DISK_CACHE_BYTES(USER_CACHE_LINES, USER_CACHE_LINE_SECTORS)]
+    __attribute__((section(".RAM_D1"), aligned(32)));
+
+static int USER_CardRead(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count)
+{
+    (void)ctx;
+    return (SD_SPI_ReadBlocks(dst, sector, count) == SD_SPI_OK) ? 0 : -1;
+}
+
+static int USER_CardWrite(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count)
+{
+    (void)ctx;
+    return (SD_SPI_WriteBlocks(src, sector, count) == SD_SPI_OK) ? 0 : -1;
+}
+
+static const disk_cache_dev_t user_card = { USER_CardRead, USER_CardWrite, 0 };
+
+/* Hit / miss and card traffic counters of the sector cache */
+void USER_GetCacheStats(disk_cache_stats_t *stats)
+{
+    DiskCache_GetStats(&user_cache, stats);
+}
+
 /* USER CODE END DECL */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -88,7 +125,10 @@ DSTATUS USER_initialize (
 
     (void)pdrv;
 
-    if (SD_SPI_Init() == SD_SPI_OK)
+    /* (Re)mounting starts with an empty cache */
+    if ((SD_SPI_Init() == SD_SPI_OK) &&
+        (DiskCache_Init(&user_cache, &user_card, user_cache_lines, USER_CACHE_LINES,
+                        USER_CACHE_LINE_SECTORS, user_cache_mem, USER_CACHE_AHEAD) == DISK_CACHE_OK))
     {
         return 0;
     }
@@ -135,7 +175,7 @@ DRESULT USER_read (
 
     (void)pdrv;
 
-    if (SD_SPI_ReadBlocks((uint8_t *)buff, (uint32_t)sector, (uint32_t)count) == SD_SPI_OK)
+    if (DiskCache_Read(&user_cache, (uint8_t *)buff, (uint32_t)sector, (uint32_t)count) == DISK_CACHE_OK)
     {
         return RES_OK;
     }
@@ -166,7 +206,7 @@ DRESULT USER_write (
 
     (void)pdrv;
 
-    if (SD_SPI_WriteBlocks((const uint8_t *)buff, (uint32_t)sector, (uint32_t)count) == SD_SPI_OK)
+    if (DiskCache_Write(&user_cache, (const uint8_t *)buff, (uint32_t)sector, (uint32_t)count) == DISK_CACHE_OK)
     {
         return RES_OK;
     }
@@ -199,7 +239,12 @@ DRESULT USER_ioctl (
     switch (cmd)
     {
         case CTRL_SYNC:
-            return RES_OK;
+            /* Writes back the cache, then ends an open multi-block write */
+            if (DiskCache_Flush(&user_cache) != DISK_CACHE_OK)
+            {
+                return RES_ERROR;
+            }
+            return (SD_SPI_Sync() == SD_SPI_OK) ? RES_OK : RES_ERROR;
 
         case GET_SECTOR_SIZE:
             *(WORD *)buff = 512;
@@ -29,11 +29,15 @@
 /* USER CODE BEGIN 0 */
 
 /* Includes ------------------------------------------------------------------*/
+#include "disk_cache.h"
+
 /* Exported types ------------------------------------------------------------*/
 /* Exported constants --------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 extern Diskio_drvTypeDef  USER_Driver;
 
+void USER_GetCacheStats(disk_cache_stats_t *stats);
+
 /* USER CODE END 0 */
 
 #ifdef __cplusplus
@@ -0,0 +1,378 @@
+#include "fft.h"
+
+#include <math.h>
+
+/*
+ * Iterative decimation-in-time radix-2 FFT.
+ *
+ * The plan holds the twiddle factors and the bit-reversal permutation so that
+ * no trigonometry is evaluated per transform. The 2D transform is done as a
+ * row pass followed by a column pass; each column is gathered into a small
+ * contiguous scratch buffer so that the butterflies always run on unit-stride
+ * data.
+ */
+
+#define FFT_PI    3.14159265358979323846
+
+
+int FFT_Init(fft_plan_t *plan, uint32_t n)
+{
+    uint32_t log2n = 0U;
+
+    if ((plan == 0) || (n < FFT_MIN_N) || (n > FFT_MAX_N) || ((n & (n - 1U)) != 0U))
+    {
+        return -1;
+    }
+
+    while ((1UL << log2n) < n)
+    {
+        log2n++;
+    }
+
+    plan->n = n;
+    plan->log2n = log2n;
+
+    for (uint32_t k = 0; k < (n / 2U); k++)
+    {
+        double a = -2.0 * FFT_PI * (double)k / (double)n;
+
+        plan->twiddle[2U * k]      = (float)cos(a);
+        plan->twiddle[2U * k + 1U] = (float)sin(a);
+    }
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t r = 0U;
+
+        for (uint32_t b = 0; b < log2n; b++)
+        {
+            r |= ((i >> b) & 1U) << (log2n - 1U - b);
+        }
+
+        plan->bitrev[i] = (uint16_t)r;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Bit-reversal permutation of a length n >> shift transform: the bit-reversal
+ * of a shorter length is the plan entry shifted right.
+ */
+static void FFT_Permute(const fft_plan_t *plan, float *data, uint32_t shift)
+{
+    const uint32_t m = plan->n >> shift;
+
+    for (uint32_t i = 0; i < m; i++)
+    {
+        uint32_t j = (uint32_t)plan->bitrev[i] >> shift;
+
+        if (i < j)
+        {
+            float re = data[2U * i];
+            float im = data[2U * i + 1U];
+
+            data[2U * i]      = data[2U * j];
+            data[2U * i + 1U] = data[2U * j + 1U];
+            data[2U * j]      = re;
+            data[2U * j + 1U] = im;
+        }
+    }
+}
+
+
+/*
+ * Butterflies of a length n >> shift transform on bit-reversed input; the
+ * twiddles are every (1 << shift)-th plan twiddle.
+ */
+static void FFT_Butterflies(const fft_plan_t *plan, float *data, uint32_t shift, FFT_Direction dir)
+{
+    const uint32_t n = plan->n;
+    const uint32_t m = n >> shift;
+    const float sign = (dir == FFT_INVERSE) ? -1.0f : 1.0f;
+
+    /* First stage: all twiddles are 1 */
+    for (uint32_t i = 0; i < 2U * m; i += 4U)
+    {
+        float re = data[i + 2U];
+        float im = data[i + 3U];
+
+        data[i + 2U] = data[i]      - re;
+        data[i + 3U] = data[i + 1U] - im;
+        data[i]      += re;
+        data[i + 1U] += im;
+    }
+
+    for (uint32_t len = 4U; len <= m; len <<= 1)
+    {
+        const uint32_t half = len >> 1;
+        const uint32_t step = n / len;
+
+        for (uint32_t i = 0; i < m; i += len)
+        {
+            float *a = &data[2U * i];
+            float *b = &data[2U * (i + half)];
+
+            for (uint32_t k = 0; k < half; k++)
+            {
+                float wr = plan->twiddle[2U * k * step];
+                float wi = sign * plan->twiddle[2U * k * step + 1U];
+                float tr = (b[2U * k] * wr) - (b[2U * k + 1U] * wi);
+                float ti = (b[2U * k] * wi) + (b[2U * k + 1U] * wr);
+
+                b[2U * k]      = a[2U * k]      - tr;
+                b[2U * k + 1U] = a[2U * k + 1U] - ti;
+                a[2U * k]      += tr;
+                a[2U * k + 1U] += ti;
+            }
+        }
+    }
+}
+
+
+/* Length n >> shift transform using the tables of the length n plan */
+static void FFT_Radix2(const fft_plan_t *plan, float *data, uint32_t shift, FFT_Direction dir)
+{
+    FFT_Permute(plan, data, shift);
+    FFT_Butterflies(plan, data, shift, dir);
+}
+
+
+void FFT_Complex(const fft_plan_t *plan, float *data, FFT_Direction dir)
+{
+    FFT_Radix2(plan, data, 0U, dir);
+}
+
+
+/* Split the half-length transform of the packed samples into the n/2 + 1 bins */
+static void FFT_RealSplit(const fft_plan_t *plan, float *data)
+{
+    const uint32_t m = plan->n / 2U;
+
+    float z0r = data[0];
+    float z0i = data[1];
+
+    data[0]           = z0r + z0i;
+    data[1]           = 0.0f;
+    data[2U * m]      = z0r - z0i;
+    data[2U * m + 1U] = 0.0f;
+
+    for (uint32_t k = 1; k <= (m / 2U); k++)
+    {
+        const uint32_t j = m - k;
+        float ar = data[2U * k];
+        float ai = data[2U * k + 1U];
+        float br = data[2U * j];
+        float bi = data[2U * j + 1U];
+        float wr = plan->twiddle[2U * k];
+        float wi = plan->twiddle[2U * k + 1U];
+
+        /* Fe = (A + conj(B)) / 2, Fo = (A - conj(B)) / 2i */
+        float fe_r = 0.5f * (ar + br);
+        float fe_i = 0.5f * (ai - bi);
+        float fo_r = 0.5f * (ai + bi);
+        float fo_i = -0.5f * (ar - br);
+
+        /* W^k * Fo */
+        float tr = (wr * fo_r) - (wi * fo_i);
+        float ti = (wr * fo_i) + (wi * fo_r);
+
+        data[2U * k]      = fe_r + tr;
+        data[2U * k + 1U] = fe_i + ti;
+        data[2U * j]      = fe_r - tr;
+        data[2U * j + 1U] = -(fe_i - ti);
+    }
+}
+
+
+/*
+ * Real forward transform of length n, in place.
+ *
+ * On entry data holds n real samples; on exit it holds the n/2 + 1 complex
+ * bins 0..n/2 (n + 2 floats). The samples are packed as n/2 complex values
+ * z[k] = x[2k] + i*x[2k+1], transformed at half length and then split into
+ * the even/odd spectra:
+ *   X[k] = Fe[k] + W^k * Fo[k],  X[n/2-k] = conj(Fe[k] - W^k * Fo[k])
+ */
+void FFT_Real(const fft_plan_t *plan, float *data)
+{
+    FFT_Radix2(plan, data, 1U, FFT_FORWARD);
+    FFT_RealSplit(plan, data);
+}
+
+
+/*
+ * Inverse of FFT_Real(): n/2 + 1 complex bins in, n real samples out, in
+ * place. Like the complex inverse the result is scaled by n.
+ */
+void FFT_RealInverse(const fft_plan_t *plan, float *data)
+{
+    const uint32_t m = plan->n / 2U;
+
+    float x0 = data[0];
+    float xm = data[2U * m];
+
+    data[0] = x0 + xm;
+    data[1] = x0 - xm;
+
+    for (uint32_t k = 1; k <= (m / 2U); k++)
+    {
+        const uint32_t j = m - k;
+        float ar = data[2U * k];
+        float ai = data[2U * k + 1U];
+        float br = data[2U * j];
+        float bi = data[2U * j + 1U];
+        float wr = plan->twiddle[2U * k];
+        float wi = plan->twiddle[2U * k + 1U];
+
+        /* Fe = X[k] + conj(X[m-k]), Fo = conj(W^k) * (X[k] - conj(X[m-k])) */
+        float fe_r = ar + br;
+        float fe_i = ai - bi;
+        float dr = ar - br;
+        float di = ai + bi;
+        float fo_r = (wr * dr) + (wi * di);
+        float fo_i = (wr * di) - (wi * dr);
+
+        /* Z[k] = Fe + i*Fo, Z[m-k] = conj(Fe) + i*conj(Fo) */
+        data[2U * k]      = fe_r - fo_i;
+        data[2U * k + 1U] = fe_i + fo_r;
+        data[2U * j]      = fe_r + fo_i;
+        data[2U * j + 1U] = fo_r - fe_i;
+    }
+
+    FFT_Radix2(plan, data, 1U, FFT_INVERSE);
+}
+
+
+/*
+ * In-place 2D transform of an n x n complex image (row-major).
+ * col must hold 2 * n floats.
+ */
+void FFT_Complex2D(const fft_plan_t *plan, float *data, float *col, FFT_Direction dir)
+{
+    const uint32_t n = plan->n;
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        FFT_Complex(plan, &data[2U * y * n], dir);
+    }
+
+    for (uint32_t x = 0; x < n; x++)
+    {
+        for (uint32_t y = 0; y < n; y++)
+        {
+            col[2U * y]      = data[2U * (y * n + x)];
+            col[2U * y + 1U] = data[2U * (y * n + x) + 1U];
+        }
+
+        FFT_Complex(plan, col, dir);
+
+        for (uint32_t y = 0; y < n; y++)
+        {
+            data[2U * (y * n + x)]      = col[2U * y];
+            data[2U * (y * n + x) + 1U] = col[2U * y + 1U];
+        }
+    }
+}
+
+
+/* Column pass of the 2D real transforms over the n/2 + 1 bin columns */
+static void FFT_Columns(const fft_plan_t *plan, float *data, float *col, FFT_Direction dir)
+{
+    const uint32_t n = plan->n;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+    const uint32_t bins = n / 2U + 1U;
+
+    for (uint32_t x = 0; x < bins; x++)
+    {
+        for (uint32_t y = 0; y < n; y++)
+        {
+            col[2U * y]      = data[y * stride + 2U * x];
+            col[2U * y + 1U] = data[y * stride + 2U * x + 1U];
+        }
+
+        FFT_Radix2(plan, col, 0U, dir);
+
+        for (uint32_t y = 0; y < n; y++)
+        {
+            data[y * stride + 2U * x]      = col[2U * y];
+            data[y * stride + 2U * x + 1U] = col[2U * y + 1U];
+        }
+    }
+}
+
+
+/*
+ * Real 2D forward transform of an n x n image into its Hermitian half
+ * spectrum. Rows are FFT_REAL_ROW_FLOATS(n) floats apart: on entry the first
+ * n floats of each row hold the samples, on exit each row holds the
+ * n/2 + 1 complex bins of that spectrum row. col must hold 2 * n floats.
+ */
+void FFT_Real2D(const fft_plan_t *plan, float *data, float *col)
+{
+    const uint32_t n = plan->n;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        FFT_Real(plan, &data[y * stride]);
+    }
+
+    FFT_Columns(plan, data, col, FFT_FORWARD);
+}
+
+
+/*
+ * As FFT_Real2D(), but the samples of each row are already in the
+ * bit-reversed pair order of the half-length transform: samples 2k and
+ * 2k + 1 at floats 2j and 2j + 1 with j = FFT_BITREV_PAIR(plan, k), as
+ * written by a loader that scatters them there directly. Saves the row
+ * permutations.
+ */
+void FFT_Real2DBitRev(const fft_plan_t *plan, float *data, float *col)
+{
+    FFT_Real2DBitRevRows(plan, data, 0U, plan->n);
+    FFT_Real2DColumns(plan, data, col);
+}
+
+
+/*
+ * The two passes of FFT_Real2DBitRev() apart, so the rows can be
+ * transformed as they arrive: rows row0 .. row0 + rows - 1, then, once all
+ * n rows are done, the column pass.
+ */
+void FFT_Real2DBitRevRows(const fft_plan_t *plan, float *data, uint32_t row0, uint32_t rows)
+{
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(plan->n);
+
+    for (uint32_t y = row0; y < (row0 + rows); y++)
+    {
+        FFT_Butterflies(plan, &data[y * stride], 1U, FFT_FORWARD);
+        FFT_RealSplit(plan, &data[y * stride]);
+    }
+}
+
+
+void FFT_Real2DColumns(const fft_plan_t *plan, float *data, float *col)
+{
+    FFT_Columns(plan, data, col, FFT_FORWARD);
+}
+
+
+/*
+ * Inverse of FFT_Real2D(): on exit the first n floats of each row hold the
+ * real samples, scaled by n * n.
+ */
+void FFT_RealInverse2D(const fft_plan_t *plan, float *data, float *col)
+{
+    const uint32_t n = plan->n;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+
+    FFT_Columns(plan, data, col, FFT_INVERSE);
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        FFT_RealInverse(plan, &data[y * stride]);
+    }
+}
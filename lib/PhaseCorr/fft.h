@@ -0,0 +1,65 @@
+#ifndef __FFT_H
+#define __FFT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Single-precision radix-2 FFT used by the phase-correlation engine.
+ *
+ * Complex data is stored interleaved (re, im, re, im, ...), the same layout
+ * used by CMSIS-DSP arm_cfft_f32(). Transforms are unnormalised in both
+ * directions: a forward + inverse round trip scales the data by N (1D) or
+ * N * N (2D).
+ *
+ * The real transforms keep only the n/2 + 1 non-redundant bins of each row
+ * (the rest follow from Hermitian symmetry), so an n x n real image needs
+ * n * (n + 2) floats instead of 2 * n * n.
+ */
+
+#ifndef FFT_MAX_N
+#define FFT_MAX_N          512U
+#endif
+
+/* The real transforms run a complex one of n/2 points, which needs two */
+#define FFT_MIN_N          4U
+
+/* Floats per row of a half spectrum: n/2 + 1 complex bins */
+#define FFT_REAL_ROW_FLOATS(n)    ((uint32_t)(n) + 2U)
+
+/* Slot of sample pair k (samples 2k, 2k + 1) in a FFT_Real2DBitRev() row */
+#define FFT_BITREV_PAIR(plan, k)  ((uint32_t)(plan)->bitrev[(k)] >> 1)
+
+typedef enum
+{
+    FFT_FORWARD = 0,
+    FFT_INVERSE = 1
+} FFT_Direction;
+
+typedef struct
+{
+    uint32_t n;                          /* Transform length, power of two */
+    uint32_t log2n;
+    float    twiddle[FFT_MAX_N];         /* n/2 complex factors exp(-2*pi*i*k/n) */
+    uint16_t bitrev[FFT_MAX_N];          /* Bit-reversed index of each input */
+} fft_plan_t;
+
+int  FFT_Init(fft_plan_t *plan, uint32_t n);
+void FFT_Complex(const fft_plan_t *plan, float *data, FFT_Direction dir);
+void FFT_Complex2D(const fft_plan_t *plan, float *data, float *col, FFT_Direction dir);
+void FFT_Real(const fft_plan_t *plan, float *data);
+void FFT_RealInverse(const fft_plan_t *plan, float *data);
+void FFT_Real2D(const fft_plan_t *plan, float *data, float *col);
+void FFT_Real2DBitRev(const fft_plan_t *plan, float *data, float *col);
+void FFT_Real2DBitRevRows(const fft_plan_t *plan, float *data, uint32_t row0, uint32_t rows);
+void FFT_Real2DColumns(const fft_plan_t *plan, float *data, float *col);
+void FFT_RealInverse2D(const fft_plan_t *plan, float *data, float *col);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FFT_H */
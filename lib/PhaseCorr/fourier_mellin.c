@@ -0,0 +1,354 @@
+#include "fourier_mellin.h"
+
+#include <math.h>
+
+#include "fmath.h"
+
+#define FOURIER_MELLIN_Q15     32768.0f
+
+
+/* sin and cos of an angle in degrees, linearly interpolated from sincos_tab.c */
+static void FourierMellin_SinCos(float deg, float *s, float *c)
+{
+    float a = fmodf(deg, 360.0f);
+
+    if (a < 0.0f)
+    {
+        a += 360.0f;
+    }
+
+    uint32_t i = (uint32_t)a;
+    uint32_t j = (i + 1U) % 360U;
+    float f = a - (float)i;
+
+    i %= 360U;
+
+    *s = sin_table[i] + (f * (sin_table[j] - sin_table[i]));
+    *c = cos_table[i] + (f * (cos_table[j] - cos_table[i]));
+}
+
+
+/*
+ * Build the log-polar taps for an n x n half spectrum resampled to m angles
+ * x m radii. Row i is the angle -90 + 180 * i / m degrees, column j the
+ * radius R_MIN * exp(j * log_step), up to n/2 - 2 so that every bilinear
+ * cell lies inside the spectrum. Does nothing if lut already holds this
+ * table.
+ */
+int LogPolar_Build(log_polar_lut_t *lut, uint32_t n, uint32_t m, log_polar_tap_t *taps)
+{
+    if ((lut == 0) || (taps == 0) || (n < 16U) || (n > FFT_MAX_N) || ((n & (n - 1U)) != 0U) ||
+        (m < 2U) || (m > FFT_MAX_N) || ((m & (m - 1U)) != 0U))
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    if ((lut->taps == taps) && (lut->n == n) && (lut->m == m))
+    {
+        return FOURIER_MELLIN_OK;
+    }
+
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+    const float r_max = (float)(n / 2U) - 2.0f;
+    const float log_step = logf(r_max / LOG_POLAR_R_MIN) / (float)(m - 1U);
+
+    for (uint32_t i = 0; i < m; i++)
+    {
+        float s;
+        float c;
+
+        FourierMellin_SinCos(-90.0f + (180.0f * (float)i / (float)m), &s, &c);
+
+        for (uint32_t j = 0; j < m; j++)
+        {
+            const float r = LOG_POLAR_R_MIN * expf((float)j * log_step);
+            float kx = r * c;
+            float ky = (r * s) + (float)(n / 2U);      /* Magnitude rows are centred on ky = 0 */
+
+            if (kx < 0.0f)
+            {
+                kx = 0.0f;
+            }
+
+            const uint32_t x0 = (uint32_t)kx;
+            const uint32_t y0 = (uint32_t)ky;
+            const float fx = (kx - (float)x0) * FOURIER_MELLIN_Q15;
+            const float fy = (ky - (float)y0) * FOURIER_MELLIN_Q15;
+            log_polar_tap_t *t = &taps[i * m + j];
+
+            t->offset = (y0 * stride) + x0;
+            t->fx = (uint16_t)((fx < 32767.0f) ? fx : 32767.0f);
+            t->fy = (uint16_t)((fy < 32767.0f) ? fy : 32767.0f);
+        }
+    }
+
+    lut->n = n;
+    lut->m = m;
+    lut->log_step = log_step;
+    lut->taps = taps;
+
+    return FOURIER_MELLIN_OK;
+}
+
+
+int FourierMellin_Init(fourier_mellin_t *fm, phase_corr_t *pc, const log_polar_lut_t *lut,
+                       float *lp_a, float *lp_b, uint8_t *canvas)
+{
+    if ((fm == 0) || (pc == 0) || (lut == 0) || (lut->taps == 0) || (canvas == 0) ||
+        (lut->n != pc->n))
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    if (PhaseCorr_Init(&fm->lp, lut->m, lp_a, lp_b) != PHASE_CORR_OK)
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    fm->pc = pc;
+    fm->lut = lut;
+    fm->canvas = canvas;
+
+    return FOURIER_MELLIN_OK;
+}
+
+
+/*
+ * Replace the half spectrum by log(1 + |F|), one float per bin at the start
+ * of each row, with the rows swapped by halves so that row n/2 is ky = 0 and
+ * a bilinear cell never wraps around.
+ */
+static void FourierMellin_Magnitude(fourier_mellin_t *fm, float *spectrum)
+{
+    const uint32_t n = fm->pc->n;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+    const uint32_t bins = n / 2U + 1U;
+    float *tmp = fm->pc->col;
+
+    for (uint32_t y = 0; y < n / 2U; y++)
+    {
+        float *a = &spectrum[y * stride];
+        float *b = &spectrum[(y + n / 2U) * stride];
+
+        for (uint32_t k = 0; k < bins; k++)
+        {
+            tmp[k] = fast_log(1.0f + sqrtf((a[2U * k] * a[2U * k]) + (a[2U * k + 1U] * a[2U * k + 1U])));
+            tmp[bins + k] = fast_log(1.0f + sqrtf((b[2U * k] * b[2U * k]) + (b[2U * k + 1U] * b[2U * k + 1U])));
+        }
+
+        for (uint32_t k = 0; k < bins; k++)
+        {
+            a[k] = tmp[bins + k];
+            b[k] = tmp[k];
+        }
+    }
+}
+
+
+/*
+ * Log-polar spectrum of the centred n x n crop of img into lp_spectrum
+ * (FOURIER_MELLIN_WORK_FLOATS(m) floats). The angle axis is periodic; the
+ * radius axis is not and gets a Hamming window. Uses pc->work_a as scratch.
+ */
+int FourierMellin_Forward(fourier_mellin_t *fm, const image_t *img, float *lp_spectrum)
+{
+    if ((fm == 0) || (lp_spectrum == 0))
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    const uint32_t n = fm->pc->n;
+    const uint32_t m = fm->lut->m;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+    const uint32_t lp_stride = FFT_REAL_ROW_FLOATS(m);
+    float *mag = fm->pc->work_a;
+
+    if (PhaseCorr_Forward(fm->pc, img, mag) != PHASE_CORR_OK)
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    FourierMellin_Magnitude(fm, mag);
+
+    for (uint32_t i = 0; i < m; i++)
+    {
+        const log_polar_tap_t *t = &fm->lut->taps[i * m];
+        float *out = &lp_spectrum[i * lp_stride];
+
+        for (uint32_t j = 0; j < m; j++)
+        {
+            const float *p = &mag[t[j].offset];
+            const float wx = (float)t[j].fx * (1.0f / FOURIER_MELLIN_Q15);
+            const float wy = (float)t[j].fy * (1.0f / FOURIER_MELLIN_Q15);
+            const float top = p[0] + (wx * (p[1] - p[0]));
+            const float bot = p[stride] + (wx * (p[stride + 1U] - p[stride]));
+            const float w = fm->lp.window[j];
+
+            out[j] = (top + (wy * (bot - top))) * w * w;
+        }
+    }
+
+    FFT_Real2D(&fm->lp.plan, lp_spectrum, fm->lp.col);
+
+    return FOURIER_MELLIN_OK;
+}
+
+
+/*
+ * Rotation and scale of frame w.r.t. the reference whose log-polar spectrum
+ * is ref_lp_spectrum (see FourierMellin_Forward()). Fills angle, scale and
+ * lp_peak of result; angle is in [-90, 90), see FourierMellin_Register().
+ */
+int FourierMellin_Estimate(fourier_mellin_t *fm, const image_t *frame, const float *ref_lp_spectrum,
+                           fourier_mellin_result_t *result)
+{
+    phase_corr_result_t lpr;
+
+    if ((fm == 0) || (ref_lp_spectrum == 0) || (result == 0))
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    if (FourierMellin_Forward(fm, frame, fm->lp.work_a) != FOURIER_MELLIN_OK)
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    PhaseCorr_CrossPower(&fm->lp, ref_lp_spectrum, 0U, fm->lut->m);
+    (void)PhaseCorr_FindPeak(&fm->lp, &lpr);
+
+    /* The spectrum turns with the image content and shrinks when it grows */
+    result->angle = 180.0f * lpr.sub_dy / (float)fm->lut->m;
+    result->scale = expf(-lpr.sub_dx * fm->lut->log_step);
+    result->lp_peak = lpr.peak;
+
+    return FOURIER_MELLIN_OK;
+}
+
+
+/*
+ * Resample the centred n x n crop of frame into the canvas, undoing a
+ * rotation by angle and a magnification by scale about the frame centre.
+ * Samples outside the frame take the frame mean.
+ */
+static void FourierMellin_Warp(fourier_mellin_t *fm, const image_t *frame, float angle, float scale)
+{
+    const uint32_t n = fm->pc->n;
+    const float cx = (float)frame->w * 0.5f;
+    const float cy = (float)frame->h * 0.5f;
+    const float half = (float)n * 0.5f;
+    const int32_t x0 = (frame->w - (int32_t)n) / 2;
+    const int32_t y0 = (frame->h - (int32_t)n) / 2;
+    uint32_t sum = 0U;
+    float s;
+    float c;
+
+    for (uint32_t y = 0; y < n; y += 2U)
+    {
+        const uint8_t *row = &frame->pixels[(uint32_t)(y0 + (int32_t)y) * (uint32_t)frame->w + (uint32_t)x0];
+
+        for (uint32_t x = 0; x < n; x += 2U)
+        {
+            sum += row[x];
+        }
+    }
+
+    const uint8_t fill = (uint8_t)(sum / ((n / 2U) * (n / 2U)));
+
+    FourierMellin_SinCos(angle, &s, &c);
+    s *= scale;
+    c *= scale;
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        const float v = (float)y - half;
+        uint8_t *out = &fm->canvas[y * n];
+
+        for (uint32_t x = 0; x < n; x++)
+        {
+            const float u = (float)x - half;
+            const float sx = cx + (c * u) - (s * v);
+            const float sy = cy + (s * u) + (c * v);
+            const int32_t ix = (int32_t)floorf(sx);
+            const int32_t iy = (int32_t)floorf(sy);
+
+            if ((ix < 0) || (iy < 0) || (ix >= frame->w - 1) || (iy >= frame->h - 1))
+            {
+                out[x] = fill;
+                continue;
+            }
+
+            const uint8_t *p = &frame->pixels[iy * frame->w + ix];
+            const float fx = sx - (float)ix;
+            const float fy = sy - (float)iy;
+            const float top = (float)p[0] + (fx * (float)((int32_t)p[1] - (int32_t)p[0]));
+            const float bot = (float)p[frame->w] + (fx * (float)((int32_t)p[frame->w + 1] - (int32_t)p[frame->w]));
+
+            out[x] = (uint8_t)(top + (fy * (bot - top)) + 0.5f);
+        }
+    }
+}
+
+
+/*
+ * Translation pass: derotate and rescale frame with the angle and scale in
+ * result, for both angle and angle + 180 degrees, and phase-correlate with
+ * ref. The candidate with the higher peak wins; result->angle and
+ * result->shift are updated.
+ */
+int FourierMellin_Register(fourier_mellin_t *fm, const image_t *frame, const image_t *ref,
+                           fourier_mellin_result_t *result)
+{
+    image_t canvas = { .w = (int)fm->pc->n, .h = (int)fm->pc->n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = fm->canvas };
+    phase_corr_result_t pcr[2];
+    const float angle[2] = { result->angle, (result->angle < 0.0f) ? (result->angle + 180.0f) : (result->angle - 180.0f) };
+
+    if ((frame == 0) || (frame->pixels == 0) || (frame->bpp != IMAGE_BPP_GRAYSCALE) ||
+        ((uint32_t)frame->w < fm->pc->n) || ((uint32_t)frame->h < fm->pc->n))
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    for (uint32_t k = 0; k < 2U; k++)
+    {
+        FourierMellin_Warp(fm, frame, angle[k], result->scale);
+
+        /* The wrong candidate is expected to fall below the confidence threshold */
+        int err = PhaseCorr_Run(fm->pc, &canvas, ref, &pcr[k]);
+
+        if ((err != PHASE_CORR_OK) && (err != PHASE_CORR_REJECTED))
+        {
+            return FOURIER_MELLIN_ERROR;
+        }
+    }
+
+    const uint32_t best = (pcr[1].peak > pcr[0].peak) ? 1U : 0U;
+
+    result->angle = angle[best];
+    result->shift = pcr[best];
+
+    return (pcr[best].psr >= fm->pc->min_psr) ? FOURIER_MELLIN_OK : FOURIER_MELLIN_REJECTED;
+}
+
+
+/* Rotation, scale and translation of frame w.r.t. ref. Needs lp_b. */
+int FourierMellin_Run(fourier_mellin_t *fm, const image_t *frame, const image_t *ref,
+                      fourier_mellin_result_t *result)
+{
+    if ((fm == 0) || (fm->lp.work_b == 0))
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    if (FourierMellin_Forward(fm, ref, fm->lp.work_b) != FOURIER_MELLIN_OK)
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    if (FourierMellin_Estimate(fm, frame, fm->lp.work_b, result) != FOURIER_MELLIN_OK)
+    {
+        return FOURIER_MELLIN_INVALID_PARAM;
+    }
+
+    return FourierMellin_Register(fm, frame, ref, result);
+}
@@ -0,0 +1,96 @@
+#ifndef __FOURIER_MELLIN_H
+#define __FOURIER_MELLIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "imlib.h"
+#include "phase_corr.h"
+
+/*
+ * Fourier-Mellin rotation and scale estimation.
+ *
+ * The magnitude of the spectrum does not depend on translation, and a
+ * rotation or scaling of the image rotates or scales its magnitude spectrum
+ * the opposite way. Resampled on a log-polar grid (rows = angle, columns =
+ * log radius) both become plain shifts, which a second, m x m phase
+ * correlation measures. The frame is then resampled into the reference
+ * geometry and the usual translation pass gives the shift.
+ *
+ * The magnitude spectrum of a real image is point symmetric, so the angle
+ * axis covers 180 degrees and the half spectrum of FFT_Real2D() holds all
+ * of it. The remaining 180 degree ambiguity is resolved by the translation
+ * pass, which is run for both candidates.
+ *
+ * The log-polar sampling positions and bilinear weights depend only on n
+ * and m: they are built once (LogPolar_Build()) into a fixed-point table of
+ * m x m taps (8 bytes each) that any number of fourier_mellin_t can share,
+ * so no trigonometry or logarithm of coordinates is evaluated per frame.
+ *
+ * Grid spacing: 180 / m degrees in angle and a factor exp(log_step) in
+ * scale (3.3 % for n = 256, m = 128); the sub-pixel peak of the log-polar
+ * correlation resolves a fraction of that.
+ */
+
+#define LOG_POLAR_R_MIN                2.0f        /* Radii below this are mostly DC leakage */
+#define FOURIER_MELLIN_WORK_FLOATS(m)  PHASE_CORR_WORK_FLOATS(m)
+
+typedef enum
+{
+    FOURIER_MELLIN_OK = 0,
+    FOURIER_MELLIN_ERROR = -1,
+    FOURIER_MELLIN_INVALID_PARAM = -2,
+    FOURIER_MELLIN_REJECTED = -3        /* Translation pass below the pc confidence threshold */
+} FourierMellin_Status;
+
+typedef struct
+{
+    uint32_t offset;    /* Top-left bin of the bilinear cell in the row-centred magnitude */
+    uint16_t fx;        /* Q15 fractional position inside the cell */
+    uint16_t fy;
+} log_polar_tap_t;
+
+typedef struct
+{
+    uint32_t         n;             /* Source FFT size */
+    uint32_t         m;             /* Log-polar size (angles = radii = m) */
+    float            log_step;      /* ln(radius) increment per column */
+    log_polar_tap_t *taps;          /* m * m, row major */
+} log_polar_lut_t;
+
+typedef struct
+{
+    float               angle;      /* Rotation of the frame content w.r.t. the reference (degrees, [-180, 180)) */
+    float               scale;      /* Size of the frame content w.r.t. the reference */
+    float               lp_peak;    /* Log-polar correlation peak */
+    phase_corr_result_t shift;      /* Translation after derotation (reference pixels) */
+} fourier_mellin_result_t;
+
+typedef struct
+{
+    phase_corr_t          *pc;      /* n x n: magnitude spectra and translation pass */
+    phase_corr_t           lp;      /* m x m: log-polar correlation */
+    const log_polar_lut_t *lut;
+    uint8_t               *canvas;  /* n x n: frame resampled into the reference geometry */
+} fourier_mellin_t;
+
+int  LogPolar_Build(log_polar_lut_t *lut, uint32_t n, uint32_t m, log_polar_tap_t *taps);
+
+int  FourierMellin_Init(fourier_mellin_t *fm, phase_corr_t *pc, const log_polar_lut_t *lut,
+                        float *lp_a, float *lp_b, uint8_t *canvas);
+int  FourierMellin_Forward(fourier_mellin_t *fm, const image_t *img, float *lp_spectrum);
+int  FourierMellin_Estimate(fourier_mellin_t *fm, const image_t *frame, const float *ref_lp_spectrum,
+                            fourier_mellin_result_t *result);
+int  FourierMellin_Register(fourier_mellin_t *fm, const image_t *frame, const image_t *ref,
+                            fourier_mellin_result_t *result);
+int  FourierMellin_Run(fourier_mellin_t *fm, const image_t *frame, const image_t *ref,
+                       fourier_mellin_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FOURIER_MELLIN_H */
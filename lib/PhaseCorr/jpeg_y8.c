@@ -0,0 +1,520 @@
+#include "jpeg_y8.h"
+
+#include <string.h>
+
+/* Natural (row-major) index of the k-th coefficient in zigzag order */
+static const uint8_t jpeg_y8_zigzag[64] =
+{
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/* T.81 Table K.1, natural order */
+static const uint8_t jpeg_y8_luma_qt[64] =
+{
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+/* Scale of AAN output k, cos(k pi / 16) * sqrt(2) (1 for k = 0), times 2^14 */
+static const uint16_t jpeg_y8_aan_scale[8] =
+{
+    16384U, 22725U, 21407U, 19266U, 16384U, 12873U, 8867U, 4520U
+};
+
+/* T.81 K.3: luminance DC and AC tables, code counts per length 1..16, then symbols */
+static const uint8_t jpeg_y8_dc_bits[16] = { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 };
+static const uint8_t jpeg_y8_dc_vals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t jpeg_y8_ac_bits[16] = { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D };
+static const uint8_t jpeg_y8_ac_vals[162] =
+{
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA
+};
+
+/* jfdctfst.c constants: cosines times 2^8 */
+#define JPEG_Y8_FIX_0_382683433   98
+#define JPEG_Y8_FIX_0_541196100   139
+#define JPEG_Y8_FIX_0_707106781   181
+#define JPEG_Y8_FIX_1_306562965   334
+
+#define JPEG_Y8_MUL(v, c)         (((v) * (c)) >> 8)
+
+
+/* Hand the current buffer over and go on in the other one */
+static void JpegY8_Switch(jpeg_y8_t *e)
+{
+    if (!e->error && (e->sink.emit(e->sink.ctx, e->buf[e->cur], e->fill) != 0))
+    {
+        e->error = 1;
+    }
+
+    e->bytes += e->fill;
+    e->cur ^= 1U;
+    e->fill = 0U;
+
+    if (!e->error && (e->sink.reclaim != 0) && (e->sink.reclaim(e->sink.ctx, e->buf[e->cur]) != 0))
+    {
+        e->error = 1;
+    }
+}
+
+
+static inline void JpegY8_Byte(jpeg_y8_t *e, uint32_t b)
+{
+    e->buf[e->cur][e->fill++] = (uint8_t)b;
+
+    if (e->fill == e->size)
+    {
+        JpegY8_Switch(e);
+    }
+}
+
+
+/* Append the n (<= 16) low bits of v to the entropy-coded data, stuffing 0xFF */
+static inline void JpegY8_Put(jpeg_y8_t *e, uint32_t v, uint32_t n)
+{
+    e->acc = (e->acc << n) | v;
+    e->bits += n;
+
+    while (e->bits >= 8U)
+    {
+        const uint32_t b = (e->acc >> (e->bits - 8U)) & 0xFFU;
+
+        e->bits -= 8U;
+        JpegY8_Byte(e, b);
+
+        if (b == 0xFFU)
+        {
+            JpegY8_Byte(e, 0U);
+        }
+    }
+}
+
+
+static void JpegY8_Word(jpeg_y8_t *e, uint32_t w)
+{
+    JpegY8_Byte(e, w >> 8);
+    JpegY8_Byte(e, w & 0xFFU);
+}
+
+
+/* Length << 16 | code for each symbol of a T.81 table (Annex C) */
+static void JpegY8_BuildHuffman(uint32_t *table, const uint8_t *bits, const uint8_t *vals)
+{
+    uint32_t code = 0U;
+    uint32_t k = 0U;
+
+    for (uint32_t len = 1U; len <= 16U; len++)
+    {
+        for (uint32_t i = 0; i < bits[len - 1U]; i++)
+        {
+            table[vals[k++]] = (len << 16) | code++;
+        }
+
+        code <<= 1;
+    }
+}
+
+
+/*
+ * Build the tables for quality 1..100 (libjpeg scaling of the K.1 table)
+ * and take the output buffers, size bytes each.
+ */
+int JpegY8_Init(jpeg_y8_t *e, uint32_t quality, uint8_t *buf0, uint8_t *buf1, uint32_t size,
+                const jpeg_y8_sink_t *sink)
+{
+    uint32_t scale;
+
+    if ((e == 0) || (quality == 0U) || (quality > 100U) || (buf0 == 0) || (buf1 == 0) || (buf0 == buf1) ||
+        (size < JPEG_Y8_MIN_BUFFER) || (sink == 0) || (sink->emit == 0))
+    {
+        return JPEG_Y8_INVALID_PARAM;
+    }
+
+    memset(e, 0, sizeof(*e));
+
+    scale = (quality < 50U) ? (5000U / quality) : (200U - (2U * quality));
+
+    for (uint32_t k = 0; k < 64U; k++)
+    {
+        const uint32_t i = jpeg_y8_zigzag[k];
+        uint32_t q = ((jpeg_y8_luma_qt[i] * scale) + 50U) / 100U;
+        uint32_t d;
+
+        q = (q < 1U) ? 1U : ((q > 255U) ? 255U : q);
+        e->qt[k] = (uint8_t)q;
+
+        /* The AAN DCT leaves coefficient (u, v) scaled by 8 * scale[u] * scale[v] */
+        d = (jpeg_y8_aan_scale[i >> 3] * jpeg_y8_aan_scale[i & 7U] + 8192U) >> 14;
+        d = ((q * d) + 1024U) >> 11;
+        d = (d < 1U) ? 1U : d;
+
+        e->recip[i] = (uint32_t)((0x80000000ULL + d - 1U) / d);
+        e->half[i] = (uint16_t)(d >> 1);
+    }
+
+    JpegY8_BuildHuffman(e->dc_huff, jpeg_y8_dc_bits, jpeg_y8_dc_vals);
+    JpegY8_BuildHuffman(e->ac_huff, jpeg_y8_ac_bits, jpeg_y8_ac_vals);
+
+    e->sink = *sink;
+    e->buf[0] = buf0;
+    e->buf[1] = buf1;
+    e->size = size;
+
+    return JPEG_Y8_OK;
+}
+
+
+/* Start a w x h image: SOI, JFIF, DQT, SOF0, DHT, SOS */
+int JpegY8_Begin(jpeg_y8_t *e, uint32_t w, uint32_t h)
+{
+    if ((e == 0) || (w == 0U) || (h == 0U) || (w > 0xFFFFU) || (h > 0xFFFFU))
+    {
+        return JPEG_Y8_INVALID_PARAM;
+    }
+
+    e->w = w;
+    e->h = h;
+    e->y = 0U;
+    e->dc = 0;
+    e->acc = 0U;
+    e->bits = 0U;
+    e->bytes = 0U;
+    e->fill = 0U;
+    e->error = (e->sink.reclaim != 0) && (e->sink.reclaim(e->sink.ctx, e->buf[e->cur]) != 0);
+
+    /* SOI, APP0 JFIF 1.01 without thumbnail */
+    static const uint8_t head[20] =
+    {
+        0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01,
+        0x00, 0x00
+    };
+
+    for (uint32_t i = 0; i < sizeof(head); i++)
+    {
+        JpegY8_Byte(e, head[i]);
+    }
+
+    JpegY8_Word(e, 0xFFDBU);
+    JpegY8_Word(e, 67U);
+    JpegY8_Byte(e, 0U);
+
+    for (uint32_t k = 0; k < 64U; k++)
+    {
+        JpegY8_Byte(e, e->qt[k]);
+    }
+
+    /* SOF0: 8 bit, one component 1x1 on table 0 */
+    JpegY8_Word(e, 0xFFC0U);
+    JpegY8_Word(e, 11U);
+    JpegY8_Byte(e, 8U);
+    JpegY8_Word(e, h);
+    JpegY8_Word(e, w);
+    JpegY8_Byte(e, 1U);
+    JpegY8_Byte(e, 1U);
+    JpegY8_Byte(e, 0x11U);
+    JpegY8_Byte(e, 0U);
+
+    JpegY8_Word(e, 0xFFC4U);
+    JpegY8_Word(e, 2U + 1U + 16U + sizeof(jpeg_y8_dc_vals) + 1U + 16U + sizeof(jpeg_y8_ac_vals));
+    JpegY8_Byte(e, 0x00U);
+
+    for (uint32_t i = 0; i < 16U; i++)
+    {
+        JpegY8_Byte(e, jpeg_y8_dc_bits[i]);
+    }
+
+    for (uint32_t i = 0; i < sizeof(jpeg_y8_dc_vals); i++)
+    {
+        JpegY8_Byte(e, jpeg_y8_dc_vals[i]);
+    }
+
+    JpegY8_Byte(e, 0x10U);
+
+    for (uint32_t i = 0; i < 16U; i++)
+    {
+        JpegY8_Byte(e, jpeg_y8_ac_bits[i]);
+    }
+
+    for (uint32_t i = 0; i < sizeof(jpeg_y8_ac_vals); i++)
+    {
+        JpegY8_Byte(e, jpeg_y8_ac_vals[i]);
+    }
+
+    /* SOS: component 1, tables 0/0, spectral 0..63 */
+    JpegY8_Word(e, 0xFFDAU);
+    JpegY8_Word(e, 8U);
+    JpegY8_Byte(e, 1U);
+    JpegY8_Byte(e, 1U);
+    JpegY8_Byte(e, 0x00U);
+    JpegY8_Byte(e, 0U);
+    JpegY8_Byte(e, 63U);
+    JpegY8_Byte(e, 0U);
+
+    return e->error ? JPEG_Y8_ERROR : JPEG_Y8_OK;
+}
+
+
+/* jfdctfst.c: rows, then columns, in place */
+static void JpegY8_FDCT(int32_t *d)
+{
+    for (uint32_t pass = 0; pass < 2U; pass++)
+    {
+        const uint32_t step = (pass == 0U) ? 1U : 8U;
+        const uint32_t next = (pass == 0U) ? 8U : 1U;
+        int32_t *p = d;
+
+        for (uint32_t i = 0; i < 8U; i++, p += next)
+        {
+            const int32_t tmp0 = p[0] + p[7 * step];
+            const int32_t tmp7 = p[0] - p[7 * step];
+            const int32_t tmp1 = p[1 * step] + p[6 * step];
+            const int32_t tmp6 = p[1 * step] - p[6 * step];
+            const int32_t tmp2 = p[2 * step] + p[5 * step];
+            const int32_t tmp5 = p[2 * step] - p[5 * step];
+            const int32_t tmp3 = p[3 * step] + p[4 * step];
+            const int32_t tmp4 = p[3 * step] - p[4 * step];
+
+            /* Even part */
+            int32_t tmp10 = tmp0 + tmp3;
+            const int32_t tmp13 = tmp0 - tmp3;
+            int32_t tmp11 = tmp1 + tmp2;
+            int32_t tmp12 = tmp1 - tmp2;
+
+            p[0] = tmp10 + tmp11;
+            p[4 * step] = tmp10 - tmp11;
+
+            const int32_t z1 = JPEG_Y8_MUL(tmp12 + tmp13, JPEG_Y8_FIX_0_707106781);
+
+            p[2 * step] = tmp13 + z1;
+            p[6 * step] = tmp13 - z1;
+
+            /* Odd part */
+            tmp10 = tmp4 + tmp5;
+            tmp11 = tmp5 + tmp6;
+            tmp12 = tmp6 + tmp7;
+
+            const int32_t z5 = JPEG_Y8_MUL(tmp10 - tmp12, JPEG_Y8_FIX_0_382683433);
+            const int32_t z2 = JPEG_Y8_MUL(tmp10, JPEG_Y8_FIX_0_541196100) + z5;
+            const int32_t z4 = JPEG_Y8_MUL(tmp12, JPEG_Y8_FIX_1_306562965) + z5;
+            const int32_t z3 = JPEG_Y8_MUL(tmp11, JPEG_Y8_FIX_0_707106781);
+            const int32_t z11 = tmp7 + z3;
+            const int32_t z13 = tmp7 - z3;
+
+            p[5 * step] = z13 + z2;
+            p[3 * step] = z13 - z2;
+            p[1 * step] = z11 + z4;
+            p[7 * step] = z11 - z4;
+        }
+    }
+}
+
+
+/* Quantised coefficient i: round(x / divisor) */
+static inline int32_t JpegY8_Quant(const jpeg_y8_t *e, int32_t x, uint32_t i)
+{
+    const uint32_t a = (uint32_t)((x < 0) ? -x : x) + e->half[i];
+    const int32_t q = (int32_t)(((uint64_t)a * e->recip[i]) >> 31);
+
+    return (x < 0) ? -q : q;
+}
+
+
+/* Magnitude category of v, and v as the T.81 F.1.2.1 additional bits */
+static inline uint32_t JpegY8_Category(int32_t v, uint32_t *extra)
+{
+    const uint32_t a = (uint32_t)((v < 0) ? -v : v);
+    const uint32_t n = 32U - (uint32_t)__builtin_clz(a);
+
+    *extra = (uint32_t)((v < 0) ? (v - 1) : v) & ((1U << n) - 1U);
+
+    return n;
+}
+
+
+static void JpegY8_Block(jpeg_y8_t *e, int32_t *d)
+{
+    uint32_t extra, n, run = 0U;
+    int32_t v;
+
+    JpegY8_FDCT(d);
+
+    /* DC, as the difference to the previous block */
+    v = JpegY8_Quant(e, d[0], 0U);
+    const int32_t diff = v - e->dc;
+    e->dc = v;
+
+    n = (diff == 0) ? 0U : JpegY8_Category(diff, &extra);
+    JpegY8_Put(e, e->dc_huff[n] & 0xFFFFU, e->dc_huff[n] >> 16);
+
+    if (n != 0U)
+    {
+        JpegY8_Put(e, extra, n);
+    }
+
+    for (uint32_t k = 1; k < 64U; k++)
+    {
+        const uint32_t i = jpeg_y8_zigzag[k];
+
+        if ((v = JpegY8_Quant(e, d[i], i)) == 0)
+        {
+            run++;
+            continue;
+        }
+
+        while (run > 15U)
+        {
+            JpegY8_Put(e, e->ac_huff[0xF0] & 0xFFFFU, e->ac_huff[0xF0] >> 16);
+            run -= 16U;
+        }
+
+        n = JpegY8_Category(v, &extra);
+
+        const uint32_t code = e->ac_huff[(run << 4) | n];
+
+        JpegY8_Put(e, code & 0xFFFFU, code >> 16);
+        JpegY8_Put(e, extra, n);
+        run = 0U;
+    }
+
+    /* EOB */
+    if (run != 0U)
+    {
+        JpegY8_Put(e, e->ac_huff[0x00] & 0xFFFFU, e->ac_huff[0x00] >> 16);
+    }
+}
+
+
+/*
+ * Encode the next rows of the image, px pointing at the first of them:
+ * a multiple of 8, or the rest of the image.
+ */
+int JpegY8_EncodeRows(jpeg_y8_t *e, const uint8_t *px, uint32_t stride, uint32_t rows)
+{
+    const uint8_t *r[8];
+    int32_t d[64];
+
+    if ((e == 0) || (px == 0) || (stride < e->w) || (rows == 0U) || (rows > (e->h - e->y)) ||
+        (((rows % 8U) != 0U) && (rows != (e->h - e->y))))
+    {
+        return JPEG_Y8_INVALID_PARAM;
+    }
+
+    for (uint32_t band = 0; band < rows; band += 8U)
+    {
+        const uint32_t n = ((rows - band) < 8U) ? (rows - band) : 8U;
+
+        /* Rows below the image repeat its last one */
+        for (uint32_t y = 0; y < 8U; y++)
+        {
+            r[y] = &px[(band + ((y < n) ? y : (n - 1U))) * stride];
+        }
+
+        for (uint32_t x0 = 0; x0 < e->w; x0 += 8U)
+        {
+            if ((x0 + 8U) <= e->w)
+            {
+                for (uint32_t y = 0; y < 8U; y++)
+                {
+                    const uint8_t *s = &r[y][x0];
+                    int32_t *o = &d[y * 8U];
+
+                    o[0] = (int32_t)s[0] - 128;
+                    o[1] = (int32_t)s[1] - 128;
+                    o[2] = (int32_t)s[2] - 128;
+                    o[3] = (int32_t)s[3] - 128;
+                    o[4] = (int32_t)s[4] - 128;
+                    o[5] = (int32_t)s[5] - 128;
+                    o[6] = (int32_t)s[6] - 128;
+                    o[7] = (int32_t)s[7] - 128;
+                }
+            }
+            else
+            {
+                /* Columns right of the image repeat its last one */
+                for (uint32_t y = 0; y < 8U; y++)
+                {
+                    for (uint32_t x = 0; x < 8U; x++)
+                    {
+                        d[(y * 8U) + x] = (int32_t)r[y][((x0 + x) < e->w) ? (x0 + x) : (e->w - 1U)] - 128;
+                    }
+                }
+            }
+
+            JpegY8_Block(e, d);
+        }
+    }
+
+    e->y += rows;
+
+    return e->error ? JPEG_Y8_ERROR : JPEG_Y8_OK;
+}
+
+
+/* Pad the last byte with ones, write EOI and emit what is left; does not wait for it */
+int JpegY8_End(jpeg_y8_t *e)
+{
+    if ((e == 0) || (e->y != e->h))
+    {
+        return JPEG_Y8_INVALID_PARAM;
+    }
+
+    if (e->bits != 0U)
+    {
+        JpegY8_Put(e, (1U << (8U - e->bits)) - 1U, 8U - e->bits);
+    }
+
+    JpegY8_Word(e, 0xFFD9U);
+
+    if (e->fill != 0U)
+    {
+        if (!e->error && (e->sink.emit(e->sink.ctx, e->buf[e->cur], e->fill) != 0))
+        {
+            e->error = 1;
+        }
+
+        e->bytes += e->fill;
+        e->cur ^= 1U;
+        e->fill = 0U;
+    }
+
+    return e->error ? JPEG_Y8_ERROR : JPEG_Y8_OK;
+}
+
+
+/* A whole w x h frame, rows stride bytes apart; e->bytes is then its size */
+int JpegY8_EncodeFrame(jpeg_y8_t *e, const uint8_t *px, uint32_t w, uint32_t h, uint32_t stride)
+{
+    int res;
+
+    if ((res = JpegY8_Begin(e, w, h)) != JPEG_Y8_OK)
+    {
+        return res;
+    }
+
+    if ((res = JpegY8_EncodeRows(e, px, stride, h)) != JPEG_Y8_OK)
+    {
+        return res;
+    }
+
+    return JpegY8_End(e);
+}
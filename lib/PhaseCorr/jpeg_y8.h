@@ -0,0 +1,89 @@
+#ifndef __JPEG_Y8_H
+#define __JPEG_Y8_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Baseline JPEG encoder for Y8 (grayscale) camera frames.
+ *
+ * One component, 8x8 blocks, no subsampling or restart markers, the
+ * standard luminance Huffman tables (ITU T.81 Annex K.3) and the standard
+ * luminance quantisation table scaled for quality as libjpeg does. All
+ * tables are built once by JpegY8_Init(): the quantisation divisors with
+ * the scale factors of the DCT folded in, as 32-bit reciprocals, and the
+ * Huffman codes as (length, code) words. The forward DCT is the integer
+ * AAN one of libjpeg's jfdctfst.c (8-bit constants), so a block costs
+ * 5 multiplies per row and column and no divides.
+ *
+ * Encoding streams: JpegY8_Begin() writes the headers, JpegY8_EncodeRows()
+ * takes the frame an MCU row (8 pixel rows) at a time, or more, straight
+ * from the frame buffer, and JpegY8_End() closes the image. Nothing of
+ * frame size is allocated. Edge blocks repeat the last column and row.
+ *
+ * Output alternates between two caller buffers: a full one is handed to
+ * sink.emit() while the encoder goes on in the other, and is only filled
+ * again after sink.reclaim() returned for it. A sink writing synchronously
+ * leaves reclaim at 0; one that queues the buffer to a writer task waits
+ * there until the task is done with it. JpegY8_End() emits the last,
+ * partly filled buffer and does not wait for it.
+ */
+
+#define JPEG_Y8_MIN_BUFFER   64U        /* Bytes per output buffer */
+
+typedef enum
+{
+    JPEG_Y8_OK = 0,
+    JPEG_Y8_ERROR = -1,                 /* The sink failed */
+    JPEG_Y8_INVALID_PARAM = -2
+} JpegY8_Status;
+
+typedef struct
+{
+    int   (*emit)(void *ctx, const uint8_t *data, uint32_t len);   /* 0 = OK */
+    int   (*reclaim)(void *ctx, const uint8_t *data);              /* Optional: wait until data is free */
+    void  *ctx;
+} jpeg_y8_sink_t;
+
+typedef struct
+{
+    /* Tables */
+    uint8_t         qt[64];             /* Quantisation table, zigzag order (DQT) */
+    uint32_t        recip[64];          /* 2^31 / divisor, rounded up, natural order */
+    uint16_t        half[64];           /* divisor / 2 */
+    uint32_t        dc_huff[12];        /* Length << 16 | code */
+    uint32_t        ac_huff[256];
+
+    /* Image */
+    uint32_t        w;
+    uint32_t        h;
+    uint32_t        y;                  /* Rows encoded */
+    int32_t         dc;                 /* Previous DC */
+
+    /* Output */
+    jpeg_y8_sink_t  sink;
+    uint8_t        *buf[2];
+    uint32_t        size;
+    uint32_t        cur;
+    uint32_t        fill;
+    uint32_t        acc;                /* Bits, MSB first */
+    uint32_t        bits;
+    uint32_t        bytes;              /* Emitted for this image */
+    int             error;
+} jpeg_y8_t;
+
+int JpegY8_Init(jpeg_y8_t *e, uint32_t quality, uint8_t *buf0, uint8_t *buf1, uint32_t size,
+                const jpeg_y8_sink_t *sink);
+int JpegY8_Begin(jpeg_y8_t *e, uint32_t w, uint32_t h);
+int JpegY8_EncodeRows(jpeg_y8_t *e, const uint8_t *px, uint32_t stride, uint32_t rows);
+int JpegY8_End(jpeg_y8_t *e);
+int JpegY8_EncodeFrame(jpeg_y8_t *e, const uint8_t *px, uint32_t w, uint32_t h, uint32_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JPEG_Y8_H */
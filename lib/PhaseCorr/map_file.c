@@ -0,0 +1,248 @@
+#include "map_file.h"
+
+#include <string.h>
+
+#include "fft.h"
+#include "tile_codec.h"
+
+
+/* Returns 1 if the header describes a map this code can read */
+int MapFile_CheckHeader(const map_file_header_t *hdr)
+{
+    if ((hdr->magic != MAP_FILE_MAGIC) || (hdr->version == 0U) || (hdr->version > MAP_FILE_VERSION) ||
+        (hdr->levels == 0U) || (hdr->levels > MAP_FILE_MAX_LEVELS) ||
+        (hdr->tile == 0U) || (hdr->step == 0U) || (hdr->step > hdr->tile))
+    {
+        return 0;
+    }
+
+    if (((hdr->flags & MAP_FILE_SPECTRA) != 0U) &&
+        ((hdr->tile > FFT_MAX_N) || ((hdr->tile & (hdr->tile - 1U)) != 0U) ||
+         ((hdr->quant != SPECTRUM_QUANT_F32) && (hdr->quant != SPECTRUM_QUANT_Q15_PHASE))))
+    {
+        return 0;
+    }
+
+    const uint32_t record = MapFile_RecordBytes(hdr->tile, hdr->flags, (SpectrumTile_Quant)hdr->quant);
+
+    for (uint32_t l = 0; l < hdr->levels; l++)
+    {
+        const map_level_t *lv = &hdr->level[l];
+        const uint64_t end = (uint64_t)lv->data_offset + ((uint64_t)lv->cols * lv->rows * lv->record_bytes);
+
+        if ((lv->cols == 0U) || (lv->rows == 0U) || (lv->record_bytes != record) ||
+            ((lv->data_offset % MAP_FILE_ALIGN) != 0U) || (end > hdr->file_bytes))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+uint32_t MapFile_PixelBytes(uint32_t tile)
+{
+    return tile * tile;
+}
+
+
+/* Offset of the spectrum header inside a record */
+uint32_t MapFile_SpectrumOffset(uint32_t tile)
+{
+    return MAP_FILE_ALIGN_UP(MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(tile), 32U);
+}
+
+
+uint32_t MapFile_RecordBytes(uint32_t tile, uint32_t flags, SpectrumTile_Quant quant)
+{
+    uint32_t bytes = MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(tile);
+
+    if ((flags & MAP_FILE_SPECTRA) != 0U)
+    {
+        spectrum_tile_header_t sh;
+
+        SpectrumTile_InitHeader(&sh, tile, quant, 0, 0);
+        bytes = MapFile_SpectrumOffset(tile) + (uint32_t)sizeof(sh) + sh.data_bytes;
+    }
+
+    return MAP_FILE_ALIGN_UP(bytes, MAP_FILE_ALIGN);
+}
+
+
+/* File offset of tile (tx, ty) of level; the caller checks the indices */
+uint32_t MapFile_RecordOffset(const map_file_header_t *hdr, uint32_t level, uint32_t tx, uint32_t ty)
+{
+    const map_level_t *lv = &hdr->level[level];
+
+    return lv->data_offset + ((ty * (uint32_t)lv->cols) + tx) * lv->record_bytes;
+}
+
+
+/*
+ * Tile of level whose centre is nearest to level pixel (x, y). Returns 0 if
+ * (x, y) is outside the level; *tx, *ty are clamped to the grid either way.
+ */
+int MapFile_TileAt(const map_file_header_t *hdr, uint32_t level, int32_t x, int32_t y,
+                   uint32_t *tx, uint32_t *ty)
+{
+    const map_level_t *lv = &hdr->level[level];
+    const int32_t half = (int32_t)hdr->tile / 2;
+    const int32_t step = (int32_t)hdr->step;
+    int32_t i = (x - half + (step / 2));
+    int32_t j = (y - half + (step / 2));
+
+    /* Floor division, so that positions left of the first centre round to -1 */
+    i = (i >= 0) ? (i / step) : -(((-i) + step - 1) / step);
+    j = (j >= 0) ? (j / step) : -(((-j) + step - 1) / step);
+
+    *tx = (uint32_t)((i < 0) ? 0 : ((i >= (int32_t)lv->cols) ? ((int32_t)lv->cols - 1) : i));
+    *ty = (uint32_t)((j < 0) ? 0 : ((j >= (int32_t)lv->rows) ? ((int32_t)lv->rows - 1) : j));
+
+    return (x >= 0) && (y >= 0) && ((uint32_t)x < lv->width) && ((uint32_t)y < lv->height);
+}
+
+
+/* Geotransform of level: a level pixel covers 2^level level 0 pixels a side */
+void MapFile_LevelGeo(const map_file_header_t *hdr, uint32_t level, double geo[6])
+{
+    const double s = (double)(1UL << level);
+
+    geo[0] = hdr->geo[0];
+    geo[1] = hdr->geo[1] * s;
+    geo[2] = hdr->geo[2] * s;
+    geo[3] = hdr->geo[3];
+    geo[4] = hdr->geo[4] * s;
+    geo[5] = hdr->geo[5] * s;
+}
+
+
+void MapFile_PixelToGeo(const double geo[6], double x, double y, double *lon, double *lat)
+{
+    *lon = geo[0] + (x * geo[1]) + (y * geo[2]);
+    *lat = geo[3] + (x * geo[4]) + (y * geo[5]);
+}
+
+
+/* Inverse of MapFile_PixelToGeo(); MAP_FILE_INVALID_PARAM if geo is singular */
+int MapFile_GeoToPixel(const double geo[6], double lon, double lat, double *x, double *y)
+{
+    const double det = (geo[1] * geo[5]) - (geo[2] * geo[4]);
+    const double u = lon - geo[0];
+    const double v = lat - geo[3];
+
+    if (det == 0.0)
+    {
+        return MAP_FILE_INVALID_PARAM;
+    }
+
+    *x = ((u * geo[5]) - (v * geo[2])) / det;
+    *y = ((v * geo[1]) - (u * geo[4])) / det;
+
+    return MAP_FILE_OK;
+}
+
+
+/*
+ * Turn a record as stored (bytes of it at packed, from its start) into a
+ * plain record in record (record_bytes, may not overlap): header, pixels
+ * unpacked if MAP_TILE_PACKED, and whatever part of the spectrum is within
+ * bytes. The copied header loses MAP_TILE_PACKED. Plain records are copied.
+ */
+int MapFile_UnpackRecord(const map_file_header_t *hdr, const void *packed, uint32_t bytes, void *record)
+{
+    const map_tile_header_t *th = (const map_tile_header_t *)packed;
+    const uint8_t *src = (const uint8_t *)packed;
+    uint8_t *dst = (uint8_t *)record;
+    const uint32_t pixels = MapFile_PixelBytes(hdr->tile);
+
+    if ((packed == 0) || (record == 0) || (bytes < MAP_TILE_HEADER_BYTES))
+    {
+        return MAP_FILE_INVALID_PARAM;
+    }
+
+    if ((th->flags & MAP_TILE_PACKED) == 0U)
+    {
+        memcpy(record, packed, bytes);
+        return MAP_FILE_OK;
+    }
+
+    if ((th->packed_bytes >= pixels) || (bytes < (MAP_TILE_HEADER_BYTES + th->packed_bytes)))
+    {
+        return MAP_FILE_BAD_FILE;
+    }
+
+    if (TileCodec_DecodeBuffer(&src[MAP_TILE_HEADER_BYTES], th->packed_bytes,
+                               &dst[MAP_TILE_HEADER_BYTES], hdr->tile, hdr->tile) != TILE_CODEC_OK)
+    {
+        return MAP_FILE_BAD_FILE;
+    }
+
+    memcpy(dst, src, MAP_TILE_HEADER_BYTES);
+    ((map_tile_header_t *)record)->flags &= (uint16_t)~MAP_TILE_PACKED;
+
+    if (bytes > MapFile_SpectrumOffset(hdr->tile))
+    {
+        const uint32_t so = MapFile_SpectrumOffset(hdr->tile);
+
+        memcpy(&dst[so], &src[so], bytes - so);
+    }
+
+    return MAP_FILE_OK;
+}
+
+
+/*
+ * Check a tile record read into memory (the first bytes of it at least:
+ * without the spectrum part the view simply has no spectrum) and point view
+ * at its parts. record must stay valid while view is used. Packed records
+ * are rejected (MAP_FILE_BAD_FILE): unpack them first.
+ */
+int MapFile_ParseRecord(const map_file_header_t *hdr, uint32_t level, uint32_t tx, uint32_t ty,
+                        const void *record, uint32_t bytes, map_tile_view_t *view)
+{
+    const uint8_t *p = (const uint8_t *)record;
+    const map_tile_header_t *th = (const map_tile_header_t *)record;
+    const uint32_t tile = hdr->tile;
+
+    if ((record == 0) || (view == 0) || (bytes < (MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(tile))))
+    {
+        return MAP_FILE_INVALID_PARAM;
+    }
+
+    if ((th->magic != MAP_TILE_MAGIC) || (th->level != level) || (th->tx != tx) || (th->ty != ty) ||
+        ((th->flags & MAP_TILE_PACKED) != 0U))
+    {
+        return MAP_FILE_BAD_FILE;
+    }
+
+    view->hdr = th;
+    view->image.w = (int)tile;
+    view->image.h = (int)tile;
+    view->image.bpp = IMAGE_BPP_GRAYSCALE;
+    view->image.pixels = (uint8_t *)&p[MAP_TILE_HEADER_BYTES];
+    view->spectrum = 0;
+    view->payload = 0;
+
+    if ((th->flags & MAP_TILE_SPECTRUM) != 0U)
+    {
+        const uint32_t so = MapFile_SpectrumOffset(tile);
+        const spectrum_tile_header_t *sh = (const spectrum_tile_header_t *)&p[so];
+
+        if (bytes >= (so + (uint32_t)sizeof(*sh)))
+        {
+            if (!SpectrumTile_CheckHeader(sh) || (sh->n != tile))
+            {
+                return MAP_FILE_BAD_FILE;
+            }
+
+            if (bytes >= (so + (uint32_t)sizeof(*sh) + sh->data_bytes))
+            {
+                view->spectrum = sh;
+                view->payload = &p[so + sizeof(*sh)];
+            }
+        }
+    }
+
+    return MAP_FILE_OK;
+}
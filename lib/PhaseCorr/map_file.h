@@ -0,0 +1,158 @@
+#ifndef __MAP_FILE_H
+#define __MAP_FILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "imlib.h"
+#include "spectrum_tile.h"
+
+/*
+ * Tiled, pyramidal reference map container (.MAP file).
+ *
+ * The mosaic and its 2x2 mean-pooled levels (as Pyramid_Build()) are cut
+ * into fixed-size Y8 tiles, tile x tile pixels every step pixels (step <
+ * tile gives overlapping tiles, as the correlator wants). Tiles are stored
+ * level by level in row-major order as fixed-size records, so the offset of
+ * any tile follows from the header alone (MapFile_RecordOffset()) and a
+ * reader fetches it with one seek and one contiguous read, without looking
+ * anything up in the file.
+ *
+ * File layout (little endian, every block aligned to MAP_FILE_ALIGN bytes so
+ * that FatFs reads whole sectors straight into the caller's buffer):
+ *   map_file_header_t, with the level table          MAP_FILE_ALIGN bytes
+ *   per level: tile index, cols * rows map_tile_entry_t
+ *   per level: cols * rows tile records of record_bytes each:
+ *     map_tile_header_t                               MAP_TILE_HEADER_BYTES
+ *     tile * tile Y8 pixels, or packed_bytes of them compressed
+ *     optional spectrum (MAP_FILE_SPECTRA): spectrum_tile_header_t and
+ *     its payload as in a .SPT file, 32-byte aligned
+ *
+ * Georeferencing uses the GDAL affine convention on pixel corners:
+ *   lon = geo[0] + x * geo[1] + y * geo[2]
+ *   lat = geo[3] + x * geo[4] + y * geo[5]
+ * The header holds the transform of level 0; every tile record carries its
+ * own, for its tile pixels, so that a tile read on its own is complete.
+ *
+ * The index gives the mean and contrast of every tile, so featureless
+ * tiles (water, fields) can be skipped without reading them. Tiles along
+ * the right and bottom edge are padded with the mean of their valid part
+ * and flagged MAP_TILE_PARTIAL.
+ *
+ * In a MAP_FILE_PACKED map the pixels of every tile that compresses are
+ * stored losslessly packed (tile_codec.h) and the tile is flagged
+ * MAP_TILE_PACKED. Records keep their size and place, so a tile is still
+ * found from the header alone, but a reader only has to fetch the header
+ * and packed_bytes (plus the spectrum, if wanted): typically half the
+ * sectors or fewer. MapFile_ParseRecord() takes plain records only; see
+ * MapFile_UnpackRecord().
+ */
+
+#define MAP_FILE_MAGIC           0x50414D50UL      /* "PMAP" */
+#define MAP_FILE_VERSION         2U         /* Version 1: no MAP_FILE_PACKED */
+#define MAP_TILE_MAGIC           0x4C495450UL      /* "PTIL" */
+
+#ifndef MAP_FILE_MAX_LEVELS
+#define MAP_FILE_MAX_LEVELS      8U
+#endif
+
+#define MAP_FILE_ALIGN           512U
+#define MAP_TILE_HEADER_BYTES    96U
+
+#define MAP_FILE_ALIGN_UP(v, a)  ((((uint32_t)(v)) + ((a) - 1U)) & ~((uint32_t)(a) - 1U))
+
+typedef enum
+{
+    MAP_FILE_OK = 0,
+    MAP_FILE_ERROR = -1,
+    MAP_FILE_INVALID_PARAM = -2,
+    MAP_FILE_BAD_FILE = -3
+} MapFile_Status;
+
+/* map_file_header_t::flags */
+#define MAP_FILE_SPECTRA         0x01U     /* Tile records carry a spectrum */
+#define MAP_FILE_PACKED          0x02U     /* Tile pixels may be compressed */
+
+/* map_tile_entry_t::flags, map_tile_header_t::flags */
+#define MAP_TILE_PARTIAL         0x01U     /* Crosses the map edge, padded */
+#define MAP_TILE_SPECTRUM        0x02U     /* Record carries a spectrum */
+#define MAP_TILE_PACKED          0x04U     /* Pixels compressed, packed_bytes long */
+
+typedef struct __attribute__((packed))
+{
+    uint32_t width;             /* Level size in pixels */
+    uint32_t height;
+    uint16_t cols;              /* Tiles per row / column */
+    uint16_t rows;
+    uint32_t index_offset;      /* File offset of the cols * rows map_tile_entry_t */
+    uint32_t data_offset;       /* File offset of the first tile record */
+    uint32_t record_bytes;      /* Size of one tile record, MAP_FILE_ALIGN multiple */
+} map_level_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t    magic;
+    uint16_t    version;
+    uint16_t    levels;
+    uint16_t    tile;           /* Tile size in pixels */
+    uint16_t    step;           /* Tile spacing in pixels, <= tile */
+    uint8_t     flags;          /* MAP_FILE_* */
+    uint8_t     quant;          /* SpectrumTile_Quant of the spectra */
+    uint16_t    reserved;
+    uint32_t    file_bytes;
+    double      geo[6];         /* Level 0 pixel to lon/lat */
+    map_level_t level[MAP_FILE_MAX_LEVELS];
+} map_file_header_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t flags;              /* MAP_TILE_* */
+    uint8_t mean;               /* Of the valid pixels */
+    uint8_t contrast;           /* Standard deviation of the valid pixels, saturated */
+    uint8_t reserved;
+} map_tile_entry_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t level;
+    uint16_t flags;             /* MAP_TILE_* */
+    uint16_t tx;
+    uint16_t ty;
+    int32_t  origin_x;          /* Top-left corner in level pixels */
+    int32_t  origin_y;
+    double   geo[6];            /* Tile pixel to lon/lat */
+    uint32_t packed_bytes;      /* MAP_TILE_PACKED: size of the packed pixels */
+} map_tile_header_t;
+
+/* A tile record in memory, as returned by MapFile_ParseRecord() */
+typedef struct
+{
+    const map_tile_header_t      *hdr;
+    image_t                       image;        /* tile x tile Y8, inside the record */
+    const spectrum_tile_header_t *spectrum;     /* NULL if the record has none (or was not read) */
+    const void                   *payload;      /* Spectrum payload */
+} map_tile_view_t;
+
+int      MapFile_CheckHeader(const map_file_header_t *hdr);
+uint32_t MapFile_PixelBytes(uint32_t tile);
+uint32_t MapFile_SpectrumOffset(uint32_t tile);
+uint32_t MapFile_RecordBytes(uint32_t tile, uint32_t flags, SpectrumTile_Quant quant);
+uint32_t MapFile_RecordOffset(const map_file_header_t *hdr, uint32_t level, uint32_t tx, uint32_t ty);
+int      MapFile_TileAt(const map_file_header_t *hdr, uint32_t level, int32_t x, int32_t y,
+                        uint32_t *tx, uint32_t *ty);
+void     MapFile_LevelGeo(const map_file_header_t *hdr, uint32_t level, double geo[6]);
+void     MapFile_PixelToGeo(const double geo[6], double x, double y, double *lon, double *lat);
+int      MapFile_GeoToPixel(const double geo[6], double lon, double lat, double *x, double *y);
+int      MapFile_UnpackRecord(const map_file_header_t *hdr, const void *packed, uint32_t bytes, void *record);
+int      MapFile_ParseRecord(const map_file_header_t *hdr, uint32_t level, uint32_t tx, uint32_t ty,
+                             const void *record, uint32_t bytes, map_tile_view_t *view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAP_FILE_H */
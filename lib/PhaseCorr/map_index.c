@@ -0,0 +1,305 @@
+#include "map_index.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/* Bit of tile (x, y) inside its 8 x 8 block: x and y bits interleaved */
+static uint32_t MapIndex_Morton(uint32_t x, uint32_t y)
+{
+    return  (x & 1U)        | ((y & 1U) << 1) |
+           ((x & 2U) << 1)  | ((y & 2U) << 2) |
+           ((x & 4U) << 2)  | ((y & 4U) << 3);
+}
+
+
+/* Bits of column x / row y of a block */
+static const uint64_t map_index_column[MAP_INDEX_BLOCK] = {
+    0x0000050500000505ULL, 0x00000A0A00000A0AULL, 0x0000505000005050ULL, 0x0000A0A00000A0A0ULL,
+    0x0505000005050000ULL, 0x0A0A00000A0A0000ULL, 0x5050000050500000ULL, 0xA0A00000A0A00000ULL
+};
+
+static const uint64_t map_index_row[MAP_INDEX_BLOCK] = {
+    0x0000000000330033ULL, 0x0000000000CC00CCULL, 0x0000000033003300ULL, 0x00000000CC00CC00ULL,
+    0x0033003300000000ULL, 0x00CC00CC00000000ULL, 0x3300330000000000ULL, 0xCC00CC0000000000ULL
+};
+
+
+/* Bits of the lines a..b of a block, lines one of the tables above */
+static uint64_t MapIndex_Span(const uint64_t *lines, uint32_t a, uint32_t b)
+{
+    uint64_t mask = 0U;
+
+    for (uint32_t i = a; i <= b; i++)
+    {
+        mask |= lines[i];
+    }
+
+    return mask;
+}
+
+
+/* x of Morton bit m inside its block (y: MapIndex_MortonX(m >> 1)) */
+static uint32_t MapIndex_MortonX(uint32_t m)
+{
+    return (m & 1U) | ((m >> 1) & 2U) | ((m >> 2) & 4U);
+}
+
+
+static uint32_t MapIndex_Blocks(uint32_t tiles)
+{
+    return (tiles + MAP_INDEX_BLOCK - 1U) / MAP_INDEX_BLOCK;
+}
+
+
+/* Bitmap bytes for all levels of the map */
+uint32_t MapIndex_Bytes(const map_file_header_t *hdr)
+{
+    uint32_t words = 0U;
+
+    for (uint32_t l = 0; l < hdr->levels; l++)
+    {
+        words += MapIndex_Blocks(hdr->level[l].cols) * MapIndex_Blocks(hdr->level[l].rows);
+    }
+
+    return words * (uint32_t)sizeof(uint64_t);
+}
+
+
+/* Empty index (no usable tile) over bits, MapIndex_Bytes() bytes */
+int MapIndex_Init(map_index_t *idx, const map_file_header_t *hdr, uint64_t *bits, uint32_t bytes)
+{
+    if ((idx == 0) || (hdr == 0) || (bits == 0) || (bytes < MapIndex_Bytes(hdr)))
+    {
+        return MAP_INDEX_INVALID_PARAM;
+    }
+
+    memset(idx, 0, sizeof(*idx));
+    memset(bits, 0, MapIndex_Bytes(hdr));
+
+    idx->levels = hdr->levels;
+    idx->tile = hdr->tile;
+    idx->step = hdr->step;
+
+    for (uint32_t l = 0; l < hdr->levels; l++)
+    {
+        map_index_level_t *lv = &idx->level[l];
+
+        lv->cols = hdr->level[l].cols;
+        lv->rows = hdr->level[l].rows;
+        lv->bcols = (uint16_t)MapIndex_Blocks(lv->cols);
+        lv->brows = (uint16_t)MapIndex_Blocks(lv->rows);
+        lv->bits = bits;
+        bits += (uint32_t)lv->bcols * lv->brows;
+    }
+
+    return MAP_INDEX_OK;
+}
+
+
+void MapIndex_Set(map_index_t *idx, uint32_t level, uint32_t tx, uint32_t ty, int usable)
+{
+    map_index_level_t *lv = &idx->level[level];
+    uint64_t *word = &lv->bits[(ty / MAP_INDEX_BLOCK) * lv->bcols + (tx / MAP_INDEX_BLOCK)];
+    const uint64_t bit = 1ULL << MapIndex_Morton(tx, ty);
+
+    *word = usable ? (*word | bit) : (*word & ~bit);
+}
+
+
+int MapIndex_Test(const map_index_t *idx, uint32_t level, uint32_t tx, uint32_t ty)
+{
+    const map_index_level_t *lv = &idx->level[level];
+
+    if ((tx >= lv->cols) || (ty >= lv->rows))
+    {
+        return 0;
+    }
+
+    return (int)((lv->bits[(ty / MAP_INDEX_BLOCK) * lv->bcols + (tx / MAP_INDEX_BLOCK)] >>
+                  MapIndex_Morton(tx, ty)) & 1U);
+}
+
+
+/*
+ * Mark the tiles described by count entries of the map's tile index of
+ * level, starting at row-major tile number first. Tiles with a contrast
+ * below min_contrast are left out.
+ */
+void MapIndex_AddEntries(map_index_t *idx, uint32_t level, uint32_t first,
+                         const map_tile_entry_t *entries, uint32_t count, uint8_t min_contrast)
+{
+    const uint32_t cols = idx->level[level].cols;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint32_t t = first + i;
+
+        MapIndex_Set(idx, level, t % cols, t / cols, entries[i].contrast >= min_contrast);
+    }
+}
+
+
+/* Restore the max-heap on dist of out[0 .. count) below entry i */
+static void MapIndex_SiftDown(map_tile_ref_t *out, uint32_t count, uint32_t i)
+{
+    const map_tile_ref_t r = out[i];
+
+    for (uint32_t c = (2U * i) + 1U; c < count; c = (2U * i) + 1U)
+    {
+        c += (((c + 1U) < count) && (out[c + 1U].dist > out[c].dist)) ? 1U : 0U;
+
+        if (out[c].dist <= r.dist)
+        {
+            break;
+        }
+
+        out[i] = out[c];
+        i = c;
+    }
+
+    out[i] = r;
+}
+
+
+static void MapIndex_Heapify(map_tile_ref_t *out, uint32_t count)
+{
+    for (uint32_t i = count / 2U; i > 0U; i--)
+    {
+        MapIndex_SiftDown(out, count, i - 1U);
+    }
+}
+
+
+/*
+ * Keep r among the max nearest hits in out (count of them): appended
+ * unordered until out is full, then out is a max-heap on dist and r only
+ * replaces its farthest entry. O(log max) a hit instead of O(max).
+ */
+static uint32_t MapIndex_Keep(map_tile_ref_t *out, uint32_t count, uint32_t max, const map_tile_ref_t *r)
+{
+    if (count < max)
+    {
+        out[count++] = *r;
+
+        if (count == max)
+        {
+            MapIndex_Heapify(out, count);
+        }
+    }
+    else if ((max != 0U) && (r->dist < out[0].dist))
+    {
+        out[0] = *r;
+        MapIndex_SiftDown(out, count, 0U);
+    }
+
+    return count;
+}
+
+
+/* Nearest first: heap sort of the hits kept, then squared distances to distances */
+static void MapIndex_Sort(map_tile_ref_t *out, uint32_t count, uint32_t max)
+{
+    if (count < max)
+    {
+        MapIndex_Heapify(out, count);
+    }
+
+    for (uint32_t n = count; n > 1U; n--)
+    {
+        const map_tile_ref_t r = out[0];
+
+        out[0] = out[n - 1U];
+        out[n - 1U] = r;
+        MapIndex_SiftDown(out, n - 1U, 0U);
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        out[i].dist = sqrtf(out[i].dist);
+    }
+}
+
+
+/*
+ * Usable tiles of level whose rectangle intersects the circle of radius
+ * around (cx, cy), all in level pixels. Up to max of them, nearest tile
+ * centre first, go to out; returns how many were stored.
+ */
+uint32_t MapIndex_Query(const map_index_t *idx, uint32_t level, float cx, float cy, float radius,
+                        map_tile_ref_t *out, uint32_t max)
+{
+    const map_index_level_t *lv = &idx->level[level];
+    const float step = (float)idx->step;
+    const float tile = (float)idx->tile;
+    const float r2 = radius * radius;
+    uint32_t count = 0U;
+
+    /* Tiles i with i * step <= cx + r and i * step + tile > cx - r */
+    int32_t i0 = (int32_t)floorf((cx - radius - tile) / step) + 1;
+    int32_t i1 = (int32_t)floorf((cx + radius) / step);
+    int32_t j0 = (int32_t)floorf((cy - radius - tile) / step) + 1;
+    int32_t j1 = (int32_t)floorf((cy + radius) / step);
+
+    i0 = (i0 < 0) ? 0 : i0;
+    j0 = (j0 < 0) ? 0 : j0;
+    i1 = (i1 >= (int32_t)lv->cols) ? ((int32_t)lv->cols - 1) : i1;
+    j1 = (j1 >= (int32_t)lv->rows) ? ((int32_t)lv->rows - 1) : j1;
+
+    if ((i0 > i1) || (j0 > j1))
+    {
+        return 0U;
+    }
+
+    for (uint32_t bj = (uint32_t)j0 / MAP_INDEX_BLOCK; bj <= (uint32_t)j1 / MAP_INDEX_BLOCK; bj++)
+    {
+        for (uint32_t bi = (uint32_t)i0 / MAP_INDEX_BLOCK; bi <= (uint32_t)i1 / MAP_INDEX_BLOCK; bi++)
+        {
+            const uint64_t word = lv->bits[bj * lv->bcols + bi];
+
+            if (word == 0U)
+            {
+                continue;
+            }
+
+            const uint32_t ya = ((bj * MAP_INDEX_BLOCK) > (uint32_t)j0) ? (bj * MAP_INDEX_BLOCK) : (uint32_t)j0;
+            const uint32_t yb = (((bj + 1U) * MAP_INDEX_BLOCK - 1U) < (uint32_t)j1) ?
+                                ((bj + 1U) * MAP_INDEX_BLOCK - 1U) : (uint32_t)j1;
+            const uint32_t xa = ((bi * MAP_INDEX_BLOCK) > (uint32_t)i0) ? (bi * MAP_INDEX_BLOCK) : (uint32_t)i0;
+            const uint32_t xb = (((bi + 1U) * MAP_INDEX_BLOCK - 1U) < (uint32_t)i1) ?
+                                ((bi + 1U) * MAP_INDEX_BLOCK - 1U) : (uint32_t)i1;
+
+            /* Only the usable tiles of the block within the bounds: those bits, lowest first */
+            const uint64_t span = MapIndex_Span(map_index_column, xa % MAP_INDEX_BLOCK, xb % MAP_INDEX_BLOCK) &
+                                  MapIndex_Span(map_index_row, ya % MAP_INDEX_BLOCK, yb % MAP_INDEX_BLOCK);
+
+            for (uint64_t left = word & span; left != 0U; left &= left - 1U)
+            {
+                const uint32_t m = (uint32_t)__builtin_ctzll(left);
+                const uint32_t tx = (bi * MAP_INDEX_BLOCK) + MapIndex_MortonX(m);
+                const uint32_t ty = (bj * MAP_INDEX_BLOCK) + MapIndex_MortonX(m >> 1);
+
+                /* Nearest point of the tile rectangle to the centre */
+                const float x0 = (float)tx * step;
+                const float y0 = (float)ty * step;
+                const float nx = (cx < x0) ? x0 : ((cx > (x0 + tile)) ? (x0 + tile) : cx);
+                const float ny = (cy < y0) ? y0 : ((cy > (y0 + tile)) ? (y0 + tile) : cy);
+                const float dx = nx - cx;
+                const float dy = ny - cy;
+
+                if (((dx * dx) + (dy * dy)) <= r2)
+                {
+                    const float ex = x0 + (0.5f * tile) - cx;
+                    const float ey = y0 + (0.5f * tile) - cy;
+                    const map_tile_ref_t ref = { (uint16_t)tx, (uint16_t)ty, (ex * ex) + (ey * ey) };
+
+                    count = MapIndex_Keep(out, count, max, &ref);
+                }
+            }
+        }
+    }
+
+    MapIndex_Sort(out, count, max);
+
+    return count;
+}
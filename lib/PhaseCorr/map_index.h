@@ -0,0 +1,77 @@
+#ifndef __MAP_INDEX_H
+#define __MAP_INDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "map_file.h"
+
+/*
+ * In-RAM spatial index of the usable tiles of a .MAP reference map.
+ *
+ * The map is a full grid of tiles (map_file.h), so finding the tiles near a
+ * position is arithmetic; what needs indexing is which of them are worth
+ * correlating (present and with enough contrast, per the map's tile index).
+ * That is kept as one bit per tile: the grid of each level is split into
+ * 8 x 8 tile blocks, each block one 64-bit word with its tiles in Morton
+ * (Z) order, blocks row-major. A query visits only the blocks overlapping
+ * the search circle, skips empty blocks with a single test, and within a
+ * block walks the set bits inside the search bounds, testing the circle
+ * against each of those tile rectangles. Hits beyond the max asked for are
+ * kept out with a heap, and the result is sorted once at the end.
+ *
+ * About one bit per tile: a 100k-tile map fits in ~13 KB, so the whole
+ * index is loaded at boot (from the map's tile index, see
+ * MapSD_LoadIndex()) and queries never touch the card.
+ */
+
+#define MAP_INDEX_BLOCK          8U
+
+typedef enum
+{
+    MAP_INDEX_OK = 0,
+    MAP_INDEX_ERROR = -1,
+    MAP_INDEX_INVALID_PARAM = -2
+} MapIndex_Status;
+
+typedef struct
+{
+    uint16_t tx;
+    uint16_t ty;
+    float    dist;              /* Tile centre to query centre (level pixels) */
+} map_tile_ref_t;
+
+typedef struct
+{
+    uint16_t  cols;             /* Tiles */
+    uint16_t  rows;
+    uint16_t  bcols;            /* Blocks */
+    uint16_t  brows;
+    uint64_t *bits;             /* bcols * brows words */
+} map_index_level_t;
+
+typedef struct
+{
+    uint32_t          levels;
+    uint32_t          tile;
+    uint32_t          step;
+    map_index_level_t level[MAP_FILE_MAX_LEVELS];
+} map_index_t;
+
+uint32_t MapIndex_Bytes(const map_file_header_t *hdr);
+int      MapIndex_Init(map_index_t *idx, const map_file_header_t *hdr, uint64_t *bits, uint32_t bytes);
+void     MapIndex_Set(map_index_t *idx, uint32_t level, uint32_t tx, uint32_t ty, int usable);
+int      MapIndex_Test(const map_index_t *idx, uint32_t level, uint32_t tx, uint32_t ty);
+void     MapIndex_AddEntries(map_index_t *idx, uint32_t level, uint32_t first,
+                             const map_tile_entry_t *entries, uint32_t count, uint8_t min_contrast);
+uint32_t MapIndex_Query(const map_index_t *idx, uint32_t level, float cx, float cy, float radius,
+                        map_tile_ref_t *out, uint32_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAP_INDEX_H */
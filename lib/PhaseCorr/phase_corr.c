@@ -0,0 +1,626 @@
+#include "phase_corr.h"
+
+#include <float.h>
+#include <math.h>
+
+#define PHASE_CORR_EPS     1e-9f
+#define PHASE_CORR_PI      3.14159265358979323846
+
+/* The upsampled refinement keeps its kernel table and row pass in pc->col */
+#if (2U * (2U * ((3U * PHASE_CORR_UPSAMPLE) / 4U) + 1U) * (2U * PHASE_CORR_UPSAMPLE_RADIUS + 1U)) > (2U * FFT_MAX_N)
+#error "PHASE_CORR_UPSAMPLE / PHASE_CORR_UPSAMPLE_RADIUS too large for the column scratch"
+#endif
+
+
+static int PhaseCorr_CheckImage(const phase_corr_t *pc, const image_t *img)
+{
+    if ((img == 0) || (img->pixels == 0) || (img->bpp != IMAGE_BPP_GRAYSCALE))
+    {
+        return 0;
+    }
+
+    return ((uint32_t)img->w >= pc->n) && ((uint32_t)img->h >= pc->n);
+}
+
+
+/* img holds the centred (n * pool)^2 crop */
+static int PhaseCorr_CheckPooled(const phase_corr_t *pc, const image_t *img, uint32_t pool)
+{
+    return (pc != 0) && (pool != 0U) && (img != 0) && (img->pixels != 0) && (img->bpp == IMAGE_BPP_GRAYSCALE) &&
+           ((uint32_t)img->w >= (pc->n * pool)) && ((uint32_t)img->h >= (pc->n * pool));
+}
+
+
+/* Sum of the pool x pool block at p */
+static inline uint32_t PhaseCorr_BlockSum(const uint8_t *p, uint32_t stride, uint32_t pool)
+{
+    uint32_t sum = 0U;
+
+    for (uint32_t j = 0; j < pool; j++)
+    {
+        for (uint32_t i = 0; i < pool; i++)
+        {
+            sum += p[j * stride + i];
+        }
+    }
+
+    return sum;
+}
+
+
+/*
+ * Fused FFT input kernel: reads the centred (n * pool)^2 crop of a Y8 image
+ * (the whole image if it is exactly that size), averages pool x pool blocks,
+ * applies the separable window and writes the floats straight into the
+ * half-spectrum row layout of dst. One pass over the pixels, no
+ * intermediate image.
+ *
+ * With PHASE_CORR_LAYOUT_BITREV each sample pair is scattered to its
+ * bit-reversed slot (FFT_BITREV_PAIR()) so that FFT_Real2DBitRev() can skip
+ * the row permutations. Only window rows row0 .. row0 + rows - 1 are
+ * loaded; arguments are checked by the callers.
+ */
+static void PhaseCorr_LoadRows(const phase_corr_t *pc, const image_t *img, uint32_t pool,
+                               PhaseCorr_Layout layout, float *dst, uint32_t row0, uint32_t rows)
+{
+    const uint32_t n = pc->n;
+    const uint32_t w = (uint32_t)img->w;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+    const uint32_t x0 = (w - (n * pool)) / 2U;
+    const uint32_t y0 = ((uint32_t)img->h - (n * pool)) / 2U;
+    const float scale = 1.0f / (float)(pool * pool);
+    const int bitrev = (layout == PHASE_CORR_LAYOUT_BITREV);
+
+    for (uint32_t y = row0; y < (row0 + rows); y++)
+    {
+        const uint8_t *row = &img->pixels[(y0 + (y * pool)) * w + x0];
+        const float wy = pc->window[y] * scale;
+        float *out = &dst[y * stride];
+
+        for (uint32_t k = 0; k < (n / 2U); k++)
+        {
+            const uint32_t j = bitrev ? FFT_BITREV_PAIR(&pc->plan, k) : k;
+            uint32_t a;
+            uint32_t b;
+
+            if (pool == 1U)
+            {
+                a = row[2U * k];
+                b = row[2U * k + 1U];
+            }
+            else
+            {
+                a = PhaseCorr_BlockSum(&row[(2U * k) * pool], w, pool);
+                b = PhaseCorr_BlockSum(&row[(2U * k + 1U) * pool], w, pool);
+            }
+
+            out[2U * j]      = (float)a * wy * pc->window[2U * k];
+            out[2U * j + 1U] = (float)b * wy * pc->window[2U * k + 1U];
+        }
+    }
+}
+
+
+/* All n rows of the fused kernel above */
+int PhaseCorr_LoadWindowed(const phase_corr_t *pc, const image_t *img, uint32_t pool,
+                           PhaseCorr_Layout layout, float *dst)
+{
+    if (!PhaseCorr_CheckPooled(pc, img, pool) || (dst == 0))
+    {
+        return PHASE_CORR_INVALID_PARAM;
+    }
+
+    PhaseCorr_LoadRows(pc, img, pool, layout, dst, 0U, pc->n);
+
+    return PHASE_CORR_OK;
+}
+
+
+int PhaseCorr_Init(phase_corr_t *pc, uint32_t n, float *work_a, float *work_b)
+{
+    if ((pc == 0) || (work_a == 0))
+    {
+        return PHASE_CORR_INVALID_PARAM;
+    }
+
+    if (FFT_Init(&pc->plan, n) != 0)
+    {
+        return PHASE_CORR_INVALID_PARAM;
+    }
+
+    pc->n = n;
+    pc->work_a = work_a;
+    pc->work_b = work_b;
+    pc->min_psr = 0.0f;
+    pc->subpixel = PHASE_CORR_SUBPIXEL_PARABOLIC;
+
+    /* np.sqrt(np.outer(h, h)) == outer(sqrt(h), sqrt(h)) */
+    for (uint32_t i = 0; i < n; i++)
+    {
+        double h = 0.54 - 0.46 * cos(2.0 * PHASE_CORR_PI * (double)i / (double)(n - 1U));
+
+        pc->window[i] = (float)sqrt(h);
+    }
+
+    return PHASE_CORR_OK;
+}
+
+
+/*
+ * Windowed real 2D transform of the centred n x n crop of img into spectrum
+ * (PHASE_CORR_WORK_FLOATS(n) floats).
+ */
+int PhaseCorr_Forward(phase_corr_t *pc, const image_t *img, float *spectrum)
+{
+    return PhaseCorr_ForwardPooled(pc, img, 1U, spectrum);
+}
+
+
+/*
+ * As PhaseCorr_Forward(), on the centred (n * pool)^2 crop of img averaged
+ * down to n x n, read directly from img (e.g. the DCMI frame buffer).
+ */
+int PhaseCorr_ForwardPooled(phase_corr_t *pc, const image_t *img, uint32_t pool, float *spectrum)
+{
+    if (PhaseCorr_LoadWindowed(pc, img, pool, PHASE_CORR_LAYOUT_BITREV, spectrum) != PHASE_CORR_OK)
+    {
+        return PHASE_CORR_INVALID_PARAM;
+    }
+
+    FFT_Real2DBitRev(&pc->plan, spectrum, pc->col);
+
+    return PHASE_CORR_OK;
+}
+
+
+/*
+ * Window rows of PhaseCorr_ForwardPooled() whose pixels are all within the
+ * first lines rows of img: those PhaseCorr_ForwardRows() can take while
+ * the rest of the frame is still coming in.
+ */
+uint32_t PhaseCorr_RowsReady(const phase_corr_t *pc, const image_t *img, uint32_t pool, uint32_t lines)
+{
+    if (!PhaseCorr_CheckPooled(pc, img, pool))
+    {
+        return 0U;
+    }
+
+    const uint32_t y0 = ((uint32_t)img->h - (pc->n * pool)) / 2U;
+    const uint32_t rows = (lines > y0) ? ((lines - y0) / pool) : 0U;
+
+    return (rows < pc->n) ? rows : pc->n;
+}
+
+
+/*
+ * PhaseCorr_ForwardPooled() a band at a time: loads and transforms window
+ * rows row0 .. row0 + rows - 1 into spectrum. Once all n rows are in,
+ * PhaseCorr_ForwardColumns() completes the same spectrum
+ * PhaseCorr_ForwardPooled() computes. Lets the row work run during the
+ * readout of the frame, leaving only the column pass for its end.
+ */
+int PhaseCorr_ForwardRows(phase_corr_t *pc, const image_t *img, uint32_t pool, float *spectrum,
+                          uint32_t row0, uint32_t rows)
+{
+    if (!PhaseCorr_CheckPooled(pc, img, pool) || (spectrum == 0) || ((row0 + rows) > pc->n))
+    {
+        return PHASE_CORR_INVALID_PARAM;
+    }
+
+    PhaseCorr_LoadRows(pc, img, pool, PHASE_CORR_LAYOUT_BITREV, spectrum, row0, rows);
+    FFT_Real2DBitRevRows(&pc->plan, spectrum, row0, rows);
+
+    return PHASE_CORR_OK;
+}
+
+
+void PhaseCorr_ForwardColumns(phase_corr_t *pc, float *spectrum)
+{
+    FFT_Real2DColumns(&pc->plan, spectrum, pc->col);
+}
+
+
+/*
+ * Replace rows row0 .. row0 + rows - 1 of the frame spectrum in work_a by
+ * the normalised cross-power spectrum A * conj(B) / |A * conj(B)|. ref holds
+ * just those rows of the reference half spectrum, FFT_REAL_ROW_FLOATS(n)
+ * floats apart.
+ *
+ * Only the half spectrum is processed: R is Hermitian like A and B, so the
+ * missing half never needs computing.
+ */
+void PhaseCorr_CrossPower(phase_corr_t *pc, const float *ref, uint32_t row0, uint32_t rows)
+{
+    PhaseCorr_CrossPowerWith(pc, pc->work_a, ref, row0, rows);
+}
+
+
+/*
+ * As PhaseCorr_CrossPower(), but with the frame spectrum A read from frame
+ * (a full half spectrum, left untouched) instead of work_a. Used to
+ * correlate one frame against several references.
+ */
+void PhaseCorr_CrossPowerWith(phase_corr_t *pc, const float *frame, const float *ref,
+                              uint32_t row0, uint32_t rows)
+{
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(pc->n);
+    const uint32_t bins = rows * (pc->n / 2U + 1U);
+    const float *a = &frame[row0 * stride];
+    float *r = &pc->work_a[row0 * stride];
+    const float *b = ref;
+
+    for (uint32_t i = 0; i < bins; i++)
+    {
+        float ar = a[2U * i];
+        float ai = a[2U * i + 1U];
+        float br = b[2U * i];
+        float bi = b[2U * i + 1U];
+        float re = (ar * br) + (ai * bi);
+        float im = (ai * br) - (ar * bi);
+        float inv = 1.0f / (sqrtf((re * re) + (im * im)) + PHASE_CORR_EPS);
+
+        r[2U * i]      = re * inv;
+        r[2U * i + 1U] = im * inv;
+    }
+}
+
+
+/* Circular distance between two indices of an n-periodic axis */
+static uint32_t PhaseCorr_WrapDist(int32_t a, int32_t b, uint32_t n)
+{
+    uint32_t d = (uint32_t)((a > b) ? (a - b) : (b - a));
+
+    return (d > (n / 2U)) ? (n - d) : d;
+}
+
+
+/* Surface value at (x, y), both taken modulo n */
+static float PhaseCorr_At(const phase_corr_t *pc, int32_t x, int32_t y)
+{
+    const int32_t n = (int32_t)pc->n;
+
+    return pc->work_a[(uint32_t)((y + n) % n) * FFT_REAL_ROW_FLOATS(pc->n) + (uint32_t)((x + n) % n)];
+}
+
+
+/* Vertex of the parabola through (-1, a), (0, b), (1, c), 0 if degenerate */
+static float PhaseCorr_Vertex(float a, float b, float c)
+{
+    const float d = a - (2.0f * b) + c;
+
+    if (d >= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    const float t = 0.5f * (a - c) / d;
+
+    return (t > 0.5f) ? 0.5f : ((t < -0.5f) ? -0.5f : t);
+}
+
+
+/*
+ * Periodic band-limited interpolation kernel of an even-length n-point
+ * axis, i.e. the inverse DFT of a flat spectrum: sin(pi t) / (n tan(pi t / n)).
+ */
+static float PhaseCorr_Dirichlet(float t, uint32_t n)
+{
+    const float a = (float)PHASE_CORR_PI * t;
+
+    if (fabsf(t) < 1e-4f)
+    {
+        return 1.0f;
+    }
+
+    return sinf(a) / ((float)n * tanf(a / (float)n));
+}
+
+
+/*
+ * Upsampled refinement: the surface is the inverse DFT of the cross-power
+ * spectrum, so its value between samples follows from the samples through
+ * the Dirichlet kernel. It is evaluated on a 1 / PHASE_CORR_UPSAMPLE grid
+ * over +-0.75 pixel around the integer peak, from the
+ * (2 * PHASE_CORR_UPSAMPLE_RADIUS + 1)^2 samples around it only (the kernel
+ * falls off as 1 / t and the peak dominates the neighbourhood), and the
+ * best grid point gets a final parabolic touch. Separable, so rows are
+ * interpolated first; pc->col is free after the inverse and holds the
+ * kernel table and the row pass.
+ */
+static void PhaseCorr_RefineUpsampled(phase_corr_t *pc, int32_t px, int32_t py, float *ox, float *oy)
+{
+    const int32_t r = (int32_t)PHASE_CORR_UPSAMPLE_RADIUS;
+    const int32_t taps = (2 * r) + 1;
+    const int32_t half = (int32_t)((3U * PHASE_CORR_UPSAMPLE) / 4U);
+    const int32_t grid = (2 * half) + 1;
+    float *kern = pc->col;                      /* grid x taps: K(u / UPSAMPLE - i) */
+    float *rows = &pc->col[grid * taps];        /* taps x grid: rows interpolated at each u */
+    float best = -FLT_MAX;
+    int32_t bu = 0;
+    int32_t bv = 0;
+
+    for (int32_t u = 0; u < grid; u++)
+    {
+        const float t = (float)(u - half) / (float)PHASE_CORR_UPSAMPLE;
+
+        for (int32_t i = 0; i < taps; i++)
+        {
+            kern[u * taps + i] = PhaseCorr_Dirichlet(t - (float)(i - r), pc->n);
+        }
+    }
+
+    for (int32_t j = 0; j < taps; j++)
+    {
+        float line[2U * PHASE_CORR_UPSAMPLE_RADIUS + 1U];
+
+        for (int32_t i = 0; i < taps; i++)
+        {
+            line[i] = PhaseCorr_At(pc, px + i - r, py + j - r);
+        }
+
+        for (int32_t u = 0; u < grid; u++)
+        {
+            float acc = 0.0f;
+
+            for (int32_t i = 0; i < taps; i++)
+            {
+                acc += line[i] * kern[u * taps + i];
+            }
+
+            rows[j * grid + u] = acc;
+        }
+    }
+
+    for (int32_t v = 0; v < grid; v++)
+    {
+        for (int32_t u = 0; u < grid; u++)
+        {
+            float acc = 0.0f;
+
+            for (int32_t j = 0; j < taps; j++)
+            {
+                acc += rows[j * grid + u] * kern[v * taps + j];
+            }
+
+            if (acc > best)
+            {
+                best = acc;
+                bu = u;
+                bv = v;
+            }
+        }
+    }
+
+    /* Parabolic fit between grid points, along the best grid row and column */
+    float fu = 0.0f;
+    float fv = 0.0f;
+
+    if ((bu > 0) && (bu < (grid - 1)) && (bv > 0) && (bv < (grid - 1)))
+    {
+        float cu[3] = { 0.0f, 0.0f, 0.0f };
+        float cv[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (int32_t k = 0; k < 3; k++)
+        {
+            for (int32_t j = 0; j < taps; j++)
+            {
+                cu[k] += rows[j * grid + bu + k - 1] * kern[bv * taps + j];
+                cv[k] += rows[j * grid + bu] * kern[(bv + k - 1) * taps + j];
+            }
+        }
+
+        fu = PhaseCorr_Vertex(cu[0], cu[1], cu[2]);
+        fv = PhaseCorr_Vertex(cv[0], cv[1], cv[2]);
+    }
+
+    *ox = ((float)(bu - half) + fu) / (float)PHASE_CORR_UPSAMPLE;
+    *oy = ((float)(bv - half) + fv) / (float)PHASE_CORR_UPSAMPLE;
+}
+
+
+/* Sub-pixel offset of the peak at (px, py) with the configured method */
+static void PhaseCorr_Refine(phase_corr_t *pc, int32_t px, int32_t py, float *ox, float *oy)
+{
+    const float c = PhaseCorr_At(pc, px, py);
+    float l = PhaseCorr_At(pc, px - 1, py);
+    float r = PhaseCorr_At(pc, px + 1, py);
+    float u = PhaseCorr_At(pc, px, py - 1);
+    float d = PhaseCorr_At(pc, px, py + 1);
+
+    *ox = 0.0f;
+    *oy = 0.0f;
+
+    switch (pc->subpixel)
+    {
+    case PHASE_CORR_SUBPIXEL_PARABOLIC:
+        *ox = PhaseCorr_Vertex(l, c, r);
+        *oy = PhaseCorr_Vertex(u, c, d);
+        break;
+
+    case PHASE_CORR_SUBPIXEL_GAUSSIAN:
+        /* Needs a positive neighbourhood, falls back to the parabola */
+        if ((l > 0.0f) && (r > 0.0f) && (u > 0.0f) && (d > 0.0f))
+        {
+            const float lc = logf(c);
+
+            *ox = PhaseCorr_Vertex(logf(l), lc, logf(r));
+            *oy = PhaseCorr_Vertex(logf(u), lc, logf(d));
+        }
+        else
+        {
+            *ox = PhaseCorr_Vertex(l, c, r);
+            *oy = PhaseCorr_Vertex(u, c, d);
+        }
+        break;
+
+    case PHASE_CORR_SUBPIXEL_UPSAMPLED:
+        PhaseCorr_RefineUpsampled(pc, px, py, ox, oy);
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+/*
+ * Inverse transform of the cross-power spectrum in work_a, peak search and
+ * peak confidence.
+ *
+ * The scan that finds the argmax also accumulates the sum and sum of
+ * squares of the surface and keeps the maximum of every row, so the
+ * confidence costs no extra pass over the surface:
+ *   psr          (peak - mean) / std of the sidelobe region, i.e. everything
+ *                outside the (2 * PHASE_CORR_PSR_EXCLUDE + 1)^2 box around
+ *                the peak
+ *   second_peak  highest row maximum outside that box. Rows crossing the
+ *                box only count if their maximum lies outside it, so a
+ *                second peak sharing a row with the main one can be missed.
+ *
+ * Returns PHASE_CORR_REJECTED if psr is below pc->min_psr; the result is
+ * filled in either way, but a rejected one is not refined (sub_dx, sub_dy
+ * are the integer shift).
+ */
+int PhaseCorr_FindPeak(phase_corr_t *pc, phase_corr_result_t *result)
+{
+    const uint32_t n = pc->n;
+    const uint32_t stride = FFT_REAL_ROW_FLOATS(n);
+    const int32_t ex = (int32_t)PHASE_CORR_PSR_EXCLUDE;
+    float *a = pc->work_a;
+
+    FFT_RealInverse2D(&pc->plan, a, pc->col);
+
+    /* The correlation surface is real and the true peak is positive */
+    float best = -FLT_MAX;
+    float sum = 0.0f;
+    float sumsq = 0.0f;
+    int32_t px = 0;
+    int32_t py = 0;
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        const float *row = &a[y * stride];
+        float rmax = -FLT_MAX;
+        float rsum = 0.0f;
+        float rsumsq = 0.0f;
+        uint32_t rx = 0U;
+
+        for (uint32_t x = 0; x < n; x++)
+        {
+            const float v = row[x];
+
+            rsum += v;
+            rsumsq += v * v;
+
+            if (v > rmax)
+            {
+                rmax = v;
+                rx = x;
+            }
+        }
+
+        pc->row_max[y] = rmax;
+        pc->row_arg[y] = (uint16_t)rx;
+        sum += rsum;
+        sumsq += rsumsq;
+
+        if (rmax > best)
+        {
+            best = rmax;
+            px = (int32_t)rx;
+            py = (int32_t)y;
+        }
+    }
+
+    /* Take the box around the peak out of the sidelobe statistics */
+    uint32_t count = n * n;
+
+    for (int32_t j = -ex; j <= ex; j++)
+    {
+        const float *row = &a[(uint32_t)((py + j + (int32_t)n) % (int32_t)n) * stride];
+
+        for (int32_t i = -ex; i <= ex; i++)
+        {
+            const float v = row[(px + i + (int32_t)n) % (int32_t)n];
+
+            sum -= v;
+            sumsq -= v * v;
+            count--;
+        }
+    }
+
+    float second = -FLT_MAX;
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        if ((PhaseCorr_WrapDist((int32_t)y, py, n) > (uint32_t)ex) ||
+            (PhaseCorr_WrapDist((int32_t)pc->row_arg[y], px, n) > (uint32_t)ex))
+        {
+            if (pc->row_max[y] > second)
+            {
+                second = pc->row_max[y];
+            }
+        }
+    }
+
+    const float mean = sum / (float)count;
+    const float var = (sumsq / (float)count) - (mean * mean);
+    const float scale = 1.0f / (float)(n * n);
+
+    /* Undo the FFT wrap-around: indices above n/2 are negative shifts */
+    result->dx = (px >= (int32_t)(n / 2U)) ? (px - (int32_t)n) : px;
+    result->dy = (py >= (int32_t)(n / 2U)) ? (py - (int32_t)n) : py;
+
+    result->sub_dx = (float)result->dx;
+    result->sub_dy = (float)result->dy;
+    result->peak = best * scale;
+    result->second_peak = second * scale;
+    result->psr = (best - mean) / (sqrtf((var > 0.0f) ? var : 0.0f) + PHASE_CORR_EPS);
+
+    /* A weak fix is dropped before any sub-pixel refinement is paid for */
+    if (result->psr < pc->min_psr)
+    {
+        return PHASE_CORR_REJECTED;
+    }
+
+    float ox;
+    float oy;
+
+    PhaseCorr_Refine(pc, px, py, &ox, &oy);
+    result->sub_dx += ox;
+    result->sub_dy += oy;
+
+    return PHASE_CORR_OK;
+}
+
+
+/* Confidence below which PhaseCorr_FindPeak() / PhaseCorr_Run() reject a fix (0 = never) */
+void PhaseCorr_SetMinConfidence(phase_corr_t *pc, float min_psr)
+{
+    pc->min_psr = min_psr;
+}
+
+
+/* Sub-pixel refinement of the peak, PHASE_CORR_SUBPIXEL_PARABOLIC by default */
+void PhaseCorr_SetSubpixel(phase_corr_t *pc, PhaseCorr_Subpixel method)
+{
+    pc->subpixel = (uint32_t)method;
+}
+
+
+int PhaseCorr_Run(phase_corr_t *pc, const image_t *frame, const image_t *ref,
+                  phase_corr_result_t *result)
+{
+    if ((pc == 0) || (result == 0) || (pc->work_b == 0) ||
+        !PhaseCorr_CheckImage(pc, frame) || !PhaseCorr_CheckImage(pc, ref))
+    {
+        return PHASE_CORR_INVALID_PARAM;
+    }
+
+    (void)PhaseCorr_Forward(pc, frame, pc->work_a);
+    (void)PhaseCorr_Forward(pc, ref, pc->work_b);
+
+    PhaseCorr_CrossPower(pc, pc->work_b, 0U, pc->n);
+
+    return PhaseCorr_FindPeak(pc, result);
+}
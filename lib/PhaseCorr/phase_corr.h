@@ -0,0 +1,149 @@
+#ifndef __PHASE_CORR_H
+#define __PHASE_CORR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "imlib.h"
+#include "fft.h"
+
+/*
+ * Phase correlation between a Y8 camera frame and a Y8 reference tile.
+ *
+ * This is the on-target version of phase_corr.py: both images are cropped
+ * to an n x n window around their centre, multiplied by a separable
+ * sqrt(hamming x hamming) window, transformed, combined into the normalised
+ * cross-power spectrum and transformed back. The location of the maximum of
+ * the correlation surface is the translation between the two images.
+ *
+ * Cropping, uint8 to float conversion, windowing and the FFT input layout
+ * are one fused pass over the frame (PhaseCorr_LoadWindowed()), which also
+ * writes the rows in bit-reversed order so the row transforms skip their
+ * permutation, and can average pool x pool blocks on the way.
+ *
+ * Both inputs are real, so the transforms run on the Hermitian half spectrum
+ * (see FFT_Real2D()), including the cross-power normalisation and the
+ * inverse.
+ *
+ * The forward transform can also be fed a band of rows at a time as a
+ * frame arrives (PhaseCorr_ForwardRows()), with only the column pass left
+ * for the frame end (PhaseCorr_ForwardColumns()).
+ *
+ * The steps are also exposed one by one so that the reference spectrum can
+ * come from somewhere else than a second forward transform (for instance a
+ * precomputed spectrum tile streamed from the SD card):
+ *   PhaseCorr_Forward(pc, frame, pc->work_a);
+ *   PhaseCorr_CrossPower(pc, ref_rows, row0, rows);   (any number of times)
+ *   PhaseCorr_FindPeak(pc, &result);
+ *
+ * Every result carries a confidence computed in the peak-search pass (see
+ * PhaseCorr_FindPeak()). With PhaseCorr_SetMinConfidence() set, weak fixes
+ * are reported as PHASE_CORR_REJECTED so callers can drop the frame before
+ * spending anything more on it.
+ *
+ * The integer peak is refined to a sub-pixel shift (sub_dx, sub_dy) from
+ * its neighbourhood, see PhaseCorr_SetSubpixel(). A 256 x 256 correlation
+ * on a 2 x 2 pooled frame refined this way is about as accurate as a
+ * 512 x 512 one on the full frame at a quarter of the cost
+ * (tools/subpixel_bench).
+ *
+ * No memory is allocated: the caller supplies the work buffers
+ * (PHASE_CORR_WORK_FLOATS(n) floats each). At n = 256 each buffer is
+ * 264,192 bytes (258 KiB), so the two take 516 KiB: more than the whole
+ * 512 KiB AXI SRAM (.RAM_D1), which also holds the frame ring, .bss, the
+ * heap and the stacks. They go in PSRAM, or one of them in the 288 KiB
+ * .RAM_D2. The firmware runs at n = 128 (65 KiB a buffer) with its
+ * buffers in .RAM_D2 (nav.c).
+ * work_b is only used by PhaseCorr_Run() and may be NULL otherwise.
+ */
+
+#define PHASE_CORR_WORK_FLOATS(n)   ((uint32_t)(n) * FFT_REAL_ROW_FLOATS(n))
+
+/* Half size of the box around the peak left out of the sidelobe statistics */
+#ifndef PHASE_CORR_PSR_EXCLUDE
+#define PHASE_CORR_PSR_EXCLUDE      2U
+#endif
+
+/* Upsampled refinement: 1 / PHASE_CORR_UPSAMPLE pixel grid over +-0.75 pixel */
+#ifndef PHASE_CORR_UPSAMPLE
+#define PHASE_CORR_UPSAMPLE         16U
+#endif
+
+/* Half size of the neighbourhood the upsampled surface is interpolated from */
+#ifndef PHASE_CORR_UPSAMPLE_RADIUS
+#define PHASE_CORR_UPSAMPLE_RADIUS  8U
+#endif
+
+typedef enum
+{
+    PHASE_CORR_OK = 0,
+    PHASE_CORR_ERROR = -1,
+    PHASE_CORR_INVALID_PARAM = -2,
+    PHASE_CORR_REJECTED = -3            /* Valid result, confidence below min_psr */
+} PhaseCorr_Status;
+
+typedef enum
+{
+    PHASE_CORR_LAYOUT_NATURAL = 0,      /* Samples in order, for FFT_Real2D() */
+    PHASE_CORR_LAYOUT_BITREV = 1        /* Sample pairs bit-reversed, for FFT_Real2DBitRev() */
+} PhaseCorr_Layout;
+
+typedef enum
+{
+    PHASE_CORR_SUBPIXEL_NONE = 0,       /* sub_dx, sub_dy = dx, dy */
+    PHASE_CORR_SUBPIXEL_PARABOLIC = 1,  /* Parabola through the peak and its 4 neighbours */
+    PHASE_CORR_SUBPIXEL_GAUSSIAN = 2,   /* Same on the log of the surface */
+    PHASE_CORR_SUBPIXEL_UPSAMPLED = 3   /* Band-limited interpolation around the peak */
+} PhaseCorr_Subpixel;
+
+typedef struct
+{
+    int32_t dx;             /* Shift of the frame content w.r.t. the reference (pixels) */
+    int32_t dy;
+    float   sub_dx;         /* Same with sub-pixel refinement */
+    float   sub_dy;
+    float   peak;           /* Correlation peak, 1.0 for a perfect match */
+    float   second_peak;    /* Highest other peak, same scale */
+    float   psr;            /* Peak-to-sidelobe ratio */
+} phase_corr_result_t;
+
+typedef struct
+{
+    uint32_t   n;
+    fft_plan_t plan;
+    float      window[FFT_MAX_N];       /* sqrt of the 1D Hamming window */
+    float      col[2U * FFT_MAX_N];     /* Column scratch for the 2D FFT */
+    float     *work_a;
+    float     *work_b;
+    float      min_psr;                 /* Rejection threshold, 0 = accept all */
+    uint32_t   subpixel;                /* PhaseCorr_Subpixel */
+    float      row_max[FFT_MAX_N];      /* Peak search: maximum of each row */
+    uint16_t   row_arg[FFT_MAX_N];      /* and its column */
+} phase_corr_t;
+
+int  PhaseCorr_Init(phase_corr_t *pc, uint32_t n, float *work_a, float *work_b);
+int  PhaseCorr_Run(phase_corr_t *pc, const image_t *frame, const image_t *ref,
+                   phase_corr_result_t *result);
+int  PhaseCorr_Forward(phase_corr_t *pc, const image_t *img, float *spectrum);
+int  PhaseCorr_ForwardPooled(phase_corr_t *pc, const image_t *img, uint32_t pool, float *spectrum);
+int  PhaseCorr_LoadWindowed(const phase_corr_t *pc, const image_t *img, uint32_t pool,
+                            PhaseCorr_Layout layout, float *dst);
+uint32_t PhaseCorr_RowsReady(const phase_corr_t *pc, const image_t *img, uint32_t pool, uint32_t lines);
+int  PhaseCorr_ForwardRows(phase_corr_t *pc, const image_t *img, uint32_t pool, float *spectrum,
+                           uint32_t row0, uint32_t rows);
+void PhaseCorr_ForwardColumns(phase_corr_t *pc, float *spectrum);
+void PhaseCorr_CrossPower(phase_corr_t *pc, const float *ref, uint32_t row0, uint32_t rows);
+void PhaseCorr_CrossPowerWith(phase_corr_t *pc, const float *frame, const float *ref,
+                              uint32_t row0, uint32_t rows);
+int  PhaseCorr_FindPeak(phase_corr_t *pc, phase_corr_result_t *result);
+void PhaseCorr_SetMinConfidence(phase_corr_t *pc, float min_psr);
+void PhaseCorr_SetSubpixel(phase_corr_t *pc, PhaseCorr_Subpixel method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PHASE_CORR_H */
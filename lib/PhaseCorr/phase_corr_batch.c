@@ -0,0 +1,122 @@
+#include "phase_corr_batch.h"
+
+
+int PhaseCorrBatch_Init(phase_corr_batch_t *b, phase_corr_t *pc, const spectrum_source_t *src,
+                        uint32_t chunk_rows, void *raw_a, void *raw_b, float *rows)
+{
+    if ((b == 0) || (pc == 0) || (pc->work_b == 0) || (src == 0) || (src->read_start == 0) ||
+        (raw_a == 0) || (raw_b == 0) || (rows == 0) ||
+        (chunk_rows == 0U) || ((pc->n % chunk_rows) != 0U))
+    {
+        return PHASE_CORR_BATCH_INVALID_PARAM;
+    }
+
+    b->pc = pc;
+    b->src = *src;
+    b->chunk_rows = chunk_rows;
+    b->raw[0] = raw_a;
+    b->raw[1] = raw_b;
+    b->rows = rows;
+
+    return PHASE_CORR_BATCH_OK;
+}
+
+
+static int PhaseCorrBatch_Start(phase_corr_batch_t *b, const spectrum_tile_header_t *hdrs,
+                                uint32_t tile, uint32_t row, void *dst)
+{
+    const uint32_t row_bytes = SpectrumTile_RowBytes(&hdrs[tile]);
+
+    return b->src.read_start(b->src.ctx, tile, row * row_bytes, dst, b->chunk_rows * row_bytes);
+}
+
+
+/*
+ * Correlate frame against the count tiles described by hdrs. results[i] gets
+ * the shift, peak and confidence of tile i, *best (optional) the index of
+ * the tile with the highest peak. Returns PHASE_CORR_BATCH_REJECTED if that
+ * tile is below the pc confidence threshold.
+ */
+int PhaseCorrBatch_Run(phase_corr_batch_t *b, const image_t *frame,
+                       const spectrum_tile_header_t *hdrs, uint32_t count,
+                       phase_corr_result_t *results, uint32_t *best)
+{
+    if ((b == 0) || (hdrs == 0) || (results == 0) || (count == 0U))
+    {
+        return PHASE_CORR_BATCH_INVALID_PARAM;
+    }
+
+    phase_corr_t *pc = b->pc;
+    const uint32_t n = pc->n;
+    uint32_t cur = 0U;
+
+    for (uint32_t t = 0; t < count; t++)
+    {
+        if (!SpectrumTile_CheckHeader(&hdrs[t]) || (hdrs[t].n != n) ||
+            (hdrs[t].window != SPECTRUM_WINDOW_SQRT_HAMMING))
+        {
+            return PHASE_CORR_BATCH_INVALID_PARAM;
+        }
+    }
+
+    /* The first read overlaps the frame transform */
+    if (PhaseCorrBatch_Start(b, hdrs, 0U, 0U, b->raw[cur]) != 0)
+    {
+        return PHASE_CORR_BATCH_ERROR;
+    }
+
+    if (PhaseCorr_Forward(pc, frame, pc->work_b) != PHASE_CORR_OK)
+    {
+        if (b->src.read_wait != 0)
+        {
+            (void)b->src.read_wait(b->src.ctx);
+        }
+
+        return PHASE_CORR_BATCH_INVALID_PARAM;
+    }
+
+    for (uint32_t t = 0; t < count; t++)
+    {
+        for (uint32_t row = 0; row < n; row += b->chunk_rows)
+        {
+            const uint32_t next_row = ((row + b->chunk_rows) < n) ? (row + b->chunk_rows) : 0U;
+            const uint32_t next_tile = (next_row != 0U) ? t : (t + 1U);
+
+            if ((b->src.read_wait != 0) && (b->src.read_wait(b->src.ctx) != 0))
+            {
+                return PHASE_CORR_BATCH_ERROR;
+            }
+
+            /* Keep one read in flight, across the tile boundary too */
+            if ((next_tile < count) &&
+                (PhaseCorrBatch_Start(b, hdrs, next_tile, next_row, b->raw[cur ^ 1U]) != 0))
+            {
+                return PHASE_CORR_BATCH_ERROR;
+            }
+
+            SpectrumTile_DecodeRows(&hdrs[t], b->raw[cur], b->rows, b->chunk_rows);
+            PhaseCorr_CrossPowerWith(pc, pc->work_b, b->rows, row, b->chunk_rows);
+
+            cur ^= 1U;
+        }
+
+        (void)PhaseCorr_FindPeak(pc, &results[t]);
+    }
+
+    uint32_t k = 0U;
+
+    for (uint32_t t = 1; t < count; t++)
+    {
+        if (results[t].peak > results[k].peak)
+        {
+            k = t;
+        }
+    }
+
+    if (best != 0)
+    {
+        *best = k;
+    }
+
+    return (results[k].psr >= pc->min_psr) ? PHASE_CORR_BATCH_OK : PHASE_CORR_BATCH_REJECTED;
+}
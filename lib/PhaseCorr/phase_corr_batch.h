@@ -0,0 +1,73 @@
+#ifndef __PHASE_CORR_BATCH_H
+#define __PHASE_CORR_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "phase_corr.h"
+#include "spectrum_tile.h"
+
+/*
+ * One-to-many correlation: one camera frame against N candidate reference
+ * tiles with precomputed spectra (see spectrum_tile.h).
+ *
+ * The frame is windowed and transformed once, into pc->work_b, and kept;
+ * each tile only costs its cross-power step and one inverse transform in
+ * pc->work_a. Reference spectra come from a spectrum_source_t in chunks of
+ * chunk_rows rows, double buffered: the read of the next chunk is always
+ * started before the current one is processed, so the first chunk of tile
+ * i + 1 is in flight while the inverse transform of tile i runs. With a
+ * synchronous source (read_wait == 0) the pipeline degrades to plain
+ * sequential reads.
+ *
+ * All tiles must have the same n as pc and the SQRT_HAMMING window; the
+ * quantisation may differ from tile to tile.
+ */
+
+/* Bytes needed by each of the two raw chunk buffers */
+#define PHASE_CORR_BATCH_RAW_BYTES(n, chunk_rows)  ((uint32_t)(chunk_rows) * FFT_REAL_ROW_FLOATS(n) * sizeof(float))
+
+typedef enum
+{
+    PHASE_CORR_BATCH_OK = 0,
+    PHASE_CORR_BATCH_ERROR = -1,
+    PHASE_CORR_BATCH_INVALID_PARAM = -2,
+    PHASE_CORR_BATCH_REJECTED = -3      /* Best tile below the pc confidence threshold */
+} PhaseCorrBatch_Status;
+
+typedef struct
+{
+    /*
+     * Start reading bytes of the payload of tile, starting offset bytes after
+     * its header, into dst. Returns 0 on success. May complete before
+     * returning.
+     */
+    int  (*read_start)(void *ctx, uint32_t tile, uint32_t offset, void *dst, uint32_t bytes);
+    /* Optional: block until the last started read is complete, 0 on success */
+    int  (*read_wait)(void *ctx);
+    void  *ctx;
+} spectrum_source_t;
+
+typedef struct
+{
+    phase_corr_t      *pc;
+    spectrum_source_t  src;
+    uint32_t           chunk_rows;
+    void              *raw[2];      /* PHASE_CORR_BATCH_RAW_BYTES(n, chunk_rows) each */
+    float             *rows;        /* chunk_rows * FFT_REAL_ROW_FLOATS(n) floats */
+} phase_corr_batch_t;
+
+int PhaseCorrBatch_Init(phase_corr_batch_t *b, phase_corr_t *pc, const spectrum_source_t *src,
+                        uint32_t chunk_rows, void *raw_a, void *raw_b, float *rows);
+int PhaseCorrBatch_Run(phase_corr_batch_t *b, const image_t *frame,
+                       const spectrum_tile_header_t *hdrs, uint32_t count,
+                       phase_corr_result_t *results, uint32_t *best);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PHASE_CORR_BATCH_H */
@@ -0,0 +1,222 @@
+#include "pyramid_search.h"
+
+
+static uint32_t PyramidSearch_Now(const pyramid_search_t *ps)
+{
+    return (ps->now_us != 0) ? ps->now_us() : 0U;
+}
+
+
+/* Number of levels needed for the top level of a w x h image to fit in n x n */
+uint32_t Pyramid_LevelsFor(uint32_t w, uint32_t h, uint32_t n)
+{
+    uint32_t levels = 1U;
+
+    while ((((w >> (levels - 1U)) > n) || ((h >> (levels - 1U)) > n)) &&
+           (levels < PYRAMID_MAX_LEVELS))
+    {
+        levels++;
+    }
+
+    return levels;
+}
+
+
+/* Bytes needed by Pyramid_Build() for levels 1 .. levels - 1 */
+uint32_t Pyramid_BufBytes(uint32_t w, uint32_t h, uint32_t levels)
+{
+    uint32_t bytes = 0U;
+
+    for (uint32_t l = 1; l < levels; l++)
+    {
+        bytes += (w >> l) * (h >> l);
+    }
+
+    return bytes;
+}
+
+
+/*
+ * Fill levels[0 .. count - 1] with base and its successive 2x2 mean-pooled
+ * copies, stored back to back in buf (Pyramid_BufBytes() bytes).
+ */
+int Pyramid_Build(const image_t *base, image_t *levels, uint32_t count, uint8_t *buf)
+{
+    if ((base == 0) || (levels == 0) || (count == 0U) || (count > PYRAMID_MAX_LEVELS) ||
+        (base->bpp != IMAGE_BPP_GRAYSCALE) || ((count > 1U) && (buf == 0)))
+    {
+        return PYRAMID_INVALID_PARAM;
+    }
+
+    levels[0] = *base;
+
+    for (uint32_t l = 1; l < count; l++)
+    {
+        levels[l].w = levels[l - 1U].w / 2;
+        levels[l].h = levels[l - 1U].h / 2;
+        levels[l].bpp = IMAGE_BPP_GRAYSCALE;
+        levels[l].pixels = buf;
+
+        if ((levels[l].w < 1) || (levels[l].h < 1))
+        {
+            return PYRAMID_INVALID_PARAM;
+        }
+
+        imlib_mean_pool(&levels[l - 1U], &levels[l], 2, 2);
+
+        buf += (uint32_t)levels[l].w * (uint32_t)levels[l].h;
+    }
+
+    return PYRAMID_OK;
+}
+
+
+/*
+ * Copy the n x n window of src centred on (cx, cy) into dst. The part of the
+ * window outside src is filled with the mean of the part inside, so that the
+ * border does not show up as a strong edge in the spectrum.
+ */
+static void PyramidSearch_Window(const image_t *src, int32_t cx, int32_t cy, uint8_t *dst, uint32_t n)
+{
+    const int32_t x0 = cx - (int32_t)(n / 2U);
+    const int32_t y0 = cy - (int32_t)(n / 2U);
+    const int32_t xa = (x0 < 0) ? 0 : x0;
+    const int32_t ya = (y0 < 0) ? 0 : y0;
+    const int32_t xb = ((x0 + (int32_t)n) > src->w) ? src->w : (x0 + (int32_t)n);
+    const int32_t yb = ((y0 + (int32_t)n) > src->h) ? src->h : (y0 + (int32_t)n);
+    uint32_t sum = 0U;
+    uint32_t count = 0U;
+    uint8_t fill;
+
+    for (int32_t y = ya; y < yb; y++)
+    {
+        const uint8_t *row = &src->pixels[y * src->w];
+
+        for (int32_t x = xa; x < xb; x++)
+        {
+            sum += row[x];
+        }
+
+        count += (xb > xa) ? (uint32_t)(xb - xa) : 0U;
+    }
+
+    fill = (count > 0U) ? (uint8_t)(sum / count) : 128U;
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        const int32_t sy = y0 + (int32_t)y;
+        uint8_t *out = &dst[y * n];
+
+        if ((sy < 0) || (sy >= src->h))
+        {
+            memset(out, fill, n);
+            continue;
+        }
+
+        const uint8_t *row = &src->pixels[sy * src->w];
+
+        for (uint32_t x = 0; x < n; x++)
+        {
+            const int32_t sx = x0 + (int32_t)x;
+
+            out[x] = ((sx < 0) || (sx >= src->w)) ? fill : row[sx];
+        }
+    }
+}
+
+
+/* Scratch needed for a frame of frame_w x frame_h: two n x n canvases + frame pyramid */
+uint32_t PyramidSearch_ScratchBytes(uint32_t frame_w, uint32_t frame_h, uint32_t n, uint32_t levels)
+{
+    return (2U * n * n) + Pyramid_BufBytes(frame_w, frame_h, levels);
+}
+
+
+int PyramidSearch_Init(pyramid_search_t *ps, phase_corr_t *pc, const image_t *map_levels,
+                       uint32_t levels, uint8_t *scratch, uint32_t (*now_us)(void))
+{
+    if ((ps == 0) || (pc == 0) || (map_levels == 0) || (scratch == 0) ||
+        (levels == 0U) || (levels > PYRAMID_MAX_LEVELS))
+    {
+        return PYRAMID_INVALID_PARAM;
+    }
+
+    ps->pc = pc;
+    ps->map = map_levels;
+    ps->levels = levels;
+    ps->canvas_frame = scratch;
+    ps->canvas_map = scratch + (pc->n * pc->n);
+    ps->frame_buf = scratch + (2U * pc->n * pc->n);
+    ps->now_us = now_us;
+
+    return PYRAMID_OK;
+}
+
+
+int PyramidSearch_Run(pyramid_search_t *ps, const image_t *frame, pyramid_result_t *result)
+{
+    const uint32_t n = ps->pc->n;
+    const uint32_t top = ps->levels - 1U;
+    image_t canvas_frame = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = ps->canvas_frame };
+    image_t canvas_map = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = ps->canvas_map };
+    phase_corr_result_t pcr;
+    uint32_t t0 = PyramidSearch_Now(ps);
+
+    if ((frame == 0) || (result == 0))
+    {
+        return PYRAMID_INVALID_PARAM;
+    }
+
+    if (Pyramid_Build(frame, ps->frame, ps->levels, ps->frame_buf) != PYRAMID_OK)
+    {
+        return PYRAMID_INVALID_PARAM;
+    }
+
+    result->levels = ps->levels;
+    result->build_us = PyramidSearch_Now(ps) - t0;
+
+    /* The top level fits in one window: start from its centre */
+    int32_t ex = ps->map[top].w / 2;
+    int32_t ey = ps->map[top].h / 2;
+
+    for (int32_t l = (int32_t)top; l >= 0; l--)
+    {
+        const image_t *fl = &ps->frame[l];
+
+        t0 = PyramidSearch_Now(ps);
+
+        if (l != (int32_t)top)
+        {
+            ex *= 2;
+            ey *= 2;
+        }
+
+        PyramidSearch_Window(fl, fl->w / 2, fl->h / 2, ps->canvas_frame, n);
+        PyramidSearch_Window(&ps->map[l], ex, ey, ps->canvas_map, n);
+
+        int err = PhaseCorr_Run(ps->pc, &canvas_frame, &canvas_map, &pcr);
+
+        if (err != PHASE_CORR_OK)
+        {
+            /* A weak level would only steer the finer ones to the wrong window */
+            return (err == PHASE_CORR_REJECTED) ? PYRAMID_REJECTED : PYRAMID_ERROR;
+        }
+
+        /* frame(x) = window(x - d): the frame centre is d before the window centre */
+        ex -= pcr.dx;
+        ey -= pcr.dy;
+
+        result->level[l].x = ex * (int32_t)(1U << l);
+        result->level[l].y = ey * (int32_t)(1U << l);
+        result->level[l].peak = pcr.peak;
+        result->level[l].psr = pcr.psr;
+        result->level[l].time_us = PyramidSearch_Now(ps) - t0;
+    }
+
+    result->x = ex;
+    result->y = ey;
+    result->peak = result->level[0].peak;
+    result->psr = result->level[0].psr;
+
+    return PYRAMID_OK;
+}
@@ -0,0 +1,85 @@
+#ifndef __PYRAMID_SEARCH_H
+#define __PYRAMID_SEARCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "imlib.h"
+#include "phase_corr.h"
+
+/*
+ * Coarse-to-fine localisation of a camera frame in a large reference map.
+ *
+ * Both the map and the frame are kept as 2x2 mean-pooled pyramids
+ * (imlib_mean_pool). The search starts at the coarsest map level, which is
+ * chosen to fit in a single n x n correlation, so one correlation covers the
+ * whole map and gives the candidate region. Each finer level then correlates
+ * only the n x n map window centred on the previous estimate (scaled by 2)
+ * and corrects it. The cost is one correlation per level, i.e. it grows
+ * with log2(map size / n) instead of with the map area.
+ *
+ * Positions are the map coordinates, in full resolution pixels, of the
+ * centre of the frame.
+ */
+
+#ifndef PYRAMID_MAX_LEVELS
+#define PYRAMID_MAX_LEVELS    8U
+#endif
+
+typedef enum
+{
+    PYRAMID_OK = 0,
+    PYRAMID_ERROR = -1,
+    PYRAMID_INVALID_PARAM = -2,
+    PYRAMID_REJECTED = -3               /* A level fell below the pc confidence threshold */
+} Pyramid_Status;
+
+typedef struct
+{
+    int32_t  x;             /* Estimate after this level (level 0 pixels) */
+    int32_t  y;
+    float    peak;
+    float    psr;
+    uint32_t time_us;       /* Window extraction + correlation time */
+} pyramid_level_t;
+
+typedef struct
+{
+    int32_t         x;
+    int32_t         y;
+    float           peak;   /* Peak and confidence of the finest level */
+    float           psr;
+    uint32_t        levels;
+    uint32_t        build_us;                   /* Frame pyramid construction time */
+    pyramid_level_t level[PYRAMID_MAX_LEVELS];  /* Indexed by pyramid level */
+} pyramid_result_t;
+
+typedef struct
+{
+    phase_corr_t  *pc;
+    const image_t *map;                         /* map[0] full resolution */
+    uint32_t       levels;
+    image_t        frame[PYRAMID_MAX_LEVELS];
+    uint8_t       *frame_buf;
+    uint8_t       *canvas_frame;                /* n x n */
+    uint8_t       *canvas_map;                  /* n x n */
+    uint32_t     (*now_us)(void);               /* Optional, for the timings */
+} pyramid_search_t;
+
+uint32_t Pyramid_LevelsFor(uint32_t w, uint32_t h, uint32_t n);
+uint32_t Pyramid_BufBytes(uint32_t w, uint32_t h, uint32_t levels);
+int      Pyramid_Build(const image_t *base, image_t *levels, uint32_t count, uint8_t *buf);
+
+uint32_t PyramidSearch_ScratchBytes(uint32_t frame_w, uint32_t frame_h, uint32_t n, uint32_t levels);
+int      PyramidSearch_Init(pyramid_search_t *ps, phase_corr_t *pc, const image_t *map_levels,
+                            uint32_t levels, uint8_t *scratch, uint32_t (*now_us)(void));
+int      PyramidSearch_Run(pyramid_search_t *ps, const image_t *frame, pyramid_result_t *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PYRAMID_SEARCH_H */
@@ -0,0 +1,111 @@
+#include "spectrum_tile.h"
+
+#include <math.h>
+
+#include "fft.h"
+
+
+void SpectrumTile_InitHeader(spectrum_tile_header_t *hdr, uint32_t n,
+                             SpectrumTile_Quant quant, int32_t origin_x, int32_t origin_y)
+{
+    hdr->magic = SPECTRUM_TILE_MAGIC;
+    hdr->version = SPECTRUM_TILE_VERSION;
+    hdr->n = (uint16_t)n;
+    hdr->window = SPECTRUM_WINDOW_SQRT_HAMMING;
+    hdr->quant = (uint8_t)quant;
+    hdr->reserved = 0U;
+    hdr->scale = (quant == SPECTRUM_QUANT_Q15_PHASE) ? (1.0f / 32767.0f) : 1.0f;
+    hdr->origin_x = origin_x;
+    hdr->origin_y = origin_y;
+    hdr->data_bytes = 0U;
+    hdr->data_bytes = n * SpectrumTile_RowBytes(hdr);
+}
+
+
+/* Returns 1 if the header describes a payload this code can decode */
+int SpectrumTile_CheckHeader(const spectrum_tile_header_t *hdr)
+{
+    if ((hdr->magic != SPECTRUM_TILE_MAGIC) || (hdr->version != SPECTRUM_TILE_VERSION))
+    {
+        return 0;
+    }
+
+    if ((hdr->n < FFT_MIN_N) || (hdr->n > FFT_MAX_N) || ((hdr->n & (hdr->n - 1U)) != 0U))
+    {
+        return 0;
+    }
+
+    if ((hdr->quant != SPECTRUM_QUANT_F32) && (hdr->quant != SPECTRUM_QUANT_Q15_PHASE))
+    {
+        return 0;
+    }
+
+    return hdr->data_bytes == ((uint32_t)hdr->n * SpectrumTile_RowBytes(hdr));
+}
+
+
+uint32_t SpectrumTile_RowBytes(const spectrum_tile_header_t *hdr)
+{
+    uint32_t comps = FFT_REAL_ROW_FLOATS(hdr->n);
+
+    return comps * ((hdr->quant == SPECTRUM_QUANT_Q15_PHASE) ? 2U : 4U);
+}
+
+
+void SpectrumTile_EncodeRows(const spectrum_tile_header_t *hdr, const float *src,
+                             void *dst, uint32_t rows)
+{
+    const uint32_t comps = rows * FFT_REAL_ROW_FLOATS(hdr->n);
+
+    if (hdr->quant == SPECTRUM_QUANT_Q15_PHASE)
+    {
+        const float inv_scale = 1.0f / hdr->scale;
+        int16_t *q = (int16_t *)dst;
+
+        for (uint32_t i = 0; i < comps; i += 2U)
+        {
+            float mag = sqrtf((src[i] * src[i]) + (src[i + 1U] * src[i + 1U]));
+            float k = (mag > 0.0f) ? (inv_scale / mag) : 0.0f;
+
+            q[i]      = (int16_t)lrintf(src[i] * k);
+            q[i + 1U] = (int16_t)lrintf(src[i + 1U] * k);
+        }
+    }
+    else
+    {
+        float *f = (float *)dst;
+
+        for (uint32_t i = 0; i < comps; i++)
+        {
+            f[i] = src[i];
+        }
+    }
+}
+
+
+/* Expand rows of payload to float. For F32 payloads src may be dst. */
+void SpectrumTile_DecodeRows(const spectrum_tile_header_t *hdr, const void *src,
+                             float *dst, uint32_t rows)
+{
+    const uint32_t comps = rows * FFT_REAL_ROW_FLOATS(hdr->n);
+
+    if (hdr->quant == SPECTRUM_QUANT_Q15_PHASE)
+    {
+        const int16_t *q = (const int16_t *)src;
+        const float scale = hdr->scale;
+
+        for (uint32_t i = 0; i < comps; i++)
+        {
+            dst[i] = (float)q[i] * scale;
+        }
+    }
+    else if ((const void *)dst != src)
+    {
+        const float *f = (const float *)src;
+
+        for (uint32_t i = 0; i < comps; i++)
+        {
+            dst[i] = f[i];
+        }
+    }
+}
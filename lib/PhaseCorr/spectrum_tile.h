@@ -0,0 +1,76 @@
+#ifndef __SPECTRUM_TILE_H
+#define __SPECTRUM_TILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Precomputed reference-tile spectrum (.SPT file).
+ *
+ * The reference map never changes, so the windowed forward transform of each
+ * reference tile is computed once on the ground (tools/spectrum_tile_gen)
+ * and stored on the SD card. At runtime only the camera frame is
+ * transformed; the stored spectrum is streamed row by row into
+ * PhaseCorr_CrossPower().
+ *
+ * File layout (little endian):
+ *   spectrum_tile_header_t                         32 bytes
+ *   n rows of n/2 + 1 complex bins (re, im)        quantised as per header
+ *
+ * Quantisation:
+ *   SPECTRUM_QUANT_F32         float32 components of the full spectrum
+ *   SPECTRUM_QUANT_Q15_PHASE   int16 components of B / |B|, value = q * scale
+ *
+ * Only the phase of the reference survives the cross-power normalisation,
+ * so Q15_PHASE stores unit phasors: every bin gets the full int16 range
+ * regardless of how weak it is, and card space and SD read time per fix are
+ * half those of F32. The magnitude is lost, so tiles that will also feed
+ * a magnitude-based stage must be stored as F32.
+ */
+
+#define SPECTRUM_TILE_MAGIC       0x54505350UL      /* "PSPT" */
+#define SPECTRUM_TILE_VERSION     1U
+
+typedef enum
+{
+    SPECTRUM_WINDOW_NONE = 0,
+    SPECTRUM_WINDOW_SQRT_HAMMING = 1                /* Window used by PhaseCorr */
+} SpectrumTile_Window;
+
+typedef enum
+{
+    SPECTRUM_QUANT_F32 = 0,
+    SPECTRUM_QUANT_Q15_PHASE = 1
+} SpectrumTile_Quant;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t n;             /* FFT size */
+    uint8_t  window;        /* SpectrumTile_Window */
+    uint8_t  quant;         /* SpectrumTile_Quant */
+    uint16_t reserved;
+    float    scale;         /* Q15_PHASE only: float value of one LSB */
+    int32_t  origin_x;      /* Top-left corner of the tile in the map (pixels) */
+    int32_t  origin_y;
+    uint32_t data_bytes;    /* Size of the payload following the header */
+} spectrum_tile_header_t;
+
+void     SpectrumTile_InitHeader(spectrum_tile_header_t *hdr, uint32_t n,
+                                 SpectrumTile_Quant quant, int32_t origin_x, int32_t origin_y);
+int      SpectrumTile_CheckHeader(const spectrum_tile_header_t *hdr);
+uint32_t SpectrumTile_RowBytes(const spectrum_tile_header_t *hdr);
+void     SpectrumTile_EncodeRows(const spectrum_tile_header_t *hdr, const float *src,
+                                 void *dst, uint32_t rows);
+void     SpectrumTile_DecodeRows(const spectrum_tile_header_t *hdr, const void *src,
+                                 float *dst, uint32_t rows);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SPECTRUM_TILE_H */
@@ -0,0 +1,390 @@
+#include "tile_cache.h"
+
+#include <string.h>
+
+
+/*
+ * Slots of at most slot_bytes each from base in store, described by
+ * entries[slots]. Misses are copied through bounce (bounce_bytes, any size;
+ * larger means fewer source and store transactions).
+ */
+int TileCache_Init(tile_cache_t *c, tile_cache_entry_t *entries, uint32_t slots,
+                   uint32_t base, uint32_t slot_bytes,
+                   const tile_store_t *store, const tile_source_t *src,
+                   void *bounce, uint32_t bounce_bytes)
+{
+    if ((c == 0) || (entries == 0) || (slots == 0U) || (slot_bytes == 0U) ||
+        (store == 0) || (store->read == 0) || (store->write == 0) ||
+        (src == 0) || (src->open == 0) || (src->read == 0) ||
+        (bounce == 0) || (bounce_bytes == 0U))
+    {
+        return TILE_CACHE_INVALID_PARAM;
+    }
+
+    memset(c, 0, sizeof(*c));
+
+    c->entries = entries;
+    c->slots = slots;
+    c->base = base;
+    c->slot_bytes = slot_bytes;
+    c->store = *store;
+    c->src = *src;
+    c->bounce = (uint8_t *)bounce;
+    c->bounce_bytes = bounce_bytes;
+
+    TileCache_Clear(c);
+
+    return TILE_CACHE_OK;
+}
+
+
+/* Forget every entry and queued prefetch; the counters are kept */
+void TileCache_Clear(tile_cache_t *c)
+{
+    for (uint32_t i = 0; i < c->slots; i++)
+    {
+        c->entries[i].key = TILE_CACHE_NO_KEY;
+        c->entries[i].bytes = 0U;
+        c->entries[i].used = 0U;
+        c->entries[i].state = TILE_CACHE_OK;
+    }
+
+    c->queue_head = 0U;
+    c->queue_count = 0U;
+    c->loading = TILE_CACHE_NO_SLOT;
+}
+
+
+static int32_t TileCache_Find(const tile_cache_t *c, uint32_t key)
+{
+    for (uint32_t i = 0; i < c->slots; i++)
+    {
+        if ((c->entries[i].key == key) && (c->entries[i].used != 0U))
+        {
+            return (int32_t)i;
+        }
+    }
+
+    return -1;
+}
+
+
+/* Empty slot if there is one, the least recently used otherwise; never one being filled */
+static uint32_t TileCache_Victim(const tile_cache_t *c)
+{
+    uint32_t victim = (c->loading == 0U) ? 1U : 0U;
+
+    for (uint32_t i = 0; i < c->slots; i++)
+    {
+        if (i == c->loading)
+        {
+            continue;
+        }
+
+        if (c->entries[i].used == 0U)
+        {
+            return i;
+        }
+
+        if (c->entries[i].used < c->entries[victim].used)
+        {
+            victim = i;
+        }
+    }
+
+    return victim;
+}
+
+
+static void TileCache_Touch(tile_cache_t *c, uint32_t slot)
+{
+    c->entries[slot].used = ++c->clock;
+}
+
+
+/* Take slot for a new object: empty until the copy has completed */
+static void TileCache_Claim(tile_cache_t *c, uint32_t slot)
+{
+    tile_cache_entry_t *e = &c->entries[slot];
+
+    if (e->used != 0U)
+    {
+        c->stats.evictions++;
+    }
+
+    e->key = TILE_CACHE_NO_KEY;
+    e->used = 0U;
+}
+
+
+/*
+ * Stream key from src into slot through bounce. Returns its size,
+ * TILE_CACHE_ABSENT or TILE_CACHE_ERROR, and the bytes read in *read.
+ * Touches nothing of c but the store.
+ */
+static int32_t TileCache_Copy(const tile_cache_t *c, const tile_source_t *src, uint8_t *bounce,
+                              uint32_t bounce_bytes, uint32_t key, uint32_t slot, uint32_t *read)
+{
+    const uint32_t addr = c->base + (slot * c->slot_bytes);
+    int32_t size;
+    int opened;
+    int err = 0;
+
+    *read = 0U;
+    size = src->open(src->ctx, key);
+    opened = (size >= 0);
+
+    if ((size >= 0) && ((uint32_t)size > c->slot_bytes))
+    {
+        size = TILE_CACHE_ERROR;
+    }
+
+    if (size >= 0)
+    {
+        for (uint32_t off = 0; (err == 0) && (off < (uint32_t)size); off += bounce_bytes)
+        {
+            const uint32_t n = (((uint32_t)size - off) < bounce_bytes) ? ((uint32_t)size - off) : bounce_bytes;
+
+            err = src->read(src->ctx, off, bounce, n);
+            err = (err == 0) ? c->store.write(c->store.ctx, addr + off, bounce, n) : err;
+        }
+
+        *read = (uint32_t)size;
+    }
+
+    if (opened && (src->close != 0))
+    {
+        src->close(src->ctx);
+    }
+
+    return ((err != 0) || ((size < 0) && (size != TILE_CACHE_ABSENT))) ? TILE_CACHE_ERROR : size;
+}
+
+
+/* Make slot the entry of key, size as returned by TileCache_Copy() */
+static int32_t TileCache_Publish(tile_cache_t *c, uint32_t key, uint32_t slot, int32_t size, uint32_t read)
+{
+    tile_cache_entry_t *e = &c->entries[slot];
+
+    c->stats.source_bytes += read;
+
+    if (size == TILE_CACHE_ERROR)
+    {
+        c->stats.errors++;
+        return TILE_CACHE_ERROR;
+    }
+
+    e->key = key;
+    e->bytes = (size < 0) ? 0U : (uint32_t)size;
+    e->state = (size < 0) ? TILE_CACHE_ABSENT : TILE_CACHE_OK;
+    TileCache_Touch(c, slot);
+
+    return (int32_t)slot;
+}
+
+
+/* Stream key from the source into a slot; returns the slot or a status */
+static int32_t TileCache_Load(tile_cache_t *c, uint32_t key)
+{
+    const uint32_t slot = TileCache_Victim(c);
+    uint32_t read;
+    int32_t size;
+
+    TileCache_Claim(c, slot);
+    size = TileCache_Copy(c, &c->src, c->bounce, c->bounce_bytes, key, slot, &read);
+
+    return TileCache_Publish(c, key, slot, size, read);
+}
+
+
+/*
+ * Make key resident, loading it from the source on a miss. Returns its
+ * slot (for TileCache_Read()) and its size in *bytes, TILE_CACHE_ABSENT if
+ * the source does not have it, or TILE_CACHE_ERROR.
+ */
+int TileCache_Get(tile_cache_t *c, uint32_t key, uint32_t *bytes)
+{
+    int32_t slot = TileCache_Find(c, key);
+
+    if (slot >= 0)
+    {
+        c->stats.hits++;
+        TileCache_Touch(c, (uint32_t)slot);
+    }
+    else
+    {
+        c->stats.misses++;
+        slot = TileCache_Load(c, key);
+
+        if (slot < 0)
+        {
+            return (int)slot;
+        }
+    }
+
+    if (c->entries[slot].state != TILE_CACHE_OK)
+    {
+        return TILE_CACHE_ABSENT;
+    }
+
+    if (bytes != 0)
+    {
+        *bytes = c->entries[slot].bytes;
+    }
+
+    return (int)slot;
+}
+
+
+/* Copy bytes of the object in slot, from offset, out of the store */
+int TileCache_Read(tile_cache_t *c, uint32_t slot, uint32_t offset, void *dst, uint32_t bytes)
+{
+    if ((slot >= c->slots) || (c->entries[slot].used == 0U) ||
+        (offset > c->entries[slot].bytes) || (bytes > (c->entries[slot].bytes - offset)))
+    {
+        return TILE_CACHE_INVALID_PARAM;
+    }
+
+    if (c->store.read(c->store.ctx, c->base + (slot * c->slot_bytes) + offset, dst, bytes) != 0)
+    {
+        c->stats.errors++;
+        return TILE_CACHE_ERROR;
+    }
+
+    return TILE_CACHE_OK;
+}
+
+
+/*
+ * Queue key for TileCache_Service() unless it is resident or queued
+ * already. When the queue is full the oldest request is dropped: the
+ * newest ones are nearest to where the tiles will be needed.
+ */
+void TileCache_Prefetch(tile_cache_t *c, uint32_t key)
+{
+    if (TileCache_Find(c, key) >= 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < c->queue_count; i++)
+    {
+        if (c->queue[(c->queue_head + i) % TILE_CACHE_QUEUE] == key)
+        {
+            return;
+        }
+    }
+
+    if (c->queue_count == TILE_CACHE_QUEUE)
+    {
+        c->queue_head = (c->queue_head + 1U) % TILE_CACHE_QUEUE;
+        c->queue_count--;
+    }
+
+    c->queue[(c->queue_head + c->queue_count) % TILE_CACHE_QUEUE] = key;
+    c->queue_count++;
+}
+
+
+/* Load up to max queued keys; returns how many were taken off the queue */
+uint32_t TileCache_Service(tile_cache_t *c, uint32_t max)
+{
+    uint32_t done = 0U;
+
+    while ((done < max) && (c->queue_count != 0U))
+    {
+        const uint32_t key = c->queue[c->queue_head];
+
+        c->queue_head = (c->queue_head + 1U) % TILE_CACHE_QUEUE;
+        c->queue_count--;
+        done++;
+
+        if ((TileCache_Find(c, key) < 0) && (TileCache_Load(c, key) >= 0))
+        {
+            c->stats.prefetched++;
+        }
+    }
+
+    return done;
+}
+
+
+/*
+ * TileCache_Service() in three steps, for a cache shared between tasks
+ * whose lock must not be held over the source: TileCache_ServiceBegin()
+ * (locked) takes the next queued key not resident and claims a slot for
+ * it, TileCache_ServiceFill() (unlocked) copies it from src through bounce,
+ * both separate from those of the cache, and TileCache_ServiceCommit()
+ * (locked) publishes it. The claimed slot is not handed out meanwhile;
+ * the store must allow a fill alongside reads of other slots. One fill at
+ * a time; Begin returns 0 while one is open or when the queue is empty.
+ */
+int TileCache_ServiceBegin(tile_cache_t *c, tile_cache_load_t *load)
+{
+    if ((c->loading != TILE_CACHE_NO_SLOT) || (c->slots < 2U))
+    {
+        return 0;
+    }
+
+    while (c->queue_count != 0U)
+    {
+        const uint32_t key = c->queue[c->queue_head];
+
+        c->queue_head = (c->queue_head + 1U) % TILE_CACHE_QUEUE;
+        c->queue_count--;
+
+        if (TileCache_Find(c, key) < 0)
+        {
+            load->key = key;
+            load->slot = TileCache_Victim(c);
+            load->size = TILE_CACHE_ERROR;
+            load->read = 0U;
+
+            TileCache_Claim(c, load->slot);
+            c->loading = load->slot;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+void TileCache_ServiceFill(const tile_cache_t *c, tile_cache_load_t *load, const tile_source_t *src,
+                           void *bounce, uint32_t bounce_bytes)
+{
+    load->size = TileCache_Copy(c, src, (uint8_t *)bounce, bounce_bytes, load->key, load->slot, &load->read);
+}
+
+
+/*
+ * Dropped if the cache was cleared since Begin, or the key loaded by a
+ * miss meanwhile (the slot stays empty).
+ */
+void TileCache_ServiceCommit(tile_cache_t *c, const tile_cache_load_t *load)
+{
+    if (c->loading != load->slot)
+    {
+        return;
+    }
+
+    c->loading = TILE_CACHE_NO_SLOT;
+
+    if (TileCache_Find(c, load->key) >= 0)
+    {
+        c->stats.source_bytes += load->read;
+        return;
+    }
+
+    if (TileCache_Publish(c, load->key, load->slot, load->size, load->read) >= 0)
+    {
+        c->stats.prefetched++;
+    }
+}
+
+
+void TileCache_GetStats(const tile_cache_t *c, tile_cache_stats_t *stats)
+{
+    *stats = c->stats;
+}
@@ -0,0 +1,135 @@
+#ifndef __TILE_CACHE_H
+#define __TILE_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * LRU cache of reference tiles (or any blobs identified by a 32-bit key) in
+ * a slow external memory, in front of an even slower source.
+ *
+ * On the board the store is the QSPI PSRAM and the source the SD card; on
+ * the host both are plain callbacks (tools/tile_cache_bench.c). The store
+ * is split into fixed slots of slot_bytes at base + slot * slot_bytes. A
+ * miss streams the object from the source into the least recently used
+ * slot through the caller's bounce buffer, so nothing is allocated and the
+ * object never needs to fit in RAM. Keys the source does not have are
+ * remembered too (TILE_CACHE_ABSENT), so asking again costs nothing.
+ *
+ * TileCache_Prefetch() queues keys; TileCache_Service() loads them, from a
+ * context that would otherwise be idle. A prefetched tile counts as a hit
+ * when it is asked for. TileCache_ServiceBegin() / Fill() / Commit() do
+ * the same with the copy outside the caller's lock.
+ *
+ * Lookup is a linear scan of the slot table: with a few hundred slots that
+ * is far below the cost of a single store access. An entry returned by
+ * TileCache_Get() is only evicted after slots other keys have been loaded.
+ * No locking: callers sharing a cache between tasks serialise access,
+ * except around TileCache_ServiceFill().
+ */
+
+#define TILE_CACHE_QUEUE          32U
+
+/* Key of tile (tx, ty) of level, tx and ty below 16384 */
+#define TILE_CACHE_KEY(level, tx, ty)  (((uint32_t)(level) << 28) | ((uint32_t)(ty) << 14) | (uint32_t)(tx))
+
+#define TILE_CACHE_NO_KEY         0xFFFFFFFFUL
+#define TILE_CACHE_NO_SLOT        0xFFFFFFFFUL
+
+typedef enum
+{
+    TILE_CACHE_OK = 0,
+    TILE_CACHE_ERROR = -1,
+    TILE_CACHE_INVALID_PARAM = -2,
+    TILE_CACHE_ABSENT = -3              /* The source has no such key */
+} TileCache_Status;
+
+typedef struct
+{
+    /* Copy bytes between the store at addr and RAM; 0 on success */
+    int  (*read)(void *ctx, uint32_t addr, void *dst, uint32_t bytes);
+    int  (*write)(void *ctx, uint32_t addr, const void *src, uint32_t bytes);
+    void  *ctx;
+} tile_store_t;
+
+typedef struct
+{
+    /*
+     * Open the object of key: returns its size in bytes, TILE_CACHE_ABSENT
+     * if there is none, another negative value on error.
+     */
+    int32_t (*open)(void *ctx, uint32_t key);
+    /* Read bytes of the open object from offset into dst; 0 on success */
+    int     (*read)(void *ctx, uint32_t offset, void *dst, uint32_t bytes);
+    void    (*close)(void *ctx);
+    void     *ctx;
+} tile_source_t;
+
+typedef struct
+{
+    uint32_t key;
+    uint32_t bytes;                     /* Object size, 0 if absent */
+    uint32_t used;                      /* Access stamp, 0 for an empty slot */
+    int32_t  state;                     /* TILE_CACHE_OK or TILE_CACHE_ABSENT */
+} tile_cache_entry_t;
+
+typedef struct
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t prefetched;                /* Loaded by TileCache_Service() */
+    uint32_t evictions;
+    uint32_t errors;
+    uint32_t source_bytes;              /* Read from the source */
+} tile_cache_stats_t;
+
+/* A load split over TileCache_ServiceBegin() / Fill() / Commit() */
+typedef struct
+{
+    uint32_t key;
+    uint32_t slot;
+    int32_t  size;                      /* Object size, or a status */
+    uint32_t read;                      /* Bytes read from the source */
+} tile_cache_load_t;
+
+typedef struct
+{
+    tile_cache_entry_t *entries;
+    uint32_t            slots;
+    uint32_t            slot_bytes;
+    uint32_t            base;
+    tile_store_t        store;
+    tile_source_t       src;
+    uint8_t            *bounce;
+    uint32_t            bounce_bytes;
+    uint32_t            clock;
+    uint32_t            queue[TILE_CACHE_QUEUE];
+    uint32_t            queue_head;
+    uint32_t            queue_count;
+    uint32_t            loading;        /* Slot claimed by TileCache_ServiceBegin(), or TILE_CACHE_NO_SLOT */
+    tile_cache_stats_t  stats;
+} tile_cache_t;
+
+int  TileCache_Init(tile_cache_t *c, tile_cache_entry_t *entries, uint32_t slots,
+                    uint32_t base, uint32_t slot_bytes,
+                    const tile_store_t *store, const tile_source_t *src,
+                    void *bounce, uint32_t bounce_bytes);
+void TileCache_Clear(tile_cache_t *c);
+int  TileCache_Get(tile_cache_t *c, uint32_t key, uint32_t *bytes);
+int  TileCache_Read(tile_cache_t *c, uint32_t slot, uint32_t offset, void *dst, uint32_t bytes);
+void TileCache_Prefetch(tile_cache_t *c, uint32_t key);
+uint32_t TileCache_Service(tile_cache_t *c, uint32_t max);
+int  TileCache_ServiceBegin(tile_cache_t *c, tile_cache_load_t *load);
+void TileCache_ServiceFill(const tile_cache_t *c, tile_cache_load_t *load, const tile_source_t *src,
+                           void *bounce, uint32_t bounce_bytes);
+void TileCache_ServiceCommit(tile_cache_t *c, const tile_cache_load_t *load);
+void TileCache_GetStats(const tile_cache_t *c, tile_cache_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TILE_CACHE_H */
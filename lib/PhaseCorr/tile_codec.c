@@ -0,0 +1,357 @@
+#include "tile_codec.h"
+
+/* Fed to the bit reader past the end of the packed data */
+static const uint8_t tile_codec_zeros[4] = { 0U, 0U, 0U, 0U };
+
+typedef struct
+{
+    uint8_t  *out;
+    uint32_t  max;
+    uint32_t  pos;
+    uint32_t  acc;
+    uint32_t  bits;
+} tile_codec_writer_t;
+
+
+/*
+ * LOCO-I median edge detector, written as the equivalent clamp of the
+ * planar prediction a + b - c to [min(a, b), max(a, b)] (no branches)
+ */
+static inline uint32_t TileCodec_Predict(uint32_t a, uint32_t b, uint32_t c)
+{
+    const int32_t mx = (int32_t)((a > b) ? a : b);
+    const int32_t mn = (int32_t)((a > b) ? b : a);
+    int32_t g = (int32_t)(a + b) - (int32_t)c;
+
+    g = (g > mx) ? mx : g;
+
+    return (uint32_t)((g < mn) ? mn : g);
+}
+
+
+/* Zigzag residual of pixel x of row (up is the row above, 0 for the first) */
+static inline uint32_t TileCodec_Residual(const uint8_t *row, const uint8_t *up, uint32_t x)
+{
+    uint32_t pred;
+
+    if (up == 0)
+    {
+        pred = (x == 0U) ? 128U : row[x - 1U];
+    }
+    else
+    {
+        pred = (x == 0U) ? up[0] : TileCodec_Predict(row[x - 1U], up[x], up[x - 1U]);
+    }
+
+    const int32_t r = (int8_t)(uint8_t)(row[x] - pred);
+
+    return (uint32_t)(uint8_t)((r << 1) ^ (r >> 7));
+}
+
+
+/* Append the n (<= 24) low bits of v */
+static void TileCodec_Put(tile_codec_writer_t *w, uint32_t v, uint32_t n)
+{
+    w->acc = (w->acc << n) | v;
+    w->bits += n;
+
+    while (w->bits >= 8U)
+    {
+        w->bits -= 8U;
+
+        if (w->pos < w->max)
+        {
+            w->out[w->pos] = (uint8_t)(w->acc >> w->bits);
+        }
+
+        w->pos++;
+    }
+}
+
+
+static uint32_t TileCodec_CodeBits(uint32_t u, uint32_t k)
+{
+    return ((u >> k) < TILE_CODEC_ESCAPE) ? ((u >> k) + 1U + k) : (TILE_CODEC_ESCAPE + 8U);
+}
+
+
+/*
+ * Compress the w x h tile px into out (max bytes). Returns the packed size,
+ * or TILE_CODEC_ERROR if it does not fit: the caller then stores the tile
+ * as it is.
+ */
+int32_t TileCodec_Encode(const uint8_t *px, uint32_t w, uint32_t h, uint8_t *out, uint32_t max)
+{
+    tile_codec_writer_t wr = { out, max, 0U, 0U, 0U };
+    uint32_t u[TILE_CODEC_BLOCK];
+
+    if ((px == 0) || (out == 0) || (w == 0U) || (h == 0U))
+    {
+        return TILE_CODEC_INVALID_PARAM;
+    }
+
+    for (uint32_t y = 0; y < h; y++)
+    {
+        const uint8_t *row = &px[y * w];
+        const uint8_t *up = (y == 0U) ? 0 : (row - w);
+
+        for (uint32_t x0 = 0; x0 < w; x0 += TILE_CODEC_BLOCK)
+        {
+            const uint32_t n = ((w - x0) < TILE_CODEC_BLOCK) ? (w - x0) : TILE_CODEC_BLOCK;
+            uint32_t best_k = 0U;
+            uint32_t best = 0xFFFFFFFFUL;
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                u[i] = TileCodec_Residual(row, up, x0 + i);
+            }
+
+            for (uint32_t k = 0; k < 8U; k++)
+            {
+                uint32_t cost = 0U;
+
+                for (uint32_t i = 0; i < n; i++)
+                {
+                    cost += TileCodec_CodeBits(u[i], k);
+                }
+
+                if (cost < best)
+                {
+                    best = cost;
+                    best_k = k;
+                }
+            }
+
+            TileCodec_Put(&wr, best_k, 3U);
+
+            for (uint32_t i = 0; i < n; i++)
+            {
+                const uint32_t q = u[i] >> best_k;
+
+                if (q < TILE_CODEC_ESCAPE)
+                {
+                    TileCodec_Put(&wr, 1U, q + 1U);
+                    TileCodec_Put(&wr, u[i] & ((1U << best_k) - 1U), best_k);
+                }
+                else
+                {
+                    TileCodec_Put(&wr, 0U, TILE_CODEC_ESCAPE);
+                    TileCodec_Put(&wr, u[i], 8U);
+                }
+            }
+
+            if (wr.pos > max)
+            {
+                return TILE_CODEC_ERROR;
+            }
+        }
+    }
+
+    if (wr.bits != 0U)
+    {
+        TileCodec_Put(&wr, 0U, 8U - wr.bits);
+    }
+
+    return (wr.pos <= max) ? (int32_t)wr.pos : TILE_CODEC_ERROR;
+}
+
+
+/*
+ * Prepare to decode packed_bytes of packed data. The first first_bytes of
+ * them are already at first (may be 0); the rest is read with read(ctx)
+ * into buf, buf_bytes at a time. With everything at first, buf and read
+ * may be 0.
+ */
+void TileCodec_InitStream(tile_codec_stream_t *s, uint32_t packed_bytes,
+                          const void *first, uint32_t first_bytes,
+                          void *buf, uint32_t buf_bytes,
+                          int (*read)(void *ctx, void *dst, uint32_t bytes), void *ctx)
+{
+    first_bytes = (first_bytes < packed_bytes) ? first_bytes : packed_bytes;
+
+    s->read = read;
+    s->ctx = ctx;
+    s->buf = (uint8_t *)buf;
+    s->buf_bytes = buf_bytes;
+    s->p = (const uint8_t *)first;
+    s->end = s->p + first_bytes;
+    s->remain = packed_bytes - first_bytes;
+    s->padded = 0U;
+    s->acc = 0U;
+    s->bits = 0U;
+}
+
+
+/* Next piece of input once s->p has reached s->end */
+static int TileCodec_Next(tile_codec_stream_t *s)
+{
+    if (s->remain == 0U)
+    {
+        s->p = tile_codec_zeros;
+        s->end = tile_codec_zeros + sizeof(tile_codec_zeros);
+        s->padded += (uint32_t)sizeof(tile_codec_zeros);
+
+        return TILE_CODEC_OK;
+    }
+
+    const uint32_t n = (s->remain < s->buf_bytes) ? s->remain : s->buf_bytes;
+
+    if ((s->read == 0) || (n == 0U) || (s->read(s->ctx, s->buf, n) != 0))
+    {
+        return TILE_CODEC_ERROR;
+    }
+
+    s->p = s->buf;
+    s->end = s->buf + n;
+    s->remain -= n;
+
+    return TILE_CODEC_OK;
+}
+
+
+/* Slow refill, byte by byte, near the end of the bytes at hand */
+static int TileCodec_RefillSlow(tile_codec_stream_t *s, const uint8_t **p, const uint8_t **end,
+                                uint32_t *acc, uint32_t *bits)
+{
+    while (*bits < 24U)
+    {
+        if (*p == *end)
+        {
+            s->p = *p;
+
+            if (TileCodec_Next(s) != TILE_CODEC_OK)
+            {
+                return TILE_CODEC_ERROR;
+            }
+
+            *p = s->p;
+            *end = s->end;
+        }
+
+        *acc |= (uint32_t)*(*p)++ << (24U - *bits);
+        *bits += 8U;
+    }
+
+    return TILE_CODEC_OK;
+}
+
+
+/* Decode the w x h tile of the stream into out */
+int TileCodec_Decode(tile_codec_stream_t *s, uint8_t *out, uint32_t w, uint32_t h)
+{
+    const uint8_t *p = s->p;
+    const uint8_t *end = s->end;
+    uint32_t acc = s->acc;
+    uint32_t bits = s->bits;
+
+    if ((out == 0) || (w == 0U) || (h == 0U))
+    {
+        return TILE_CODEC_INVALID_PARAM;
+    }
+
+/*
+ * At least 24 valid bits: enough for a block header or any one code. With
+ * four bytes at hand a single big-endian load tops the reservoir up (the
+ * bits of a partly used byte are loaded again, at the same place).
+ */
+#define TILE_CODEC_REFILL()                                                      \
+    if ((end - p) >= 4)                                                          \
+    {                                                                            \
+        acc |= (((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |                \
+                ((uint32_t)p[2] << 8) | (uint32_t)p[3]) >> bits;                 \
+        p += (31U - bits) >> 3;                                                  \
+        bits |= 24U;                                                             \
+    }                                                                            \
+    else if (TileCodec_RefillSlow(s, &p, &end, &acc, &bits) != TILE_CODEC_OK)    \
+    {                                                                            \
+        return TILE_CODEC_ERROR;                                                 \
+    }
+
+    for (uint32_t y = 0; y < h; y++)
+    {
+        uint8_t *row = &out[y * w];
+        const uint8_t *up = row - w;
+        uint32_t a = 128U;
+
+        for (uint32_t x0 = 0; x0 < w; x0 += TILE_CODEC_BLOCK)
+        {
+            const uint32_t n = ((w - x0) < TILE_CODEC_BLOCK) ? (w - x0) : TILE_CODEC_BLOCK;
+            uint32_t k;
+
+            TILE_CODEC_REFILL();
+            k = acc >> 29;
+            acc <<= 3;
+            bits -= 3U;
+
+            for (uint32_t x = x0; x < (x0 + n); x++)
+            {
+                uint32_t u;
+
+                TILE_CODEC_REFILL();
+
+                if ((acc >> (32U - TILE_CODEC_ESCAPE)) == 0U)
+                {
+                    u = (acc << TILE_CODEC_ESCAPE) >> 24;
+                    acc <<= TILE_CODEC_ESCAPE + 8U;
+                    bits -= TILE_CODEC_ESCAPE + 8U;
+                }
+                else
+                {
+                    const uint32_t q = (uint32_t)__builtin_clz(acc);
+
+                    acc <<= q + 1U;
+                    u = (q << k) | ((acc >> 1) >> (31U - k));
+                    acc <<= k;
+                    bits -= q + 1U + k;
+                }
+
+                /* Same prediction as TileCodec_Residual(), a is the left pixel */
+                if (y == 0U)
+                {
+                    a = (a + ((u >> 1) ^ (0U - (u & 1U)))) & 0xFFU;
+                }
+                else if (x == 0U)
+                {
+                    a = (up[0] + ((u >> 1) ^ (0U - (u & 1U)))) & 0xFFU;
+                }
+                else
+                {
+                    a = (TileCodec_Predict(a, up[x], up[x - 1U]) + ((u >> 1) ^ (0U - (u & 1U)))) & 0xFFU;
+                }
+
+                row[x] = (uint8_t)a;
+            }
+        }
+    }
+
+#undef TILE_CODEC_REFILL
+
+    s->p = p;
+    s->end = end;
+    s->acc = acc;
+    s->bits = bits;
+
+    /* Padding pulled into the reservoir must not have been consumed */
+    if ((s->padded != 0U) && (((s->padded - (uint32_t)(end - p)) * 8U) > bits))
+    {
+        return TILE_CODEC_BAD_DATA;
+    }
+
+    return TILE_CODEC_OK;
+}
+
+
+/* Decode a tile whose packed data is all in memory */
+int TileCodec_DecodeBuffer(const void *in, uint32_t bytes, uint8_t *out, uint32_t w, uint32_t h)
+{
+    tile_codec_stream_t s;
+
+    if (in == 0)
+    {
+        return TILE_CODEC_INVALID_PARAM;
+    }
+
+    TileCodec_InitStream(&s, bytes, in, bytes, 0, 0U, 0, 0);
+
+    return TileCodec_Decode(&s, out, w, h);
+}
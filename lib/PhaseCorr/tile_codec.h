@@ -0,0 +1,74 @@
+#ifndef __TILE_CODEC_H
+#define __TILE_CODEC_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * Lossless compression of Y8 map tiles.
+ *
+ * Each pixel is predicted from its left (a), upper (b) and upper-left (c)
+ * neighbours with the LOCO-I median edge detector: min(a, b) if c >=
+ * max(a, b), max(a, b) if c <= min(a, b), a + b - c otherwise. The first
+ * row uses a (128 for the first pixel), the first column b. The residual,
+ * modulo 256 and zigzag mapped to 0..255 (0, -1, 1, -2, ...), is Rice
+ * coded with one parameter k (0..7) per TILE_CODEC_BLOCK pixels of a row:
+ *   block:   k in 3 bits, then one code per pixel
+ *   code:    q = u >> k < 16: q zero bits, a one bit, the low k bits of u
+ *            otherwise:       16 zero bits, u in 8 bits
+ * Bits are packed MSB first. Aerial imagery is smooth at tile scale, so
+ * residuals are small and this typically halves the tile.
+ *
+ * Decoding streams the packed bytes through a caller buffer, refilled by a
+ * read callback (the SD card on the board), and writes the pixels straight
+ * into the output tile; nothing is allocated. The inner loops are a count
+ * leading zeros, two shifts and the predictor per pixel.
+ */
+
+#define TILE_CODEC_BLOCK          16U
+#define TILE_CODEC_ESCAPE         16U
+
+/* Worst-case packed size: every block header plus 24-bit escapes */
+#define TILE_CODEC_MAX_BYTES(w, h) \
+    ((((uint32_t)(h) * (((uint32_t)(w) + TILE_CODEC_BLOCK - 1U) / TILE_CODEC_BLOCK) * 3U) + \
+      ((uint32_t)(w) * (uint32_t)(h) * 24U) + 7U) / 8U)
+
+typedef enum
+{
+    TILE_CODEC_OK = 0,
+    TILE_CODEC_ERROR = -1,
+    TILE_CODEC_INVALID_PARAM = -2,
+    TILE_CODEC_BAD_DATA = -3            /* Truncated or corrupt packed data */
+} TileCodec_Status;
+
+typedef struct
+{
+    /* Read exactly bytes more packed bytes into dst; 0 on success */
+    int           (*read)(void *ctx, void *dst, uint32_t bytes);
+    void           *ctx;
+    uint8_t        *buf;
+    uint32_t        buf_bytes;
+    const uint8_t  *p;                  /* Unused bytes at hand: p .. end */
+    const uint8_t  *end;
+    uint32_t        remain;             /* Packed bytes still to read */
+    uint32_t        padded;             /* Zero bytes fed past the end */
+    uint32_t        acc;                /* Bit reservoir, MSB first */
+    uint32_t        bits;               /* Valid bits in acc */
+} tile_codec_stream_t;
+
+int32_t TileCodec_Encode(const uint8_t *px, uint32_t w, uint32_t h, uint8_t *out, uint32_t max);
+void    TileCodec_InitStream(tile_codec_stream_t *s, uint32_t packed_bytes,
+                             const void *first, uint32_t first_bytes,
+                             void *buf, uint32_t buf_bytes,
+                             int (*read)(void *ctx, void *dst, uint32_t bytes), void *ctx);
+int     TileCodec_Decode(tile_codec_stream_t *s, uint8_t *out, uint32_t w, uint32_t h);
+int     TileCodec_DecodeBuffer(const void *in, uint32_t bytes, uint8_t *out, uint32_t w, uint32_t h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TILE_CODEC_H */
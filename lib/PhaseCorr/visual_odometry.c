@@ -0,0 +1,165 @@
+#include "visual_odometry.h"
+
+#include <string.h>
+
+
+int VisualOdometry_Init(visual_odometry_t *vo, phase_corr_t *pc, const visual_odometry_config_t *cfg,
+                        float *spec_a, float *spec_b, vo_absolute_fn absolute, void *absolute_ctx)
+{
+    if ((vo == 0) || (pc == 0) || (cfg == 0) || (spec_a == 0) || (spec_b == 0) ||
+        (absolute == 0) || (cfg->anchor_every == 0U) ||
+        ((cfg->pool != 1U) && (cfg->pool != 2U) && (cfg->pool != 4U)))
+    {
+        return VISUAL_ODOMETRY_INVALID_PARAM;
+    }
+
+    memset(vo, 0, sizeof(*vo));
+
+    vo->pc = pc;
+    vo->cfg = *cfg;
+    vo->absolute = absolute;
+    vo->absolute_ctx = absolute_ctx;
+    vo->spec[0] = spec_a;
+    vo->spec[1] = spec_b;
+
+    /* Weak increments are rejected by the correlator itself */
+    PhaseCorr_SetMinConfidence(pc, cfg->min_track_psr);
+
+    return VISUAL_ODOMETRY_OK;
+}
+
+
+/* Starting estimate handed to the absolute search before the first fix */
+void VisualOdometry_SetPrior(visual_odometry_t *vo, float x, float y)
+{
+    vo->pos.x = x;
+    vo->pos.y = y;
+}
+
+
+/* Run the absolute search on the next frame regardless of the schedule */
+void VisualOdometry_ForceAnchor(visual_odometry_t *vo)
+{
+    vo->force_anchor = 1U;
+}
+
+
+/* Forget the rows VisualOdometry_Rows() took of a frame that will not be processed */
+void VisualOdometry_BeginFrame(visual_odometry_t *vo)
+{
+    vo->rows = 0U;
+}
+
+
+/*
+ * Tracking work on the first lines rows of a frame still being captured:
+ * the rows of its spectrum they complete. VisualOdometry_Process() on the
+ * same frame then only does the rest.
+ */
+int VisualOdometry_Rows(visual_odometry_t *vo, const image_t *frame, uint32_t lines)
+{
+    if (vo == 0)
+    {
+        return VISUAL_ODOMETRY_INVALID_PARAM;
+    }
+
+    const uint32_t ready = PhaseCorr_RowsReady(vo->pc, frame, vo->cfg.pool, lines);
+
+    if (ready > vo->rows)
+    {
+        if (PhaseCorr_ForwardRows(vo->pc, frame, vo->cfg.pool, vo->spec[vo->cur], vo->rows,
+                                  ready - vo->rows) != PHASE_CORR_OK)
+        {
+            return VISUAL_ODOMETRY_INVALID_PARAM;
+        }
+
+        vo->rows = ready;
+    }
+
+    return VISUAL_ODOMETRY_OK;
+}
+
+
+/*
+ * Process one frame: track it against the previous one and, when due,
+ * re-anchor it with the absolute search. *out gets the position after this
+ * frame; out->source tells which fix (if any) produced it.
+ */
+int VisualOdometry_Process(visual_odometry_t *vo, const image_t *frame, position_fix_t *out)
+{
+    phase_corr_result_t r;
+
+    if ((vo == 0) || (out == 0))
+    {
+        return VISUAL_ODOMETRY_INVALID_PARAM;
+    }
+
+    const uint32_t n = vo->pc->n;
+    const uint32_t rows = vo->rows;
+
+    vo->rows = 0U;
+
+    /* Pooled straight out of the frame, no intermediate canvas; rows already streamed are kept */
+    if (PhaseCorr_ForwardRows(vo->pc, frame, vo->cfg.pool, vo->spec[vo->cur], rows, n - rows) != PHASE_CORR_OK)
+    {
+        return VISUAL_ODOMETRY_INVALID_PARAM;
+    }
+
+    PhaseCorr_ForwardColumns(vo->pc, vo->spec[vo->cur]);
+
+    vo->pos.frame++;
+    vo->pos.source = POSITION_SOURCE_NONE;
+
+    if (vo->have_prev)
+    {
+        PhaseCorr_CrossPowerWith(vo->pc, vo->spec[vo->cur], vo->spec[vo->cur ^ 1U], 0U, n);
+        vo->incremental_runs++;
+
+        if (PhaseCorr_FindPeak(vo->pc, &r) == PHASE_CORR_OK)
+        {
+            /* frame(x) = previous(x - d): the view moved by -d over the map */
+            vo->pos.x -= r.sub_dx * (float)vo->cfg.pool;
+            vo->pos.y -= r.sub_dy * (float)vo->cfg.pool;
+            vo->pos.peak = r.peak;
+            vo->pos.psr = r.psr;
+            vo->pos.since_anchor++;
+
+            if (vo->pos.valid)
+            {
+                vo->pos.source = POSITION_SOURCE_INCREMENTAL;
+            }
+        }
+        else
+        {
+            vo->dropped++;
+            vo->force_anchor = 1U;
+        }
+    }
+
+    if (!vo->pos.valid || vo->force_anchor || (vo->pos.since_anchor >= vo->cfg.anchor_every))
+    {
+        position_fix_t fix = vo->pos;
+
+        vo->absolute_runs++;
+
+        if ((vo->absolute(vo->absolute_ctx, frame, &vo->pos, &fix) == 0) &&
+            (fix.psr >= vo->cfg.min_anchor_psr))
+        {
+            vo->pos.x = fix.x;
+            vo->pos.y = fix.y;
+            vo->pos.peak = fix.peak;
+            vo->pos.psr = fix.psr;
+            vo->pos.valid = 1U;
+            vo->pos.since_anchor = 0U;
+            vo->pos.source = POSITION_SOURCE_ABSOLUTE;
+            vo->force_anchor = 0U;
+        }
+    }
+
+    vo->have_prev = 1U;
+    vo->cur ^= 1U;
+
+    *out = vo->pos;
+
+    return VISUAL_ODOMETRY_OK;
+}
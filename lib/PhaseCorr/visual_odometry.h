@@ -0,0 +1,108 @@
+#ifndef __VISUAL_ODOMETRY_H
+#define __VISUAL_ODOMETRY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "imlib.h"
+#include "phase_corr.h"
+
+/*
+ * Frame-to-frame tracking with periodic absolute re-anchoring.
+ *
+ * Consecutive frames overlap almost entirely, so most fixes come from phase
+ * correlating each frame against the previous one on a small FFT (the
+ * centred n*pool crop, pool x pool averaged down to n x n): one forward
+ * transform per frame, because the previous frame's spectrum is kept, plus
+ * the cross-power and inverse. The increments are integrated into the
+ * position.
+ *
+ * The expensive absolute search (any vo_absolute_fn: pyramid search, tile
+ * batch around the prior, ...) only runs every anchor_every frames, when an
+ * increment's confidence (peak-to-sidelobe ratio) falls below
+ * min_track_psr, or while there is no valid position yet. Both kinds of
+ * fix come out of VisualOdometry_Process() as a single position_fix_t.
+ *
+ * The tracking transform can start while the frame is still coming in:
+ * VisualOdometry_Rows() takes the rows captured so far, and
+ * VisualOdometry_Process() on the frame then only finishes it.
+ *
+ * Like the absolute searches, the tracker assumes frame and map share the
+ * same scale and orientation.
+ */
+
+typedef enum
+{
+    VISUAL_ODOMETRY_OK = 0,
+    VISUAL_ODOMETRY_ERROR = -1,
+    VISUAL_ODOMETRY_INVALID_PARAM = -2
+} VisualOdometry_Status;
+
+typedef enum
+{
+    POSITION_SOURCE_NONE = 0,           /* No new fix this frame, position held */
+    POSITION_SOURCE_ABSOLUTE = 1,
+    POSITION_SOURCE_INCREMENTAL = 2
+} Position_Source;
+
+typedef struct
+{
+    float    x;             /* Map position of the frame centre (map pixels) */
+    float    y;
+    float    peak;          /* Peak and confidence of the correlation behind this fix */
+    float    psr;
+    uint8_t  source;        /* Position_Source */
+    uint8_t  valid;         /* 0 until the first absolute fix */
+    uint16_t reserved;
+    uint32_t frame;         /* Frames processed so far */
+    uint32_t since_anchor;  /* Frames since the last absolute fix */
+} position_fix_t;
+
+/*
+ * Absolute localisation of frame. prior is the current estimate (valid may
+ * be 0). Returns 0 and fills x, y, peak and psr of fix on success.
+ */
+typedef int (*vo_absolute_fn)(void *ctx, const image_t *frame, const position_fix_t *prior,
+                              position_fix_t *fix);
+
+typedef struct
+{
+    uint32_t anchor_every;      /* Absolute search every K frames */
+    uint32_t pool;              /* Tracking crop decimation: 1, 2 or 4 */
+    float    min_track_psr;     /* Weaker increments are dropped and trigger a re-anchor */
+    float    min_anchor_psr;    /* Weaker absolute fixes are ignored */
+} visual_odometry_config_t;
+
+typedef struct
+{
+    phase_corr_t             *pc;           /* Tracking correlator, work_b unused */
+    visual_odometry_config_t  cfg;
+    vo_absolute_fn            absolute;
+    void                     *absolute_ctx;
+    float                    *spec[2];      /* Spectra of the current and previous frame */
+    uint32_t                  cur;
+    uint32_t                  rows;         /* Of spec[cur] done by VisualOdometry_Rows() */
+    uint8_t                   have_prev;
+    uint8_t                   force_anchor;
+    position_fix_t            pos;
+    uint32_t                  absolute_runs;
+    uint32_t                  incremental_runs;
+    uint32_t                  dropped;      /* Increments below min_track_psr */
+} visual_odometry_t;
+
+int  VisualOdometry_Init(visual_odometry_t *vo, phase_corr_t *pc, const visual_odometry_config_t *cfg,
+                         float *spec_a, float *spec_b, vo_absolute_fn absolute, void *absolute_ctx);
+void VisualOdometry_SetPrior(visual_odometry_t *vo, float x, float y);
+void VisualOdometry_ForceAnchor(visual_odometry_t *vo);
+void VisualOdometry_BeginFrame(visual_odometry_t *vo);
+int  VisualOdometry_Rows(visual_odometry_t *vo, const image_t *frame, uint32_t lines);
+int  VisualOdometry_Process(visual_odometry_t *vo, const image_t *frame, position_fix_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VISUAL_ODOMETRY_H */
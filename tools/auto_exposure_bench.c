@@ -0,0 +1,557 @@
+/*
+ * Exposure control in firmware (Test2/Core/Inc/auto_exposure.h) on a
+ * synthetic sensor: frames to the target from the start settings and
+ * after a change of light, and what the exposure does to the correlation.
+ *
+ *   auto_exposure_bench
+ *
+ * The driver runs unchanged over a simulated register map (sccb_mock.h):
+ * OV5640_Init(VGA, Y8) and OV5640_SetWindow() with the flight window,
+ * then the controller configured as main.c (CAMERA_AE_*), fed by frame
+ * bands of BENCH_BAND_ROWS rows (AutoExposure_AttachBands()) and setting
+ * the sensor with OV5640_SetExposure().
+ *
+ * The sensor model latches exposure (0x3500..0x3502) and gain
+ * (0x350A..0x350B) at each frame start, for the frame after
+ * (CAMERA_AE_DELAY 1). A pixel is the scene radiance x exposure x gain,
+ * plus read noise amplified by the gain, saturating at full scale, through
+ * the ISP gamma OV5640_Init() programs (OV5640_GetGammaCurve(), which the
+ * controller is given as main.c does). The scene is a texture; "patches" adds
+ * a ninth of the frame BENCH_PATCH_GAIN times brighter (roofs, water
+ * glint), where the clipping limit rather than the mean decides.
+ *
+ * A frame is on target when its mean is within BENCH_ON_TARGET of
+ * CAMERA_AE_TARGET, or when the clipping limit holds it below: at most
+ * twice CAMERA_AE_MAX_CLIPPED of the pixels clipped and the brightest
+ * allowed ones past BENCH_NEAR_CLIP of the clip level; or when taken at the
+ * end of the range the controller would go past. Reported per scene: the
+ * frames before it stays on target (2 is the least with the one-frame
+ * delay), the settings and frame reached, and SCCB writes over the last
+ * BENCH_SETTLED_FRAMES frames.
+ *
+ * Runs: each scene brightness from the start settings of main.c, over
+ * three decades of light; then steps of light while settled; then the PSR
+ * of two views of the patches scene BENCH_SHIFT_X, BENCH_SHIFT_Y px apart
+ * (PhaseCorr_Run(), n = 128) at the settings reached and at the mean level
+ * the sensor's own AEC holds with the limits of OV5640_Init()
+ * (BENCH_SENSOR_AEC_LEVEL).
+ *
+ * Checked: on target within BENCH_MAX_FRAMES frames from a first frame
+ * with levels to go by, within BENCH_MAX_FRAMES_BLIND from one more than
+ * CAMERA_AE_MAX_CLIPPED saturated or with a mean under BENCH_DARK_MEAN
+ * ("blind", a step or two of AUTO_EXPOSURE_SATURATED_STEP or the largest);
+ * no SCCB writes once settled.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "auto_exposure.h"
+#include "frame_bands.h"
+#include "ov5640.h"
+#include "phase_corr.h"
+#include "sccb_mock.h"
+#include "host_util.h"
+
+#define BENCH_W             256U
+#define BENCH_H             256U
+#define BENCH_MAP           512U
+#define BENCH_BAND_ROWS     32U
+#define BENCH_FRAMES        12U         /* Per run */
+#define BENCH_MAX_FRAMES    2U
+#define BENCH_MAX_FRAMES_BLIND 6U
+#define BENCH_SETTLED_FRAMES 4U
+#define BENCH_DARK_MEAN     1.0
+#define BENCH_ON_TARGET     0.10
+#define BENCH_NEAR_CLIP     0.85
+#define BENCH_READ_NOISE    0.002       /* Of full scale, at 1x */
+#define BENCH_PATCH_GAIN    12.0
+#define BENCH_SHIFT_X       5U
+#define BENCH_SHIFT_Y       3U
+#define BENCH_PSR_N         128U
+#define BENCH_SENSOR_AEC_LEVEL 44.0     /* Middle of the stable range of OV5640_Init() */
+
+/* main.c */
+#define CAMERA_AE_TARGET         160.0f
+#define CAMERA_AE_MAX_CLIPPED    0.005f
+#define CAMERA_AE_CLIP_LEVEL     250U
+#define CAMERA_AE_TOLERANCE      0.05f
+#define CAMERA_AE_MAX_STEP       256.0f
+#define CAMERA_AE_MIN_EXPOSURE   16U
+#define CAMERA_AE_MIN_GAIN       16U
+#define CAMERA_AE_MAX_GAIN       (8U * 16U)
+#define CAMERA_AE_DELAY          1U
+#define CAMERA_AE_START_EXPOSURE (16U * 16U)
+
+typedef struct
+{
+    const uint8_t  *map;                /* Reflectance texture, BENCH_MAP^2 */
+    uint32_t        patches;            /* Bright patches on */
+    double          light;              /* Linear full scale per line at 1x and reflectance 1 */
+    uint32_t        exposure;           /* In effect: 1/16 lines */
+    uint32_t        gain;               /* 1/16 */
+    uint32_t        noise;
+    uint8_t         curve[256];         /* ISP gamma, as programmed */
+} bench_sensor_t;
+
+typedef struct
+{
+    uint32_t  frames;                   /* Before it stays on target, BENCH_FRAMES + 1 if never */
+    int       blind;                    /* First frame saturated or black */
+    double    mean;
+    double    clipped;
+    uint32_t  exposure;
+    uint32_t  gain;
+    uint32_t  settled_writes;           /* SCCB writes over the last BENCH_SETTLED_FRAMES */
+} bench_run_t;
+
+static bench_sensor_t sensor;
+static OV5640_Object_t camera;
+static auto_exposure_t ae;
+static frame_bands_t bands;
+static uint8_t frame[BENCH_W * BENCH_H];
+
+
+/* Level out of the ISP for a signal lin of full scale */
+static double Bench_Gamma(double lin)
+{
+    const double x = (lin < 0.0) ? 0.0 : (lin * 256.0);
+
+    if (x >= 256.0)
+    {
+        return 255.0;
+    }
+
+    if (x >= 255.0)
+    {
+        return sensor.curve[255] + (255.0 - sensor.curve[255]) * (x - 255.0);
+    }
+
+    const uint32_t i = (uint32_t)x;
+
+    return sensor.curve[i] + ((double)sensor.curve[i + 1U] - sensor.curve[i]) * (x - i);
+}
+
+
+/* Signal for level, the inverse of Bench_Gamma() */
+static double Bench_Signal(double level)
+{
+    double lo = 0.0;
+    double hi = 1.0;
+
+    for (uint32_t i = 0; i < 40U; i++)
+    {
+        const double mid = 0.5 * (lo + hi);
+
+        if (Bench_Gamma(mid) < level)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return 0.5 * (lo + hi);
+}
+
+
+static double Bench_Noise(void)
+{
+    double sum = 0.0;
+
+    /* Sum of four uniforms, unit variance */
+    for (uint32_t i = 0; i < 4U; i++)
+    {
+        sensor.noise = sensor.noise * 1664525U + 1013904223U;
+        sum += (double)(sensor.noise >> 8) / 16777216.0 - 0.5;
+    }
+
+    return sum * sqrt(3.0);
+}
+
+
+/* Reflectance at map x, y: the texture around 1, and the patches */
+static double Bench_Reflectance(uint32_t x, uint32_t y)
+{
+    double r = 0.25 + 1.5 * (double)sensor.map[(y % BENCH_MAP) * BENCH_MAP + (x % BENCH_MAP)] / 255.0;
+
+    if (sensor.patches && (((x / 24U) % 3U) == 1U) && (((y / 24U) % 3U) == 1U))
+    {
+        r *= BENCH_PATCH_GAIN;
+    }
+
+    return r;
+}
+
+
+/* A frame of the view at map x0, y0 with the settings in effect */
+static void Bench_Expose(uint8_t *out, uint32_t x0, uint32_t y0)
+{
+    const double lines = (double)sensor.exposure / 16.0;
+    const double gain = (double)sensor.gain / 16.0;
+
+    for (uint32_t y = 0; y < BENCH_H; y++)
+    {
+        for (uint32_t x = 0; x < BENCH_W; x++)
+        {
+            const double lin = sensor.light * Bench_Reflectance(x0 + x, y0 + y) * lines * gain +
+                               BENCH_READ_NOISE * gain * Bench_Noise();
+            const double v = Bench_Gamma(lin) + 0.5;
+
+            out[y * BENCH_W + x] = (uint8_t)((v > 255.0) ? 255.0 : v);
+        }
+    }
+}
+
+
+static uint32_t Bench_Reg(uint16_t reg, uint32_t bytes)
+{
+    uint32_t v = 0U;
+
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        v = (v << 8) | sccb_mock.reg[reg + i];
+    }
+
+    return v;
+}
+
+
+/* Frame k: the settings latched at its start show in frame k + 1 */
+static void Bench_Frame(uint32_t seq, uint32_t *taken_exposure, uint32_t *taken_gain)
+{
+    const uint32_t exposure = Bench_Reg(OV5640_AEC_PK_EXPOSURE_19_16, 3U) & 0xFFFFFU;
+    const uint32_t gain = Bench_Reg(OV5640_AEC_PK_REAL_GAIN_9_8, 2U) & 0x3FFU;
+
+    Bench_Expose(frame, 0U, 0U);
+
+    *taken_exposure = sensor.exposure;
+    *taken_gain = sensor.gain;
+
+    sensor.exposure = exposure;
+    sensor.gain = gain;
+
+    AutoExposure_SetSeq(&ae, seq);
+    FrameBands_Begin(&bands, frame);
+
+    for (uint32_t lines = BENCH_BAND_ROWS; lines < BENCH_H; lines += BENCH_BAND_ROWS)
+    {
+        (void)FrameBands_Lines(&bands, lines);
+    }
+
+    FrameBands_End(&bands);
+}
+
+
+/* img taken with exposure, gain */
+static int Bench_OnTarget(const uint8_t *img, uint32_t exposure, uint32_t gain)
+{
+    uint32_t hist[256] = { 0 };
+    uint32_t clipped = 0U;
+    uint32_t above = 0U;
+    uint32_t l = 255U;
+    double sum = 0.0;
+
+    for (uint32_t i = 0; i < BENCH_W * BENCH_H; i++)
+    {
+        hist[img[i]]++;
+        sum += img[i];
+        clipped += (img[i] >= CAMERA_AE_CLIP_LEVEL) ? 1U : 0U;
+    }
+
+    while ((l > 0U) && ((above + hist[l]) <= (uint32_t)(CAMERA_AE_MAX_CLIPPED * BENCH_W * BENCH_H)))
+    {
+        above += hist[l--];
+    }
+
+    const double mean = sum / (BENCH_W * BENCH_H);
+    const int clip_ok = (clipped <= (uint32_t)(2.0 * CAMERA_AE_MAX_CLIPPED * BENCH_W * BENCH_H));
+    const int at_min = (exposure == ae.cfg.min_exposure) && (gain == ae.cfg.min_gain);
+    const int at_max = (exposure == ae.cfg.max_exposure) && (gain == ae.cfg.max_gain);
+
+    if ((at_min && (!clip_ok || (mean > CAMERA_AE_TARGET))) || (at_max && (mean < CAMERA_AE_TARGET)))
+    {
+        return 1;
+    }
+
+    return clip_ok && ((fabs(mean / CAMERA_AE_TARGET - 1.0) <= BENCH_ON_TARGET) ||
+                       ((mean < CAMERA_AE_TARGET) && (l >= BENCH_NEAR_CLIP * CAMERA_AE_CLIP_LEVEL)));
+}
+
+
+static int Bench_Apply(void *ctx, uint32_t exposure, uint32_t gain)
+{
+    return (OV5640_SetExposure((OV5640_Object_t *)ctx, exposure, gain) == OV5640_OK) ? 0 : -1;
+}
+
+
+/* Sensor and controller as main.c leaves them before the first frame */
+static int Bench_Start(void)
+{
+    const OV5640_Window_t window = { BENCH_W, BENCH_H, 0, 0, OV5640_BINNING_4x4 };
+    OV5640_IO_t io;
+    auto_exposure_config_t cfg = {
+        .target_mean = CAMERA_AE_TARGET,
+        .max_clipped = CAMERA_AE_MAX_CLIPPED,
+        .clip_level = CAMERA_AE_CLIP_LEVEL,
+        .curve = sensor.curve,
+        .tolerance = CAMERA_AE_TOLERANCE,
+        .max_step = CAMERA_AE_MAX_STEP,
+        .min_exposure = CAMERA_AE_MIN_EXPOSURE,
+        .min_gain = CAMERA_AE_MIN_GAIN,
+        .max_gain = CAMERA_AE_MAX_GAIN,
+        .delay = CAMERA_AE_DELAY,
+    };
+    uint32_t id;
+
+    io.Init = SccbMock_Init;
+    io.DeInit = SccbMock_DeInit;
+    io.Address = 0x3C;
+    io.ReadReg = SccbMock_ReadReg;
+    io.WriteReg = SccbMock_WriteReg;
+    io.GetTick = SccbMock_GetTick;
+
+    SccbMock_Reset();
+    memset(&camera, 0, sizeof(camera));
+    camera.Mode = PARALLEL_MODE;
+
+    if ((OV5640_RegisterBusIO(&camera, &io) != OV5640_OK) ||
+        (OV5640_ReadID(&camera, &id) != OV5640_OK) ||
+        (OV5640_Init(&camera, OV5640_R640x480, OV5640_Y8) != OV5640_OK) ||
+        (OV5640_SetWindow(&camera, &window) != OV5640_OK) ||
+        (OV5640_GetMaxExposure(&camera, &cfg.max_exposure) != OV5640_OK) ||
+        (OV5640_GetGammaCurve(&camera, sensor.curve) != OV5640_OK) ||
+        (FrameBands_Init(&bands, BENCH_W, BENCH_H, BENCH_BAND_ROWS) != FRAME_BANDS_OK) ||
+        (AutoExposure_Init(&ae, &cfg, Bench_Apply, &camera, CAMERA_AE_START_EXPOSURE,
+                           CAMERA_AE_MIN_GAIN) != AUTO_EXPOSURE_OK) ||
+        (AutoExposure_AttachBands(&ae, &bands) != AUTO_EXPOSURE_OK))
+    {
+        return -1;
+    }
+
+    /* Frame 0 is taken with the start settings */
+    sensor.exposure = CAMERA_AE_START_EXPOSURE;
+    sensor.gain = CAMERA_AE_MIN_GAIN;
+
+    return 0;
+}
+
+
+/* BENCH_FRAMES frames from seq on, at the light set */
+static void Bench_Run(uint32_t seq, bench_run_t *run)
+{
+    uint32_t writes = 0U;
+    uint32_t exposure;
+    uint32_t gain;
+
+    run->frames = BENCH_FRAMES + 1U;
+
+    for (uint32_t k = 0; k < BENCH_FRAMES; k++)
+    {
+        if (k == (BENCH_FRAMES - BENCH_SETTLED_FRAMES))
+        {
+            writes = sccb_mock.writes;
+        }
+
+        Bench_Frame(seq + k, &exposure, &gain);
+
+        if (k == 0U)
+        {
+            run->blind = (ae.saturated > CAMERA_AE_MAX_CLIPPED) || (ae.mean < BENCH_DARK_MEAN);
+        }
+
+        if (!Bench_OnTarget(frame, exposure, gain))
+        {
+            run->frames = BENCH_FRAMES + 1U;
+        }
+        else if (run->frames > BENCH_FRAMES)
+        {
+            run->frames = k;
+        }
+    }
+
+    run->mean = ae.mean;
+    run->clipped = ae.clipped;
+    run->settled_writes = sccb_mock.writes - writes;
+    AutoExposure_Get(&ae, &run->exposure, &run->gain);
+}
+
+
+static int Bench_Report(const char *name, const bench_run_t *run)
+{
+    const int ok = (run->frames <= (run->blind ? BENCH_MAX_FRAMES_BLIND : BENCH_MAX_FRAMES)) &&
+                   (run->settled_writes == 0U);
+
+    printf("%-26s %2u frames%s  expo %6.1f lines  gain %5.2fx  mean %5.1f  clipped %5.2f%%  "
+           "writes settled %u%s\n",
+           name, run->frames, run->blind ? " (blind)" : "        ", run->exposure / 16.0, run->gain / 16.0,
+           run->mean, 100.0 * run->clipped, run->settled_writes, ok ? "" : "  FAIL");
+
+    return ok;
+}
+
+
+/* Exposure at 1x for a frame mean of level */
+static uint32_t Bench_ExposureForMean(double level)
+{
+    uint32_t lo = ae.cfg.min_exposure;
+    uint32_t hi = ae.cfg.max_exposure;
+
+    sensor.gain = CAMERA_AE_MIN_GAIN;
+
+    while ((hi - lo) > 1U)
+    {
+        const uint32_t mid = (lo + hi) / 2U;
+        double sum = 0.0;
+
+        sensor.exposure = mid;
+        Bench_Expose(frame, 100U, 100U);
+
+        for (uint32_t i = 0; i < BENCH_W * BENCH_H; i++)
+        {
+            sum += frame[i];
+        }
+
+        if ((sum / (BENCH_W * BENCH_H)) < level)
+        {
+            lo = mid;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return hi;
+}
+
+
+/* PSR of two views BENCH_SHIFT_X, BENCH_SHIFT_Y apart with exposure x gain total (1/16 lines at 1x) */
+static float Bench_Psr(phase_corr_t *pc, uint32_t exposure, uint32_t gain)
+{
+    static uint8_t a[BENCH_W * BENCH_H];
+    static uint8_t b[BENCH_W * BENCH_H];
+    image_t ia = { .w = BENCH_W, .h = BENCH_H, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = a };
+    image_t ib = { .w = BENCH_W, .h = BENCH_H, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = b };
+    phase_corr_result_t r;
+
+    sensor.exposure = exposure;
+    sensor.gain = gain;
+    Bench_Expose(a, 100U, 100U);
+    Bench_Expose(b, 100U + BENCH_SHIFT_X, 100U + BENCH_SHIFT_Y);
+
+    return (PhaseCorr_Run(pc, &ib, &ia, &r) == PHASE_CORR_OK) ? r.psr : 0.0f;
+}
+
+
+int main(void)
+{
+    static const struct
+    {
+        const char *name;
+        double      lines;              /* Exposure at 1x putting the texture mean on target */
+    } scenes[] =
+    {
+        { "4x start light", 4.0 },
+        { "start light", 16.0 },
+        { "1/4 start light", 64.0 },
+        { "1/16 start light", 256.0 },
+        { "1/64 start light", 1024.0 },
+        { "1/256 start light", 4096.0 },
+    };
+    /* Signal of the target level, mean reflectance about 1 */
+    double target_lin;
+    uint8_t *map = malloc(BENCH_MAP * BENCH_MAP);
+    int ok = 1;
+    bench_run_t run;
+    char name[40];
+
+    Host_MakeTexture(map, BENCH_MAP, BENCH_MAP, 7U);
+
+    if (Bench_Start() != 0)
+    {
+        printf("driver refused the configuration\n");
+        return 1;
+    }
+
+    target_lin = Bench_Signal(CAMERA_AE_TARGET);
+    sensor.map = map;
+    sensor.noise = 1U;
+
+    printf("frames before on target (the least is %u with the settings showing a frame late)\n",
+           1U + CAMERA_AE_DELAY);
+
+    for (uint32_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++)
+    {
+        for (uint32_t patches = 0; patches < 2U; patches++)
+        {
+            if (Bench_Start() != 0)
+            {
+                printf("driver refused the configuration\n");
+                return 1;
+            }
+
+            sensor.patches = patches;
+            sensor.light = target_lin / scenes[i].lines;
+            Bench_Run(0U, &run);
+
+            snprintf(name, sizeof(name), "%s%s", scenes[i].name, patches ? " +patches" : "");
+            ok &= Bench_Report(name, &run);
+        }
+    }
+
+    /* Light steps while settled */
+    static const double steps[] = { 8.0, 1.0 / 8.0, 3.0, 1.0 / 3.0 };
+    uint32_t seq = BENCH_FRAMES;
+
+    (void)Bench_Start();
+    sensor.patches = 0U;
+    sensor.light = target_lin / 16.0;
+    Bench_Run(0U, &run);
+
+    for (uint32_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++)
+    {
+        sensor.light *= steps[i];
+        Bench_Run(seq, &run);
+        seq += BENCH_FRAMES;
+
+        snprintf(name, sizeof(name), "light x%.3g", steps[i]);
+        ok &= Bench_Report(name, &run);
+    }
+
+    /* Correlation at the settings reached and at the level the sensor's own loop holds */
+    phase_corr_t *pc = malloc(sizeof(phase_corr_t));
+    float *work_a = malloc(PHASE_CORR_WORK_FLOATS(BENCH_PSR_N) * sizeof(float));
+    float *work_b = malloc(PHASE_CORR_WORK_FLOATS(BENCH_PSR_N) * sizeof(float));
+
+    (void)PhaseCorr_Init(pc, BENCH_PSR_N, work_a, work_b);
+
+    for (uint32_t patches = 0; patches < 2U; patches++)
+    {
+        (void)Bench_Start();
+        sensor.patches = patches;
+        sensor.light = target_lin / 16.0;
+        Bench_Run(0U, &run);
+
+        const float psr_ae = Bench_Psr(pc, run.exposure, run.gain);
+        const uint32_t sensor_aec = Bench_ExposureForMean(BENCH_SENSOR_AEC_LEVEL);
+        const float psr_sensor = Bench_Psr(pc, sensor_aec, CAMERA_AE_MIN_GAIN);
+
+        printf("PSR%s, %u,%u px apart: %5.1f at %5.1f lines (firmware), %5.1f at %5.1f lines (sensor AEC level)\n",
+               patches ? " +patches" : "", BENCH_SHIFT_X, BENCH_SHIFT_Y, psr_ae, run.exposure / 16.0,
+               psr_sensor, sensor_aec / 16.0);
+    }
+
+    free(pc);
+    free(work_a);
+    free(work_b);
+    free(map);
+
+    printf("%s\n", ok ? "all scenes on target in time" : "FAILED");
+
+    return ok ? 0 : 1;
+}
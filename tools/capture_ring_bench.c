@@ -0,0 +1,358 @@
+/*
+ * Capture ring (Test2/Core/Inc/capture_ring.h) between a simulated DCMI
+ * and a camera task, on POSIX threads.
+ *
+ *   capture_ring_bench [frame.pgm ...]
+ *
+ * The DCMI thread plays the sensor: every BENCH_PERIOD_US a frame starts
+ * and its pixels arrive in BENCH_BANDS bands over BENCH_READOUT_US, copied
+ * into the buffer capture was armed with, the frame counter stamped into
+ * its first 4 bytes. At the end of the frame CaptureRing_FrameDone() runs
+ * under the ring's lock (the interrupt) and its buffer is armed next. A
+ * frame starting while capture is stopped is missed, as the DCMI would
+ * wait for the next VSYNC. Frames are the PGM files given, in turn (all
+ * of one size), or BENCH_SOURCES 160 x 120 textures.
+ *
+ * The camera task waits for the frame notification, acquires, works for
+ * 20 to 60 ms (on average longer than a frame period, as frames with a
+ * tile search are) and releases, arming capture again with the buffer
+ * Release() returns. Each frame is checked when acquired and again before
+ * release: its stamp and checksum must match the source frame, and
+ * frames must come in order.
+ *
+ * Run with 1, 2 and 3 slots. Reported: frames the sensor produced,
+ * captured, processed (and per second), dropped, missed while capture was
+ * stopped, stalls, frame end to acquire latency (mean, worst) and frames
+ * found corrupt or out of order.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "capture_ring.h"
+#include "host_util.h"
+
+#define BENCH_W              160U
+#define BENCH_H              120U
+#define BENCH_SOURCES        4U
+#define BENCH_FRAMES         90U
+#define BENCH_PERIOD_US      33333U
+#define BENCH_READOUT_US     25000U
+#define BENCH_BANDS          8U
+#define BENCH_WORK_MIN_MS    20U
+#define BENCH_WORK_MAX_MS    60U
+
+typedef struct
+{
+    /* The ring's lock, and the camera task notification */
+    pthread_mutex_t  lock;
+    pthread_cond_t   note_cond;
+    int              note;
+    int              done;
+
+    capture_ring_t   ring;
+    uint8_t         *armed;             /* Buffer capture runs into, 0 = stopped */
+
+    const uint8_t  **src;
+    uint32_t        *src_sum;
+    uint32_t         sources;
+    uint32_t         bytes;
+
+    uint32_t         produced;
+    uint32_t         missed;
+    uint32_t         bad;
+} bench_t;
+
+
+static void Bench_Sleep(uint32_t us)
+{
+    struct timespec ts = { (time_t)(us / 1000000U), (long)(us % 1000000U) * 1000L };
+
+    while (nanosleep(&ts, &ts) != 0)
+    {
+    }
+}
+
+
+static void Bench_Lock(void *ctx)
+{
+    pthread_mutex_lock(&((bench_t *)ctx)->lock);
+}
+
+
+static void Bench_Unlock(void *ctx)
+{
+    pthread_mutex_unlock(&((bench_t *)ctx)->lock);
+}
+
+
+static uint32_t Bench_NowUs(void *ctx)
+{
+    (void)ctx;
+
+    return (uint32_t)(Host_NowMs() * 1e3);
+}
+
+
+static uint32_t Bench_Sum(const uint8_t *p, uint32_t len)
+{
+    uint32_t a = 1U;
+    uint32_t b = 0U;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        a = (a + p[i]) % 65521U;
+        b = (b + a) % 65521U;
+    }
+
+    return (b << 16) | a;
+}
+
+
+/* Capture into buf from the next frame on (the HAL re-arm on the board) */
+static void Bench_Arm(bench_t *b, uint8_t *buf)
+{
+    if (buf != 0)
+    {
+        pthread_mutex_lock(&b->lock);
+        b->armed = buf;
+        pthread_mutex_unlock(&b->lock);
+    }
+}
+
+
+/* The frame is what the sensor sent for its stamp */
+static int Bench_Check(const bench_t *b, const capture_frame_t *f)
+{
+    uint32_t stamp;
+
+    memcpy(&stamp, f->data, sizeof(stamp));
+
+    return Bench_Sum(&f->data[4], b->bytes - 4U) == b->src_sum[stamp % b->sources];
+}
+
+
+static void *Bench_Dcmi(void *arg)
+{
+    bench_t *b = (bench_t *)arg;
+    const uint32_t band = b->bytes / BENCH_BANDS;
+    const double t0 = Host_NowMs();
+
+    for (uint32_t n = 0; n < BENCH_FRAMES; n++)
+    {
+        const uint8_t *src = b->src[n % b->sources];
+        uint8_t *dst;
+
+        /* VSYNC */
+        while ((Host_NowMs() - t0) * 1e3 < (double)n * BENCH_PERIOD_US)
+        {
+            Bench_Sleep(200U);
+        }
+
+        b->produced++;
+        pthread_mutex_lock(&b->lock);
+        dst = b->armed;
+        pthread_mutex_unlock(&b->lock);
+
+        if (dst == 0)
+        {
+            b->missed++;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < BENCH_BANDS; i++)
+        {
+            const uint32_t len = (i == (BENCH_BANDS - 1U)) ? (b->bytes - i * band) : band;
+
+            memcpy(&dst[i * band], &src[i * band], len);
+            Bench_Sleep(BENCH_READOUT_US / BENCH_BANDS);
+        }
+
+        memcpy(dst, &n, sizeof(n));
+
+        /* Frame end interrupt */
+        pthread_mutex_lock(&b->lock);
+        b->armed = CaptureRing_FrameDone(&b->ring);
+        b->note = 1;
+        pthread_cond_signal(&b->note_cond);
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    pthread_mutex_lock(&b->lock);
+    b->done = 1;
+    pthread_cond_signal(&b->note_cond);
+    pthread_mutex_unlock(&b->lock);
+
+    return 0;
+}
+
+
+static void *Bench_Camera(void *arg)
+{
+    bench_t *b = (bench_t *)arg;
+    uint32_t state = 7U;
+    int64_t last = -1;
+
+    for (;;)
+    {
+        capture_frame_t f;
+
+        pthread_mutex_lock(&b->lock);
+
+        while (!b->note && !b->done)
+        {
+            pthread_cond_wait(&b->note_cond, &b->lock);
+        }
+
+        const int done = !b->note && b->done;
+
+        b->note = 0;
+        pthread_mutex_unlock(&b->lock);
+
+        if (done)
+        {
+            break;
+        }
+
+        if (CaptureRing_Acquire(&b->ring, &f) != CAPTURE_RING_OK)
+        {
+            continue;
+        }
+
+        uint32_t stamp;
+
+        memcpy(&stamp, f.data, sizeof(stamp));
+        b->bad += (!Bench_Check(b, &f) || ((int64_t)stamp <= last)) ? 1U : 0U;
+        last = stamp;
+
+        state = state * 1664525U + 1013904223U;
+        Bench_Sleep(1000U * (BENCH_WORK_MIN_MS + (state >> 8) % (BENCH_WORK_MAX_MS - BENCH_WORK_MIN_MS + 1U)));
+
+        /* Not written while held */
+        b->bad += Bench_Check(b, &f) ? 0U : 1U;
+        Bench_Arm(b, CaptureRing_Release(&b->ring, &f));
+    }
+
+    return 0;
+}
+
+
+static int Bench_Run(const uint8_t **src, const uint32_t *src_sum, uint32_t sources, uint32_t bytes, uint32_t slots)
+{
+    uint8_t *bufs[CAPTURE_RING_MAX_SLOTS];
+    bench_t b;
+    capture_ring_stats_t st;
+    pthread_t dcmi, camera;
+
+    memset(&b, 0, sizeof(b));
+    pthread_mutex_init(&b.lock, 0);
+    pthread_cond_init(&b.note_cond, 0);
+    b.src = src;
+    b.src_sum = (uint32_t *)src_sum;
+    b.sources = sources;
+    b.bytes = bytes;
+
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        bufs[i] = calloc(1, bytes);
+    }
+
+    const capture_ring_os_t os = { Bench_Lock, Bench_Unlock, Bench_NowUs, &b };
+    int ok = CaptureRing_Init(&b.ring, &os, bufs, slots) == CAPTURE_RING_OK;
+
+    b.armed = CaptureRing_Start(&b.ring);
+
+    const double t0 = Host_NowMs();
+
+    pthread_create(&camera, 0, Bench_Camera, &b);
+    pthread_create(&dcmi, 0, Bench_Dcmi, &b);
+    pthread_join(dcmi, 0);
+    pthread_join(camera, 0);
+
+    const double s = (Host_NowMs() - t0) / 1e3;
+
+    CaptureRing_GetStats(&b.ring, &st);
+    ok &= (b.bad == 0U) && (st.captured == (b.produced - b.missed)) &&
+          (st.captured == (st.consumed + st.dropped + ((b.ring.ready >= 0) ? 1U : 0U)));
+
+    printf("%u slot%s  %3u frames  %3u captured  %3u processed (%4.1f/s)  %3u dropped  %3u missed  %3u stalls  "
+           "latency %5.1f ms mean %5.1f max  %u bad  %s\n",
+           slots, (slots > 1U) ? "s" : " ", b.produced, st.captured, st.consumed, st.consumed / s, st.dropped,
+           b.missed, st.stalls, st.consumed ? (double)st.latency_sum_us / st.consumed / 1e3 : 0.0,
+           st.latency_max_us / 1e3, b.bad, ok ? "OK" : "FAILED");
+
+    for (uint32_t i = 0; i < slots; i++)
+    {
+        free(bufs[i]);
+    }
+
+    pthread_cond_destroy(&b.note_cond);
+    pthread_mutex_destroy(&b.lock);
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    const uint32_t sources = (argc > 1) ? (uint32_t)(argc - 1) : BENCH_SOURCES;
+    const uint8_t **src = calloc(sources, sizeof(*src));
+    uint32_t *src_sum = calloc(sources, sizeof(*src_sum));
+    uint32_t w = BENCH_W;
+    uint32_t h = BENCH_H;
+    int ok = 1;
+
+    for (uint32_t i = 0; i < sources; i++)
+    {
+        uint8_t *img;
+
+        if (argc > 1)
+        {
+            uint32_t fw, fh;
+
+            if ((img = Host_ReadPGM(argv[i + 1], &fw, &fh)) == NULL)
+            {
+                fprintf(stderr, "cannot read %s (8-bit binary PGM expected)\n", argv[i + 1]);
+                return 1;
+            }
+
+            if ((i > 0U) && ((fw != w) || (fh != h)))
+            {
+                fprintf(stderr, "%s: %u x %u, not %u x %u as the first frame\n", argv[i + 1], fw, fh, w, h);
+                return 1;
+            }
+
+            w = fw;
+            h = fh;
+        }
+        else
+        {
+            img = malloc(w * h);
+            Host_MakeTexture(img, w, h, 11U + i);
+        }
+
+        src[i] = img;
+        src_sum[i] = Bench_Sum(&img[4], w * h - 4U);
+    }
+
+    printf("%u frame%s of %u x %u, one every %.1f ms, processing %u..%u ms\n", sources, (sources > 1U) ? "s" : "",
+           w, h, BENCH_PERIOD_US / 1e3, BENCH_WORK_MIN_MS, BENCH_WORK_MAX_MS);
+
+    for (uint32_t slots = 1U; slots <= 3U; slots++)
+    {
+        ok &= Bench_Run(src, src_sum, sources, w * h, slots);
+    }
+
+    for (uint32_t i = 0; i < sources; i++)
+    {
+        free((void *)src[i]);
+    }
+
+    free(src);
+    free(src_sum);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,305 @@
+/*
+ * FatFs over the SD driver, with and without the diskio sector cache.
+ *
+ *   fatfs_cache_bench [image]
+ *
+ * The flight storage path runs unchanged: FatFs, user_diskio.c with the
+ * sector cache (disk_cache.c), and the SD driver (sd_spi.c), over a
+ * simulated 64 MB card (sd_mock.h) whose sectors live in a file, image
+ * (a scratch file in /tmp by default). "direct" is the same path without
+ * the cache, as user_diskio.c was before it.
+ *
+ * Each workload starts on a remounted volume (FatFs' own buffers dropped;
+ * the sector cache stays, as on the target) and its data is checked.
+ * Reported: SD commands and bus calls per MB moved by f_read() /
+ * f_write(), the resulting rate at 25 MHz with BENCH_CALL_US of software
+ * per bus call, and the cache hit rate of the workload.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ff_gen_drv.h"
+#include "sd_mock.h"
+#include "sd_spi.h"
+#include "user_diskio.h"
+
+#define BENCH_SECTORS      131072U           /* 64 MB */
+#define BENCH_HZ           25e6
+#define BENCH_CALL_US      1.5
+#define BENCH_FILE_BYTES   (2U * 1024U * 1024U)
+#define BENCH_RECORD       100U              /* Log record written per f_write() */
+#define BENCH_TILE         1024U             /* Tile record read at random */
+#define BENCH_TILES        2000U
+
+typedef struct
+{
+    uint64_t  calls;
+    uint32_t  commands;
+    double    ns;
+    disk_cache_stats_t cache;
+} bench_mark_t;
+
+static sd_mock_t  bench_card;
+static FATFS      bench_fs;
+static char       bench_path[4];
+static uint8_t    bench_buf[32U * 1024U];
+
+
+static uint32_t Bench_Rand(uint32_t *state)
+{
+    *state = *state * 1664525U + 1013904223U;
+
+    return *state >> 8;
+}
+
+
+/* Content of byte i of the test file */
+static uint8_t Bench_Byte(uint32_t i)
+{
+    return (uint8_t)((i * 13U) ^ (i >> 11));
+}
+
+
+static int Bench_Check(const uint8_t *data, uint32_t offset, uint32_t bytes)
+{
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        if (data[i] != Bench_Byte(offset + i))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/* The uncached driver: every FatFs sector access goes to the card */
+static DSTATUS Direct_Initialize(BYTE pdrv)
+{
+    (void)pdrv;
+    return (SD_SPI_Init() == SD_SPI_OK) ? 0 : STA_NOINIT;
+}
+
+
+static DSTATUS Direct_Status(BYTE pdrv)
+{
+    (void)pdrv;
+    return 0;
+}
+
+
+static DRESULT Direct_Read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+    return (SD_SPI_ReadBlocks(buff, sector, count) == SD_SPI_OK) ? RES_OK : RES_ERROR;
+}
+
+
+static DRESULT Direct_Write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+    (void)pdrv;
+    return (SD_SPI_WriteBlocks(buff, sector, count) == SD_SPI_OK) ? RES_OK : RES_ERROR;
+}
+
+
+static DRESULT Direct_Ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+    (void)pdrv;
+
+    switch (cmd)
+    {
+    case CTRL_SYNC:
+        return (SD_SPI_Sync() == SD_SPI_OK) ? RES_OK : RES_ERROR;
+
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = 512;
+        return RES_OK;
+
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = 1;
+        return RES_OK;
+
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = SD_SPI_GetSectorCount();
+        return RES_OK;
+
+    default:
+        return RES_PARERR;
+    }
+}
+
+
+static const Diskio_drvTypeDef Direct_Driver =
+{
+    Direct_Initialize,
+    Direct_Status,
+    Direct_Read,
+    Direct_Write,
+    Direct_Ioctl,
+};
+
+
+static bench_mark_t Bench_Mark(void)
+{
+    bench_mark_t m = { bench_card.stats.calls, bench_card.stats.commands, bench_card.now_ns, { 0 } };
+
+    USER_GetCacheStats(&m.cache);
+
+    return m;
+}
+
+
+static void Bench_Report(const char *driver, const char *work, const bench_mark_t *a,
+                         uint32_t bytes, int cached, int ok)
+{
+    const bench_mark_t b = Bench_Mark();
+    const double mb = bytes / (1024.0 * 1024.0);
+
+    printf("%-7s %-22s %8.1f cmd/MB %9.1f calls/MB %6.2f MB/s",
+           driver, work, (b.commands - a->commands) / mb, (double)(b.calls - a->calls) / mb,
+           mb / ((b.ns - a->ns) * 1e-9));
+
+    if (cached)
+    {
+        const uint32_t hits = b.cache.hits - a->cache.hits;
+        const uint32_t lookups = hits + (b.cache.misses - a->cache.misses);
+
+        printf("  hits %5.1f%% of %6u (%u ahead, %u bypassed)",
+               100.0 * hits / (double)(lookups ? lookups : 1U), lookups,
+               b.cache.ahead - a->cache.ahead, b.cache.bypassed - a->cache.bypassed);
+    }
+
+    printf("  %s\n", ok ? "OK" : "MISMATCH");
+}
+
+
+/* Mount afresh: FatFs reads the boot sector and FAT again */
+static int Bench_Mount(void)
+{
+    return (f_mount(0, bench_path, 0) == FR_OK) && (f_mount(&bench_fs, bench_path, 1) == FR_OK);
+}
+
+
+static int Bench_Driver(const char *name, const Diskio_drvTypeDef *driver, uint8_t *image)
+{
+    const int cached = (driver == &USER_Driver);
+    bench_mark_t m;
+    FIL f;
+    UINT n;
+    uint32_t state = 3U;
+    int all = 1;
+    int ok;
+
+    memset(image, 0, (size_t)BENCH_SECTORS * SD_MOCK_BLOCK);
+    SdMock_Init(&bench_card, image, BENCH_SECTORS, BENCH_HZ, BENCH_CALL_US * 1e3, 1);
+    SD_SPI_SetBus(&bench_card.bus);
+
+    if ((FATFS_LinkDriver(driver, bench_path) != 0U) ||
+        (f_mkfs(bench_path, FM_ANY, 4096U, bench_buf, sizeof(bench_buf)) != FR_OK) || !Bench_Mount())
+    {
+        printf("%s: no volume\n", name);
+        return 0;
+    }
+
+    /* Log records appended one f_write() at a time */
+    ok = f_open(&f, "LOG.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK;
+    m = Bench_Mark();
+
+    for (uint32_t off = 0; ok && (off < BENCH_FILE_BYTES); off += BENCH_RECORD)
+    {
+        const uint32_t len = ((BENCH_FILE_BYTES - off) < BENCH_RECORD) ? (BENCH_FILE_BYTES - off) : BENCH_RECORD;
+
+        for (uint32_t i = 0; i < len; i++)
+        {
+            bench_buf[i] = Bench_Byte(off + i);
+        }
+
+        ok = (f_write(&f, bench_buf, len, &n) == FR_OK) && (n == len);
+    }
+
+    ok &= f_close(&f) == FR_OK;
+    Bench_Report(name, "write 100 B records", &m, BENCH_FILE_BYTES, cached, ok);
+    all &= ok;
+
+    /* Sequential reads: small through FatFs' sector buffer, large straight into bench_buf */
+    for (uint32_t chunk = 256U; chunk <= sizeof(bench_buf); chunk *= 128U)
+    {
+        char work[32];
+
+        ok = Bench_Mount() && (f_open(&f, "LOG.BIN", FA_READ) == FR_OK);
+        m = Bench_Mark();
+
+        for (uint32_t off = 0; ok && (off < BENCH_FILE_BYTES); off += chunk)
+        {
+            ok = (f_read(&f, bench_buf, chunk, &n) == FR_OK) && (n == chunk) && Bench_Check(bench_buf, off, chunk);
+        }
+
+        ok &= f_close(&f) == FR_OK;
+        snprintf(work, sizeof(work), "read %u B sequential", chunk);
+        Bench_Report(name, work, &m, BENCH_FILE_BYTES, cached, ok);
+        all &= ok;
+    }
+
+    /* Tile records at random offsets */
+    ok = Bench_Mount() && (f_open(&f, "LOG.BIN", FA_READ) == FR_OK);
+    m = Bench_Mark();
+
+    for (uint32_t t = 0; ok && (t < BENCH_TILES); t++)
+    {
+        const uint32_t off = (Bench_Rand(&state) % (BENCH_FILE_BYTES / BENCH_TILE)) * BENCH_TILE;
+
+        ok = (f_lseek(&f, off) == FR_OK) && (f_read(&f, bench_buf, BENCH_TILE, &n) == FR_OK) &&
+             (n == BENCH_TILE) && Bench_Check(bench_buf, off, BENCH_TILE);
+    }
+
+    ok &= f_close(&f) == FR_OK;
+    Bench_Report(name, "read 1 KB random", &m, BENCH_TILES * BENCH_TILE, cached, ok);
+    all &= ok;
+
+    all &= bench_card.stats.errors == 0U;
+    f_mount(0, bench_path, 0);
+    SD_SPI_ReleaseBus();
+    FATFS_UnLinkDriver(bench_path);
+
+    return all;
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 1) ? argv[1] : "/tmp/fatfs_cache_bench.img";
+    const size_t bytes = (size_t)BENCH_SECTORS * SD_MOCK_BLOCK;
+    uint8_t *image;
+    int fd;
+    int ok = 1;
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if ((fd < 0) || (ftruncate(fd, (off_t)bytes) != 0))
+    {
+        perror(path);
+        return 1;
+    }
+
+    image = mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (image == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    ok &= Bench_Driver("direct", &Direct_Driver, image);
+    ok &= Bench_Driver("cached", &USER_Driver, image);
+
+    munmap(image, bytes);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+/*
+ * Host benchmark for the Fourier-Mellin rotation/scale stage.
+ *
+ * Renders frames out of a synthetic map with a known rotation, scale and
+ * shift w.r.t. the reference tile, recovers them with FourierMellin_Run()
+ * and reports the error and the time per fix. The log-polar table build is
+ * timed separately: it runs once per FFT size, not per frame.
+ *
+ *   make -C tools && tools/build/fourier_mellin_bench
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fourier_mellin.h"
+#include "host_util.h"
+
+#define BENCH_MAP_SIZE     1024U
+#define BENCH_N            256U
+#define BENCH_M            128U
+#define BENCH_RUNS         5U
+#define BENCH_PI           3.14159265358979323846
+
+typedef struct
+{
+    float   angle;
+    float   scale;
+    int32_t dx;
+    int32_t dy;
+} bench_case_t;
+
+static const bench_case_t bench_cases[] =
+{
+    {    0.0f, 1.00f,   7,  -4 },
+    {   12.0f, 1.00f,  -3,   9 },
+    {  -35.0f, 1.10f,   5,   5 },
+    {   70.0f, 0.90f, -11,   2 },
+    {  150.0f, 1.20f,   0,  -6 },
+    { -120.0f, 0.80f,   4,   0 },
+};
+
+
+/*
+ * Frame whose content is the map around (cx, cy) + (dx, dy) turned by
+ * angle and magnified by scale about the frame centre.
+ */
+static void Bench_Render(const uint8_t *map, uint8_t *dst, uint32_t n, float cx, float cy,
+                         const bench_case_t *bc)
+{
+    const double a = -(double)bc->angle * BENCH_PI / 180.0;
+    const float c = (float)cos(a) / bc->scale;
+    const float s = (float)sin(a) / bc->scale;
+    const float half = (float)n * 0.5f;
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            const float u = (float)x - half;
+            const float v = (float)y - half;
+            const float sx = cx + (float)bc->dx + (c * u) - (s * v);
+            const float sy = cy + (float)bc->dy + (s * u) + (c * v);
+            const int32_t ix = (int32_t)floorf(sx);
+            const int32_t iy = (int32_t)floorf(sy);
+            const float fx = sx - (float)ix;
+            const float fy = sy - (float)iy;
+            const uint8_t *p = &map[(uint32_t)iy * BENCH_MAP_SIZE + (uint32_t)ix];
+            const float top = p[0] + (fx * (p[1] - p[0]));
+            const float bot = p[BENCH_MAP_SIZE] + (fx * (p[BENCH_MAP_SIZE + 1U] - p[BENCH_MAP_SIZE]));
+
+            dst[y * n + x] = (uint8_t)(top + (fy * (bot - top)) + 0.5f);
+        }
+    }
+}
+
+
+int main(void)
+{
+    uint8_t *map = malloc(BENCH_MAP_SIZE * BENCH_MAP_SIZE);
+    uint8_t *ref_px = malloc(BENCH_N * BENCH_N);
+    uint8_t *frame_px = malloc(BENCH_N * BENCH_N);
+    uint8_t *canvas = malloc(BENCH_N * BENCH_N);
+    float *work_a = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N) * sizeof(float));
+    float *work_b = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N) * sizeof(float));
+    float *lp_a = malloc(FOURIER_MELLIN_WORK_FLOATS(BENCH_M) * sizeof(float));
+    float *lp_b = malloc(FOURIER_MELLIN_WORK_FLOATS(BENCH_M) * sizeof(float));
+    log_polar_tap_t *taps = malloc(BENCH_M * BENCH_M * sizeof(log_polar_tap_t));
+    static phase_corr_t pc;
+    static fourier_mellin_t fm;
+    log_polar_lut_t lut = {0};
+    const float c = (float)BENCH_MAP_SIZE * 0.5f;
+    const bench_case_t still = { 0.0f, 1.0f, 0, 0 };
+    int err = 0;
+
+    Host_MakeTexture(map, BENCH_MAP_SIZE, BENCH_MAP_SIZE, 7U);
+    Bench_Render(map, ref_px, BENCH_N, c, c, &still);
+
+    image_t ref = { .w = BENCH_N, .h = BENCH_N, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = ref_px };
+    image_t frame = { .w = BENCH_N, .h = BENCH_N, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = frame_px };
+
+    double t0 = Host_NowMs();
+    (void)LogPolar_Build(&lut, BENCH_N, BENCH_M, taps);
+    printf("log-polar table %ux%u from %ux%u: %.2f ms, %u bytes\n", BENCH_M, BENCH_M, BENCH_N, BENCH_N,
+           Host_NowMs() - t0, (unsigned)(BENCH_M * BENCH_M * sizeof(log_polar_tap_t)));
+
+    (void)PhaseCorr_Init(&pc, BENCH_N, work_a, work_b);
+
+    if (FourierMellin_Init(&fm, &pc, &lut, lp_a, lp_b, canvas) != FOURIER_MELLIN_OK)
+    {
+        printf("init failed\n");
+        return 1;
+    }
+
+    const float angle_tol = 180.0f / (float)BENCH_M;
+    const float scale_tol = lut.log_step;
+
+    for (uint32_t i = 0; i < sizeof(bench_cases) / sizeof(bench_cases[0]); i++)
+    {
+        const bench_case_t *bc = &bench_cases[i];
+        fourier_mellin_result_t res = {0};
+
+        Bench_Render(map, frame_px, BENCH_N, c, c, bc);
+
+        t0 = Host_NowMs();
+
+        for (uint32_t r = 0; r < BENCH_RUNS; r++)
+        {
+            (void)FourierMellin_Run(&fm, &frame, &ref, &res);
+        }
+
+        double ms = (Host_NowMs() - t0) / BENCH_RUNS;
+
+        /* frame centre shows ref centre + d, so the derotated frame is ref shifted by -d */
+        int ok = (fabsf(res.angle - bc->angle) <= angle_tol) &&
+                 (fabsf(logf(res.scale / bc->scale)) <= scale_tol) &&
+                 (abs(res.shift.dx + bc->dx) <= 1) && (abs(res.shift.dy + bc->dy) <= 1);
+
+        printf("angle %7.1f scale %.2f shift (%3d, %3d) -> angle %7.1f scale %.3f shift (%3d, %3d)  "
+               "peaks %.3f %.3f  %6.2f ms  %s\n",
+               bc->angle, bc->scale, bc->dx, bc->dy, res.angle, res.scale, -res.shift.dx, -res.shift.dy,
+               res.lp_peak, res.shift.peak, ms, ok ? "OK" : "WRONG");
+
+        err |= !ok;
+    }
+
+    free(map);
+    free(ref_px);
+    free(frame_px);
+    free(canvas);
+    free(work_a);
+    free(work_b);
+    free(lp_a);
+    free(lp_b);
+    free(taps);
+
+    return err;
+}
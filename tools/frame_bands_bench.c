@@ -0,0 +1,407 @@
+/*
+ * Frame bands (Test2/Core/Inc/frame_bands.h): work on a frame as its rows
+ * are captured instead of after the frame end.
+ *
+ *   frame_bands_bench [map.pgm]
+ *
+ * A sensor thread flies a 640 x 480 window over the map (default a
+ * 1024 x 1024 texture), BENCH_STEP pixels a frame, and writes each frame
+ * into one of two buffers BENCH_CHUNK rows at a time over
+ * BENCH_READOUT_US, every BENCH_PERIOD_US. The camera thread tracks the
+ * frames with VisualOdometry_Process() (n = 128 on a 2 x 2 pooled crop,
+ * as the board does), and three consumers take the bands:
+ *
+ *   tracking    VisualOdometry_Rows(), as Nav_AttachBands()
+ *   histogram   256-bin histogram
+ *   jpeg        JpegY8_EncodeRows() at quality 70
+ *
+ * Two runs: "frame" hands over all bands at the frame end, "bands" hands
+ * them over as the rows arrive (woken every BENCH_BAND_ROWS rows). Both
+ * must give the same positions (bit for bit), histograms and JPEG bytes.
+ *
+ * Reported: frame end to position fix latency (mean, worst), and the share
+ * of the consumers' work done before the frame end.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "frame_bands.h"
+#include "visual_odometry.h"
+#include "jpeg_y8.h"
+#include "host_util.h"
+
+#define BENCH_W              640U
+#define BENCH_H              480U
+#define BENCH_MAP            1024U
+#define BENCH_FRAMES         60U
+#define BENCH_STEP           3U
+#define BENCH_PERIOD_US      33333U
+#define BENCH_READOUT_US     25000U
+#define BENCH_CHUNK          16U
+#define BENCH_BAND_ROWS      32U
+#define BENCH_N              128U
+#define BENCH_POOL           2U
+#define BENCH_QUALITY        70U
+#define BENCH_JPEG_MAX       (256U * 1024U)
+
+typedef struct
+{
+    /* Sensor to camera thread */
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+    uint32_t         frame;             /* Frame being written */
+    uint32_t         lines;             /* Of it */
+    uint32_t         done;              /* Frames complete */
+    double           done_ms[BENCH_FRAMES];
+
+    const uint8_t   *map;
+    uint32_t         map_w;
+    uint32_t         map_h;
+    uint8_t         *buf[2];
+
+    /* Consumers */
+    visual_odometry_t vo;
+    image_t          img;
+    uint32_t         hist[256];
+    jpeg_y8_t        enc;
+    uint8_t         *jpeg;
+    uint32_t         jpeg_len;
+    double           early_ms;          /* Consumer time before the frame end */
+    double           late_ms;           /* and after */
+
+    /* Per frame results */
+    position_fix_t   fix[BENCH_FRAMES];
+    uint32_t         hist_sum[BENCH_FRAMES];
+    uint32_t         jpeg_bytes[BENCH_FRAMES];
+    uint32_t         jpeg_sum[BENCH_FRAMES];
+    double           latency_ms[BENCH_FRAMES];
+} bench_t;
+
+static uint8_t bench_out[2][4096];
+
+
+static void Bench_Sleep(uint32_t us)
+{
+    struct timespec ts = { (time_t)(us / 1000000U), (long)(us % 1000000U) * 1000L };
+
+    while (nanosleep(&ts, &ts) != 0)
+    {
+    }
+}
+
+
+static uint32_t Bench_Sum(const uint8_t *p, uint32_t len)
+{
+    uint32_t a = 1U;
+    uint32_t b = 0U;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        a = (a + p[i]) % 65521U;
+        b = (b + a) % 65521U;
+    }
+
+    return (b << 16) | a;
+}
+
+
+static int Bench_Absolute(void *ctx, const image_t *frame, const position_fix_t *prior, position_fix_t *fix)
+{
+    (void)ctx;
+    (void)frame;
+
+    fix->x = prior->x;
+    fix->y = prior->y;
+    fix->peak = 1.0f;
+    fix->psr = 100.0f;
+
+    return 0;
+}
+
+
+static int Bench_JpegEmit(void *ctx, const uint8_t *data, uint32_t len)
+{
+    bench_t *b = (bench_t *)ctx;
+
+    if ((b->jpeg_len + len) > BENCH_JPEG_MAX)
+    {
+        return -1;
+    }
+
+    memcpy(&b->jpeg[b->jpeg_len], data, len);
+    b->jpeg_len += len;
+
+    return 0;
+}
+
+
+static void Bench_Begin(void *ctx, const uint8_t *frame, uint32_t width, uint32_t height)
+{
+    bench_t *b = (bench_t *)ctx;
+
+    b->img.w = (int)width;
+    b->img.h = (int)height;
+    b->img.bpp = IMAGE_BPP_GRAYSCALE;
+    b->img.pixels = (uint8_t *)frame;
+    VisualOdometry_BeginFrame(&b->vo);
+    memset(b->hist, 0, sizeof(b->hist));
+    b->jpeg_len = 0U;
+    (void)JpegY8_Begin(&b->enc, width, height);
+}
+
+
+static void Bench_Band(void *ctx, const uint8_t *rows, uint32_t row0, uint32_t count)
+{
+    bench_t *b = (bench_t *)ctx;
+
+    (void)VisualOdometry_Rows(&b->vo, &b->img, row0 + count);
+
+    for (uint32_t i = 0; i < count * (uint32_t)b->img.w; i++)
+    {
+        b->hist[rows[i]]++;
+    }
+
+    (void)JpegY8_EncodeRows(&b->enc, rows, (uint32_t)b->img.w, count);
+}
+
+
+static void Bench_End(void *ctx)
+{
+    (void)JpegY8_End(&((bench_t *)ctx)->enc);
+}
+
+
+static void *Bench_Sensor(void *arg)
+{
+    bench_t *b = (bench_t *)arg;
+    const double t0 = Host_NowMs();
+
+    for (uint32_t n = 0; n < BENCH_FRAMES; n++)
+    {
+        uint8_t *dst = b->buf[n & 1U];
+        const uint32_t x0 = 64U + n * BENCH_STEP;
+        const uint32_t y0 = 64U + n * BENCH_STEP / 2U;
+
+        while ((Host_NowMs() - t0) * 1e3 < (double)n * BENCH_PERIOD_US)
+        {
+            Bench_Sleep(200U);
+        }
+
+        pthread_mutex_lock(&b->lock);
+        b->frame = n;
+        b->lines = 0U;
+        pthread_mutex_unlock(&b->lock);
+
+        for (uint32_t y = 0; y < BENCH_H; y += BENCH_CHUNK)
+        {
+            for (uint32_t j = y; j < (y + BENCH_CHUNK); j++)
+            {
+                memcpy(&dst[j * BENCH_W], &b->map[(y0 + j) * b->map_w + x0], BENCH_W);
+            }
+
+            Bench_Sleep(BENCH_READOUT_US * BENCH_CHUNK / BENCH_H);
+
+            pthread_mutex_lock(&b->lock);
+            b->lines = y + BENCH_CHUNK;
+
+            if (((b->lines % BENCH_BAND_ROWS) == 0U) || (b->lines == BENCH_H))
+            {
+                if (b->lines == BENCH_H)
+                {
+                    b->done_ms[n] = Host_NowMs();
+                    b->done = n + 1U;
+                }
+
+                pthread_cond_signal(&b->cond);
+            }
+
+            pthread_mutex_unlock(&b->lock);
+        }
+    }
+
+    return 0;
+}
+
+
+static int Bench_Run(bench_t *b, int streamed)
+{
+    frame_bands_t fb;
+    const frame_band_consumer_t consumer = { Bench_Begin, Bench_Band, Bench_End, b };
+    const visual_odometry_config_t cfg = { 1000U, BENCH_POOL, 0.0f, 0.0f };
+    static phase_corr_t pc;
+    static float corr[PHASE_CORR_WORK_FLOATS(BENCH_N)];
+    static float spec[2][PHASE_CORR_WORK_FLOATS(BENCH_N)];
+    pthread_t sensor;
+    int ok = 1;
+
+    ok &= PhaseCorr_Init(&pc, BENCH_N, corr, 0) == PHASE_CORR_OK;
+    ok &= VisualOdometry_Init(&b->vo, &pc, &cfg, spec[0], spec[1], Bench_Absolute, 0) == VISUAL_ODOMETRY_OK;
+    ok &= FrameBands_Init(&fb, BENCH_W, BENCH_H, BENCH_BAND_ROWS) == FRAME_BANDS_OK;
+    ok &= FrameBands_Attach(&fb, &consumer) == FRAME_BANDS_OK;
+
+    b->frame = 0U;
+    b->lines = 0U;
+    b->done = 0U;
+    b->early_ms = 0.0;
+    b->late_ms = 0.0;
+
+    pthread_create(&sensor, 0, Bench_Sensor, b);
+
+    for (uint32_t n = 0; n < BENCH_FRAMES; n++)
+    {
+        const uint8_t *frame = b->buf[n & 1U];
+        uint32_t lines = 0U;
+        double t;
+
+        /* The frame as it comes in */
+        for (;;)
+        {
+            pthread_mutex_lock(&b->lock);
+
+            while ((b->done <= n) && (!streamed || (b->frame != n) || (b->lines == lines)))
+            {
+                pthread_cond_wait(&b->cond, &b->lock);
+            }
+
+            lines = (b->done > n) ? BENCH_H : b->lines;
+            pthread_mutex_unlock(&b->lock);
+
+            if (lines == BENCH_H)
+            {
+                break;
+            }
+
+            if (fb.frame != frame)
+            {
+                FrameBands_Begin(&fb, frame);
+            }
+
+            t = Host_NowMs();
+            (void)FrameBands_Lines(&fb, lines);
+            b->early_ms += Host_NowMs() - t;
+        }
+
+        /* Frame end */
+        t = Host_NowMs();
+
+        if (fb.frame != frame)
+        {
+            FrameBands_Begin(&fb, frame);
+        }
+
+        FrameBands_End(&fb);
+        ok &= VisualOdometry_Process(&b->vo, &b->img, &b->fix[n]) == VISUAL_ODOMETRY_OK;
+
+        const double end = Host_NowMs();
+
+        b->late_ms += end - t;
+        b->latency_ms[n] = end - b->done_ms[n];
+        b->hist_sum[n] = Bench_Sum((const uint8_t *)b->hist, sizeof(b->hist));
+        b->jpeg_bytes[n] = b->jpeg_len;
+        b->jpeg_sum[n] = Bench_Sum(b->jpeg, b->jpeg_len);
+
+        /* The sensor must not have overtaken the frame */
+        pthread_mutex_lock(&b->lock);
+        ok &= (b->frame <= (n + 1U));
+        pthread_mutex_unlock(&b->lock);
+    }
+
+    pthread_join(sensor, 0);
+
+    double sum = 0.0;
+    double max = 0.0;
+
+    for (uint32_t n = 0; n < BENCH_FRAMES; n++)
+    {
+        sum += b->latency_ms[n];
+        max = (b->latency_ms[n] > max) ? b->latency_ms[n] : max;
+    }
+
+    printf("%-6s  latency %6.3f ms mean %6.3f max  work %6.3f ms/frame, %4.1f%% before the frame end  %s\n",
+           streamed ? "bands" : "frame", sum / BENCH_FRAMES, max, (b->early_ms + b->late_ms) / BENCH_FRAMES,
+           100.0 * b->early_ms / (b->early_ms + b->late_ms), ok ? "OK" : "FAILED");
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    static bench_t frame;
+    static bench_t bands;
+    uint32_t w = BENCH_MAP;
+    uint32_t h = BENCH_MAP;
+    uint8_t *map;
+    int ok = 1;
+
+    if (argc > 1)
+    {
+        if ((map = Host_ReadPGM(argv[1], &w, &h)) == NULL)
+        {
+            fprintf(stderr, "cannot read %s (8-bit binary PGM expected)\n", argv[1]);
+            return 1;
+        }
+
+        if ((w < (128U + BENCH_W + BENCH_FRAMES * BENCH_STEP)) || (h < (128U + BENCH_H + BENCH_FRAMES * BENCH_STEP)))
+        {
+            fprintf(stderr, "%s: %u x %u, too small for the flight\n", argv[1], w, h);
+            return 1;
+        }
+    }
+    else
+    {
+        map = malloc(w * h);
+        Host_MakeTexture(map, w, h, 3U);
+    }
+
+    printf("%u frames of %u x %u, %u rows over %.1f ms every %.1f ms, bands of %u rows\n", BENCH_FRAMES, BENCH_W,
+           BENCH_H, BENCH_H, BENCH_READOUT_US / 1e3, BENCH_PERIOD_US / 1e3, BENCH_BAND_ROWS);
+
+    bench_t *runs[2] = { &frame, &bands };
+
+    for (uint32_t r = 0; r < 2U; r++)
+    {
+        bench_t *b = runs[r];
+        const jpeg_y8_sink_t sink = { Bench_JpegEmit, 0, b };
+
+        pthread_mutex_init(&b->lock, 0);
+        pthread_cond_init(&b->cond, 0);
+        b->map = map;
+        b->map_w = w;
+        b->map_h = h;
+        b->buf[0] = malloc(BENCH_W * BENCH_H);
+        b->buf[1] = malloc(BENCH_W * BENCH_H);
+        b->jpeg = malloc(BENCH_JPEG_MAX);
+        ok &= JpegY8_Init(&b->enc, BENCH_QUALITY, bench_out[0], bench_out[1], sizeof(bench_out[0]), &sink) == JPEG_Y8_OK;
+        ok &= Bench_Run(b, (int)r);
+    }
+
+    /* Same results either way */
+    int same = 1;
+
+    for (uint32_t n = 0; n < BENCH_FRAMES; n++)
+    {
+        same &= (memcmp(&frame.fix[n], &bands.fix[n], sizeof(frame.fix[n])) == 0);
+        same &= (frame.hist_sum[n] == bands.hist_sum[n]);
+        same &= (frame.jpeg_bytes[n] == bands.jpeg_bytes[n]) && (frame.jpeg_sum[n] == bands.jpeg_sum[n]);
+    }
+
+    printf("positions, histograms and JPEG %s; track %.1f, %.1f px (flown %u, %u)\n",
+           same ? "identical" : "DIFFER", bands.fix[BENCH_FRAMES - 1U].x, bands.fix[BENCH_FRAMES - 1U].y,
+           (BENCH_FRAMES - 1U) * BENCH_STEP, (BENCH_FRAMES - 1U) * BENCH_STEP / 2U);
+
+    for (uint32_t r = 0; r < 2U; r++)
+    {
+        free(runs[r]->buf[0]);
+        free(runs[r]->buf[1]);
+        free(runs[r]->jpeg);
+    }
+
+    free(map);
+
+    return (ok && same) ? 0 : 1;
+}
@@ -0,0 +1,12 @@
+/*
+ * Host build stand-in for CMSIS-DSP.
+ *
+ * The STM32IPL headers include arm_math.h but the declarations pulled in by
+ * the tools (image_t and friends) do not use anything from it.
+ */
+#ifndef __HOST_ARM_MATH_H
+#define __HOST_ARM_MATH_H
+
+#include <math.h>
+
+#endif /* __HOST_ARM_MATH_H */
@@ -0,0 +1,13 @@
+/*
+ * Host build stand-in for the CMSIS compiler header.
+ *
+ * ov5640_reg.h includes cmsis_compiler.h for the stdint.h types it pulls
+ * in; nothing else of it is used by the camera driver
+ * (tools/ov5640_window_bench.c).
+ */
+#ifndef __HOST_CMSIS_COMPILER_H
+#define __HOST_CMSIS_COMPILER_H
+
+#include <stdint.h>
+
+#endif /* __HOST_CMSIS_COMPILER_H */
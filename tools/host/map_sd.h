@@ -0,0 +1,57 @@
+/*
+ * Host build of the map reader: same API as Test2/Core/Inc/map_sd.h, over
+ * a read-only mmap() of the .MAP file instead of FatFs.
+ *
+ * MapSD_ReadTile() does not copy: the view points straight into the
+ * mapping (and must be treated as read-only), and buf is not touched. Only
+ * the tiles of a packed map that are stored packed are unpacked into buf,
+ * which may therefore be NULL for any other map. Pages are faulted in by
+ * the kernel as tiles are used, so multi-gigabyte mosaics open instantly
+ * and cost only the tiles actually visited.
+ *
+ * Code written against map_sd.h builds unchanged on both sides (tools/host
+ * comes first on the host include path), so replays measure the
+ * algorithm, not the card.
+ */
+#ifndef __MAP_SD_H
+#define __MAP_SD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "map_file.h"
+#include "map_index.h"
+
+typedef enum
+{
+    MAP_SD_OK = 0,
+    MAP_SD_ERROR = -1,
+    MAP_SD_BAD_FILE = -2,
+    MAP_SD_INVALID_PARAM = -3
+} MapSD_Status;
+
+typedef struct
+{
+    const uint8_t     *base;        /* The whole file, mapped */
+    size_t             size;
+    map_file_header_t  hdr;
+} map_sd_t;
+
+int      MapSD_Open(map_sd_t *m, const char *path);
+void     MapSD_Close(map_sd_t *m);
+uint32_t MapSD_TileBytes(const map_sd_t *m, int with_spectrum);
+int      MapSD_ReadTile(map_sd_t *m, uint32_t level, uint32_t tx, uint32_t ty,
+                        void *buf, uint32_t bytes, map_tile_view_t *view);
+int      MapSD_ReadIndex(map_sd_t *m, uint32_t level, uint32_t first, uint32_t count,
+                         map_tile_entry_t *entries);
+int      MapSD_LoadIndex(map_sd_t *m, map_index_t *idx, uint64_t *bits, uint32_t bytes,
+                         uint8_t min_contrast);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MAP_SD_H */
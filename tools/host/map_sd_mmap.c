@@ -0,0 +1,167 @@
+#include "map_sd.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+int MapSD_Open(map_sd_t *m, const char *path)
+{
+    struct stat st;
+    void *base;
+    int fd;
+
+    if ((m == 0) || (path == 0))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    memset(m, 0, sizeof(*m));
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        return MAP_SD_ERROR;
+    }
+
+    if ((fstat(fd, &st) != 0) || ((size_t)st.st_size < MAP_FILE_ALIGN))
+    {
+        close(fd);
+        return MAP_SD_BAD_FILE;
+    }
+
+    base = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    /* The mapping keeps the file referenced */
+    close(fd);
+
+    if (base == MAP_FAILED)
+    {
+        return MAP_SD_ERROR;
+    }
+
+    m->base = (const uint8_t *)base;
+    m->size = (size_t)st.st_size;
+    memcpy(&m->hdr, m->base, sizeof(m->hdr));
+
+    if (!MapFile_CheckHeader(&m->hdr) || (m->size < m->hdr.file_bytes))
+    {
+        MapSD_Close(m);
+        return MAP_SD_BAD_FILE;
+    }
+
+    return MAP_SD_OK;
+}
+
+
+void MapSD_Close(map_sd_t *m)
+{
+    if (m->base != 0)
+    {
+        munmap((void *)m->base, m->size);
+    }
+
+    m->base = 0;
+    m->size = 0U;
+}
+
+
+/* Bytes of a record MapSD_ReadTile() looks at, with or without the spectrum */
+uint32_t MapSD_TileBytes(const map_sd_t *m, int with_spectrum)
+{
+    if (with_spectrum && ((m->hdr.flags & MAP_FILE_SPECTRA) != 0U))
+    {
+        return m->hdr.level[0].record_bytes;
+    }
+
+    return MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(m->hdr.tile);
+}
+
+
+/*
+ * Point view at tile (tx, ty) of level inside the mapping (bytes =
+ * MapSD_TileBytes() of the record are looked at). A tile stored packed is
+ * unpacked into buf (bytes) instead.
+ */
+int MapSD_ReadTile(map_sd_t *m, uint32_t level, uint32_t tx, uint32_t ty,
+                   void *buf, uint32_t bytes, map_tile_view_t *view)
+{
+    const uint8_t *record;
+    int err;
+
+    if ((m == 0) || (m->base == 0) || (view == 0) || (level >= m->hdr.levels) ||
+        (tx >= m->hdr.level[level].cols) || (ty >= m->hdr.level[level].rows) ||
+        (bytes < (MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(m->hdr.tile))) ||
+        (bytes > m->hdr.level[level].record_bytes))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    record = &m->base[MapFile_RecordOffset(&m->hdr, level, tx, ty)];
+
+    if (((m->hdr.flags & MAP_FILE_PACKED) != 0U) && (bytes >= MAP_TILE_HEADER_BYTES) &&
+        ((((const map_tile_header_t *)record)->flags & MAP_TILE_PACKED) != 0U))
+    {
+        if (buf == 0)
+        {
+            return MAP_SD_INVALID_PARAM;
+        }
+
+        if (MapFile_UnpackRecord(&m->hdr, record, bytes, buf) != MAP_FILE_OK)
+        {
+            return MAP_SD_BAD_FILE;
+        }
+
+        record = (const uint8_t *)buf;
+    }
+
+    err = MapFile_ParseRecord(&m->hdr, level, tx, ty, record, bytes, view);
+
+    if (err == MAP_FILE_OK)
+    {
+        return MAP_SD_OK;
+    }
+
+    return (err == MAP_FILE_BAD_FILE) ? MAP_SD_BAD_FILE : MAP_SD_INVALID_PARAM;
+}
+
+
+/* Index entries first .. first + count - 1 of level (row-major tile order) */
+int MapSD_ReadIndex(map_sd_t *m, uint32_t level, uint32_t first, uint32_t count,
+                    map_tile_entry_t *entries)
+{
+    if ((m == 0) || (m->base == 0) || (entries == 0) || (level >= m->hdr.levels) ||
+        ((first + count) > ((uint32_t)m->hdr.level[level].cols * m->hdr.level[level].rows)))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    memcpy(entries, &m->base[m->hdr.level[level].index_offset + (first * (uint32_t)sizeof(map_tile_entry_t))],
+           count * sizeof(map_tile_entry_t));
+
+    return MAP_SD_OK;
+}
+
+
+/* As on target, straight from the mapped tile index of every level */
+int MapSD_LoadIndex(map_sd_t *m, map_index_t *idx, uint64_t *bits, uint32_t bytes,
+                    uint8_t min_contrast)
+{
+    if ((m == 0) || (m->base == 0) || (MapIndex_Init(idx, &m->hdr, bits, bytes) != MAP_INDEX_OK))
+    {
+        return MAP_SD_INVALID_PARAM;
+    }
+
+    for (uint32_t l = 0; l < m->hdr.levels; l++)
+    {
+        const map_tile_entry_t *entries = (const map_tile_entry_t *)&m->base[m->hdr.level[l].index_offset];
+
+        MapIndex_AddEntries(idx, l, 0U, entries, (uint32_t)m->hdr.level[l].cols * m->hdr.level[l].rows,
+                            min_contrast);
+    }
+
+    return MAP_SD_OK;
+}
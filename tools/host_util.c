@@ -0,0 +1,158 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "host_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+double Host_NowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((double)ts.tv_sec * 1000.0) + ((double)ts.tv_nsec / 1.0e6);
+}
+
+
+/*
+ * Deterministic aerial-like texture: value noise summed over octaves with
+ * an amplitude proportional to the feature size (roughly the 1/f spectrum of
+ * real imagery, so it keeps structure at every pyramid level), stretched to
+ * the full 0..255 range. Wraps around at the edges.
+ */
+void Host_MakeTexture(uint8_t *buf, uint32_t w, uint32_t h, uint32_t seed)
+{
+    float *acc = calloc((size_t)w * h, sizeof(float));
+    uint32_t state = seed ? seed : 1U;
+
+    for (uint32_t cell = 2U; (cell <= w) && (cell <= h) && (cell <= 256U); cell <<= 1)
+    {
+        uint32_t gw = w / cell;
+        uint32_t gh = h / cell;
+        float *grid = malloc((size_t)gw * gh * sizeof(float));
+
+        for (uint32_t i = 0; i < gw * gh; i++)
+        {
+            state = state * 1664525U + 1013904223U;
+            grid[i] = (float)(state >> 8) / 16777216.0f - 0.5f;
+        }
+
+        for (uint32_t y = 0; y < h; y++)
+        {
+            uint32_t gy = (y / cell) % gh;
+            uint32_t gy1 = (gy + 1U) % gh;
+            float fy = (float)(y % cell) / (float)cell;
+
+            for (uint32_t x = 0; x < w; x++)
+            {
+                uint32_t gx = (x / cell) % gw;
+                uint32_t gx1 = (gx + 1U) % gw;
+                float fx = (float)(x % cell) / (float)cell;
+                float top = grid[gy * gw + gx] + fx * (grid[gy * gw + gx1] - grid[gy * gw + gx]);
+                float bot = grid[gy1 * gw + gx] + fx * (grid[gy1 * gw + gx1] - grid[gy1 * gw + gx]);
+
+                acc[y * w + x] += (float)cell * (top + fy * (bot - top));
+            }
+        }
+
+        free(grid);
+    }
+
+    float lo = acc[0];
+    float hi = acc[0];
+
+    for (uint32_t i = 0; i < w * h; i++)
+    {
+        if (acc[i] < lo) lo = acc[i];
+        if (acc[i] > hi) hi = acc[i];
+    }
+
+    for (uint32_t i = 0; i < w * h; i++)
+    {
+        buf[i] = (uint8_t)((acc[i] - lo) * 255.0f / ((hi > lo) ? (hi - lo) : 1.0f));
+    }
+
+    free(acc);
+}
+
+
+static int Host_PGMSkip(FILE *f)
+{
+    int c = fgetc(f);
+
+    while ((c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == '#'))
+    {
+        if (c == '#')
+        {
+            while ((c != '\n') && (c != EOF))
+            {
+                c = fgetc(f);
+            }
+        }
+
+        c = fgetc(f);
+    }
+
+    return ungetc(c, f);
+}
+
+
+/* Binary 8-bit grayscale PGM (P5). Returns a malloc'ed buffer or NULL. */
+uint8_t *Host_ReadPGM(const char *path, uint32_t *w, uint32_t *h)
+{
+    FILE *f = fopen(path, "rb");
+    unsigned int pw, ph, maxval;
+    uint8_t *buf = NULL;
+
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    if ((fgetc(f) != 'P') || (fgetc(f) != '5') ||
+        (Host_PGMSkip(f) == EOF) || (fscanf(f, "%u", &pw) != 1) ||
+        (Host_PGMSkip(f) == EOF) || (fscanf(f, "%u", &ph) != 1) ||
+        (Host_PGMSkip(f) == EOF) || (fscanf(f, "%u", &maxval) != 1) ||
+        (maxval != 255U) || (fgetc(f) == EOF))
+    {
+        fclose(f);
+        return NULL;
+    }
+
+    buf = malloc((size_t)pw * ph);
+
+    if ((buf != NULL) && (fread(buf, 1, (size_t)pw * ph, f) != (size_t)pw * ph))
+    {
+        free(buf);
+        buf = NULL;
+    }
+
+    fclose(f);
+
+    *w = pw;
+    *h = ph;
+
+    return buf;
+}
+
+
+int Host_WritePGM(const char *path, const uint8_t *buf, uint32_t w, uint32_t h)
+{
+    FILE *f = fopen(path, "wb");
+    int ok;
+
+    if (f == NULL)
+    {
+        return -1;
+    }
+
+    fprintf(f, "P5\n%u %u\n255\n", w, h);
+    ok = fwrite(buf, 1, (size_t)w * h, f) == (size_t)w * h;
+    fclose(f);
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,15 @@
+#ifndef __HOST_UTIL_H
+#define __HOST_UTIL_H
+
+#include <stdint.h>
+
+/*
+ * Helpers shared by the host tools and benchmarks.
+ */
+
+double   Host_NowMs(void);
+void     Host_MakeTexture(uint8_t *buf, uint32_t w, uint32_t h, uint32_t seed);
+uint8_t *Host_ReadPGM(const char *path, uint32_t *w, uint32_t *h);
+int      Host_WritePGM(const char *path, const uint8_t *buf, uint32_t w, uint32_t h);
+
+#endif /* __HOST_UTIL_H */
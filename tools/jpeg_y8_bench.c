@@ -0,0 +1,196 @@
+/*
+ * Speed and size of the Y8 JPEG encoder (jpeg_y8.h).
+ *
+ *   jpeg_y8_bench [frame.pgm [prefix]]
+ *
+ * Without a frame a 640 x 480 fractal texture with +-2 grey levels of
+ * sensor-like noise stands in for a camera frame. It is encoded at quality
+ * 70 and 90, streamed as on the board: an MCU row (8 pixel rows) per call
+ * into two BENCH_BUFFER-byte output buffers. The stream must equal the
+ * whole-frame encode, and start with SOI and end with EOI. A crop 3
+ * columns and 7 rows smaller exercises the partial edge blocks. With a prefix
+ * the images are written to <prefix>70.jpg and <prefix>90.jpg.
+ *
+ * Reported: encode speed in MB/s of frame and cycles per pixel (TSC on
+ * x86), output size and bits per pixel, buffers handed to the sink.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()   __rdtsc()
+#else
+#define BENCH_CYCLES()   0ULL
+#endif
+
+#include "jpeg_y8.h"
+#include "host_util.h"
+
+#define BENCH_W           640U
+#define BENCH_H           480U
+#define BENCH_BUFFER      4096U
+#define BENCH_ROUNDS      50U
+
+/* Collects the output; checks the encoder never writes a buffer still out */
+typedef struct
+{
+    uint8_t        *out;
+    uint32_t        max;
+    uint32_t        len;
+    uint32_t        emits;
+    const uint8_t  *held;           /* Emitted, not reclaimed yet */
+    int             ok;
+} bench_sink_t;
+
+static uint8_t bench_buf[2][BENCH_BUFFER];
+
+
+static int Bench_Emit(void *ctx, const uint8_t *data, uint32_t len)
+{
+    bench_sink_t *s = (bench_sink_t *)ctx;
+
+    if ((s->len + len) > s->max)
+    {
+        return -1;
+    }
+
+    memcpy(&s->out[s->len], data, len);
+    s->len += len;
+    s->emits++;
+    s->ok &= (s->held != data);
+    s->held = data;
+
+    return 0;
+}
+
+
+static int Bench_Reclaim(void *ctx, const uint8_t *data)
+{
+    bench_sink_t *s = (bench_sink_t *)ctx;
+
+    s->held = (s->held == data) ? 0 : s->held;
+
+    return 0;
+}
+
+
+static int Bench_Quality(const uint8_t *img, uint32_t w, uint32_t h, uint32_t stride, uint32_t quality,
+                         const char *prefix)
+{
+    const size_t max = (size_t)w * h * 2U + 4096U;
+    bench_sink_t whole = { malloc(max), (uint32_t)max, 0U, 0U, 0, 1 };
+    bench_sink_t band = { malloc(max), (uint32_t)max, 0U, 0U, 0, 1 };
+    const jpeg_y8_sink_t ws = { Bench_Emit, 0, &whole };
+    const jpeg_y8_sink_t bs = { Bench_Emit, Bench_Reclaim, &band };
+    static uint8_t big[2][1U << 20];
+    jpeg_y8_t e;
+    int ok = 1;
+
+    /* Reference: the whole frame in one call, into buffers large enough for it */
+    ok &= JpegY8_Init(&e, quality, big[0], big[1], sizeof(big[0]), &ws) == JPEG_Y8_OK;
+    ok &= JpegY8_EncodeFrame(&e, img, w, h, stride) == JPEG_Y8_OK;
+
+    /* As on the board: an MCU row at a time through two small buffers */
+    ok &= JpegY8_Init(&e, quality, bench_buf[0], bench_buf[1], BENCH_BUFFER, &bs) == JPEG_Y8_OK;
+    ok &= JpegY8_Begin(&e, w, h) == JPEG_Y8_OK;
+
+    for (uint32_t y = 0; ok && (y < h); y += 8U)
+    {
+        ok &= JpegY8_EncodeRows(&e, &img[(size_t)y * stride], stride, ((h - y) < 8U) ? (h - y) : 8U) == JPEG_Y8_OK;
+    }
+
+    ok &= JpegY8_End(&e) == JPEG_Y8_OK;
+    ok &= band.ok && (band.len == e.bytes) && (band.len == whole.len) && (memcmp(band.out, whole.out, band.len) == 0);
+    ok &= (band.len > 4U) && (band.out[0] == 0xFFU) && (band.out[1] == 0xD8U) &&
+          (band.out[band.len - 2U] == 0xFFU) && (band.out[band.len - 1U] == 0xD9U);
+
+    /* Timing, streamed */
+    uint64_t c0 = BENCH_CYCLES();
+    double t0 = Host_NowMs();
+
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++)
+    {
+        band.len = 0U;
+        band.held = 0;
+        ok &= JpegY8_EncodeFrame(&e, img, w, h, stride) == JPEG_Y8_OK;
+    }
+
+    const double ms = (Host_NowMs() - t0) / BENCH_ROUNDS;
+    const uint64_t cycles = (BENCH_CYCLES() - c0) / BENCH_ROUNDS;
+
+    printf("%ux%u q%-3u %7.1f MB/s  %5.1f cycles/px  %7u bytes  %.2f bits/px  %u buffers of %u  %s\n",
+           w, h, quality, (double)w * h / 1e3 / ms, (double)cycles / ((double)w * h), band.len,
+           8.0 * band.len / ((double)w * h), band.emits / (BENCH_ROUNDS + 1U), BENCH_BUFFER, ok ? "OK" : "FAILED");
+
+    if (prefix != 0)
+    {
+        char path[512];
+        FILE *fp;
+
+        snprintf(path, sizeof(path), "%s%u.jpg", prefix, quality);
+
+        if (((fp = fopen(path, "wb")) == 0) || (fwrite(band.out, 1, band.len, fp) != band.len))
+        {
+            perror(path);
+            ok = 0;
+        }
+
+        if (fp != 0)
+        {
+            fclose(fp);
+        }
+    }
+
+    free(whole.out);
+    free(band.out);
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t w = BENCH_W;
+    uint32_t h = BENCH_H;
+    uint8_t *img;
+    int ok = 1;
+
+    if (argc > 1)
+    {
+        if ((img = Host_ReadPGM(argv[1], &w, &h)) == NULL)
+        {
+            fprintf(stderr, "cannot read %s (8-bit binary PGM expected)\n", argv[1]);
+            return 1;
+        }
+    }
+    else
+    {
+        uint32_t state = 99U;
+
+        img = malloc(w * h);
+        Host_MakeTexture(img, w, h, 5U);
+
+        for (uint32_t i = 0; i < w * h; i++)
+        {
+            int32_t v;
+
+            state = state * 1664525U + 1013904223U;
+            v = (int32_t)img[i] + (int32_t)((state >> 24) % 5U) - 2;
+            img[i] = (uint8_t)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+        }
+    }
+
+    printf("%s: %u x %u Y8\n", (argc > 1) ? argv[1] : "texture", w, h);
+    ok &= Bench_Quality(img, w, h, w, 70U, (argc > 2) ? argv[2] : 0);
+    ok &= Bench_Quality(img, w, h, w, 90U, (argc > 2) ? argv[2] : 0);
+
+    /* Partial blocks at the right and bottom edges */
+    ok &= Bench_Quality(img, w - 3U, h - 7U, w, 70U, 0);
+
+    free(img);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/*
+ * Host benchmark for the map spatial index (map_index.h).
+ *
+ * Builds the index of a synthetic map header with a 400 x 250 tile level 0
+ * (100k tiles, 256 px tiles every 192 px) plus its coarser levels. Some
+ * tiles are unusable: scattered low-contrast tiles and large empty "lakes".
+ * Circle queries at random positions are timed for a few radii, on level 0
+ * and level 3, and checked against a linear scan over every tile of the
+ * level, which is also timed. Queries are timed both for every hit and for
+ * the BENCH_NEAREST nearest (a 3 x 3 neighbourhood), which must be the head
+ * of the full answer.
+ *
+ *   make -C tools && tools/build/map_index_bench
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "map_index.h"
+#include "host_util.h"
+
+#define BENCH_COLS        400U
+#define BENCH_ROWS        250U
+#define BENCH_LEVELS      5U
+#define BENCH_TILE        256U
+#define BENCH_STEP        192U
+#define BENCH_QUERIES     100000U
+#define BENCH_SCANS       200U
+#define BENCH_MAX_OUT     4096U
+#define BENCH_NEAREST     9U
+#define BENCH_LAKES       40U
+
+static uint32_t bench_rng = 2024U;
+
+static float Bench_Rand(void)
+{
+    bench_rng = bench_rng * 1664525U + 1013904223U;
+
+    return (float)(bench_rng >> 8) / 16777216.0f;
+}
+
+
+/* Reference: every tile of the level, same geometry as MapIndex_Query() */
+static uint32_t Bench_Scan(const map_index_t *idx, const uint8_t *usable, uint32_t level,
+                           float cx, float cy, float radius, map_tile_ref_t *out)
+{
+    const map_index_level_t *lv = &idx->level[level];
+    const float tile = (float)idx->tile;
+    uint32_t count = 0U;
+
+    for (uint32_t ty = 0; ty < lv->rows; ty++)
+    {
+        for (uint32_t tx = 0; tx < lv->cols; tx++)
+        {
+            const float x0 = (float)(tx * idx->step);
+            const float y0 = (float)(ty * idx->step);
+            const float nx = fminf(fmaxf(cx, x0), x0 + tile);
+            const float ny = fminf(fmaxf(cy, y0), y0 + tile);
+
+            if (usable[ty * lv->cols + tx] &&
+                ((((nx - cx) * (nx - cx)) + ((ny - cy) * (ny - cy))) <= (radius * radius)))
+            {
+                out[count].tx = (uint16_t)tx;
+                out[count].ty = (uint16_t)ty;
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+
+static int Bench_CompareRef(const void *a, const void *b)
+{
+    const map_tile_ref_t *ra = (const map_tile_ref_t *)a;
+    const map_tile_ref_t *rb = (const map_tile_ref_t *)b;
+
+    return ((int)ra->ty - (int)rb->ty) * 65536 + ((int)ra->tx - (int)rb->tx);
+}
+
+
+static int Bench_Radius(const map_index_t *idx, uint8_t *const *usable, uint32_t level, float radius)
+{
+    const map_index_level_t *lv = &idx->level[level];
+    const float w = (float)(lv->cols * idx->step);
+    const float h = (float)(lv->rows * idx->step);
+    static map_tile_ref_t out[BENCH_MAX_OUT];
+    static map_tile_ref_t ref[BENCH_COLS * BENCH_ROWS];
+    uint64_t found = 0U;
+    int ok = 1;
+
+    double t0 = Host_NowMs();
+
+    for (uint32_t q = 0; q < BENCH_QUERIES; q++)
+    {
+        found += MapIndex_Query(idx, level, Bench_Rand() * w, Bench_Rand() * h, radius, out, BENCH_MAX_OUT);
+    }
+
+    const double us_index = (Host_NowMs() - t0) * 1000.0 / BENCH_QUERIES;
+
+    t0 = Host_NowMs();
+
+    for (uint32_t q = 0; q < BENCH_QUERIES; q++)
+    {
+        (void)MapIndex_Query(idx, level, Bench_Rand() * w, Bench_Rand() * h, radius, out, BENCH_NEAREST);
+    }
+
+    const double us_nearest = (Host_NowMs() - t0) * 1000.0 / BENCH_QUERIES;
+
+    /* Same kind of queries against the linear scan, results compared */
+    double ms_scan = 0.0;
+
+    for (uint32_t q = 0; q < BENCH_SCANS; q++)
+    {
+        const float cx = Bench_Rand() * w;
+        const float cy = Bench_Rand() * h;
+        map_tile_ref_t near[BENCH_NEAREST];
+        const uint32_t k = MapIndex_Query(idx, level, cx, cy, radius, near, BENCH_NEAREST);
+        const uint32_t n = MapIndex_Query(idx, level, cx, cy, radius, out, BENCH_MAX_OUT);
+
+        t0 = Host_NowMs();
+        const uint32_t m = Bench_Scan(idx, usable[level], level, cx, cy, radius, ref);
+        ms_scan += Host_NowMs() - t0;
+
+        for (uint32_t i = 1; i < n; i++)
+        {
+            ok &= out[i - 1U].dist <= out[i].dist;
+        }
+
+        /* Ties may swap tiles, not distances */
+        ok &= k == ((n < BENCH_NEAREST) ? n : BENCH_NEAREST);
+
+        for (uint32_t i = 0; ok && (i < k); i++)
+        {
+            ok &= near[i].dist == out[i].dist;
+        }
+
+        qsort(out, n, sizeof(out[0]), Bench_CompareRef);
+        ok &= (n == m);
+
+        for (uint32_t i = 0; ok && (i < n); i++)
+        {
+            ok &= (out[i].tx == ref[i].tx) && (out[i].ty == ref[i].ty);
+        }
+    }
+
+    printf("level %u  %4ux%-4u  radius %6.0f px  %6.1f tiles/query  index %7.2f us  nearest %u %5.2f us  "
+           "scan %8.1f us  %s\n",
+           level, lv->cols, lv->rows, radius, (double)found / BENCH_QUERIES, us_index, BENCH_NEAREST, us_nearest,
+           ms_scan * 1000.0 / BENCH_SCANS, ok ? "OK" : "MISMATCH");
+
+    return ok;
+}
+
+
+int main(void)
+{
+    static map_file_header_t hdr;
+    static map_index_t idx;
+    uint8_t *usable[BENCH_LEVELS];
+    uint32_t tiles = 0U;
+    uint32_t kept = 0U;
+    int ok = 1;
+
+    hdr.levels = BENCH_LEVELS;
+    hdr.tile = BENCH_TILE;
+    hdr.step = BENCH_STEP;
+
+    for (uint32_t l = 0; l < BENCH_LEVELS; l++)
+    {
+        hdr.level[l].cols = (uint16_t)((BENCH_COLS + (1U << l) - 1U) >> l);
+        hdr.level[l].rows = (uint16_t)((BENCH_ROWS + (1U << l) - 1U) >> l);
+        tiles += (uint32_t)hdr.level[l].cols * hdr.level[l].rows;
+    }
+
+    const uint32_t bytes = MapIndex_Bytes(&hdr);
+    uint64_t *bits = malloc(bytes);
+    float lake[BENCH_LAKES][3];
+
+    (void)MapIndex_Init(&idx, &hdr, bits, bytes);
+
+    for (uint32_t k = 0; k < BENCH_LAKES; k++)
+    {
+        lake[k][0] = Bench_Rand() * BENCH_COLS;
+        lake[k][1] = Bench_Rand() * BENCH_ROWS;
+        lake[k][2] = 3.0f + Bench_Rand() * 20.0f;
+    }
+
+    for (uint32_t l = 0; l < BENCH_LEVELS; l++)
+    {
+        const uint32_t cols = hdr.level[l].cols;
+        const uint32_t rows = hdr.level[l].rows;
+
+        usable[l] = malloc(cols * rows);
+
+        for (uint32_t ty = 0; ty < rows; ty++)
+        {
+            for (uint32_t tx = 0; tx < cols; tx++)
+            {
+                int u = Bench_Rand() > 0.1f;
+
+                for (uint32_t k = 0; k < BENCH_LAKES; k++)
+                {
+                    const float dx = (float)(tx << l) - lake[k][0];
+                    const float dy = (float)(ty << l) - lake[k][1];
+
+                    u &= ((dx * dx) + (dy * dy)) > (lake[k][2] * lake[k][2]);
+                }
+
+                usable[l][ty * cols + tx] = (uint8_t)u;
+                MapIndex_Set(&idx, l, tx, ty, u);
+                kept += (uint32_t)u;
+            }
+        }
+    }
+
+    printf("%u tiles over %u levels, %u usable, index %u bytes\n", tiles, BENCH_LEVELS, kept, bytes);
+
+    ok &= Bench_Radius(&idx, usable, 0U, 300.0f);
+    ok &= Bench_Radius(&idx, usable, 0U, 1000.0f);
+    ok &= Bench_Radius(&idx, usable, 0U, 5000.0f);
+    ok &= Bench_Radius(&idx, usable, 3U, 300.0f);
+    ok &= Bench_Radius(&idx, usable, 3U, 2000.0f);
+
+    for (uint32_t l = 0; l < BENCH_LEVELS; l++)
+    {
+        free(usable[l]);
+    }
+
+    free(bits);
+
+    return ok ? 0 : 1;
+}
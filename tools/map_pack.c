@@ -0,0 +1,470 @@
+/*
+ * Build a tiled, pyramidal reference map (.MAP, see map_file.h) from a
+ * grayscale mosaic.
+ *
+ *   map_pack <mosaic.pgm> <out.map> <tile> <step> <levels> <lon0> <lat0> <dlon> <dlat> [q15|f32] [packed]
+ *
+ * (lon0, lat0) is the top-left corner of the mosaic and dlon / dlat the
+ * size of one pixel (dlat is usually negative: rows go south). With q15 or
+ * f32 every tile also gets its precomputed spectrum (tile must then be a
+ * power of two), windowed and transformed exactly as PhaseCorr_Forward()
+ * does on target. levels is clamped to what the mosaic size allows. With
+ * packed the pixels of every tile that compresses are stored packed
+ * (tile_codec.h); the compression ratio and the sectors a reader then
+ * fetches per tile are reported.
+ *
+ * Only binary PGM is read; convert PNG mosaics first (e.g. with
+ * ImageMagick: convert map.png -colorspace gray map.pgm).
+ *
+ * After writing, a sample of tiles is read back with a single seek and read
+ * each, unpacked, and compared with the mosaic. A packed map is also read
+ * through MapSD_ReadTile(), which must turn down a buffer too short for the
+ * unpacked pixels.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "map_file.h"
+#include "map_sd.h"
+#include "tile_codec.h"
+#include "phase_corr.h"
+#include "pyramid_search.h"
+#include "host_util.h"
+
+#define PACK_CHECK_TILES   64U
+
+
+/*
+ * Cut tile (tx, ty) out of img into px, padding the part outside img with
+ * the mean of the part inside. Fills the index entry.
+ */
+static void Pack_Cut(const image_t *img, uint32_t tile, uint32_t step, uint32_t tx, uint32_t ty,
+                     uint8_t *px, map_tile_entry_t *e)
+{
+    const uint32_t x0 = tx * step;
+    const uint32_t y0 = ty * step;
+    const uint32_t w = (uint32_t)img->w;
+    const uint32_t h = (uint32_t)img->h;
+    const uint32_t vw = ((x0 + tile) <= w) ? tile : (w - x0);
+    const uint32_t vh = ((y0 + tile) <= h) ? tile : (h - y0);
+    double sum = 0.0;
+    double sumsq = 0.0;
+
+    for (uint32_t y = 0; y < vh; y++)
+    {
+        for (uint32_t x = 0; x < vw; x++)
+        {
+            const uint8_t v = img->pixels[(y0 + y) * w + x0 + x];
+
+            sum += v;
+            sumsq += (double)v * v;
+        }
+    }
+
+    const double count = (double)vw * vh;
+    const double mean = sum / count;
+    const double var = (sumsq / count) - (mean * mean);
+    const double sd = sqrt((var > 0.0) ? var : 0.0);
+
+    for (uint32_t y = 0; y < tile; y++)
+    {
+        for (uint32_t x = 0; x < tile; x++)
+        {
+            px[y * tile + x] = ((x < vw) && (y < vh)) ? img->pixels[(y0 + y) * w + x0 + x] :
+                                                        (uint8_t)(mean + 0.5);
+        }
+    }
+
+    e->flags = ((vw < tile) || (vh < tile)) ? MAP_TILE_PARTIAL : 0U;
+    e->mean = (uint8_t)(mean + 0.5);
+    e->contrast = (uint8_t)((sd > 255.0) ? 255.0 : (sd + 0.5));
+    e->reserved = 0U;
+}
+
+
+/* Tiles needed to cover size pixels with tiles of tile pixels every step */
+static uint32_t Pack_Count(uint32_t size, uint32_t tile, uint32_t step)
+{
+    return (size <= tile) ? 1U : (1U + ((size - tile) + step - 1U) / step);
+}
+
+
+/* Read tile (tx, ty) of level back with one seek and one read and compare it */
+static int Pack_Check(FILE *f, const map_file_header_t *hdr, const image_t *levels,
+                      uint32_t level, uint32_t tx, uint32_t ty, uint8_t *record)
+{
+    const map_level_t *lv = &hdr->level[level];
+    const uint32_t tile = hdr->tile;
+    map_tile_view_t view;
+    map_tile_entry_t e;
+    uint8_t *px = malloc(MapFile_PixelBytes(tile));
+    uint8_t *plain = malloc(lv->record_bytes);
+    int ok;
+
+    ok = (fseek(f, (long)MapFile_RecordOffset(hdr, level, tx, ty), SEEK_SET) == 0) &&
+         (fread(record, 1, lv->record_bytes, f) == lv->record_bytes) &&
+         (MapFile_UnpackRecord(hdr, record, lv->record_bytes, plain) == MAP_FILE_OK) &&
+         (MapFile_ParseRecord(hdr, level, tx, ty, plain, lv->record_bytes, &view) == MAP_FILE_OK);
+
+    if (ok)
+    {
+        Pack_Cut(&levels[level], tile, hdr->step, tx, ty, px, &e);
+        ok = (memcmp(view.image.pixels, px, MapFile_PixelBytes(tile)) == 0) &&
+             (((hdr->flags & MAP_FILE_SPECTRA) == 0U) || (view.spectrum != NULL));
+    }
+
+    free(px);
+    free(plain);
+
+    return ok;
+}
+
+
+/*
+ * MapSD_ReadTile() of the first tile stored packed, into a buffer holding
+ * the header only: refused, and nothing written past it.
+ */
+static int Pack_CheckShort(const char *path)
+{
+    map_sd_t m;
+    map_tile_view_t view;
+    int ok = 0;
+
+    if (MapSD_Open(&m, path) != MAP_SD_OK)
+    {
+        return 0;
+    }
+
+    const map_level_t *lv = &m.hdr.level[0];
+    uint8_t *buf = malloc(lv->record_bytes);
+
+    for (uint32_t t = 0; t < ((uint32_t)lv->cols * lv->rows); t++)
+    {
+        const uint32_t tx = t % lv->cols;
+        const uint32_t ty = t / lv->cols;
+        const map_tile_header_t *th = (const map_tile_header_t *)&m.base[MapFile_RecordOffset(&m.hdr, 0U, tx, ty)];
+
+        if ((th->flags & MAP_TILE_PACKED) != 0U)
+        {
+            memset(buf, 0xA5, lv->record_bytes);
+            ok = (MapSD_ReadTile(&m, 0U, tx, ty, buf, MAP_TILE_HEADER_BYTES, &view) == MAP_SD_INVALID_PARAM) &&
+                 (buf[MAP_TILE_HEADER_BYTES] == 0xA5U) &&
+                 (MapSD_ReadTile(&m, 0U, tx, ty, buf, MapSD_TileBytes(&m, 0), &view) == MAP_SD_OK);
+            break;
+        }
+    }
+
+    free(buf);
+    MapSD_Close(&m);
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    if ((argc < 10) || (argc > 12))
+    {
+        fprintf(stderr, "usage: %s <mosaic.pgm> <out.map> <tile> <step> <levels> "
+                        "<lon0> <lat0> <dlon> <dlat> [q15|f32] [packed]\n", argv[0]);
+        return 2;
+    }
+
+    uint32_t w, h;
+    uint8_t *mosaic = Host_ReadPGM(argv[1], &w, &h);
+    const uint32_t tile = (uint32_t)atoi(argv[3]);
+    const uint32_t step = (uint32_t)atoi(argv[4]);
+    uint32_t levels = (uint32_t)atoi(argv[5]);
+    SpectrumTile_Quant quant = SPECTRUM_QUANT_Q15_PHASE;
+    int spectra = 0;
+    int packed = 0;
+    int options = 1;
+
+    for (int i = 10; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "q15") == 0) || (strcmp(argv[i], "f32") == 0))
+        {
+            options &= !spectra;
+            spectra = 1;
+            quant = (strcmp(argv[i], "f32") == 0) ? SPECTRUM_QUANT_F32 : SPECTRUM_QUANT_Q15_PHASE;
+        }
+        else
+        {
+            options &= !packed && (strcmp(argv[i], "packed") == 0);
+            packed = 1;
+        }
+    }
+
+    if (mosaic == NULL)
+    {
+        fprintf(stderr, "cannot read %s (8-bit binary PGM expected)\n", argv[1]);
+        return 1;
+    }
+
+    if ((tile == 0U) || (tile > 0xFFFFU) || (step == 0U) || (step > tile) || (levels == 0U) || !options ||
+        (spectra && ((tile > FFT_MAX_N) || ((tile & (tile - 1U)) != 0U))))
+    {
+        fprintf(stderr, "invalid tile %u / step %u / levels %u or options%s\n", tile, step, levels,
+                spectra ? " (spectra need a power of two tile up to FFT_MAX_N)" : "");
+        return 1;
+    }
+
+    /* Stop before a level gets smaller than half a tile */
+    if (levels > MAP_FILE_MAX_LEVELS)
+    {
+        levels = MAP_FILE_MAX_LEVELS;
+    }
+
+    while ((levels > 1U) && (((w >> (levels - 1U)) < (tile / 2U)) || ((h >> (levels - 1U)) < (tile / 2U))))
+    {
+        levels--;
+    }
+
+    image_t base = { .w = (int)w, .h = (int)h, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = mosaic };
+    image_t lv_img[MAP_FILE_MAX_LEVELS];
+    uint8_t *pyr = malloc(Pyramid_BufBytes(w, h, levels) + 1U);
+
+    if (Pyramid_Build(&base, lv_img, levels, pyr) != PYRAMID_OK)
+    {
+        fprintf(stderr, "cannot build %u levels\n", levels);
+        return 1;
+    }
+
+    /* Layout: header, all indexes, all records */
+    static map_file_header_t hdr;
+    uint64_t offset = MAP_FILE_ALIGN;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = MAP_FILE_MAGIC;
+    hdr.version = MAP_FILE_VERSION;
+    hdr.levels = (uint16_t)levels;
+    hdr.tile = (uint16_t)tile;
+    hdr.step = (uint16_t)step;
+    hdr.flags = (spectra ? MAP_FILE_SPECTRA : 0U) | (packed ? MAP_FILE_PACKED : 0U);
+    hdr.quant = (uint8_t)quant;
+    hdr.geo[0] = atof(argv[6]);
+    hdr.geo[1] = atof(argv[8]);
+    hdr.geo[2] = 0.0;
+    hdr.geo[3] = atof(argv[7]);
+    hdr.geo[4] = 0.0;
+    hdr.geo[5] = atof(argv[9]);
+
+    for (uint32_t l = 0; l < levels; l++)
+    {
+        map_level_t *lv = &hdr.level[l];
+        const uint32_t cols = Pack_Count((uint32_t)lv_img[l].w, tile, step);
+        const uint32_t rows = Pack_Count((uint32_t)lv_img[l].h, tile, step);
+
+        if ((cols > 0xFFFFU) || (rows > 0xFFFFU))
+        {
+            fprintf(stderr, "level %u: too many tiles\n", l);
+            return 1;
+        }
+
+        lv->width = (uint32_t)lv_img[l].w;
+        lv->height = (uint32_t)lv_img[l].h;
+        lv->cols = (uint16_t)cols;
+        lv->rows = (uint16_t)rows;
+        lv->record_bytes = MapFile_RecordBytes(tile, hdr.flags, quant);
+        lv->index_offset = (uint32_t)offset;
+        offset += MAP_FILE_ALIGN_UP(cols * rows * sizeof(map_tile_entry_t), MAP_FILE_ALIGN);
+    }
+
+    for (uint32_t l = 0; l < levels; l++)
+    {
+        map_level_t *lv = &hdr.level[l];
+
+        lv->data_offset = (uint32_t)offset;
+        offset += (uint64_t)lv->cols * lv->rows * lv->record_bytes;
+    }
+
+    /* Offsets are 32 bit, like FAT32 file sizes */
+    if (offset > 0xFFFFFFFFULL)
+    {
+        fprintf(stderr, "map too large (%.1f GB)\n", (double)offset / 1e9);
+        return 1;
+    }
+
+    hdr.file_bytes = (uint32_t)offset;
+
+    FILE *f = fopen(argv[2], "w+b");
+    uint8_t *block = calloc(1, MAP_FILE_ALIGN);
+    uint8_t *record = calloc(1, hdr.level[0].record_bytes);
+    float *spectrum = spectra ? malloc(PHASE_CORR_WORK_FLOATS(tile) * sizeof(float)) : NULL;
+    uint8_t *squeezed = malloc(MapFile_PixelBytes(tile));
+    uint64_t pixel_bytes = 0U;
+    uint64_t sectors = 0U;
+    uint32_t tiles = 0U;
+    uint32_t packed_tiles = 0U;
+    static phase_corr_t pc;
+
+    if ((f == NULL) || (spectra && (PhaseCorr_Init(&pc, tile, spectrum, NULL) != PHASE_CORR_OK)))
+    {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+
+    memcpy(block, &hdr, sizeof(hdr));
+    fwrite(block, 1, MAP_FILE_ALIGN, f);
+
+    /* Index first (cut every tile once for the statistics), then the records */
+    for (uint32_t pass = 0; pass < 2U; pass++)
+    {
+        for (uint32_t l = 0; l < levels; l++)
+        {
+            const map_level_t *lv = &hdr.level[l];
+            const uint32_t count = (uint32_t)lv->cols * lv->rows;
+            map_tile_entry_t *index = calloc(1, MAP_FILE_ALIGN_UP(count * sizeof(map_tile_entry_t), MAP_FILE_ALIGN));
+
+            for (uint32_t t = 0; t < count; t++)
+            {
+                const uint32_t tx = t % lv->cols;
+                const uint32_t ty = t / lv->cols;
+                map_tile_header_t *th = (map_tile_header_t *)record;
+                double geo[6];
+
+                Pack_Cut(&lv_img[l], tile, step, tx, ty, &record[MAP_TILE_HEADER_BYTES], &index[t]);
+
+                if (pass == 0U)
+                {
+                    continue;
+                }
+
+                memset(record, 0, MAP_TILE_HEADER_BYTES);
+                th->magic = MAP_TILE_MAGIC;
+                th->level = (uint16_t)l;
+                th->flags = index[t].flags;
+                th->tx = (uint16_t)tx;
+                th->ty = (uint16_t)ty;
+                th->origin_x = (int32_t)(tx * step);
+                th->origin_y = (int32_t)(ty * step);
+
+                /* Shift the level transform to the tile corner */
+                double lon;
+                double lat;
+
+                MapFile_LevelGeo(&hdr, l, geo);
+                MapFile_PixelToGeo(geo, (double)th->origin_x, (double)th->origin_y, &lon, &lat);
+                th->geo[0] = lon;
+                th->geo[1] = geo[1];
+                th->geo[2] = geo[2];
+                th->geo[3] = lat;
+                th->geo[4] = geo[4];
+                th->geo[5] = geo[5];
+
+                if (spectra)
+                {
+                    image_t img = { .w = (int)tile, .h = (int)tile, .bpp = IMAGE_BPP_GRAYSCALE,
+                                    .pixels = &record[MAP_TILE_HEADER_BYTES] };
+                    spectrum_tile_header_t *sh = (spectrum_tile_header_t *)&record[MapFile_SpectrumOffset(tile)];
+
+                    th->flags |= MAP_TILE_SPECTRUM;
+                    (void)PhaseCorr_Forward(&pc, &img, spectrum);
+                    SpectrumTile_InitHeader(sh, tile, quant, th->origin_x, th->origin_y);
+                    SpectrumTile_EncodeRows(sh, spectrum, &record[MapFile_SpectrumOffset(tile) + sizeof(*sh)], tile);
+                }
+
+                /* Packed only where that saves something; the spectrum stays in place */
+                uint32_t stored = MapFile_PixelBytes(tile);
+
+                if (packed)
+                {
+                    const int32_t n = TileCodec_Encode(&record[MAP_TILE_HEADER_BYTES], tile, tile,
+                                                       squeezed, MapFile_PixelBytes(tile) - 1U);
+
+                    if (n > 0)
+                    {
+                        memset(&record[MAP_TILE_HEADER_BYTES], 0, MapFile_PixelBytes(tile));
+                        memcpy(&record[MAP_TILE_HEADER_BYTES], squeezed, (size_t)n);
+                        th->flags |= MAP_TILE_PACKED;
+                        th->packed_bytes = (uint32_t)n;
+                        stored = (uint32_t)n;
+                        packed_tiles++;
+                    }
+                }
+
+                pixel_bytes += stored;
+                sectors += MAP_FILE_ALIGN_UP(MAP_TILE_HEADER_BYTES + stored, MAP_FILE_ALIGN) / MAP_FILE_ALIGN;
+                tiles++;
+
+                if (fwrite(record, 1, lv->record_bytes, f) != lv->record_bytes)
+                {
+                    fprintf(stderr, "write failed\n");
+                    return 1;
+                }
+            }
+
+            if ((pass == 0U) &&
+                (fwrite(index, 1, MAP_FILE_ALIGN_UP(count * sizeof(map_tile_entry_t), MAP_FILE_ALIGN), f) !=
+                 MAP_FILE_ALIGN_UP(count * sizeof(map_tile_entry_t), MAP_FILE_ALIGN)))
+            {
+                fprintf(stderr, "write failed\n");
+                return 1;
+            }
+
+            free(index);
+        }
+    }
+
+    fflush(f);
+
+    /* Read back a spread of tiles from every level */
+    uint32_t checked = 0U;
+    uint32_t bad = 0U;
+
+    for (uint32_t l = 0; l < levels; l++)
+    {
+        const map_level_t *lv = &hdr.level[l];
+        const uint32_t count = (uint32_t)lv->cols * lv->rows;
+
+        for (uint32_t k = 0; k < PACK_CHECK_TILES; k++)
+        {
+            const uint32_t t = (uint32_t)(((uint64_t)k * 2654435761ULL) % count);
+
+            bad += Pack_Check(f, &hdr, lv_img, l, t % lv->cols, t / lv->cols, record) ? 0U : 1U;
+            checked++;
+        }
+    }
+
+    for (uint32_t l = 0; l < levels; l++)
+    {
+        printf("level %u  %6ux%-6u  %4ux%-4u tiles\n", l, hdr.level[l].width, hdr.level[l].height,
+               hdr.level[l].cols, hdr.level[l].rows);
+    }
+
+    printf("%ux%u tiles every %u px, %u levels, %s, %u bytes per tile, %.1f MB\n", tile, tile, step,
+           levels, spectra ? ((quant == SPECTRUM_QUANT_F32) ? "f32 spectra" : "q15 spectra") : "no spectra",
+           hdr.level[0].record_bytes, (double)hdr.file_bytes / 1e6);
+
+    if (packed)
+    {
+        printf("pixels packed %.2f:1 (%u of %u tiles packed), %.2f sectors read per tile instead of %u\n",
+               (double)tiles * MapFile_PixelBytes(tile) / (double)pixel_bytes, packed_tiles, tiles,
+               (double)sectors / tiles,
+               MAP_FILE_ALIGN_UP(MAP_TILE_HEADER_BYTES + MapFile_PixelBytes(tile), MAP_FILE_ALIGN) / MAP_FILE_ALIGN);
+    }
+
+    printf("read back %u tiles: %s\n", checked, (bad == 0U) ? "OK" : "MISMATCH");
+
+    if (packed && (packed_tiles > 0U))
+    {
+        fflush(f);
+        const int short_ok = Pack_CheckShort(argv[2]);
+
+        printf("packed tile into a header-only buffer: %s\n", short_ok ? "refused" : "NOT REFUSED");
+        bad += short_ok ? 0U : 1U;
+    }
+
+    fclose(f);
+    free(block);
+    free(record);
+    free(spectrum);
+    free(squeezed);
+    free(pyr);
+    free(mosaic);
+
+    return (bad == 0U) ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+/*
+ * Tile access cost of the host map reader (host/map_sd.h, mmap, zero-copy)
+ * against reading every record into a buffer as the FatFs reader does.
+ *
+ *   map_read_bench <file.map> [tiles]
+ *
+ * The same pseudo-random sequence of tiles (default 20000, all levels) is
+ * fetched both ways, with or without the spectrum part, and every view is
+ * used (its pixels read) so the page faults of the mapping are paid for.
+ * The sums must agree. Both passes start with the file in the page cache,
+ * so the difference is the copy and the syscalls: what a replay no longer
+ * spends outside the algorithm.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "map_sd.h"
+#include "host_util.h"
+
+#define BENCH_TILES   20000U
+#define BENCH_LINE    64U
+
+
+/* Tile i of the sequence */
+static void Bench_Pick(const map_file_header_t *hdr, uint32_t i, uint32_t *level, uint32_t *tx, uint32_t *ty)
+{
+    uint32_t r = (i + 1U) * 2654435761U;
+
+    r ^= r >> 15;
+    *level = r % hdr->levels;
+    *tx = (r >> 4) % hdr->level[*level].cols;
+    *ty = (r >> 17) % hdr->level[*level].rows;
+}
+
+
+/* One byte per cache line of the pixels: touches every page of the tile */
+static uint64_t Bench_Use(const map_tile_view_t *v)
+{
+    const uint32_t n = (uint32_t)(v->image.w * v->image.h);
+    uint64_t sum = 0U;
+
+    for (uint32_t i = 0; i < n; i += BENCH_LINE)
+    {
+        sum += v->image.pixels[i];
+    }
+
+    return sum + ((v->spectrum != 0) ? v->spectrum->data_bytes : 0U);
+}
+
+
+static long Bench_Faults(void)
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    return ru.ru_minflt + ru.ru_majflt;
+}
+
+
+int main(int argc, char **argv)
+{
+    const uint32_t tiles = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 10) : BENCH_TILES;
+    map_sd_t m;
+    int ok = 1;
+
+    if ((argc < 2) || (tiles == 0U))
+    {
+        fprintf(stderr, "usage: map_read_bench <file.map> [tiles]\n");
+        return 1;
+    }
+
+    if (MapSD_Open(&m, argv[1]) != MAP_SD_OK)
+    {
+        fprintf(stderr, "cannot open %s as a map\n", argv[1]);
+        return 1;
+    }
+
+    const int fd = open(argv[1], O_RDONLY);
+    uint8_t *record = malloc(m.hdr.level[0].record_bytes);
+    uint8_t *buf = malloc(m.hdr.level[0].record_bytes);
+
+    printf("%s: %u levels, %u px tiles, %u bytes%s\n", argv[1], m.hdr.levels, m.hdr.tile,
+           m.hdr.file_bytes, ((m.hdr.flags & MAP_FILE_PACKED) != 0U) ? ", packed" : "");
+
+    for (int with_spectrum = 0; with_spectrum < 2; with_spectrum++)
+    {
+        const uint32_t bytes = MapSD_TileBytes(&m, with_spectrum);
+        uint64_t sum_map = 0U;
+        uint64_t sum_read = 0U;
+        uint64_t io = 0U;
+        uint32_t level;
+        uint32_t tx;
+        uint32_t ty;
+
+        if (with_spectrum && ((m.hdr.flags & MAP_FILE_SPECTRA) == 0U))
+        {
+            continue;
+        }
+
+        /* Copying reader: one pread() of the record, unpacked if need be */
+        double t0 = Host_NowMs();
+
+        for (uint32_t i = 0; i < tiles; i++)
+        {
+            map_tile_view_t v;
+
+            Bench_Pick(&m.hdr, i, &level, &tx, &ty);
+
+            if ((pread(fd, record, bytes, MapFile_RecordOffset(&m.hdr, level, tx, ty)) != (ssize_t)bytes) ||
+                (MapFile_UnpackRecord(&m.hdr, record, bytes, buf) != MAP_FILE_OK) ||
+                (MapFile_ParseRecord(&m.hdr, level, tx, ty, buf, bytes, &v) != MAP_FILE_OK))
+            {
+                ok = 0;
+                break;
+            }
+
+            io += bytes;
+            sum_read += Bench_Use(&v);
+        }
+
+        const double ms_read = Host_NowMs() - t0;
+        const long faults = Bench_Faults();
+
+        /* Mapped reader */
+        t0 = Host_NowMs();
+
+        for (uint32_t i = 0; i < tiles; i++)
+        {
+            map_tile_view_t v;
+
+            Bench_Pick(&m.hdr, i, &level, &tx, &ty);
+
+            if (MapSD_ReadTile(&m, level, tx, ty, buf, bytes, &v) != MAP_SD_OK)
+            {
+                ok = 0;
+                break;
+            }
+
+            sum_map += Bench_Use(&v);
+        }
+
+        const double ms_map = Host_NowMs() - t0;
+
+        ok &= sum_map == sum_read;
+
+        printf("%-17s %u tiles: pread+copy %7.2f us/tile (%6.0f MB/s)  mmap %7.2f us/tile  "
+               "%ld page faults  %s\n",
+               with_spectrum ? "pixels+spectrum" : "pixels", tiles,
+               ms_read * 1e3 / tiles, (double)io / 1e3 / ms_read, ms_map * 1e3 / tiles,
+               Bench_Faults() - faults, (sum_map == sum_read) ? "OK" : "MISMATCH");
+    }
+
+    /* The same tiles again: the mapping is populated now */
+    double t0 = Host_NowMs();
+    uint32_t level;
+    uint32_t tx;
+    uint32_t ty;
+
+    for (uint32_t i = 0; i < tiles; i++)
+    {
+        map_tile_view_t v;
+
+        Bench_Pick(&m.hdr, i, &level, &tx, &ty);
+        ok &= MapSD_ReadTile(&m, level, tx, ty, buf, MapSD_TileBytes(&m, 0), &v) == MAP_SD_OK;
+    }
+
+    printf("mmap view only, warm: %.3f us/tile\n", (Host_NowMs() - t0) * 1e3 / tiles);
+
+    close(fd);
+    free(record);
+    free(buf);
+    MapSD_Close(&m);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+/*
+ * OV5640 bring-up (Test2 main.c and Test2/Core/Src/ov5640.c): SCCB
+ * transfers of the register tables and time from reset to the first frame,
+ * against a simulated register map (sccb_mock.h).
+ *
+ *   ov5640_bringup_bench
+ *
+ * The driver runs unchanged: OV5640_ReadID(), OV5640_Init(VGA, Y8),
+ * OV5640_SetWindow() with the flight window, OV5640_WaitAutoExposure().
+ * Behind the register map a sensor model streams frames once 0x3008 says
+ * so, one every BENCH_VGA_FRAME_MS x VTS / 1088 (fixed pixel clock and
+ * HTS), and runs its auto exposure once a frame: outside the stable range
+ * (0x3A10 .. 0x3A0F) the exposure moves halfway, in log, toward the level
+ * target, then the gain once the exposure is at its limit; AVG_READOUT
+ * (0x56A1) gives the level of the last frame.
+ *
+ * Reported:
+ *   - registers written, SCCB transfers and bus time, one register a
+ *     transfer (as before) and in bursts of consecutive registers
+ *   - frames and time the auto exposure takes to settle, and when
+ *     OV5640_WaitAutoExposure() sees it
+ *   - reset to first frame: waits of main.c, bus, exposure, first frame;
+ *     before, the waits were 100 + 100 ms of reset, 500 ms in
+ *     OV5640_ReadID() and a fixed 1000 ms for the exposure
+ *
+ * Checked: the exposure is settled when the wait returns, a scene that
+ * never settles times out, and manual exposure returns at once.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ov5640.h"
+#include "sccb_mock.h"
+
+#define BENCH_VGA_FRAME_MS      33.333      /* 30 fps at VTS 1088, assumed */
+#define BENCH_RESET_MS          1.0         /* main.c CAMERA_RESET_MS, CAMERA_BOOT_MS */
+#define BENCH_BOOT_MS           20.0
+#define BENCH_AEC_TIMEOUT_MS    1000U       /* main.c CAMERA_AEC_TIMEOUT_MS */
+#define BENCH_OLD_WAITS_MS      (100.0 + 100.0 + 500.0 + 1000.0)
+#define BENCH_EXPOSURE0         32.0        /* Lines, at reset */
+#define BENCH_SCENE             0.30        /* Level per line of exposure at 1x gain */
+#define BENCH_FLIGHT_W          256U
+#define BENCH_FLIGHT_H          256U
+
+typedef struct
+{
+    double    scene;                /* Level per line at 1x */
+    double    flicker;              /* Level swing frame to frame, 0..1 */
+    double    exposure;             /* Lines */
+    double    gain;                 /* 1x .. */
+    double    level;
+    double    stream_ns;            /* First frame start, < 0 while stopped */
+    uint32_t  frames;
+    uint32_t  moves;                /* Frames the AEC changed something */
+    double    settled_ns;           /* Since the last change */
+} bench_sensor_t;
+
+static bench_sensor_t sensor;
+
+
+static uint32_t Bench_Reg16(uint16_t reg)
+{
+    return ((uint32_t)sccb_mock.reg[reg] << 8) | sccb_mock.reg[reg + 1U];
+}
+
+
+static double Bench_FrameNs(void)
+{
+    return BENCH_VGA_FRAME_MS * 1e6 * Bench_Reg16(OV5640_TIMING_VTS_HIGH) / 1088.0;
+}
+
+
+/* One frame of the sensor's auto exposure */
+static void Bench_Frame(void)
+{
+    const double low = sccb_mock.reg[OV5640_AEC_CTRL10];
+    const double high = sccb_mock.reg[OV5640_AEC_CTRL0F];
+    const double max_expo = Bench_Reg16(OV5640_AEC_MAX_EXPO_HIGH);
+    const double swing = (sensor.frames & 1U) ? (1.0 + sensor.flicker) : (1.0 - sensor.flicker);
+    const double level = sensor.scene * swing * sensor.exposure * sensor.gain;
+
+    sensor.level = (level > 255.0) ? 255.0 : level;
+    sensor.frames++;
+
+    if (((sccb_mock.reg[OV5640_AEC_PK_MANUAL] & 0x03U) != 0x03U) && ((sensor.level < low) || (sensor.level > high)))
+    {
+        const double step = sqrt(0.5 * (low + high) / ((sensor.level > 0.5) ? sensor.level : 0.5));
+        double exposure = sensor.exposure * step;
+
+        if (exposure > max_expo)
+        {
+            sensor.gain = fmin(sensor.gain * exposure / max_expo, 64.0);
+            exposure = max_expo;
+        }
+        else if ((sensor.gain > 1.0) && (step < 1.0))
+        {
+            sensor.gain = fmax(sensor.gain * step, 1.0);
+            exposure = sensor.exposure;
+        }
+
+        sensor.exposure = fmax(exposure, 1.0);
+        sensor.moves++;
+        sensor.settled_ns = sccb_mock.now_ns;
+    }
+
+    const uint32_t e16 = (uint32_t)(sensor.exposure * 16.0);
+    const uint32_t g16 = (uint32_t)(sensor.gain * 16.0);
+
+    sccb_mock.reg[OV5640_AVG_READOUT] = (uint8_t)sensor.level;
+    sccb_mock.reg[OV5640_AEC_PK_EXPOSURE_19_16] = (uint8_t)(e16 >> 16);
+    sccb_mock.reg[OV5640_AEC_PK_EXPOSURE_HIGH] = (uint8_t)(e16 >> 8);
+    sccb_mock.reg[OV5640_AEC_PK_EXPOSURE_LOW] = (uint8_t)e16;
+    sccb_mock.reg[OV5640_AEC_PK_REAL_GAIN_9_8] = (uint8_t)((g16 >> 8) & 0x03U);
+    sccb_mock.reg[OV5640_AEC_PK_REAL_GAIN_LOW] = (uint8_t)g16;
+}
+
+
+/* Frames up to the clock of the read */
+static void Bench_OnRead(uint16_t reg, uint16_t len)
+{
+    (void)reg;
+    (void)len;
+
+    if (sccb_mock.reg[OV5640_SYSTEM_CTROL0] != 0x02U)
+    {
+        sensor.stream_ns = -1.0;
+        return;
+    }
+
+    if (sensor.stream_ns < 0.0)
+    {
+        sensor.stream_ns = sccb_mock.now_ns;
+        sensor.frames = 0U;
+    }
+
+    while (sccb_mock.now_ns >= sensor.stream_ns + (sensor.frames + 1U) * Bench_FrameNs())
+    {
+        Bench_Frame();
+    }
+}
+
+
+static void Bench_Reset(double scene, double flicker)
+{
+    SccbMock_Reset();
+    sccb_mock.on_read = Bench_OnRead;
+
+    memset(&sensor, 0, sizeof(sensor));
+    sensor.scene = scene;
+    sensor.flicker = flicker;
+    sensor.exposure = BENCH_EXPOSURE0;
+    sensor.gain = 1.0;
+    sensor.stream_ns = -1.0;
+}
+
+
+static int Bench_Configure(OV5640_Object_t *camera)
+{
+    static const OV5640_Window_t window = { BENCH_FLIGHT_W, BENCH_FLIGHT_H, 0, 0, OV5640_BINNING_4x4 };
+    OV5640_IO_t io;
+    uint32_t id = 0;
+
+    memset(camera, 0, sizeof(*camera));
+    memset(&io, 0, sizeof(io));
+    io.Init = SccbMock_Init;
+    io.DeInit = SccbMock_DeInit;
+    io.Address = 0x3C;
+    io.ReadReg = SccbMock_ReadReg;
+    io.WriteReg = SccbMock_WriteReg;
+    io.GetTick = SccbMock_GetTick;
+    camera->Mode = PARALLEL_MODE;
+
+    return (OV5640_RegisterBusIO(camera, &io) == OV5640_OK) && (OV5640_ReadID(camera, &id) == OV5640_OK) &&
+           (id == OV5640_ID) && (OV5640_Init(camera, OV5640_R640x480, OV5640_Y8) == OV5640_OK) &&
+           (OV5640_SetWindow(camera, &window) == OV5640_OK);
+}
+
+
+int main(void)
+{
+    OV5640_Object_t camera;
+    int ok = 1;
+
+    /* Register tables: ReadID, Init and the window */
+    Bench_Reset(BENCH_SCENE, 0.0);
+
+    if (!Bench_Configure(&camera))
+    {
+        printf("bring-up failed on the register map\n");
+        return 1;
+    }
+
+    const uint32_t regs = sccb_mock.logged;
+    const uint32_t writes = sccb_mock.writes;
+    const uint32_t reads = sccb_mock.reads;
+    const double config_ms = sccb_mock.now_ns / 1e6;
+    /* A write transfer: id, address high and low, then the data, 9 bits a byte, start and stop */
+    const uint64_t write_bits = ((uint64_t)3U * writes + regs) * 9U + 2U * writes;
+    const uint64_t read_bits = sccb_mock.bits - write_bits;
+    const double burst_ms = (double)sccb_mock.bits * 1e3 / SCCB_MOCK_HZ;
+    const double single_ms = (double)((uint64_t)regs * (4U * 9U + 2U) + read_bits) * 1e3 / SCCB_MOCK_HZ;
+
+    printf("ReadID, Init(VGA, Y8), SetWindow(%ux%u): %u registers written, %u reads, SCCB at %.0f kHz\n",
+           BENCH_FLIGHT_W, BENCH_FLIGHT_H, regs, reads, SCCB_MOCK_HZ / 1e3);
+    printf("  one a transfer   %4u transfers  %6.1f ms\n", regs, single_ms);
+    printf("  bursts           %4u transfers  %6.1f ms  (%.1fx fewer)\n", writes, burst_ms, (double)regs / writes);
+
+    /* Exposure: from the end of the tables until the wait returns */
+    SccbMock_ClearStats();
+
+    const double wait0_ns = sccb_mock.now_ns;
+    const int32_t aec = OV5640_WaitAutoExposure(&camera, BENCH_AEC_TIMEOUT_MS);
+    const double wait_ms = (sccb_mock.now_ns - wait0_ns) / 1e6;
+    const double settled_ms = (sensor.settled_ns - wait0_ns) / 1e6;
+    const double frame_ms = Bench_FrameNs() / 1e6;
+
+    printf("auto exposure: settled %.1f ms after the tables (%u frames of %.1f ms, %u moves), level %.0f,\n"
+           "  wait returned after %.1f ms with %d, %u polls\n",
+           settled_ms, sensor.frames, frame_ms, sensor.moves, sensor.level, wait_ms, (int)aec, sccb_mock.reads / 3U);
+
+    if ((aec != OV5640_OK) || (sensor.level < sccb_mock.reg[OV5640_AEC_CTRL10]) ||
+        (sensor.level > sccb_mock.reg[OV5640_AEC_CTRL0F]) || (sensor.settled_ns > sccb_mock.now_ns))
+    {
+        printf("  FAIL: returned before the exposure settled\n");
+        ok = 0;
+    }
+
+    /* First frame once started: the rest of the frame running, then a whole one */
+    const double before_ms = BENCH_OLD_WAITS_MS + single_ms + 2.0 * BENCH_VGA_FRAME_MS;
+    const double after_ms = BENCH_RESET_MS + BENCH_BOOT_MS + config_ms + wait_ms + 2.0 * frame_ms;
+
+    printf("reset to first frame: %.0f ms, was %.0f ms (%.1fx)\n", after_ms, before_ms, before_ms / after_ms);
+
+    /* A flickering scene never settles: the wait gives up at the timeout */
+    Bench_Reset(BENCH_SCENE, 0.5);
+
+    if (!Bench_Configure(&camera))
+    {
+        return 1;
+    }
+
+    const double flicker0_ns = sccb_mock.now_ns;
+    const int32_t flicker = OV5640_WaitAutoExposure(&camera, BENCH_AEC_TIMEOUT_MS);
+    const double flicker_ms = (sccb_mock.now_ns - flicker0_ns) / 1e6;
+
+    printf("flickering scene: %d after %.0f ms\n", (int)flicker, flicker_ms);
+
+    if ((flicker != OV5640_TIMEOUT) || (flicker_ms < BENCH_AEC_TIMEOUT_MS) || (flicker_ms > BENCH_AEC_TIMEOUT_MS + 20.0))
+    {
+        printf("  FAIL: expected a timeout at %u ms\n", BENCH_AEC_TIMEOUT_MS);
+        ok = 0;
+    }
+
+    /* Manual exposure and gain: nothing to wait for */
+    Bench_Reset(BENCH_SCENE, 0.5);
+
+    if (!Bench_Configure(&camera))
+    {
+        return 1;
+    }
+
+    uint8_t manual = 0x03;
+    const double manual0_ns = sccb_mock.now_ns;
+
+    (void)ov5640_write_reg(&camera.Ctx, OV5640_AEC_PK_MANUAL, &manual, 1);
+
+    const int32_t man = OV5640_WaitAutoExposure(&camera, BENCH_AEC_TIMEOUT_MS);
+
+    printf("manual exposure: %d after %.2f ms\n", (int)man, (sccb_mock.now_ns - manual0_ns) / 1e6);
+
+    if ((man != OV5640_OK) || ((sccb_mock.now_ns - manual0_ns) > 2e6))
+    {
+        printf("  FAIL: expected an immediate return\n");
+        ok = 0;
+    }
+
+    printf("\n%s\n", ok ? "ok" : "FAILED");
+
+    return ok ? 0 : 1;
+}
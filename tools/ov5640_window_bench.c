@@ -0,0 +1,358 @@
+/*
+ * OV5640 output windows (OV5640_SetWindow() in Test2/Core/Src/ov5640.c)
+ * checked against a simulated SCCB register map.
+ *
+ *   ov5640_window_bench
+ *
+ * The driver runs unchanged over sccb_mock.h. A model of the sensor
+ * timing, from the datasheet, decodes what the registers make the sensor
+ * output: array window (0x3800..0x3807), skipping (0x3814/0x3815),
+ * binning (bit 0 of 0x3820/0x3821), ISP margins (0x3810..0x3813), DVP
+ * output size (0x3808..0x380B), VTS and the AEC exposure limits. The field
+ * of view is the one OV5640_Init() sets up for VGA.
+ *
+ * Checked:
+ *   - the window { 640, 480, 0, 0, OV5640_SUBSAMPLE_4x4 } leaves every
+ *     register as OV5640_Init(OV5640_R640x480, OV5640_Y8) set it
+ *   - for each window of bench_windows: the sensor outputs Width x Height
+ *     at the decimation asked for, centred where asked within the field,
+ *     with the blanking and exposure margin of VGA; only timing and AEC
+ *     limit registers are written, mirror/flip bits are kept, and
+ *     OV5640_GetWindow() reads the window back (and refuses QVGA, which
+ *     the ISP scales 4:1)
+ *   - windows outside the field, of odd sizes or unknown decimation are
+ *     refused without a register written
+ *
+ * Reported per window: SCCB transfers and bus time, bytes per frame over
+ * the DCMI, and the frame rate relative to VGA (fixed HTS and pixel
+ * clock, so frame time follows VTS). The sequence of the flight window
+ * (Test2 main.c) is listed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ov5640.h"
+#include "sccb_mock.h"
+
+typedef struct
+{
+    int32_t   x_start;              /* Array window */
+    int32_t   x_end;
+    int32_t   y_start;
+    int32_t   y_end;
+    uint32_t  skip_x;               /* Array pixels per sensor pixel */
+    uint32_t  skip_y;
+    uint32_t  bin_x;
+    uint32_t  bin_y;
+    uint32_t  isp_w;                /* Sensor output less the ISP margins */
+    uint32_t  isp_h;
+    uint32_t  out_w;                /* DVP */
+    uint32_t  out_h;
+    uint32_t  lines;                /* Sensor lines read */
+    uint32_t  vts;
+    uint32_t  max_expo;
+    uint32_t  b50_bands;
+    uint32_t  b60_bands;
+    uint32_t  b50_step;
+    uint32_t  b60_step;
+} bench_sensor_t;
+
+typedef struct
+{
+    OV5640_Window_t  win;
+    int              valid;
+    const char      *name;
+} bench_window_t;
+
+static const bench_window_t bench_windows[] =
+{
+    { { 640U, 480U,    0,    0, OV5640_SUBSAMPLE_4x4 }, 1, "VGA"                  },
+    { { 256U, 256U,    0,    0, OV5640_BINNING_4x4   }, 1, "flight"               },
+    { { 256U, 256U,    0,    0, OV5640_SUBSAMPLE_4x4 }, 1, ""                     },
+    { { 256U, 256U,    0,    0, OV5640_BINNING_2x2   }, 1, ""                     },
+    { { 512U, 512U,    0,    0, OV5640_SUBSAMPLE_2x2 }, 1, ""                     },
+    { {1280U, 960U,    0,    0, OV5640_BINNING_2x2   }, 1, "whole field"          },
+    { { 320U, 240U,   80,   60, OV5640_BINNING_4x4   }, 1, ""                     },
+    { { 128U, 128U, -200, -150, OV5640_BINNING_4x4   }, 1, ""                     },
+    { { 160U, 120U,    0,    0, OV5640_BINNING_4x4   }, 1, ""                     },
+    { { 800U, 480U,    0,    0, OV5640_SUBSAMPLE_4x4 }, 0, "wider than the field" },
+    { { 256U, 256U,  200,    0, OV5640_BINNING_4x4   }, 0, "off the field"        },
+    { { 256U, 256U,    0, -200, OV5640_BINNING_2x2   }, 1, ""                     },
+    { { 256U, 256U,    0, -360, OV5640_BINNING_2x2   }, 0, "off the field"        },
+    { { 258U, 256U,    0,    0, OV5640_BINNING_4x4   }, 0, "width not 4n"         },
+    { { 256U, 255U,    0,    0, OV5640_BINNING_4x4   }, 0, "odd height"           },
+    { { 256U, 256U,    0,    0, 4U                   }, 0, "decimation"           },
+};
+
+#define BENCH_WINDOWS  (sizeof(bench_windows) / sizeof(bench_windows[0]))
+#define BENCH_FLIGHT   1U
+
+
+static uint32_t Bench_Reg16(uint16_t reg)
+{
+    return ((uint32_t)sccb_mock.reg[reg] << 8) | sccb_mock.reg[reg + 1U];
+}
+
+
+/* Odd and even increments of 0x3814/0x3815: array pixels per sensor pixel */
+static uint32_t Bench_Skip(uint8_t inc)
+{
+    return ((inc >> 4) + (inc & 0x0FU)) / 2U;
+}
+
+
+static void Bench_Decode(bench_sensor_t *s)
+{
+    s->x_start = (int32_t)Bench_Reg16(OV5640_TIMING_HS_HIGH);
+    s->x_end = (int32_t)Bench_Reg16(OV5640_TIMING_HW_HIGH);
+    s->y_start = (int32_t)Bench_Reg16(OV5640_TIMING_VS_HIGH);
+    s->y_end = (int32_t)Bench_Reg16(OV5640_TIMING_VH_HIGH);
+    s->skip_x = Bench_Skip(sccb_mock.reg[OV5640_TIMING_X_INC]);
+    s->skip_y = Bench_Skip(sccb_mock.reg[OV5640_TIMING_Y_INC]);
+    s->bin_x = sccb_mock.reg[OV5640_TIMING_TC_REG21] & 0x01U;
+    s->bin_y = sccb_mock.reg[OV5640_TIMING_TC_REG20] & 0x01U;
+
+    const uint32_t sensor_w = (uint32_t)(s->x_end - s->x_start + 1) / s->skip_x;
+
+    s->lines = (uint32_t)(s->y_end - s->y_start + 1) / s->skip_y;
+    s->isp_w = sensor_w - 2U * Bench_Reg16(OV5640_TIMING_HOFFSET_HIGH);
+    s->isp_h = s->lines - 2U * Bench_Reg16(OV5640_TIMING_VOFFSET_HIGH);
+    s->out_w = Bench_Reg16(OV5640_TIMING_DVPHO_HIGH);
+    s->out_h = Bench_Reg16(OV5640_TIMING_DVPVO_HIGH);
+    s->vts = Bench_Reg16(OV5640_TIMING_VTS_HIGH);
+    s->max_expo = Bench_Reg16(OV5640_AEC_MAX_EXPO_HIGH);
+    s->b50_step = Bench_Reg16(OV5640_AEC_B50_STEP_HIGH);
+    s->b60_step = Bench_Reg16(OV5640_AEC_B60_STEP_HIGH);
+    s->b50_bands = sccb_mock.reg[OV5640_AEC_CTRL0E];
+    s->b60_bands = sccb_mock.reg[OV5640_AEC_CTRL0D];
+}
+
+
+/* Registers a window may write: the timing block and the AEC exposure limits */
+static int Bench_WindowReg(uint32_t r)
+{
+    return ((r >= OV5640_TIMING_HS_HIGH) && (r <= OV5640_TIMING_Y_INC)) ||
+           (r == OV5640_TIMING_TC_REG20) || (r == OV5640_TIMING_TC_REG21) ||
+           (r == OV5640_AEC_CTRL02) || (r == OV5640_AEC_CTRL03) ||
+           (r == OV5640_AEC_CTRL0D) || (r == OV5640_AEC_CTRL0E) ||
+           (r == OV5640_AEC_MAX_EXPO_HIGH) || (r == OV5640_AEC_MAX_EXPO_LOW);
+}
+
+
+static int Bench_Fail(const bench_window_t *w, const char *what)
+{
+    printf("  FAIL %u x %u %+d %+d dec %u: %s\n", w->win.Width, w->win.Height, w->win.OffsetX, w->win.OffsetY,
+           w->win.Decimation, what);
+
+    return 0;
+}
+
+
+/* The sensor output against the window asked for; field is the VGA set up by Init */
+static int Bench_Check(const bench_window_t *w, const bench_sensor_t *s, const bench_sensor_t *field,
+                       const uint8_t *before)
+{
+    const uint32_t scale = ((w->win.Decimation & OV5640_SUBSAMPLE_4x4) != 0U) ? 2U : 1U;
+    const uint32_t bin = w->win.Decimation & OV5640_BINNING_2x2;
+    const int32_t dec = 2 * (int32_t)scale;
+    int ok = 1;
+
+    if ((s->out_w != w->win.Width) || (s->out_h != w->win.Height))
+    {
+        ok = Bench_Fail(w, "output size");
+    }
+
+    if ((s->skip_x != 2U) || (s->skip_y != 2U) || (s->isp_w != scale * s->out_w) || (s->isp_h != scale * s->out_h))
+    {
+        ok = Bench_Fail(w, "decimation");
+    }
+
+    if ((s->bin_x != bin) || (s->bin_y != bin))
+    {
+        ok = Bench_Fail(w, "binning");
+    }
+
+    if ((s->x_start < field->x_start) || (s->x_end > field->x_end) ||
+        (s->y_start < field->y_start) || (s->y_end > field->y_end) ||
+        ((s->x_start & 1) != 0) || ((s->y_start & 1) != 0))
+    {
+        ok = Bench_Fail(w, "array window outside the field or off the Bayer grid");
+    }
+
+    /* Centres doubled, to stay in integers */
+    if ((s->x_start + s->x_end != field->x_start + field->x_end + 2 * w->win.OffsetX * dec) ||
+        (s->y_start + s->y_end != field->y_start + field->y_end + 2 * w->win.OffsetY * dec))
+    {
+        ok = Bench_Fail(w, "window centre");
+    }
+
+    if ((s->vts - s->lines != field->vts - field->lines) || (s->vts - s->max_expo != field->vts - field->max_expo) ||
+        (Bench_Reg16(OV5640_AEC_CTRL02) != s->max_expo))
+    {
+        ok = Bench_Fail(w, "frame timing or exposure limit");
+    }
+
+    if ((s->b50_bands == 0U) || (s->b60_bands == 0U) ||
+        ((s->b50_bands > 1U) && (s->b50_bands * s->b50_step > s->max_expo)) ||
+        ((s->b60_bands > 1U) && (s->b60_bands * s->b60_step > s->max_expo)))
+    {
+        ok = Bench_Fail(w, "AEC band limits");
+    }
+
+    if ((sccb_mock.reg[OV5640_TIMING_TC_REG20] & 0xFEU) != (before[OV5640_TIMING_TC_REG20] & 0xFEU) ||
+        (sccb_mock.reg[OV5640_TIMING_TC_REG21] & 0xFEU) != (before[OV5640_TIMING_TC_REG21] & 0xFEU))
+    {
+        ok = Bench_Fail(w, "mirror/flip bits");
+    }
+
+    for (uint32_t r = 0; r < 65536U; r++)
+    {
+        if ((sccb_mock.reg[r] != before[r]) && !Bench_WindowReg(r))
+        {
+            printf("  register 0x%04X changed\n", r);
+            ok = Bench_Fail(w, "register outside the window set");
+        }
+    }
+
+    return ok;
+}
+
+
+int main(void)
+{
+    OV5640_Object_t camera;
+    OV5640_IO_t io;
+    bench_sensor_t field;
+    uint8_t *vga = malloc(65536U);
+    uint8_t *before = malloc(65536U);
+    uint32_t id = 0;
+    int ok = 1;
+
+    memset(&camera, 0, sizeof(camera));
+    memset(&io, 0, sizeof(io));
+    io.Init = SccbMock_Init;
+    io.DeInit = SccbMock_DeInit;
+    io.Address = 0x3C;
+    io.ReadReg = SccbMock_ReadReg;
+    io.WriteReg = SccbMock_WriteReg;
+    io.GetTick = SccbMock_GetTick;
+    camera.Mode = PARALLEL_MODE;
+
+    SccbMock_Reset();
+
+    if ((OV5640_RegisterBusIO(&camera, &io) != OV5640_OK) || (OV5640_ReadID(&camera, &id) != OV5640_OK) ||
+        (id != OV5640_ID) || (OV5640_Init(&camera, OV5640_R640x480, OV5640_Y8) != OV5640_OK))
+    {
+        printf("OV5640_Init() failed on the register map\n");
+        return 1;
+    }
+
+    printf("OV5640_Init(VGA, Y8): %u writes, %u reads, %.1f ms of SCCB at %.0f kHz\n", sccb_mock.writes,
+           sccb_mock.reads, (double)sccb_mock.bits * 1e3 / SCCB_MOCK_HZ, SCCB_MOCK_HZ / 1e3);
+
+    memcpy(vga, sccb_mock.reg, 65536U);
+    Bench_Decode(&field);
+
+    printf("field: array %d..%d x %d..%d, VTS %u\n\n", field.x_start, field.x_end, field.y_start, field.y_end,
+           field.vts);
+    printf("%-24s %-13s %6s %5s %7s %9s %5s %7s\n", "window", "decimation", "writes", "reads", "bus ms",
+           "bytes", "VTS", "rate");
+
+    for (uint32_t i = 0; i < BENCH_WINDOWS; i++)
+    {
+        static const char *const dec_name[] = { "subsample 2x2", "binning 2x2", "subsample 4x4", "binning 4x4" };
+        const bench_window_t *w = &bench_windows[i];
+        OV5640_Window_t back;
+        bench_sensor_t s;
+        char label[32];
+
+        /* Each window from the state Init left */
+        memcpy(sccb_mock.reg, vga, 65536U);
+        memcpy(before, vga, 65536U);
+        SccbMock_ClearStats();
+
+        const int32_t ret = OV5640_SetWindow(&camera, &w->win);
+
+        snprintf(label, sizeof(label), "%ux%u %+d%+d", w->win.Width, w->win.Height, w->win.OffsetX, w->win.OffsetY);
+
+        if (!w->valid)
+        {
+            const int untouched = (sccb_mock.writes == 0U) && (memcmp(sccb_mock.reg, vga, 65536U) == 0);
+
+            printf("%-24s %-13s %s (%s)\n", label, (w->win.Decimation < 4U) ? dec_name[w->win.Decimation] : "?",
+                   ((ret != OV5640_OK) && untouched) ? "refused" : "NOT REFUSED", w->name);
+
+            if ((ret == OV5640_OK) || !untouched)
+            {
+                ok = Bench_Fail(w, "accepted, or registers written");
+            }
+
+            continue;
+        }
+
+        if (ret != OV5640_OK)
+        {
+            ok = Bench_Fail(w, "refused");
+            continue;
+        }
+
+        const uint32_t writes = sccb_mock.writes;
+        const uint32_t reads = sccb_mock.reads;
+        const double bus_ms = (double)sccb_mock.bits * 1e3 / SCCB_MOCK_HZ;
+
+        Bench_Decode(&s);
+        ok &= Bench_Check(w, &s, &field, before);
+
+        if ((OV5640_GetWindow(&camera, &back) != OV5640_OK) || (back.Width != w->win.Width) ||
+            (back.Height != w->win.Height) || (back.OffsetX != w->win.OffsetX) ||
+            (back.OffsetY != w->win.OffsetY) || (back.Decimation != w->win.Decimation))
+        {
+            ok = Bench_Fail(w, "OV5640_GetWindow()");
+        }
+
+        printf("%-24s %-13s %6u %5u %7.2f %9u %5u %6.2fx  %s\n", label, dec_name[w->win.Decimation], writes, reads,
+               bus_ms, (uint32_t)w->win.Width * w->win.Height, s.vts, (double)field.vts / s.vts, w->name);
+
+        if ((i == 0U) && (memcmp(sccb_mock.reg, vga, 65536U) != 0))
+        {
+            ok = Bench_Fail(w, "not the VGA of OV5640_Init()");
+        }
+
+        if (i == BENCH_FLIGHT)
+        {
+            const uint32_t n = (sccb_mock.logged < SCCB_MOCK_LOG) ? sccb_mock.logged : SCCB_MOCK_LOG;
+
+            printf("  sequence:");
+
+            for (uint32_t k = 0; k < n; k++)
+            {
+                printf("%s %04X=%02X", ((k % 8U) == 0U) ? "\n   " : "", sccb_mock.log_reg[k], sccb_mock.log_val[k]);
+            }
+
+            printf("\n");
+        }
+    }
+
+    /* QVGA scales the VGA field 4:1 in the ISP: not a window, GetWindow() must say so */
+    memcpy(sccb_mock.reg, vga, 65536U);
+
+    {
+        OV5640_Window_t back;
+
+        if ((OV5640_SetResolution(&camera, OV5640_R320x240) != OV5640_OK) ||
+            (OV5640_GetWindow(&camera, &back) == OV5640_OK))
+        {
+            printf("QVGA taken for a window\n");
+            ok = 0;
+        }
+    }
+
+    printf("\n%s\n", ok ? "all windows as asked" : "FAILED");
+
+    free(vga);
+    free(before);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,370 @@
+/*
+ * Host benchmark for the phase-correlation engine.
+ *
+ * Correlates a synthetic reference tile against a copy shifted by a known
+ * amount, for each FFT size, and reports the average time per fix together
+ * with the recovered shift. Compare the timings against one camera frame
+ * period (33 ms at 30 fps).
+ *
+ * "precomputed" is the on-target path with a stored Q15 phase-only reference spectrum
+ * (.SPT): only the frame is transformed and the reference rows are decoded
+ * and streamed into the cross-power step.
+ *
+ * "batch" correlates the frame against a 3x3 neighbourhood of stored tiles
+ * with PhaseCorrBatch_Run() (one frame transform for all of them) and is
+ * compared with running the precomputed path once per tile.
+ *
+ * "load" compares ways of getting the frame into the FFT: separate
+ * convert / window / copy passes as in phase_corr.py, the fused kernel
+ * (PhaseCorr_LoadWindowed()), and the fused kernel writing bit-reversed rows
+ * for FFT_Real2DBitRev(); times are load alone and load + forward FFT.
+ *
+ *   make -C tools && tools/build/phase_corr_bench
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phase_corr.h"
+#include "phase_corr_batch.h"
+#include "spectrum_tile.h"
+#include "host_util.h"
+
+#define BENCH_MAP_SIZE     1024U
+#define BENCH_RUNS         10U
+#define BENCH_SHIFT_X      17
+#define BENCH_SHIFT_Y      -9
+#define BENCH_TILES        9U
+#define BENCH_TILE_STEP    64
+#define BENCH_CHUNK_ROWS   8U
+
+typedef struct
+{
+    const int16_t *payload[BENCH_TILES];
+} bench_source_t;
+
+
+static void Bench_Crop(const uint8_t *map, uint8_t *dst, uint32_t n, int32_t x0, int32_t y0)
+{
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            dst[y * n + x] = map[(uint32_t)(y0 + (int32_t)y) * BENCH_MAP_SIZE + (uint32_t)(x0 + (int32_t)x)];
+        }
+    }
+}
+
+
+/* In-memory spectrum_source_t over Q15 payloads */
+static int Bench_ReadStart(void *ctx, uint32_t tile, uint32_t offset, void *dst, uint32_t bytes)
+{
+    bench_source_t *bs = (bench_source_t *)ctx;
+
+    memcpy(dst, (const uint8_t *)bs->payload[tile] + offset, bytes);
+
+    return 0;
+}
+
+
+/*
+ * Tiles on a 3x3 grid around the frame position; tile 4 is the one the frame
+ * was cut from. Returns 1 if the batch picks it with the expected shift.
+ */
+static int Bench_Batch(const uint8_t *map, phase_corr_t *pc, const image_t *frame, uint32_t n)
+{
+    const int32_t c = (int32_t)(BENCH_MAP_SIZE - n) / 2;
+    spectrum_tile_header_t hdrs[BENCH_TILES];
+    phase_corr_result_t results[BENCH_TILES];
+    bench_source_t bs = {0};
+    uint8_t *tile_px = malloc(n * n);
+    void *raw_a = malloc(PHASE_CORR_BATCH_RAW_BYTES(n, BENCH_CHUNK_ROWS));
+    void *raw_b = malloc(PHASE_CORR_BATCH_RAW_BYTES(n, BENCH_CHUNK_ROWS));
+    float *rows = malloc(BENCH_CHUNK_ROWS * FFT_REAL_ROW_FLOATS(n) * sizeof(float));
+    image_t tile = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = tile_px };
+    const spectrum_source_t src = { Bench_ReadStart, 0, &bs };
+    phase_corr_batch_t batch;
+    uint32_t best = 0U;
+    phase_corr_result_t res;
+
+    for (uint32_t t = 0; t < BENCH_TILES; t++)
+    {
+        int16_t *payload = malloc(n * FFT_REAL_ROW_FLOATS(n) * sizeof(int16_t));
+
+        Bench_Crop(map, tile_px, n, c + ((int32_t)(t % 3U) - 1) * BENCH_TILE_STEP,
+                   c + ((int32_t)(t / 3U) - 1) * BENCH_TILE_STEP);
+        (void)PhaseCorr_Forward(pc, &tile, pc->work_b);
+        SpectrumTile_InitHeader(&hdrs[t], n, SPECTRUM_QUANT_Q15_PHASE, 0, 0);
+        SpectrumTile_EncodeRows(&hdrs[t], pc->work_b, payload, n);
+        bs.payload[t] = payload;
+    }
+
+    /* One tile at a time: frame transformed for every tile */
+    double t0 = Host_NowMs();
+
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        for (uint32_t t = 0; t < BENCH_TILES; t++)
+        {
+            (void)PhaseCorr_Forward(pc, frame, pc->work_a);
+
+            for (uint32_t row = 0; row < n; row += BENCH_CHUNK_ROWS)
+            {
+                SpectrumTile_DecodeRows(&hdrs[t], &bs.payload[t][row * FFT_REAL_ROW_FLOATS(n)], rows, BENCH_CHUNK_ROWS);
+                PhaseCorr_CrossPower(pc, rows, row, BENCH_CHUNK_ROWS);
+            }
+
+            (void)PhaseCorr_FindPeak(pc, &res);
+        }
+    }
+
+    double ms_single = (Host_NowMs() - t0) / BENCH_RUNS;
+
+    (void)PhaseCorrBatch_Init(&batch, pc, &src, BENCH_CHUNK_ROWS, raw_a, raw_b, rows);
+
+    t0 = Host_NowMs();
+
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        (void)PhaseCorrBatch_Run(&batch, frame, hdrs, BENCH_TILES, results, &best);
+    }
+
+    double ms_batch = (Host_NowMs() - t0) / BENCH_RUNS;
+    int ok = (best == 4U) && (results[best].dx == BENCH_SHIFT_X) && (results[best].dy == BENCH_SHIFT_Y);
+
+    printf("%4ux%-4u batch of %u     %8.2f ms/fix  (%.2f ms one by one)  best %u shift (%d, %d)  peak %.3f  %s\n",
+           n, n, BENCH_TILES, ms_batch, ms_single, best, results[best].dx, results[best].dy,
+           results[best].peak, ok ? "OK" : "WRONG");
+
+    for (uint32_t t = 0; t < BENCH_TILES; t++)
+    {
+        free((void *)bs.payload[t]);
+    }
+
+    free(tile_px);
+    free(raw_a);
+    free(raw_b);
+    free(rows);
+
+    return ok;
+}
+
+
+/* Frame to FFT input the way phase_corr.py does it: convert, window, copy */
+static void Bench_LoadPasses(const phase_corr_t *pc, const image_t *img, float *tmp, float *dst)
+{
+    const uint32_t n = pc->n;
+
+    for (uint32_t i = 0; i < n * n; i++)
+    {
+        tmp[i] = (float)img->pixels[i];
+    }
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            tmp[y * n + x] *= pc->window[y] * pc->window[x];
+        }
+    }
+
+    for (uint32_t y = 0; y < n; y++)
+    {
+        memcpy(&dst[y * FFT_REAL_ROW_FLOATS(n)], &tmp[y * n], n * sizeof(float));
+    }
+}
+
+
+static int Bench_Load(phase_corr_t *pc, const image_t *frame)
+{
+    const uint32_t n = pc->n;
+    const uint32_t runs = BENCH_RUNS * 10U;
+    float *tmp = malloc(n * n * sizeof(float));
+    float *ref = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    float *out = pc->work_a;
+    double ms_load[3];
+    double ms_fft[3];
+    float err = 0.0f;
+
+    for (uint32_t v = 0; v < 3U; v++)
+    {
+        double t0 = Host_NowMs();
+
+        for (uint32_t i = 0; i < runs; i++)
+        {
+            if (v == 0U)
+            {
+                Bench_LoadPasses(pc, frame, tmp, out);
+            }
+            else
+            {
+                (void)PhaseCorr_LoadWindowed(pc, frame, 1U, (v == 1U) ? PHASE_CORR_LAYOUT_NATURAL :
+                                             PHASE_CORR_LAYOUT_BITREV, out);
+            }
+        }
+
+        ms_load[v] = (Host_NowMs() - t0) / runs;
+        t0 = Host_NowMs();
+
+        for (uint32_t i = 0; i < runs; i++)
+        {
+            if (v == 0U)
+            {
+                Bench_LoadPasses(pc, frame, tmp, out);
+                FFT_Real2D(&pc->plan, out, pc->col);
+            }
+            else if (v == 1U)
+            {
+                (void)PhaseCorr_LoadWindowed(pc, frame, 1U, PHASE_CORR_LAYOUT_NATURAL, out);
+                FFT_Real2D(&pc->plan, out, pc->col);
+            }
+            else
+            {
+                (void)PhaseCorr_Forward(pc, frame, out);
+            }
+        }
+
+        ms_fft[v] = (Host_NowMs() - t0) / runs;
+
+        /* All three must give the same spectrum */
+        if (v == 0U)
+        {
+            memcpy(ref, out, PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+        }
+        else
+        {
+            float mag = 0.0f;
+            float d = 0.0f;
+
+            for (uint32_t i = 0; i < PHASE_CORR_WORK_FLOATS(n); i++)
+            {
+                mag = (fabsf(ref[i]) > mag) ? fabsf(ref[i]) : mag;
+                d = (fabsf(out[i] - ref[i]) > d) ? fabsf(out[i] - ref[i]) : d;
+            }
+
+            /* Rounding differs with the order of the window products */
+            err = ((d / mag) > err) ? (d / mag) : err;
+        }
+    }
+
+    const int ok = err < 1e-5f;
+
+    printf("%4ux%-4u load          passes %.3f ms  fused %.3f ms  bit-reversed %.3f ms\n", n, n,
+           ms_load[0], ms_load[1], ms_load[2]);
+    printf("%4ux%-4u load + FFT    passes %.2f ms  fused %.2f ms  bit-reversed %.2f ms  %s\n", n, n,
+           ms_fft[0], ms_fft[1], ms_fft[2], ok ? "OK" : "MISMATCH");
+
+    free(tmp);
+    free(ref);
+
+    return ok;
+}
+
+
+static int Bench_Size(const uint8_t *map, uint32_t n)
+{
+    phase_corr_t *pc = malloc(sizeof(phase_corr_t));
+    float *work_a = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    float *work_b = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    uint8_t *ref_px = malloc(n * n);
+    uint8_t *frame_px = malloc(n * n);
+    int32_t c = (int32_t)(BENCH_MAP_SIZE - n) / 2;
+    phase_corr_result_t res = {0};
+    int ok;
+
+    /* frame(x) = ref(x - shift) */
+    Bench_Crop(map, ref_px, n, c, c);
+    Bench_Crop(map, frame_px, n, c - BENCH_SHIFT_X, c - BENCH_SHIFT_Y);
+
+    image_t ref = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = ref_px };
+    image_t frame = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = frame_px };
+
+    if (PhaseCorr_Init(pc, n, work_a, work_b) != PHASE_CORR_OK)
+    {
+        printf("%4ux%-4u init failed\n", n, n);
+        return 1;
+    }
+
+    double t0 = Host_NowMs();
+
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        (void)PhaseCorr_Run(pc, &frame, &ref, &res);
+    }
+
+    double ms = (Host_NowMs() - t0) / BENCH_RUNS;
+
+    ok = (res.dx == BENCH_SHIFT_X) && (res.dy == BENCH_SHIFT_Y);
+
+    printf("%4ux%-4u both images   %8.2f ms/fix  shift (%d, %d)  peak %.3f  psr %5.1f  2nd %.3f  %s\n",
+           n, n, ms, res.dx, res.dy, res.peak, res.psr, res.second_peak, ok ? "OK" : "WRONG");
+
+    /* Reference spectrum computed once, stored as Q15 phasors */
+    spectrum_tile_header_t hdr;
+    int16_t *stored = malloc(n * FFT_REAL_ROW_FLOATS(n) * sizeof(int16_t));
+    float rows[8U * FFT_REAL_ROW_FLOATS(FFT_MAX_N)];
+
+    (void)PhaseCorr_Forward(pc, &ref, work_b);
+    SpectrumTile_InitHeader(&hdr, n, SPECTRUM_QUANT_Q15_PHASE, 0, 0);
+    SpectrumTile_EncodeRows(&hdr, work_b, stored, n);
+
+    t0 = Host_NowMs();
+
+    for (uint32_t i = 0; i < BENCH_RUNS; i++)
+    {
+        (void)PhaseCorr_Forward(pc, &frame, work_a);
+
+        for (uint32_t row = 0; row < n; row += 8U)
+        {
+            SpectrumTile_DecodeRows(&hdr, &stored[row * FFT_REAL_ROW_FLOATS(n)], rows, 8U);
+            PhaseCorr_CrossPower(pc, rows, row, 8U);
+        }
+
+        (void)PhaseCorr_FindPeak(pc, &res);
+    }
+
+    ms = (Host_NowMs() - t0) / BENCH_RUNS;
+    ok &= (res.dx == BENCH_SHIFT_X) && (res.dy == BENCH_SHIFT_Y);
+
+    printf("%4ux%-4u precomputed   %8.2f ms/fix  shift (%d, %d)  peak %.3f  psr %5.1f  2nd %.3f  %s\n",
+           n, n, ms, res.dx, res.dy, res.peak, res.psr, res.second_peak, ok ? "OK" : "WRONG");
+
+    free(stored);
+
+    ok &= Bench_Batch(map, pc, &frame, n);
+    ok &= Bench_Load(pc, &frame);
+
+    free(pc);
+    free(work_a);
+    free(work_b);
+    free(ref_px);
+    free(frame_px);
+
+    return ok ? 0 : 1;
+}
+
+
+int main(void)
+{
+    uint8_t *map = malloc(BENCH_MAP_SIZE * BENCH_MAP_SIZE);
+    static fft_plan_t plan;
+    int err = 0;
+
+    /* Below FFT_MIN_N the half-length transform of the real path runs off the row */
+    if ((FFT_Init(&plan, FFT_MIN_N / 2U) == 0) || (FFT_Init(&plan, FFT_MIN_N) != 0))
+    {
+        printf("FFT_Init size limits: FAILED\n");
+        err = 1;
+    }
+
+    Host_MakeTexture(map, BENCH_MAP_SIZE, BENCH_MAP_SIZE, 42U);
+
+    err |= Bench_Size(map, 256U);
+    err |= Bench_Size(map, 512U);
+
+    free(map);
+
+    return err;
+}
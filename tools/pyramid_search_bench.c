@@ -0,0 +1,104 @@
+/*
+ * Host benchmark for the coarse-to-fine pyramid search.
+ *
+ * Cuts a 640x480 frame out of synthetic maps of growing size at a known
+ * position and localises it with PyramidSearch_Run(), printing the
+ * per-level estimate, peak and time. The number of levels, and so the
+ * cost, grows with log2 of the map size.
+ *
+ *   make -C tools && tools/build/pyramid_search_bench
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pyramid_search.h"
+#include "host_util.h"
+
+#define BENCH_N            256U
+#define BENCH_FRAME_W      640U
+#define BENCH_FRAME_H      480U
+
+
+static uint32_t Bench_NowUs(void)
+{
+    return (uint32_t)(Host_NowMs() * 1000.0);
+}
+
+
+static int Bench_Map(uint32_t size)
+{
+    uint8_t *map_px = malloc((size_t)size * size);
+    uint8_t *frame_px = malloc(BENCH_FRAME_W * BENCH_FRAME_H);
+    uint32_t levels = Pyramid_LevelsFor(size, size, BENCH_N);
+    uint8_t *map_buf = malloc(Pyramid_BufBytes(size, size, levels) + 1U);
+    uint8_t *scratch = malloc(PyramidSearch_ScratchBytes(BENCH_FRAME_W, BENCH_FRAME_H, BENCH_N, levels));
+    float *work_a = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N) * sizeof(float));
+    float *work_b = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N) * sizeof(float));
+    static phase_corr_t pc;
+    static pyramid_search_t ps;
+    image_t map_levels[PYRAMID_MAX_LEVELS];
+    pyramid_result_t res;
+
+    Host_MakeTexture(map_px, size, size, size);
+
+    /* Frame centre somewhere off-centre in the map */
+    int32_t cx = (int32_t)(size * 3U / 10U) + 37;
+    int32_t cy = (int32_t)(size * 7U / 10U) - 11;
+
+    for (uint32_t y = 0; y < BENCH_FRAME_H; y++)
+    {
+        memcpy(&frame_px[y * BENCH_FRAME_W],
+               &map_px[(uint32_t)(cy - (int32_t)BENCH_FRAME_H / 2 + (int32_t)y) * size + (uint32_t)(cx - (int32_t)BENCH_FRAME_W / 2)],
+               BENCH_FRAME_W);
+    }
+
+    image_t map = { .w = (int)size, .h = (int)size, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = map_px };
+    image_t frame = { .w = BENCH_FRAME_W, .h = BENCH_FRAME_H, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = frame_px };
+
+    (void)Pyramid_Build(&map, map_levels, levels, map_buf);
+    (void)PhaseCorr_Init(&pc, BENCH_N, work_a, work_b);
+    (void)PyramidSearch_Init(&ps, &pc, map_levels, levels, scratch, Bench_NowUs);
+
+    double t0 = Host_NowMs();
+    int err = PyramidSearch_Run(&ps, &frame, &res);
+    double ms = Host_NowMs() - t0;
+    int ok = (err == PYRAMID_OK) && (res.x == cx) && (res.y == cy);
+
+    printf("map %5ux%-5u  %u levels  %7.2f ms  found (%d, %d) expected (%d, %d)  %s\n",
+           size, size, levels, ms, res.x, res.y, cx, cy, ok ? "OK" : "WRONG");
+    printf("    frame pyramid        %7.2f ms\n", res.build_us / 1000.0);
+
+    for (int32_t l = (int32_t)levels - 1; l >= 0; l--)
+    {
+        printf("    level %d  %4dx%-4d  %7.2f ms  estimate (%d, %d)  peak %.3f\n",
+               l, map_levels[l].w, map_levels[l].h, res.level[l].time_us / 1000.0,
+               res.level[l].x, res.level[l].y, res.level[l].peak);
+    }
+
+    free(map_px);
+    free(frame_px);
+    free(map_buf);
+    free(scratch);
+    free(work_a);
+    free(work_b);
+
+    return ok ? 0 : 1;
+}
+
+
+int main(void)
+{
+    int err = 0;
+
+    err |= Bench_Map(1024U);
+    err |= Bench_Map(2048U);
+    err |= Bench_Map(4096U);
+    err |= Bench_Map(8192U);
+
+    return err;
+}
@@ -0,0 +1,283 @@
+/*
+ * Telemetry logging through a FatFs file against the raw ring log.
+ *
+ *   ring_log_bench [ring file]
+ *
+ * The flight storage path (FatFs, user_diskio.c with its sector cache, the
+ * SD driver) runs over a simulated 64 MB card (sd_mock.h) at 25 MHz.
+ * BENCH_RECORDS 64-byte position records are logged two ways, flushed
+ * every BENCH_FLUSH_EVERY records:
+ *
+ *   file   f_write() of each record to LOG.BIN, f_sync() to flush (what
+ *          SD_TestWrite() does)
+ *   ring   RingLog_Append() to NAV.LOG (ring_log_sd.h), RingLog_Flush()
+ *
+ * Reported: card time per flush interval (mean and worst), SD commands
+ * and sectors programmed per 1000 records. The ring is then checked for
+ * recovery after a power cut (records appended after the last flush are
+ * lost, the rest found again) and across wraps. With a file argument the
+ * ring (NAV.LOG) is saved there for ring_log_csv.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ff_gen_drv.h"
+#include "nav.h"
+#include "ring_log_sd.h"
+#include "sd_mock.h"
+#include "user_diskio.h"
+
+#define BENCH_SECTORS        131072U       /* 64 MB */
+#define BENCH_HZ             25e6
+#define BENCH_CALL_US        1.5
+#define BENCH_RECORDS        4096U
+#define BENCH_FLUSH_EVERY    16U
+#define BENCH_RING_BYTES     (1024U * 1024U)
+#define BENCH_SMALL_BYTES    (64U * 1024U)
+#define BENCH_BUF_SECTORS    8U
+
+typedef struct
+{
+    double   sum_ms;
+    double   max_ms;
+    uint32_t intervals;
+    uint32_t commands;
+    uint32_t writes;
+} bench_cost_t;
+
+static uint8_t    *bench_image;
+static sd_mock_t   bench_card;
+static FATFS       bench_fs;
+static char        bench_path[4];
+static uint8_t     bench_work[4096];
+static uint8_t     bench_ring_buf[BENCH_BUF_SECTORS * RING_LOG_SECTOR];
+
+
+static position_fix_t Bench_Fix(uint32_t i)
+{
+    position_fix_t fix = { 0 };
+
+    fix.x = 100.0f + 0.25f * (float)i;
+    fix.y = 50.0f - 0.125f * (float)i;
+    fix.psr = 12.0f;
+    fix.source = POSITION_SOURCE_INCREMENTAL;
+    fix.valid = 1U;
+    fix.frame = i;
+
+    return fix;
+}
+
+
+static void Bench_Interval(bench_cost_t *c, double t0_ns)
+{
+    const double ms = (bench_card.now_ns - t0_ns) * 1e-6;
+
+    c->sum_ms += ms;
+    c->max_ms = (ms > c->max_ms) ? ms : c->max_ms;
+    c->intervals++;
+}
+
+
+static void Bench_Report(const char *name, const bench_cost_t *c, int ok)
+{
+    printf("%-5s %7.2f ms/flush mean %7.2f ms worst  %7.1f cmd/1000 rec  %7.1f sectors/1000 rec  %s\n",
+           name, c->sum_ms / c->intervals, c->max_ms, 1000.0 * c->commands / BENCH_RECORDS,
+           1000.0 * c->writes / BENCH_RECORDS, ok ? "OK" : "FAILED");
+}
+
+
+static int Bench_File(void)
+{
+    const sd_mock_stats_t s0 = bench_card.stats;
+    bench_cost_t c = { 0 };
+    FIL f;
+    UINT n;
+    int ok = f_open(&f, "LOG.BIN", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK;
+    double t0 = bench_card.now_ns;
+
+    for (uint32_t i = 0; ok && (i < BENCH_RECORDS); i++)
+    {
+        const position_fix_t fix = Bench_Fix(i);
+        uint8_t rec[RING_LOG_RECORD] = { 0 };
+
+        memcpy(rec, &fix, sizeof(fix));
+        ok = (f_write(&f, rec, sizeof(rec), &n) == FR_OK) && (n == sizeof(rec));
+
+        if (((i + 1U) % BENCH_FLUSH_EVERY) == 0U)
+        {
+            ok &= f_sync(&f) == FR_OK;
+            Bench_Interval(&c, t0);
+            t0 = bench_card.now_ns;
+        }
+    }
+
+    ok &= f_close(&f) == FR_OK;
+    c.commands = bench_card.stats.commands - s0.commands;
+    c.writes = bench_card.stats.writes - s0.writes;
+    Bench_Report("file", &c, ok);
+
+    return ok;
+}
+
+
+static int Bench_Append(ring_log_sd_t *rl, uint32_t first, uint32_t count, uint32_t flush_every,
+                        bench_cost_t *c)
+{
+    double t0 = bench_card.now_ns;
+    int ok = 1;
+
+    for (uint32_t i = first; ok && (i < (first + count)); i++)
+    {
+        const position_fix_t fix = Bench_Fix(i);
+
+        ok = RingLog_Append(&rl->log, NAV_LOG_FIX, i * 100U, &fix, sizeof(fix)) == RING_LOG_OK;
+
+        if ((flush_every != 0U) && (((i + 1U) % flush_every) == 0U))
+        {
+            ok &= RingLog_Flush(&rl->log) == RING_LOG_OK;
+
+            if (c != 0)
+            {
+                Bench_Interval(c, t0);
+                t0 = bench_card.now_ns;
+            }
+        }
+    }
+
+    return ok;
+}
+
+
+typedef struct
+{
+    uint32_t next;          /* Sequence number expected */
+    uint32_t seen;
+    int      ok;
+} bench_walk_t;
+
+
+static int Bench_Visit(void *ctx, const ring_log_record_t *rec)
+{
+    bench_walk_t *w = (bench_walk_t *)ctx;
+    position_fix_t fix;
+
+    memcpy(&fix, rec->payload, sizeof(fix));
+
+    if (w->seen == 0U)
+    {
+        w->next = rec->seq;
+    }
+
+    w->ok &= (rec->seq == w->next) && (rec->type == NAV_LOG_FIX) && (fix.frame == rec->seq);
+    w->next = rec->seq + 1U;
+    w->seen++;
+
+    return 0;
+}
+
+
+/* Remount and open the ring again, as after a reset */
+static int Bench_Reboot(ring_log_sd_t *rl, const char *path, uint32_t bytes)
+{
+    return (f_mount(0, bench_path, 0) == FR_OK) && (f_mount(&bench_fs, bench_path, 1) == FR_OK) &&
+           (RingLogSD_Open(rl, path, bytes, bench_ring_buf, BENCH_BUF_SECTORS, 0x5EED0001UL) == RING_LOG_OK);
+}
+
+
+static int Bench_Ring(const char *save)
+{
+    ring_log_sd_t rl;
+    bench_cost_t c = { 0 };
+    bench_walk_t w = { 0, 0, 1 };
+    sd_mock_stats_t s0;
+    int ok;
+
+    ok = RingLogSD_Open(&rl, "NAV.LOG", BENCH_RING_BYTES, bench_ring_buf, BENCH_BUF_SECTORS, 0x5EED0001UL) ==
+         RING_LOG_OK;
+    s0 = bench_card.stats;
+    ok &= Bench_Append(&rl, 0U, BENCH_RECORDS, BENCH_FLUSH_EVERY, &c);
+    c.commands = bench_card.stats.commands - s0.commands;
+    c.writes = bench_card.stats.writes - s0.writes;
+    Bench_Report("ring", &c, ok);
+
+    /* Power cut: 10 records appended after the last flush are lost */
+    ok &= Bench_Append(&rl, BENCH_RECORDS, 10U, 0U, 0);
+    ok &= Bench_Reboot(&rl, "NAV.LOG", BENCH_RING_BYTES);
+    ok &= rl.log.next_seq == BENCH_RECORDS;
+    printf("recovery: next seq %u of %u after a power cut, %u sector reads over %u sectors\n",
+           rl.log.next_seq, BENCH_RECORDS, rl.log.stats.open_reads, rl.log.sectors);
+
+    /* Logging carries on where it stopped */
+    ok &= Bench_Append(&rl, BENCH_RECORDS, 5U, 0U, 0) && (RingLog_Flush(&rl.log) == RING_LOG_OK);
+    ok &= RingLog_ForEach(&rl.log, Bench_Visit, &w) == RING_LOG_OK;
+    ok &= w.ok && (w.seen == (BENCH_RECORDS + 5U)) && (w.next == (BENCH_RECORDS + 5U));
+
+    if (save != 0)
+    {
+        FILE *fp = fopen(save, "wb");
+        const size_t bytes = (size_t)(rl.log.sectors + 1U) * RING_LOG_SECTOR;
+
+        ok &= (fp != 0) && (fwrite(&bench_image[(size_t)rl.log.base * RING_LOG_SECTOR], 1, bytes, fp) == bytes);
+
+        if (fp != 0)
+        {
+            fclose(fp);
+        }
+    }
+
+    /* A small ring, around several times, reopened at odd points */
+    ring_log_sd_t small;
+    uint32_t total = 0U;
+
+    ok &= RingLogSD_Open(&small, "SMALL.LOG", BENCH_SMALL_BYTES, bench_ring_buf, BENCH_BUF_SECTORS, 0x5EED0002UL) ==
+          RING_LOG_OK;
+
+    for (uint32_t round = 0; ok && (round < 6U); round++)
+    {
+        const uint32_t n = 397U + round * 211U;
+
+        ok &= Bench_Append(&small, total, n, 0U, 0) && (RingLog_Flush(&small.log) == RING_LOG_OK);
+        total += n;
+        ok &= Bench_Reboot(&small, "SMALL.LOG", BENCH_SMALL_BYTES) && (small.log.next_seq == total);
+    }
+
+    w.next = 0U;
+    w.seen = 0U;
+    w.ok = 1;
+    ok &= RingLog_ForEach(&small.log, Bench_Visit, &w) == RING_LOG_OK;
+    ok &= w.ok && (w.next == total) && (w.seen > ((small.log.sectors - 1U) * RING_LOG_PER_SECTOR));
+    printf("wrap: %u records through a %u-record ring, %u kept in order, next seq %u  %s\n",
+           total, small.log.sectors * RING_LOG_PER_SECTOR, w.seen, small.log.next_seq, ok ? "OK" : "FAILED");
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ok = 1;
+
+    bench_image = calloc(BENCH_SECTORS, SD_MOCK_BLOCK);
+    SdMock_Init(&bench_card, bench_image, BENCH_SECTORS, BENCH_HZ, BENCH_CALL_US * 1e3, 1);
+    SD_SPI_SetBus(&bench_card.bus);
+
+    if ((FATFS_LinkDriver(&USER_Driver, bench_path) != 0U) ||
+        (f_mkfs(bench_path, FM_ANY, 4096U, bench_work, sizeof(bench_work)) != FR_OK) ||
+        (f_mount(&bench_fs, bench_path, 1) != FR_OK))
+    {
+        printf("no volume\n");
+        return 1;
+    }
+
+    ok &= Bench_File();
+    ok &= Bench_Ring((argc > 1) ? argv[1] : 0);
+    ok &= bench_card.stats.errors == 0U;
+
+    f_mount(0, bench_path, 0);
+    SD_SPI_ReleaseBus();
+    free(bench_image);
+
+    return ok ? 0 : 1;
+}
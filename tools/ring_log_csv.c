@@ -0,0 +1,165 @@
+/*
+ * Ring log (Test2/Core/Inc/ring_log.h) to CSV.
+ *
+ *   ring_log_csv <ring file> [first sector]
+ *
+ * The ring file is NAV.LOG (or any ring) copied off the card, or a whole
+ * card image with the sector of the ring header given. The records come
+ * out oldest first, one line each:
+ *
+ *   seq,time_ms,type,x,y,peak,psr,source,valid,frame,since_anchor,data
+ *
+ * Position fixes (NAV_LOG_FIX) fill the position_fix_t columns; text
+ * records put their text in data, any other type its payload in hex.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nav.h"
+#include "ring_log.h"
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t         size;
+} csv_file_t;
+
+static uint8_t csv_buf[RING_LOG_SECTOR];
+
+
+static int Csv_Read(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count)
+{
+    const csv_file_t *f = (const csv_file_t *)ctx;
+    const size_t at = (size_t)sector * RING_LOG_SECTOR;
+
+    if ((at > f->size) || (((size_t)count * RING_LOG_SECTOR) > (f->size - at)))
+    {
+        return -1;
+    }
+
+    memcpy(dst, &f->data[at], (size_t)count * RING_LOG_SECTOR);
+
+    return 0;
+}
+
+
+/* The file is only read */
+static int Csv_Write(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count)
+{
+    (void)ctx;
+    (void)src;
+    (void)sector;
+    (void)count;
+
+    return -1;
+}
+
+
+static int Csv_Record(void *ctx, const ring_log_record_t *rec)
+{
+    (void)ctx;
+
+    printf("%u,%u,%u,", rec->seq, rec->time_ms, rec->type);
+
+    if ((rec->type == NAV_LOG_FIX) && (rec->len == sizeof(position_fix_t)))
+    {
+        position_fix_t fix;
+
+        memcpy(&fix, rec->payload, sizeof(fix));
+        printf("%.3f,%.3f,%.4f,%.2f,%u,%u,%u,%u,\n", fix.x, fix.y, fix.peak, fix.psr, fix.source, fix.valid,
+               fix.frame, fix.since_anchor);
+        return 0;
+    }
+
+    printf(",,,,,,,,");
+
+    if (rec->type == RING_LOG_TEXT)
+    {
+        putchar('"');
+
+        for (uint32_t i = 0; i < rec->len; i++)
+        {
+            if (rec->payload[i] == '"')
+            {
+                putchar('"');
+            }
+
+            putchar(rec->payload[i]);
+        }
+
+        putchar('"');
+    }
+    else
+    {
+        for (uint32_t i = 0; i < rec->len; i++)
+        {
+            printf("%02x", rec->payload[i]);
+        }
+    }
+
+    putchar('\n');
+
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    csv_file_t file = { 0, 0 };
+    const ring_log_dev_t dev = { Csv_Read, Csv_Write, 0, &file };
+    const uint32_t first = (argc > 2) ? (uint32_t)strtoul(argv[2], 0, 0) : 0U;
+    const ring_log_header_t *h = (const ring_log_header_t *)csv_buf;
+    ring_log_t log;
+    uint8_t *data;
+    FILE *fp;
+    long size;
+    int res;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <ring file> [first sector]\n", argv[0]);
+        return 2;
+    }
+
+    if (((fp = fopen(argv[1], "rb")) == 0) || (fseek(fp, 0, SEEK_END) != 0) || ((size = ftell(fp)) < 0))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    data = malloc((size_t)size + 1U);
+    rewind(fp);
+
+    if ((data == 0) || (fread(data, 1, (size_t)size, fp) != (size_t)size))
+    {
+        perror(argv[1]);
+        fclose(fp);
+        return 1;
+    }
+
+    fclose(fp);
+    file.data = data;
+    file.size = (size_t)size;
+
+    /* The header gives the size of the region */
+    if ((Csv_Read(&file, csv_buf, first, 1U) != 0) || (h->magic != RING_LOG_MAGIC) ||
+        (RingLog_Init(&log, &dev, first, h->sectors, csv_buf, 1U) != RING_LOG_OK) ||
+        ((res = RingLog_Open(&log)) != RING_LOG_OK))
+    {
+        fprintf(stderr, "%s: no ring log at sector %u\n", argv[1], first);
+        free(data);
+        return 1;
+    }
+
+    fprintf(stderr, "%s: ring %08x, %u record sectors, next seq %u (%u sector reads to find it)\n",
+            argv[1], log.id, log.sectors, log.next_seq, log.stats.open_reads);
+
+    printf("seq,time_ms,type,x,y,peak,psr,source,valid,frame,since_anchor,data\n");
+    res = RingLog_ForEach(&log, Csv_Record, 0);
+
+    free(data);
+
+    return (res == RING_LOG_OK) ? 0 : 1;
+}
@@ -0,0 +1,102 @@
+#include "sccb_mock.h"
+
+#include <string.h>
+
+sccb_mock_t sccb_mock;
+
+
+static void SccbMock_Clock(uint32_t bytes, uint32_t conditions)
+{
+    const uint64_t bits = (uint64_t)bytes * 9U + conditions;
+
+    sccb_mock.bits += bits;
+    sccb_mock.now_ns += (double)bits * 1e9 / SCCB_MOCK_HZ;
+}
+
+
+void SccbMock_Reset(void)
+{
+    memset(&sccb_mock, 0, sizeof(sccb_mock));
+
+    /* OV5640_ID */
+    sccb_mock.reg[0x300A] = 0x56;
+    sccb_mock.reg[0x300B] = 0x40;
+}
+
+
+void SccbMock_ClearStats(void)
+{
+    sccb_mock.writes = 0U;
+    sccb_mock.reads = 0U;
+    sccb_mock.bits = 0U;
+    sccb_mock.logged = 0U;
+}
+
+
+int32_t SccbMock_Init(void)
+{
+    return 0;
+}
+
+
+int32_t SccbMock_DeInit(void)
+{
+    return 0;
+}
+
+
+/* Device address, register address, data; start and stop */
+int32_t SccbMock_WriteReg(uint16_t addr, uint16_t reg, uint8_t *data, uint16_t len)
+{
+    (void)addr;
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        const uint16_t r = (uint16_t)(reg + i);
+
+        sccb_mock.reg[r] = data[i];
+
+        if (sccb_mock.logged < SCCB_MOCK_LOG)
+        {
+            sccb_mock.log_reg[sccb_mock.logged] = r;
+            sccb_mock.log_val[sccb_mock.logged] = data[i];
+        }
+
+        sccb_mock.logged++;
+    }
+
+    sccb_mock.writes++;
+    SccbMock_Clock(3U + len, 2U);
+
+    return 0;
+}
+
+
+/* Device address, register address; repeated start, device address, data; stop */
+int32_t SccbMock_ReadReg(uint16_t addr, uint16_t reg, uint8_t *data, uint16_t len)
+{
+    (void)addr;
+
+    sccb_mock.reads++;
+    SccbMock_Clock(4U + len, 3U);
+
+    if (sccb_mock.on_read != 0)
+    {
+        sccb_mock.on_read(reg, len);
+    }
+
+    for (uint32_t i = 0; i < len; i++)
+    {
+        data[i] = sccb_mock.reg[(uint16_t)(reg + i)];
+    }
+
+    return 0;
+}
+
+
+int32_t SccbMock_GetTick(void)
+{
+    sccb_mock.now_ns += SCCB_MOCK_POLL_NS;
+
+    return (int32_t)(sccb_mock.now_ns / 1e6);
+}
@@ -0,0 +1,52 @@
+/*
+ * OV5640 register map behind SCCB, simulated for the camera driver
+ * (Test2/Core/Src/ov5640.c) as the bus functions of an OV5640_IO_t.
+ *
+ * The map covers the 16-bit register address space: zero after
+ * SccbMock_Reset() but for the chip ID (0x300A/0x300B). Writes land in it
+ * and reads come from it, several bytes at consecutive addresses per
+ * transfer (auto-increment). Every transfer is counted and the registers
+ * written are logged in order, so a benchmark can check the sequence a
+ * driver call writes and what it costs on the bus.
+ *
+ * The clock is simulated: SccbMock_GetTick() follows the bits put on the
+ * bus at SCCB_MOCK_HZ (the I2C1 clock of the board) plus
+ * SCCB_MOCK_POLL_NS per call, so the driver's delays run without waiting.
+ * A benchmark modelling the sensor (auto exposure ...) sets on_read, called
+ * before each read with the clock of the transfer.
+ */
+#ifndef __SCCB_MOCK_H
+#define __SCCB_MOCK_H
+
+#include <stdint.h>
+
+#define SCCB_MOCK_HZ        100000.0
+#define SCCB_MOCK_POLL_NS   1000.0
+#define SCCB_MOCK_LOG       4096U
+
+typedef struct
+{
+    uint8_t   reg[65536];
+    uint32_t  writes;               /* Write transfers */
+    uint32_t  reads;                /* Read transfers */
+    uint64_t  bits;                 /* Clocked, start/stop and acks included */
+    double    now_ns;
+    uint32_t  logged;               /* Bytes written since the log was cleared (may exceed SCCB_MOCK_LOG) */
+    uint16_t  log_reg[SCCB_MOCK_LOG];
+    uint8_t   log_val[SCCB_MOCK_LOG];
+    void    (*on_read)(uint16_t reg, uint16_t len);     /* Optional */
+} sccb_mock_t;
+
+extern sccb_mock_t sccb_mock;
+
+void    SccbMock_Reset(void);
+void    SccbMock_ClearStats(void);
+
+/* OV5640_IO_t bus functions */
+int32_t SccbMock_Init(void);
+int32_t SccbMock_DeInit(void);
+int32_t SccbMock_WriteReg(uint16_t addr, uint16_t reg, uint8_t *data, uint16_t len);
+int32_t SccbMock_ReadReg(uint16_t addr, uint16_t reg, uint8_t *data, uint16_t len);
+int32_t SccbMock_GetTick(void);
+
+#endif /* __SCCB_MOCK_H */
@@ -0,0 +1,410 @@
+#include "sd_mock.h"
+
+#include <string.h>
+
+#define SD_MOCK_R1_IDLE        0x01U
+#define SD_MOCK_R1_ILLEGAL     0x04U
+#define SD_MOCK_R1_CRC         0x08U
+#define SD_MOCK_R1_ADDRESS     0x20U
+
+#define SD_MOCK_TOKEN_OUT_OF_RANGE  0x08U
+#define SD_MOCK_DATA_ACCEPTED       0x05U
+#define SD_MOCK_DATA_WRITE_ERROR    0x0DU
+
+
+static void SdMock_Respond(sd_mock_t *c, const uint8_t *bytes, uint32_t n)
+{
+    for (uint32_t i = 0; (i < n) && (c->resp_len < sizeof(c->resp)); i++)
+    {
+        c->resp[(c->resp_head + c->resp_len++) % sizeof(c->resp)] = bytes[i];
+    }
+}
+
+
+/* One 0xFF (Ncr) and the R1, followed by extra bytes (R3 / R7) */
+static void SdMock_R1(sd_mock_t *c, uint8_t r1, const uint8_t *extra, uint32_t n)
+{
+    const uint8_t head[2] = { 0xFFU, (uint8_t)(r1 | (c->idle ? SD_MOCK_R1_IDLE : 0U)) };
+
+    SdMock_Respond(c, head, 2U);
+    SdMock_Respond(c, extra, n);
+}
+
+
+/* CSD version 2.0 of a card of c->sectors sectors */
+static uint8_t SdMock_CsdByte(const sd_mock_t *c, uint32_t i)
+{
+    const uint32_t c_size = (c->sectors / 1024U) - 1U;
+
+    switch (i)
+    {
+    case 0:  return 0x40U;
+    case 5:  return 0x59U;
+    case 7:  return (uint8_t)((c_size >> 16) & 0x3FU);
+    case 8:  return (uint8_t)(c_size >> 8);
+    case 9:  return (uint8_t)c_size;
+    default: return 0x00U;
+    }
+}
+
+
+static void SdMock_Command(sd_mock_t *c)
+{
+    const uint32_t idx = c->cmd[0] & 0x3FU;
+    const uint32_t arg = ((uint32_t)c->cmd[1] << 24) | ((uint32_t)c->cmd[2] << 16) |
+                         ((uint32_t)c->cmd[3] << 8) | c->cmd[4];
+    const int app = c->app;
+
+    c->stats.commands++;
+    c->app = 0;
+
+    if (((idx == 0U) && (c->cmd[5] != 0x95U)) || ((idx == 8U) && (c->cmd[5] != 0x87U)))
+    {
+        c->stats.errors++;
+        SdMock_R1(c, SD_MOCK_R1_CRC, 0, 0U);
+        return;
+    }
+
+    if (app)
+    {
+        if (idx == 41U)
+        {
+            if (++c->init_polls > SD_MOCK_INIT_POLLS)
+            {
+                c->idle = 0;
+            }
+
+            SdMock_R1(c, 0U, 0, 0U);
+            return;
+        }
+    }
+
+    switch (idx)
+    {
+    case 0:
+        c->idle = 1;
+        c->init_polls = 0U;
+        c->reading = 0;
+        c->writing = 0;
+        SdMock_R1(c, 0U, 0, 0U);
+        break;
+
+    case 8:
+    {
+        const uint8_t r7[4] = { 0x00U, 0x00U, (uint8_t)((arg >> 8) & 0x0FU), (uint8_t)arg };
+
+        SdMock_R1(c, 0U, r7, 4U);
+        break;
+    }
+
+    case 9:
+        SdMock_R1(c, 0U, 0, 0U);
+        c->reading = 9;
+        c->read_pos = -(int32_t)SD_MOCK_ACCESS_BYTES;
+        break;
+
+    case 12:
+        c->reading = 0;
+        SdMock_R1(c, 0U, 0, 0U);
+        c->busy = 2U;
+        break;
+
+    case 16:
+    case 55:
+        c->app = (idx == 55U);
+        SdMock_R1(c, 0U, 0, 0U);
+        break;
+
+    case 17:
+    case 18:
+    case 24:
+    case 25:
+        if (c->idle || (arg >= c->sectors))
+        {
+            c->stats.errors++;
+            SdMock_R1(c, c->idle ? SD_MOCK_R1_ILLEGAL : SD_MOCK_R1_ADDRESS, 0, 0U);
+            break;
+        }
+
+        SdMock_R1(c, 0U, 0, 0U);
+
+        if (idx < 24U)
+        {
+            c->reading = (int)idx;
+            c->read_sector = arg;
+            c->read_pos = -(int32_t)SD_MOCK_ACCESS_BYTES;
+        }
+        else
+        {
+            c->writing = (int)idx;
+            c->write_sector = arg;
+            c->write_pos = -1;
+        }
+        break;
+
+    case 58:
+    {
+        /* Powered up and high capacity once initialised */
+        const uint8_t ocr[4] = { c->idle ? 0x00U : 0xC0U, 0xFFU, 0x80U, 0x00U };
+
+        SdMock_R1(c, 0U, ocr, 4U);
+        break;
+    }
+
+    default:
+        c->stats.errors++;
+        SdMock_R1(c, SD_MOCK_R1_ILLEGAL, 0, 0U);
+        break;
+    }
+}
+
+
+/* Next byte of the block being sent */
+static uint8_t SdMock_ReadByte(sd_mock_t *c)
+{
+    const int32_t len = (c->reading == 9) ? 16 : (int32_t)SD_MOCK_BLOCK;
+    uint8_t v = 0x00U;
+
+    if (c->read_pos < 0)
+    {
+        c->read_pos++;
+        return 0xFFU;
+    }
+
+    if (c->read_pos == 0)
+    {
+        /* A stream running off the end of the card */
+        if ((c->reading == 18) && (c->read_sector >= c->sectors))
+        {
+            c->reading = 0;
+            return SD_MOCK_TOKEN_OUT_OF_RANGE;
+        }
+
+        v = 0xFEU;
+    }
+    else if (c->read_pos <= len)
+    {
+        v = (c->reading == 9) ? SdMock_CsdByte(c, (uint32_t)c->read_pos - 1U)
+                              : c->image[(uint64_t)c->read_sector * SD_MOCK_BLOCK + (uint32_t)c->read_pos - 1U];
+    }
+
+    /* Token, data and two CRC bytes (not checked by the driver: left 0) */
+    if (++c->read_pos > (len + 2))
+    {
+        if (c->reading == 18)
+        {
+            c->stats.reads++;
+            c->read_sector++;
+            c->read_pos = -(int32_t)SD_MOCK_ACCESS_BYTES;
+        }
+        else
+        {
+            c->stats.reads += (c->reading == 17) ? 1U : 0U;
+            c->reading = 0;
+        }
+    }
+
+    return v;
+}
+
+
+static void SdMock_WriteByte(sd_mock_t *c, uint8_t out)
+{
+    if (c->write_pos < 0)
+    {
+        if (((out == 0xFEU) && (c->writing == 24)) || ((out == 0xFCU) && (c->writing == 25)))
+        {
+            c->write_pos = 0;
+        }
+        else if ((out == 0xFDU) && (c->writing == 25))
+        {
+            c->writing = 0;
+            c->busy = SD_MOCK_BUSY_BYTES;
+        }
+
+        return;
+    }
+
+    if (c->write_pos < (int32_t)SD_MOCK_BLOCK)
+    {
+        c->block[c->write_pos++] = out;
+        return;
+    }
+
+    /* Two CRC bytes, then the data response and the programming time */
+    if (++c->write_pos < (int32_t)(SD_MOCK_BLOCK + 2U))
+    {
+        return;
+    }
+
+    if (c->write_sector < c->sectors)
+    {
+        const uint8_t ok = SD_MOCK_DATA_ACCEPTED;
+
+        memcpy(&c->image[(uint64_t)c->write_sector * SD_MOCK_BLOCK], c->block, SD_MOCK_BLOCK);
+        SdMock_Respond(c, &ok, 1U);
+        c->stats.writes++;
+    }
+    else
+    {
+        const uint8_t err = SD_MOCK_DATA_WRITE_ERROR;
+
+        SdMock_Respond(c, &err, 1U);
+        c->stats.errors++;
+    }
+
+    c->busy = SD_MOCK_BUSY_BYTES;
+    c->write_sector++;
+    c->write_pos = -1;
+
+    if (c->writing == 24)
+    {
+        c->writing = 0;
+    }
+}
+
+
+/* One byte each way, without the per-call overhead */
+static uint8_t SdMock_Clock(sd_mock_t *c, uint8_t out)
+{
+    uint8_t in = 0xFFU;
+
+    c->stats.bytes++;
+    c->now_ns += 8e9 / c->hz;
+
+    if (!c->selected)
+    {
+        return 0xFFU;
+    }
+
+    /* What the card shifts out does not depend on the byte coming in */
+    if (c->resp_len != 0U)
+    {
+        in = c->resp[c->resp_head];
+        c->resp_head = (c->resp_head + 1U) % sizeof(c->resp);
+        c->resp_len--;
+    }
+    else if (c->busy != 0U)
+    {
+        in = 0x00U;
+        c->busy--;
+    }
+    else if (c->reading != 0)
+    {
+        in = SdMock_ReadByte(c);
+    }
+
+    if (c->writing != 0)
+    {
+        SdMock_WriteByte(c, out);
+    }
+    else if ((c->cmd_len != 0U) || ((out & 0xC0U) == 0x40U))
+    {
+        c->cmd[c->cmd_len++] = out;
+
+        if (c->cmd_len == sizeof(c->cmd))
+        {
+            c->cmd_len = 0U;
+            SdMock_Command(c);
+        }
+    }
+
+    return in;
+}
+
+
+static void SdMock_Call(sd_mock_t *c)
+{
+    c->stats.calls++;
+    c->now_ns += c->call_ns;
+}
+
+
+static void SdMock_Select(void *ctx, int on)
+{
+    sd_mock_t *c = (sd_mock_t *)ctx;
+
+    c->selected = on;
+    c->cmd_len = 0U;
+}
+
+
+uint8_t SdMock_Xchg(sd_mock_t *c, uint8_t out)
+{
+    SdMock_Call(c);
+
+    return SdMock_Clock(c, out);
+}
+
+
+static uint8_t SdMock_BusXchg(void *ctx, uint8_t out)
+{
+    return SdMock_Xchg((sd_mock_t *)ctx, out);
+}
+
+
+static int SdMock_Receive(void *ctx, uint8_t *dst, uint32_t bytes)
+{
+    sd_mock_t *c = (sd_mock_t *)ctx;
+
+    SdMock_Call(c);
+
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        dst[i] = SdMock_Clock(c, 0xFFU);
+    }
+
+    return 0;
+}
+
+
+static int SdMock_Transmit(void *ctx, const uint8_t *src, uint32_t bytes)
+{
+    sd_mock_t *c = (sd_mock_t *)ctx;
+
+    SdMock_Call(c);
+
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        (void)SdMock_Clock(c, src[i]);
+    }
+
+    return 0;
+}
+
+
+uint32_t SdMock_Now(const sd_mock_t *c)
+{
+    return (uint32_t)(c->now_ns / 1e6);
+}
+
+
+static uint32_t SdMock_BusNow(void *ctx)
+{
+    return SdMock_Now((const sd_mock_t *)ctx);
+}
+
+
+/*
+ * Power up a card over image. With bulk the bus moves block payloads in
+ * one receive() / transmit() call, otherwise the driver clocks them byte
+ * by byte.
+ */
+void SdMock_Init(sd_mock_t *card, uint8_t *image, uint32_t sectors, double hz, double call_ns,
+                 int bulk)
+{
+    memset(card, 0, sizeof(*card));
+
+    card->image = image;
+    card->sectors = sectors;
+    card->hz = hz;
+    card->call_ns = call_ns;
+    card->idle = 1;
+
+    card->bus.select = SdMock_Select;
+    card->bus.xchg = SdMock_BusXchg;
+    card->bus.receive = bulk ? SdMock_Receive : 0;
+    card->bus.transmit = bulk ? SdMock_Transmit : 0;
+    card->bus.now_ms = SdMock_BusNow;
+    card->bus.ctx = card;
+}
@@ -0,0 +1,77 @@
+/*
+ * SDHC card in SPI mode, simulated byte by byte over a sector image, as an
+ * sd_spi_bus_t for the SD driver (Test2/Core/Src/sd_spi.c).
+ *
+ * It answers the commands the driver uses (CMD0/8/9/12/17/18/24/25/55/58,
+ * ACMD41) with SPI-mode timing: one byte before every R1, a few 0xFF
+ * bytes of access time before each data token, and busy (0x00) bytes
+ * after every written block. CMD0 and CMD8 need their real CRC. While
+ * deselected the card ignores the bus.
+ *
+ * The clock is simulated too: SdMock_Now() advances with the bits put on
+ * the bus at hz, plus call_ns of software overhead per bus call, so the
+ * driver's timeouts and the benchmark figures both follow the bus model.
+ */
+#ifndef __SD_MOCK_H
+#define __SD_MOCK_H
+
+#include <stdint.h>
+
+#include "sd_spi.h"
+
+#define SD_MOCK_BLOCK          512U
+#define SD_MOCK_ACCESS_BYTES   4U      /* 0xFF before each data token */
+#define SD_MOCK_BUSY_BYTES     16U     /* Programming time after a written block */
+#define SD_MOCK_INIT_POLLS     3U      /* ACMD41 answered "idle" this many times */
+
+typedef struct
+{
+    uint64_t bytes;             /* Bytes clocked */
+    uint64_t calls;             /* Bus calls (xchg, receive, transmit) */
+    uint32_t commands;
+    uint32_t reads;             /* Blocks sent */
+    uint32_t writes;            /* Blocks programmed */
+    uint32_t errors;            /* Bad CRC, unknown command, out of range */
+} sd_mock_stats_t;
+
+typedef struct
+{
+    uint8_t        *image;
+    uint32_t        sectors;
+    double          hz;
+    double          call_ns;
+    double          now_ns;
+
+    int             selected;
+    int             idle;
+    int             app;        /* Next command is an ACMD */
+    uint32_t        init_polls;
+
+    uint8_t         cmd[6];
+    uint32_t        cmd_len;
+
+    uint8_t         resp[24];   /* Queued response bytes */
+    uint32_t        resp_head;
+    uint32_t        resp_len;
+    uint32_t        busy;       /* 0x00 bytes still to send */
+
+    int             reading;    /* 0, 17 or 18 */
+    int32_t         read_pos;   /* < 0: access time, 0: token, 1..512 data, then CRC */
+    uint32_t        read_sector;
+
+    int             writing;    /* 0, 24 or 25 */
+    int32_t         write_pos;  /* < 0: waiting for a token */
+    uint32_t        write_sector;
+    uint8_t         block[SD_MOCK_BLOCK];
+
+    sd_mock_stats_t stats;
+    sd_spi_bus_t    bus;
+} sd_mock_t;
+
+/* image (sectors x 512 bytes) stays owned by the caller */
+void     SdMock_Init(sd_mock_t *card, uint8_t *image, uint32_t sectors, double hz, double call_ns,
+                     int bulk);
+uint8_t  SdMock_Xchg(sd_mock_t *card, uint8_t out);
+uint32_t SdMock_Now(const sd_mock_t *card);
+
+#endif /* __SD_MOCK_H */
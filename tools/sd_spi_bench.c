@@ -0,0 +1,219 @@
+/*
+ * SD driver protocol check and bus cost, against a simulated card.
+ *
+ *   sd_spi_bench
+ *
+ * The flight driver (Test2/Core/Src/sd_spi.c) runs unchanged over
+ * sd_mock.h: a 64 MB SDHC card in SPI mode. Every workload is checked
+ * against the card image, three ways:
+ *
+ *   bytewise   block payloads clocked one xchg() at a time, stream ended
+ *              after every call (the old payload path)
+ *   bulk       one receive() / transmit() per block, stream ended after
+ *              every call
+ *   streamed   bulk, and CMD18 / CMD25 left open between calls
+ *
+ * Reported per sector: bytes on the wire, bus calls and commands, and the
+ * time they take at the present SPI clock (200 MHz / 256) and at 25 MHz,
+ * counting BENCH_CALL_US of software per bus call (a polled HAL transfer
+ * on the H753; a DMA block costs about the same to set up).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sd_mock.h"
+#include "sd_spi.h"
+
+#define BENCH_SECTORS      131072U           /* 64 MB */
+#define BENCH_SLOW_HZ      (200e6 / 256.0)
+#define BENCH_FAST_HZ      25e6
+#define BENCH_CALL_US      1.5
+#define BENCH_RANDOM       500U
+
+typedef enum
+{
+    BENCH_BYTEWISE = 0,
+    BENCH_BULK,
+    BENCH_STREAMED
+} bench_mode_t;
+
+static const char *const bench_mode_name[] = { "bytewise", "bulk", "streamed" };
+
+static uint8_t *bench_image;
+static uint8_t  bench_buf[64U * SD_MOCK_BLOCK];
+
+
+static uint32_t Bench_Rand(uint32_t *state)
+{
+    *state = *state * 1664525U + 1013904223U;
+
+    return *state >> 8;
+}
+
+
+/* Data written at byte i of the 8-sector call starting at sector s */
+static uint8_t Bench_Pattern(uint32_t s, uint32_t i)
+{
+    return (uint8_t)((s * 31U) ^ (i * 7U) ^ (i >> 9));
+}
+
+
+static void Bench_Report(const char *work, bench_mode_t mode, const sd_mock_stats_t *a,
+                         const sd_mock_stats_t *b, uint32_t sectors, int ok)
+{
+    const double bytes = (double)(b->bytes - a->bytes);
+    const double calls = (double)(b->calls - a->calls);
+    const double call_s = calls * BENCH_CALL_US * 1e-6;
+    const double kb = sectors * (SD_MOCK_BLOCK / 1024.0);
+
+    printf("%-22s %-9s %7.1f B/sector %7.2f calls/sector %5.2f cmd/sector  "
+           "%6.1f KB/s @0.78 MHz  %7.1f KB/s @25 MHz  %s\n",
+           work, bench_mode_name[mode], bytes / sectors, calls / sectors,
+           (double)(b->commands - a->commands) / sectors,
+           kb / (bytes * 8.0 / BENCH_SLOW_HZ + call_s),
+           kb / (bytes * 8.0 / BENCH_FAST_HZ + call_s),
+           ok ? "OK" : "MISMATCH");
+}
+
+
+static int Bench_Read(bench_mode_t mode, uint32_t sector, uint32_t count)
+{
+    int ok = SD_SPI_ReadBlocks(bench_buf, sector, count) == SD_SPI_OK;
+
+    if (mode != BENCH_STREAMED)
+    {
+        ok &= SD_SPI_Sync() == SD_SPI_OK;
+    }
+
+    return ok && (memcmp(bench_buf, &bench_image[(size_t)sector * SD_MOCK_BLOCK], count * SD_MOCK_BLOCK) == 0);
+}
+
+
+static int Bench_Mode(bench_mode_t mode)
+{
+    sd_mock_t card;
+    sd_mock_stats_t s0;
+    uint32_t state = 7U;
+    int all = 1;
+    int ok;
+
+    SdMock_Init(&card, bench_image, BENCH_SECTORS, BENCH_SLOW_HZ, BENCH_CALL_US * 1e3, mode != BENCH_BYTEWISE);
+    SD_SPI_SetBus(&card.bus);
+
+    if ((SD_SPI_Init() != SD_SPI_OK) || (SD_SPI_GetSectorCount() != BENCH_SECTORS))
+    {
+        printf("%s: init failed (%u sectors)\n", bench_mode_name[mode], SD_SPI_GetSectorCount());
+        return 0;
+    }
+
+    /* Sequential, a cluster (8 sectors) per call: f_read() into a big buffer */
+    ok = 1;
+    s0 = card.stats;
+
+    for (uint32_t s = 1000U; s < 1000U + 2048U; s += 8U)
+    {
+        ok &= Bench_Read(mode, s, 8U);
+    }
+
+    Bench_Report("sequential 8-sector", mode, &s0, &card.stats, 2048U, ok);
+    all &= ok;
+
+    /* Sequential, one sector per call: FatFs window reads */
+    ok = 1;
+    s0 = card.stats;
+
+    for (uint32_t s = 5000U; s < 5000U + 512U; s++)
+    {
+        ok &= Bench_Read(mode, s, 1U);
+    }
+
+    Bench_Report("sequential 1-sector", mode, &s0, &card.stats, 512U, ok);
+    all &= ok;
+
+    /* Scattered single sectors: tile headers, FAT lookups */
+    ok = 1;
+    s0 = card.stats;
+
+    for (uint32_t i = 0; i < BENCH_RANDOM; i++)
+    {
+        ok &= Bench_Read(mode, Bench_Rand(&state) % BENCH_SECTORS, 1U);
+    }
+
+    Bench_Report("random 1-sector", mode, &s0, &card.stats, BENCH_RANDOM, ok);
+    all &= ok;
+
+    /* Sequential writes, 8 sectors per call, synced at the end */
+    const uint32_t first = 20000U + (uint32_t)mode * 4096U;
+
+    ok = 1;
+    s0 = card.stats;
+
+    for (uint32_t s = first; s < first + 2048U; s += 8U)
+    {
+        for (uint32_t i = 0; i < 8U * SD_MOCK_BLOCK; i++)
+        {
+            bench_buf[i] = Bench_Pattern(s, i);
+        }
+
+        ok &= SD_SPI_WriteBlocks(bench_buf, s, 8U) == SD_SPI_OK;
+
+        if (mode != BENCH_STREAMED)
+        {
+            ok &= SD_SPI_Sync() == SD_SPI_OK;
+        }
+    }
+
+    ok &= SD_SPI_Sync() == SD_SPI_OK;
+
+    for (uint32_t i = 0; i < 2048U * SD_MOCK_BLOCK; i++)
+    {
+        const uint32_t call = i / (8U * SD_MOCK_BLOCK);
+
+        ok &= bench_image[(size_t)first * SD_MOCK_BLOCK + i] ==
+              Bench_Pattern(first + call * 8U, i - call * 8U * SD_MOCK_BLOCK);
+    }
+
+    Bench_Report("sequential 8-sector wr", mode, &s0, &card.stats, 2048U, ok);
+    all &= ok;
+
+    /* Writes read back, across a stream change */
+    ok = Bench_Read(mode, first, 64U);
+    ok &= SD_SPI_WriteBlocks(bench_buf, 90000U, 1U) == SD_SPI_OK;
+    ok &= Bench_Read(mode, 90000U, 1U);
+    ok &= card.stats.errors == 0U;
+    all &= ok;
+
+    SD_SPI_ReleaseBus();
+
+    if (!ok)
+    {
+        printf("%s: read-back failed (%u card errors)\n", bench_mode_name[mode], card.stats.errors);
+    }
+
+    return all;
+}
+
+
+int main(void)
+{
+    uint32_t state = 1U;
+    int ok = 1;
+
+    bench_image = malloc((size_t)BENCH_SECTORS * SD_MOCK_BLOCK);
+
+    for (size_t i = 0; i < (size_t)BENCH_SECTORS * SD_MOCK_BLOCK; i++)
+    {
+        bench_image[i] = (uint8_t)(Bench_Rand(&state) >> 4);
+    }
+
+    for (int mode = BENCH_BYTEWISE; mode <= BENCH_STREAMED; mode++)
+    {
+        ok &= Bench_Mode((bench_mode_t)mode);
+    }
+
+    free(bench_image);
+
+    return ok ? 0 : 1;
+}
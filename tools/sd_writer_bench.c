@@ -0,0 +1,639 @@
+/*
+ * Background SD writer (Test2/Core/Inc/sd_writer.h) on POSIX threads.
+ *
+ *   sd_writer_bench [image file]
+ *
+ * The card is a file (default /tmp/sd_writer_bench.img) written with
+ * pwrite(), each call delayed as on the SPI card: BENCH_CMD_US per call,
+ * BENCH_SECTOR_US per sector, and a BENCH_STALL_MS busy spell every
+ * BENCH_STALL_EVERY calls (the card's own housekeeping).
+ *
+ * A camera task produces a BENCH_FRAME-byte frame every BENCH_PERIOD_MS
+ * from a pool of BENCH_FRAME_POOL buffers, and a 64-byte telemetry record
+ * with each. Frames go to a wrapping DROP_OLDEST stream, records to a
+ * BLOCK stream. Two runs:
+ *
+ *   inline   the camera task writes itself: Submit() and Service() until
+ *            the queues are empty (what a blocking write costs it)
+ *   task     a writer thread runs Service(), the camera task only Submit()s
+ *
+ * Reported: time the camera task spends storing per frame (mean, worst),
+ * frames written and dropped, record waits, card calls, sectors per call
+ * and calls off a cluster boundary. Both regions are then read back from
+ * the file and compared with what the release functions saw written.
+ *
+ * A third run, sink, is the nav log of the firmware: a ring log
+ * (ring_log.h) as the sink of a BLOCK stream. The camera task only queues
+ * a record per frame and a flush every BENCH_LOG_FLUSH_EVERY frames, the
+ * writer thread appends them; the ring is then opened afresh and must hold
+ * every record, in order.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ring_log.h"
+#include "sd_writer.h"
+
+#define BENCH_FRAME          (320U * 240U)
+#define BENCH_FRAMES         100U
+#define BENCH_PERIOD_MS      33U
+#define BENCH_FRAME_POOL     4U
+#define BENCH_FRAME_DEPTH    2U
+#define BENCH_RECORD         64U
+#define BENCH_LOG_PAYLOAD    16U
+#define BENCH_RECORD_POOL    32U
+#define BENCH_RECORD_DEPTH   16U
+
+#define BENCH_CLUSTER        8U             /* Sectors */
+#define BENCH_FRAME_BASE     2048U
+#define BENCH_FRAME_SECTORS  6000U          /* 40 frames: the stream wraps */
+#define BENCH_RECORD_BASE    8192U
+#define BENCH_RECORD_SECTORS 64U
+#define BENCH_LOG_BASE       (BENCH_RECORD_BASE + BENCH_RECORD_SECTORS)
+#define BENCH_LOG_SECTORS    65U            /* Header and 512 records */
+#define BENCH_LOG_ID         0x4E41564CUL
+#define BENCH_LOG_FLUSH_EVERY 16U
+#define BENCH_IMAGE_SECTORS  (BENCH_LOG_BASE + BENCH_LOG_SECTORS)
+
+#define BENCH_CMD_US         500U
+#define BENCH_SECTOR_US      164U           /* 512 bytes at 25 MHz */
+#define BENCH_STALL_MS       60U
+#define BENCH_STALL_EVERY    32U
+
+_Static_assert(sizeof(ring_log_record_t) == BENCH_RECORD, "a record slot holds one ring log record");
+
+/* The OS shim: one mutex, binary events as a flag under a condition variable */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_mutex_t ev_lock;
+    pthread_cond_t  ev_cond;
+    int             pending[2];
+} bench_os_t;
+
+/* The card */
+typedef struct
+{
+    int       fd;
+    uint32_t  calls;
+    uint32_t  sectors;
+    uint32_t  unaligned;
+    uint32_t  syncs;
+} bench_card_t;
+
+/* What the release functions saw written, laid out as on the card */
+typedef struct
+{
+    uint8_t  *data;
+    uint32_t  bytes;        /* Region */
+    uint64_t  total;        /* Written through the stream */
+    uint32_t  written;
+    uint32_t  dropped;
+    uint32_t  failed;
+} bench_shadow_t;
+
+typedef struct
+{
+    uint8_t         *buf;
+    uint32_t         len;
+    volatile int     busy;
+    bench_shadow_t  *shadow;
+} bench_slot_t;
+
+static bench_os_t     bench_os;
+static bench_card_t   bench_card;
+static sd_writer_t    bench_writer;
+static volatile int   bench_stop;
+
+static uint8_t        bench_frame_stage[BENCH_CLUSTER * SD_WRITER_SECTOR];
+static uint8_t        bench_record_stage[BENCH_CLUSTER * SD_WRITER_SECTOR];
+static sd_writer_job_t bench_frame_jobs[BENCH_FRAME_DEPTH];
+static sd_writer_job_t bench_record_jobs[BENCH_RECORD_DEPTH];
+static bench_slot_t   bench_frames[BENCH_FRAME_POOL];
+static bench_slot_t   bench_records[BENCH_RECORD_POOL];
+
+
+static double Bench_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec * 1e-6;
+}
+
+
+static void Bench_Sleep(uint32_t us)
+{
+    struct timespec ts = { (time_t)(us / 1000000U), (long)(us % 1000000U) * 1000L };
+
+    while (nanosleep(&ts, &ts) != 0)
+    {
+    }
+}
+
+
+static void Bench_Lock(void *ctx)
+{
+    pthread_mutex_lock(&((bench_os_t *)ctx)->lock);
+}
+
+
+static void Bench_Unlock(void *ctx)
+{
+    pthread_mutex_unlock(&((bench_os_t *)ctx)->lock);
+}
+
+
+static int Bench_Wait(void *ctx, int event, uint32_t timeout_ms)
+{
+    bench_os_t *os = (bench_os_t *)ctx;
+    struct timespec until;
+    int res = 0;
+
+    clock_gettime(CLOCK_REALTIME, &until);
+    until.tv_sec += (time_t)(timeout_ms / 1000U);
+    until.tv_nsec += (long)(timeout_ms % 1000U) * 1000000L;
+
+    if (until.tv_nsec >= 1000000000L)
+    {
+        until.tv_sec++;
+        until.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&os->ev_lock);
+
+    while (!os->pending[event] && (res == 0))
+    {
+        res = (timeout_ms == SD_WRITER_FOREVER) ? pthread_cond_wait(&os->ev_cond, &os->ev_lock)
+                                                : pthread_cond_timedwait(&os->ev_cond, &os->ev_lock, &until);
+    }
+
+    res = os->pending[event] ? 0 : -1;
+    os->pending[event] = 0;
+    pthread_mutex_unlock(&os->ev_lock);
+
+    return res;
+}
+
+
+static void Bench_Signal(void *ctx, int event)
+{
+    bench_os_t *os = (bench_os_t *)ctx;
+
+    pthread_mutex_lock(&os->ev_lock);
+    os->pending[event] = 1;
+    pthread_cond_broadcast(&os->ev_cond);
+    pthread_mutex_unlock(&os->ev_lock);
+}
+
+
+static int Bench_Write(void *ctx, const uint8_t *src, uint32_t sector, uint32_t count)
+{
+    bench_card_t *c = (bench_card_t *)ctx;
+    const size_t bytes = (size_t)count * SD_WRITER_SECTOR;
+
+    if (pwrite(c->fd, src, bytes, (off_t)sector * SD_WRITER_SECTOR) != (ssize_t)bytes)
+    {
+        return -1;
+    }
+
+    c->calls++;
+    c->sectors += count;
+    c->unaligned += ((sector % BENCH_CLUSTER) != 0U) ? 1U : 0U;
+    Bench_Sleep(BENCH_CMD_US + count * BENCH_SECTOR_US);
+
+    if ((c->calls % BENCH_STALL_EVERY) == 0U)
+    {
+        Bench_Sleep(BENCH_STALL_MS * 1000U);
+    }
+
+    return 0;
+}
+
+
+static int Bench_Read(void *ctx, uint8_t *dst, uint32_t sector, uint32_t count)
+{
+    const size_t bytes = (size_t)count * SD_WRITER_SECTOR;
+
+    return (pread(((bench_card_t *)ctx)->fd, dst, bytes, (off_t)sector * SD_WRITER_SECTOR) == (ssize_t)bytes) ? 0
+                                                                                                                : -1;
+}
+
+
+static int Bench_Sync(void *ctx)
+{
+    bench_card_t *c = (bench_card_t *)ctx;
+
+    c->syncs++;
+
+    return 0;
+}
+
+
+static uint8_t Bench_Byte(uint32_t tag, uint32_t i)
+{
+    return (uint8_t)((tag * 131U) + (i * 7U) + (i >> 9));
+}
+
+
+/* Writer side: lay what was written out as the stream does on the card */
+static void Bench_Release(void *ctx, const uint8_t *data, int status)
+{
+    bench_slot_t *slot = (bench_slot_t *)ctx;
+    bench_shadow_t *sh = slot->shadow;
+
+    if (status == SD_WRITER_OK)
+    {
+        for (uint32_t i = 0; i < slot->len; i++)
+        {
+            sh->data[(sh->total + i) % sh->bytes] = data[i];
+        }
+
+        sh->total += slot->len;
+        sh->written++;
+    }
+    else if (status == SD_WRITER_DROPPED)
+    {
+        sh->dropped++;
+    }
+    else
+    {
+        sh->failed++;
+    }
+
+    slot->busy = 0;
+}
+
+
+static void *Bench_WriterThread(void *arg)
+{
+    (void)arg;
+
+    while (!bench_stop)
+    {
+        (void)SdWriter_Service(&bench_writer, 10U);
+    }
+
+    /* Everything is queued by now; a Service() that found the queues empty may have raced the last Submit() */
+    while (SdWriter_Service(&bench_writer, 0U) != 0)
+    {
+    }
+
+    return 0;
+}
+
+
+static bench_slot_t *Bench_Take(bench_slot_t *pool, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (!pool[i].busy)
+        {
+            pool[i].busy = 1;
+            return &pool[i];
+        }
+    }
+
+    return 0;
+}
+
+
+/* Compare a region of the file with its shadow; the sector the stream ends in is zero-padded */
+static int Bench_Check(const bench_shadow_t *sh, uint32_t base)
+{
+    uint8_t *img = malloc(sh->bytes);
+    const uint32_t end = (uint32_t)(sh->total % sh->bytes);
+    const uint32_t pad = ((end + SD_WRITER_SECTOR - 1U) / SD_WRITER_SECTOR) * SD_WRITER_SECTOR;
+    const uint32_t upto = (sh->total < sh->bytes) ? end : sh->bytes;
+    int ok = (img != 0) && (pread(bench_card.fd, img, sh->bytes, (off_t)base * SD_WRITER_SECTOR) ==
+                            (ssize_t)sh->bytes);
+
+    for (uint32_t i = 0; ok && (i < upto); i++)
+    {
+        ok = ((i >= end) && (i < pad)) ? (img[i] == 0U) : (img[i] == sh->data[i]);
+    }
+
+    free(img);
+
+    return ok;
+}
+
+
+static int Bench_Run(const char *name, int threaded)
+{
+    const sd_writer_os_t os = { Bench_Lock, Bench_Unlock, Bench_Wait, Bench_Signal, &bench_os };
+    const sd_writer_dev_t dev = { Bench_Write, Bench_Sync, &bench_card };
+    bench_shadow_t frames = { calloc(BENCH_FRAME_SECTORS, SD_WRITER_SECTOR), BENCH_FRAME_SECTORS * SD_WRITER_SECTOR,
+                              0U, 0U, 0U, 0U };
+    bench_shadow_t records = { calloc(BENCH_RECORD_SECTORS, SD_WRITER_SECTOR),
+                               BENCH_RECORD_SECTORS * SD_WRITER_SECTOR, 0U, 0U, 0U, 0U };
+    sd_writer_stream_t fs, rs;
+    sd_writer_stream_stats_t fst, rst;
+    pthread_t writer;
+    double sum_ms = 0.0, max_ms = 0.0, next = 0.0;
+    int ok = 1;
+
+    memset(&bench_card.calls, 0, sizeof(bench_card) - sizeof(bench_card.fd));
+    ok &= ftruncate(bench_card.fd, 0) == 0;
+    ok &= ftruncate(bench_card.fd, (off_t)BENCH_IMAGE_SECTORS * SD_WRITER_SECTOR) == 0;
+
+    ok &= SdWriter_Init(&bench_writer, &os) == SD_WRITER_OK;
+    ok &= SdWriter_AddStream(&bench_writer, &fs, &dev, BENCH_FRAME_BASE, BENCH_FRAME_SECTORS, BENCH_CLUSTER,
+                             bench_frame_stage, bench_frame_jobs, BENCH_FRAME_DEPTH, SD_WRITER_DROP_OLDEST,
+                             1) == SD_WRITER_OK;
+    ok &= SdWriter_AddStream(&bench_writer, &rs, &dev, BENCH_RECORD_BASE, BENCH_RECORD_SECTORS, BENCH_CLUSTER,
+                             bench_record_stage, bench_record_jobs, BENCH_RECORD_DEPTH, SD_WRITER_BLOCK,
+                             0) == SD_WRITER_OK;
+
+    for (uint32_t i = 0; i < BENCH_FRAME_POOL; i++)
+    {
+        bench_frames[i].busy = 0;
+        bench_frames[i].shadow = &frames;
+    }
+
+    for (uint32_t i = 0; i < BENCH_RECORD_POOL; i++)
+    {
+        bench_records[i].busy = 0;
+        bench_records[i].shadow = &records;
+    }
+
+    bench_stop = 0;
+    ok &= !threaded || (pthread_create(&writer, 0, Bench_WriterThread, 0) == 0);
+    next = Bench_Now();
+
+    for (uint32_t f = 0; ok && (f < BENCH_FRAMES); f++)
+    {
+        bench_slot_t *frame, *rec;
+        double t0;
+
+        /* Next frame period */
+        next += BENCH_PERIOD_MS;
+        t0 = Bench_Now();
+
+        if (next > t0)
+        {
+            Bench_Sleep((uint32_t)((next - t0) * 1e3));
+        }
+
+        /* A DROP_OLDEST queue never holds the whole pool; the record pool outlasts its queue */
+        if (((frame = Bench_Take(bench_frames, BENCH_FRAME_POOL)) == 0) ||
+            ((rec = Bench_Take(bench_records, BENCH_RECORD_POOL)) == 0))
+        {
+            ok = 0;
+            break;
+        }
+
+        for (uint32_t i = 0; i < BENCH_FRAME; i++)
+        {
+            frame->buf[i] = Bench_Byte(f, i);
+        }
+
+        for (uint32_t i = 0; i < BENCH_RECORD; i++)
+        {
+            rec->buf[i] = Bench_Byte(f ^ 0x5A5AU, i);
+        }
+
+        t0 = Bench_Now();
+        ok &= SdWriter_Submit(&bench_writer, &fs, frame->buf, BENCH_FRAME, Bench_Release, frame, 0U) ==
+              SD_WRITER_OK;
+        ok &= SdWriter_Submit(&bench_writer, &rs, rec->buf, BENCH_RECORD, Bench_Release, rec,
+                              SD_WRITER_FOREVER) == SD_WRITER_OK;
+
+        while (!threaded && (SdWriter_Service(&bench_writer, 0U) != 0))
+        {
+        }
+
+        const double ms = Bench_Now() - t0;
+
+        sum_ms += ms;
+        max_ms = (ms > max_ms) ? ms : max_ms;
+    }
+
+    ok &= SdWriter_Flush(&bench_writer, &fs, SD_WRITER_FOREVER) == SD_WRITER_OK;
+    ok &= SdWriter_Flush(&bench_writer, &rs, SD_WRITER_FOREVER) == SD_WRITER_OK;
+    bench_stop = 1;
+
+    if (threaded)
+    {
+        pthread_join(writer, 0);
+    }
+    else
+    {
+        while (SdWriter_Service(&bench_writer, 0U) != 0)
+        {
+        }
+    }
+
+    SdWriter_GetStats(&bench_writer, &fs, &fst);
+    SdWriter_GetStats(&bench_writer, &rs, &rst);
+
+    ok &= (frames.failed == 0U) && (records.failed == 0U) && (fst.errors == 0U) && (rst.errors == 0U);
+    ok &= (frames.written + frames.dropped) == BENCH_FRAMES;
+    ok &= (records.written == BENCH_FRAMES) && (rst.dropped == 0U);
+    ok &= Bench_Check(&frames, BENCH_FRAME_BASE) && Bench_Check(&records, BENCH_RECORD_BASE);
+
+    printf("%-6s store %6.2f ms/frame mean %7.2f ms worst  frames %3u written %3u dropped (%u wraps)  "
+           "records %3u written, %u waits\n",
+           name, sum_ms / BENCH_FRAMES, max_ms, frames.written, frames.dropped, fst.wraps, records.written,
+           rst.waits);
+    printf("       card %u calls, %.1f sectors/call, %u off a cluster boundary, %u syncs  %s\n",
+           bench_card.calls, (double)bench_card.sectors / bench_card.calls, bench_card.unaligned, bench_card.syncs,
+           ok ? "OK" : "FAILED");
+
+    free(frames.data);
+    free(records.data);
+
+    return ok;
+}
+
+
+/* Sink run: the records come back in order, one per frame */
+typedef struct
+{
+    uint32_t seen;
+    uint32_t bad;
+} bench_log_check_t;
+
+
+static int Bench_LogVisit(void *ctx, const ring_log_record_t *rec)
+{
+    bench_log_check_t *chk = (bench_log_check_t *)ctx;
+    uint32_t frame;
+
+    memcpy(&frame, rec->payload, sizeof(frame));
+    chk->bad += ((rec->len != BENCH_LOG_PAYLOAD) || (frame != chk->seen) ||
+                 (rec->payload[sizeof(frame)] != Bench_Byte(frame, 0U))) ? 1U : 0U;
+    chk->seen++;
+
+    return 0;
+}
+
+
+static void Bench_LogRelease(void *ctx, const uint8_t *data, int status)
+{
+    bench_slot_t *slot = (bench_slot_t *)ctx;
+
+    (void)data;
+    slot->shadow->written += (status == SD_WRITER_OK) ? 1U : 0U;
+    slot->shadow->failed += (status == SD_WRITER_OK) ? 0U : 1U;
+    slot->busy = 0;
+}
+
+
+static int Bench_RunSink(const char *name)
+{
+    const sd_writer_os_t os = { Bench_Lock, Bench_Unlock, Bench_Wait, Bench_Signal, &bench_os };
+    const ring_log_dev_t dev = { Bench_Read, Bench_Write, Bench_Sync, &bench_card };
+    static uint8_t log_buf[BENCH_CLUSTER * RING_LOG_SECTOR], check_buf[RING_LOG_SECTOR];
+    bench_shadow_t records = { 0, 0U, 0U, 0U, 0U, 0U };
+    bench_log_check_t chk = { 0U, 0U };
+    ring_log_t log, reopened;
+    sd_writer_sink_t sink = { RingLog_SinkPut, RingLog_SinkFlush, &log };
+    sd_writer_stream_t ls;
+    sd_writer_stream_stats_t lst;
+    pthread_t writer;
+    double sum_ms = 0.0, max_ms = 0.0, next = 0.0;
+    int ok = 1;
+
+    memset(&bench_card.calls, 0, sizeof(bench_card) - sizeof(bench_card.fd));
+    ok &= ftruncate(bench_card.fd, 0) == 0;
+    ok &= ftruncate(bench_card.fd, (off_t)BENCH_IMAGE_SECTORS * SD_WRITER_SECTOR) == 0;
+
+    ok &= RingLog_Init(&log, &dev, BENCH_LOG_BASE, BENCH_LOG_SECTORS, log_buf, BENCH_CLUSTER) == RING_LOG_OK;
+    ok &= RingLog_Format(&log, BENCH_LOG_ID) == RING_LOG_OK;
+    ok &= SdWriter_Init(&bench_writer, &os) == SD_WRITER_OK;
+    ok &= SdWriter_AddSink(&bench_writer, &ls, &sink, bench_record_jobs, BENCH_RECORD_DEPTH, SD_WRITER_BLOCK) ==
+          SD_WRITER_OK;
+
+    for (uint32_t i = 0; i < BENCH_RECORD_POOL; i++)
+    {
+        bench_records[i].busy = 0;
+        bench_records[i].shadow = &records;
+    }
+
+    bench_stop = 0;
+    ok &= pthread_create(&writer, 0, Bench_WriterThread, 0) == 0;
+    next = Bench_Now();
+
+    for (uint32_t f = 0; ok && (f < BENCH_FRAMES); f++)
+    {
+        bench_slot_t *slot;
+        ring_log_record_t *rec;
+        double t0;
+
+        next += BENCH_PERIOD_MS;
+        t0 = Bench_Now();
+
+        if (next > t0)
+        {
+            Bench_Sleep((uint32_t)((next - t0) * 1e3));
+        }
+
+        if ((slot = Bench_Take(bench_records, BENCH_RECORD_POOL)) == 0)
+        {
+            ok = 0;
+            break;
+        }
+
+        rec = (ring_log_record_t *)slot->buf;
+        memset(rec, 0, sizeof(*rec));
+        rec->type = 1U;
+        rec->len = BENCH_LOG_PAYLOAD;
+        rec->time_ms = f * BENCH_PERIOD_MS;
+        memcpy(rec->payload, &f, sizeof(f));
+        rec->payload[sizeof(f)] = Bench_Byte(f, 0U);
+
+        t0 = Bench_Now();
+        ok &= SdWriter_Submit(&bench_writer, &ls, slot->buf, sizeof(*rec), Bench_LogRelease, slot,
+                              SD_WRITER_FOREVER) == SD_WRITER_OK;
+
+        if ((f % BENCH_LOG_FLUSH_EVERY) == 0U)
+        {
+            ok &= SdWriter_Flush(&bench_writer, &ls, SD_WRITER_FOREVER) == SD_WRITER_OK;
+        }
+
+        const double ms = Bench_Now() - t0;
+
+        sum_ms += ms;
+        max_ms = (ms > max_ms) ? ms : max_ms;
+    }
+
+    ok &= SdWriter_Flush(&bench_writer, &ls, SD_WRITER_FOREVER) == SD_WRITER_OK;
+    bench_stop = 1;
+    pthread_join(writer, 0);
+
+    SdWriter_GetStats(&bench_writer, &ls, &lst);
+
+    ok &= RingLog_Init(&reopened, &dev, BENCH_LOG_BASE, BENCH_LOG_SECTORS, check_buf, 1U) == RING_LOG_OK;
+    ok &= RingLog_Open(&reopened) == RING_LOG_OK;
+    ok &= RingLog_ForEach(&reopened, Bench_LogVisit, &chk) == RING_LOG_OK;
+    ok &= (records.written == BENCH_FRAMES) && (records.failed == 0U) && (lst.errors == 0U);
+    ok &= (chk.seen == BENCH_FRAMES) && (chk.bad == 0U);
+
+    printf("%-6s store %6.2f ms/frame mean %7.2f ms worst  records %3u appended, %u waits, %u back from the ring\n",
+           name, sum_ms / BENCH_FRAMES, max_ms, records.written, lst.waits, chk.seen);
+    printf("       card %u calls, %.1f sectors/call  %s\n",
+           bench_card.calls, (double)bench_card.sectors / bench_card.calls, ok ? "OK" : "FAILED");
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    const char *path = (argc > 1) ? argv[1] : "/tmp/sd_writer_bench.img";
+    int ok = 1;
+
+    if ((bench_card.fd = open(path, O_RDWR | O_CREAT, 0644)) < 0)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    pthread_mutex_init(&bench_os.lock, 0);
+    pthread_mutex_init(&bench_os.ev_lock, 0);
+    pthread_cond_init(&bench_os.ev_cond, 0);
+
+    for (uint32_t i = 0; i < BENCH_FRAME_POOL; i++)
+    {
+        bench_frames[i].buf = malloc(BENCH_FRAME);
+        bench_frames[i].len = BENCH_FRAME;
+    }
+
+    for (uint32_t i = 0; i < BENCH_RECORD_POOL; i++)
+    {
+        bench_records[i].buf = malloc(BENCH_RECORD);
+        bench_records[i].len = BENCH_RECORD;
+    }
+
+    printf("%u frames of %u bytes every %u ms, a %u-byte record with each; card %u us/call + %u us/sector, "
+           "%u ms stall every %u calls\n",
+           BENCH_FRAMES, BENCH_FRAME, BENCH_PERIOD_MS, BENCH_RECORD, BENCH_CMD_US, BENCH_SECTOR_US,
+           BENCH_STALL_MS, BENCH_STALL_EVERY);
+
+    ok &= Bench_Run("inline", 0);
+    ok &= Bench_Run("task", 1);
+    ok &= Bench_RunSink("sink");
+
+    for (uint32_t i = 0; i < BENCH_FRAME_POOL; i++)
+    {
+        free(bench_frames[i].buf);
+    }
+
+    for (uint32_t i = 0; i < BENCH_RECORD_POOL; i++)
+    {
+        free(bench_records[i].buf);
+    }
+
+    close(bench_card.fd);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/*
+ * Build precomputed reference spectra (.SPT) from a grayscale map.
+ *
+ *   spectrum_tile_gen <map.pgm> <n> <step> <outdir> [q15|f32]
+ *
+ * The map is cut into n x n tiles every <step> pixels. Each tile is windowed
+ * and transformed exactly as PhaseCorr_Forward() does on target, and written
+ * to <outdir>/XXXXYYYY.SPT (tile column and row, 8.3 names for FatFs).
+ * q15 (default) stores the phase-only spectrum, f32 the full spectrum.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phase_corr.h"
+#include "spectrum_tile.h"
+#include "host_util.h"
+
+
+static int Gen_WriteTile(const char *path, const spectrum_tile_header_t *hdr, const float *spectrum)
+{
+    FILE *f = fopen(path, "wb");
+    void *payload = malloc(hdr->data_bytes);
+    int ok;
+
+    if ((f == NULL) || (payload == NULL))
+    {
+        if (f != NULL) fclose(f);
+        free(payload);
+        return -1;
+    }
+
+    SpectrumTile_EncodeRows(hdr, spectrum, payload, hdr->n);
+
+    ok = (fwrite(hdr, sizeof(*hdr), 1, f) == 1) &&
+         (fwrite(payload, 1, hdr->data_bytes, f) == hdr->data_bytes);
+
+    fclose(f);
+    free(payload);
+
+    return ok ? 0 : -1;
+}
+
+
+int main(int argc, char **argv)
+{
+    if ((argc < 5) || (argc > 6))
+    {
+        fprintf(stderr, "usage: %s <map.pgm> <n> <step> <outdir> [q15|f32]\n", argv[0]);
+        return 2;
+    }
+
+    uint32_t w, h;
+    uint8_t *map = Host_ReadPGM(argv[1], &w, &h);
+    uint32_t n = (uint32_t)atoi(argv[2]);
+    uint32_t step = (uint32_t)atoi(argv[3]);
+    SpectrumTile_Quant quant = ((argc == 6) && (strcmp(argv[5], "f32") == 0)) ?
+                               SPECTRUM_QUANT_F32 : SPECTRUM_QUANT_Q15_PHASE;
+
+    if (map == NULL)
+    {
+        fprintf(stderr, "cannot read %s (8-bit binary PGM expected)\n", argv[1]);
+        return 1;
+    }
+
+    static phase_corr_t pc;
+    float *spectrum = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    uint8_t *tile_px = malloc((size_t)n * n);
+
+    if ((step == 0U) || (w < n) || (h < n) ||
+        (PhaseCorr_Init(&pc, n, spectrum, NULL) != PHASE_CORR_OK))
+    {
+        fprintf(stderr, "invalid tile size %u / step %u for a %ux%u map\n", n, step, w, h);
+        return 1;
+    }
+
+    image_t tile = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = tile_px };
+    spectrum_tile_header_t hdr;
+    uint32_t count = 0U;
+
+    for (uint32_t ty = 0, y0 = 0; y0 + n <= h; ty++, y0 += step)
+    {
+        for (uint32_t tx = 0, x0 = 0; x0 + n <= w; tx++, x0 += step)
+        {
+            char path[1024];
+
+            for (uint32_t y = 0; y < n; y++)
+            {
+                memcpy(&tile_px[y * n], &map[(y0 + y) * w + x0], n);
+            }
+
+            (void)PhaseCorr_Forward(&pc, &tile, spectrum);
+
+            SpectrumTile_InitHeader(&hdr, n, quant, (int32_t)x0, (int32_t)y0);
+
+            snprintf(path, sizeof(path), "%s/%04u%04u.SPT", argv[4], tx, ty);
+
+            if (Gen_WriteTile(path, &hdr, spectrum) != 0)
+            {
+                fprintf(stderr, "cannot write %s\n", path);
+                return 1;
+            }
+
+            count++;
+        }
+    }
+
+    printf("%u tiles of %ux%u, %s, %u bytes each\n", count, n, n,
+           (quant == SPECTRUM_QUANT_Q15_PHASE) ? "q15 phase" : "f32",
+           (uint32_t)(sizeof(hdr) + ((count > 0U) ? hdr.data_bytes : 0U)));
+
+    free(map);
+    free(spectrum);
+    free(tile_px);
+
+    return 0;
+}
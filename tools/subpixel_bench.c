@@ -0,0 +1,270 @@
+/*
+ * Host accuracy/timing benchmark for the sub-pixel peak refinement.
+ *
+ * A synthetic scene (bilinearly interpolated texture, so it is defined at
+ * any position) is rendered as a 512 x 512 reference and as frames shifted
+ * by known fractional amounts, each pixel integrating 4 x 4 samples of its
+ * area like a sensor would, with +-3 LSB of noise on the frames.
+ *
+ * Every refinement method is run on the full-resolution frames at n = 512
+ * and on the same frames 2 x 2 pooled at n = 256 (errors reported in
+ * full-resolution pixels), with the RMS and worst error over all shifts and
+ * the average time per fix. The pooled 256 x 256 correlation should match
+ * the accuracy of the integer 512 x 512 one. A last run sets the upsampled
+ * method but rejects every fix: each must come back unrefined, at about the
+ * cost of the integer method.
+ *
+ *   make -C tools && tools/build/subpixel_bench
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "phase_corr.h"
+#include "host_util.h"
+
+#define BENCH_TEX_SIZE     640U
+#define BENCH_FRAME        512U
+#define BENCH_SUPERSAMPLE  4U
+#define BENCH_TRIALS       32U
+#define BENCH_MAX_SHIFT    20.0f
+#define BENCH_NOISE        3
+
+static const char *const bench_method_name[] = { "integer", "parabolic", "gaussian", "upsampled" };
+
+typedef struct
+{
+    uint8_t *full;      /* BENCH_FRAME^2 */
+    uint8_t *pooled;    /* (BENCH_FRAME / 2)^2 */
+    float    sx;        /* Shift of the content w.r.t. the reference, full-resolution pixels */
+    float    sy;
+} bench_frame_t;
+
+
+static uint32_t bench_rng = 12345U;
+
+static float Bench_Rand(void)
+{
+    bench_rng = bench_rng * 1664525U + 1013904223U;
+
+    return (float)(bench_rng >> 8) / 16777216.0f;
+}
+
+
+/* Scene value at continuous texture position (x, y), bilinear */
+static float Bench_Scene(const uint8_t *tex, float x, float y)
+{
+    const int32_t ix = (int32_t)floorf(x);
+    const int32_t iy = (int32_t)floorf(y);
+    const float fx = x - (float)ix;
+    const float fy = y - (float)iy;
+    const uint8_t *p = &tex[(uint32_t)iy * BENCH_TEX_SIZE + (uint32_t)ix];
+    const float top = (float)p[0] + fx * (float)(p[1] - p[0]);
+    const float bot = (float)p[BENCH_TEX_SIZE] + fx * (float)(p[BENCH_TEX_SIZE + 1U] - p[BENCH_TEX_SIZE]);
+
+    return top + fy * (bot - top);
+}
+
+
+/* frame(x) = scene(x - shift), area sampled, plus noise */
+static void Bench_Render(const uint8_t *tex, bench_frame_t *f, int noise)
+{
+    const float x0 = (float)(BENCH_TEX_SIZE - BENCH_FRAME) / 2.0f - f->sx;
+    const float y0 = (float)(BENCH_TEX_SIZE - BENCH_FRAME) / 2.0f - f->sy;
+    const float step = 1.0f / (float)BENCH_SUPERSAMPLE;
+    const uint32_t h = BENCH_FRAME / 2U;
+
+    for (uint32_t y = 0; y < BENCH_FRAME; y++)
+    {
+        for (uint32_t x = 0; x < BENCH_FRAME; x++)
+        {
+            float acc = 0.0f;
+
+            for (uint32_t j = 0; j < BENCH_SUPERSAMPLE; j++)
+            {
+                for (uint32_t i = 0; i < BENCH_SUPERSAMPLE; i++)
+                {
+                    acc += Bench_Scene(tex, x0 + (float)x + ((float)i + 0.5f) * step,
+                                       y0 + (float)y + ((float)j + 0.5f) * step);
+                }
+            }
+
+            acc = acc * step * step + (noise ? (Bench_Rand() - 0.5f) * (float)(2 * BENCH_NOISE) : 0.0f);
+            f->full[y * BENCH_FRAME + x] = (uint8_t)((acc < 0.0f) ? 0.0f : ((acc > 255.0f) ? 255.0f : acc + 0.5f));
+        }
+    }
+
+    for (uint32_t y = 0; y < h; y++)
+    {
+        for (uint32_t x = 0; x < h; x++)
+        {
+            const uint8_t *p = &f->full[(2U * y) * BENCH_FRAME + 2U * x];
+
+            f->pooled[y * h + x] = (uint8_t)((p[0] + p[1] + p[BENCH_FRAME] + p[BENCH_FRAME + 1U] + 2U) >> 2);
+        }
+    }
+}
+
+
+/* Accuracy and timing of one FFT size / method; returns the RMS error in full-resolution pixels */
+static float Bench_Method(phase_corr_t *pc, const bench_frame_t *ref, const bench_frame_t *frames,
+                          uint32_t pool, PhaseCorr_Subpixel method)
+{
+    const uint32_t n = pc->n;
+    image_t ref_img = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE,
+                        .pixels = (pool == 1U) ? ref->full : ref->pooled };
+    double sq = 0.0;
+    double ms = 0.0;
+    float worst = 0.0f;
+    phase_corr_result_t res;
+
+    PhaseCorr_SetSubpixel(pc, method);
+
+    for (uint32_t t = 0; t < BENCH_TRIALS; t++)
+    {
+        image_t frame = ref_img;
+
+        frame.pixels = (pool == 1U) ? frames[t].full : frames[t].pooled;
+
+        const double t0 = Host_NowMs();
+
+        (void)PhaseCorr_Run(pc, &frame, &ref_img, &res);
+        ms += Host_NowMs() - t0;
+
+        const float ex = res.sub_dx * (float)pool - frames[t].sx;
+        const float ey = res.sub_dy * (float)pool - frames[t].sy;
+        const float e = sqrtf((ex * ex) + (ey * ey));
+
+        sq += (double)(e * e);
+        worst = (e > worst) ? e : worst;
+    }
+
+    const float rms = (float)sqrt(sq / BENCH_TRIALS);
+
+    printf("%4ux%-4u pool %u  %-10s %8.2f ms/fix  rms %.3f px  max %.3f px\n",
+           n, n, pool, bench_method_name[method], ms / BENCH_TRIALS, rms, worst);
+
+    return rms;
+}
+
+
+static float Bench_Size(uint32_t n, uint32_t pool, const bench_frame_t *ref, const bench_frame_t *frames,
+                        float *integer_rms)
+{
+    phase_corr_t *pc = malloc(sizeof(phase_corr_t));
+    float *work_a = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    float *work_b = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    float best = 1e9f;
+
+    (void)PhaseCorr_Init(pc, n, work_a, work_b);
+
+    for (uint32_t m = PHASE_CORR_SUBPIXEL_NONE; m <= PHASE_CORR_SUBPIXEL_UPSAMPLED; m++)
+    {
+        const float rms = Bench_Method(pc, ref, frames, pool, (PhaseCorr_Subpixel)m);
+
+        if (m == PHASE_CORR_SUBPIXEL_NONE)
+        {
+            *integer_rms = rms;
+        }
+        else if (rms < best)
+        {
+            best = rms;
+        }
+    }
+
+    free(pc);
+    free(work_a);
+    free(work_b);
+
+    return best;
+}
+
+
+/* Upsampled refinement with every fix rejected: no refinement is paid for, sub_dx / sub_dy stay integer */
+static int Bench_Rejected(uint32_t n, uint32_t pool, const bench_frame_t *ref, const bench_frame_t *frames)
+{
+    phase_corr_t *pc = malloc(sizeof(phase_corr_t));
+    float *work_a = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    float *work_b = malloc(PHASE_CORR_WORK_FLOATS(n) * sizeof(float));
+    image_t ref_img = { .w = (int)n, .h = (int)n, .bpp = IMAGE_BPP_GRAYSCALE,
+                        .pixels = (pool == 1U) ? ref->full : ref->pooled };
+    double ms = 0.0;
+    int ok = PhaseCorr_Init(pc, n, work_a, work_b) == PHASE_CORR_OK;
+    phase_corr_result_t res;
+
+    PhaseCorr_SetSubpixel(pc, PHASE_CORR_SUBPIXEL_UPSAMPLED);
+    PhaseCorr_SetMinConfidence(pc, 1e9f);
+
+    for (uint32_t t = 0; ok && (t < BENCH_TRIALS); t++)
+    {
+        image_t frame = ref_img;
+
+        frame.pixels = (pool == 1U) ? frames[t].full : frames[t].pooled;
+
+        const double t0 = Host_NowMs();
+
+        ok = (PhaseCorr_Run(pc, &frame, &ref_img, &res) == PHASE_CORR_REJECTED) &&
+             (res.sub_dx == (float)res.dx) && (res.sub_dy == (float)res.dy);
+        ms += Host_NowMs() - t0;
+    }
+
+    printf("%4ux%-4u pool %u  %-10s %8.2f ms/fix  all rejected, unrefined  %s\n",
+           n, n, pool, "rejected", ms / BENCH_TRIALS, ok ? "OK" : "FAILED");
+
+    free(pc);
+    free(work_a);
+    free(work_b);
+
+    return ok;
+}
+
+
+int main(void)
+{
+    uint8_t *tex = malloc(BENCH_TEX_SIZE * BENCH_TEX_SIZE);
+    bench_frame_t ref;
+    bench_frame_t *frames = malloc(BENCH_TRIALS * sizeof(bench_frame_t));
+    float int512;
+    float int256;
+
+    Host_MakeTexture(tex, BENCH_TEX_SIZE, BENCH_TEX_SIZE, 7U);
+
+    ref.full = malloc(BENCH_FRAME * BENCH_FRAME);
+    ref.pooled = malloc(BENCH_FRAME * BENCH_FRAME / 4U);
+    ref.sx = 0.0f;
+    ref.sy = 0.0f;
+    Bench_Render(tex, &ref, 0);
+
+    for (uint32_t t = 0; t < BENCH_TRIALS; t++)
+    {
+        frames[t].full = malloc(BENCH_FRAME * BENCH_FRAME);
+        frames[t].pooled = malloc(BENCH_FRAME * BENCH_FRAME / 4U);
+        frames[t].sx = (Bench_Rand() * 2.0f - 1.0f) * BENCH_MAX_SHIFT;
+        frames[t].sy = (Bench_Rand() * 2.0f - 1.0f) * BENCH_MAX_SHIFT;
+        Bench_Render(tex, &frames[t], 1);
+    }
+
+    printf("%u shifts within +-%.0f px, errors in full-resolution pixels\n", BENCH_TRIALS, BENCH_MAX_SHIFT);
+
+    (void)Bench_Size(512U, 1U, &ref, frames, &int512);
+    const float sub256 = Bench_Size(256U, 2U, &ref, frames, &int256);
+    const int rejected = Bench_Rejected(256U, 2U, &ref, frames);
+    const int ok = (sub256 <= int512) && rejected;
+
+    printf("256 pooled, refined: rms %.3f px vs 512 integer %.3f px  %s\n", sub256, int512,
+           (sub256 <= int512) ? "OK" : "WORSE");
+
+    for (uint32_t t = 0; t < BENCH_TRIALS; t++)
+    {
+        free(frames[t].full);
+        free(frames[t].pooled);
+    }
+
+    free(frames);
+    free(ref.full);
+    free(ref.pooled);
+    free(tex);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,390 @@
+/*
+ * Host test of the tile cache (tile_cache.h) in the configuration used on
+ * the board by Test2/Core/Src/spectrum_cache.c: 8 MB "PSRAM" in 68 KB slots
+ * (float spectra of 128 x 128 tiles) in front of a tile "card".
+ *
+ * The PSRAM is a RAM-backed stand-in with the PSRAM_Read/PSRAM_Write
+ * signature; the card is a generator of deterministic tile contents that
+ * counts every access, with no tiles south of row BENCH_MAP_END (off the
+ * map). A random flight over an 8 x 8 tile area is flown twice over the
+ * same track: every frame queues the 3x3 tiles around the
+ * position and the service loop loads up to two of them (the idle time of
+ * the camera task), every tenth frame anchors on the 3x3 tiles. Every byte
+ * read out of the cache is checked against the generator.
+ *
+ * The second pass must not touch the card. A run with prefetching off and
+ * one with a cache too small for the flight show what each part buys. The
+ * split service (TileCache_ServiceBegin() / Fill() / Commit(), as
+ * spectrum_cache.c runs it outside its lock) is flown too, with a reader
+ * anchoring on the tiles around the one being filled every
+ * BENCH_MIDFILL_EVERY frames, as the camera task does when it preempts
+ * the prefetch; no key may then end up in two slots.
+ *
+ *   make -C tools && tools/build/tile_cache_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tile_cache.h"
+
+#define BENCH_PSRAM_BYTES     (8U * 1024U * 1024U)
+#define BENCH_SLOT_BYTES      (68U * 1024U)
+#define BENCH_TILE_BYTES      (32U + (128U * 130U * 4U))
+#define BENCH_AREA_MIN        96
+#define BENCH_AREA_MAX        104
+#define BENCH_MAP_END         103U
+#define BENCH_FRAMES          1500U
+#define BENCH_ANCHOR_EVERY    10U
+#define BENCH_TILE_STEP       64.0f
+#define BENCH_CHUNK           1040U
+#define BENCH_MIDFILL_EVERY   3U
+
+static uint8_t *bench_psram;
+static uint32_t bench_psram_reads;
+static uint32_t bench_card_opens;
+static uint32_t bench_key;
+static uint32_t bench_prefetch_key;
+
+/* Reader to run in the middle of the next split fill, around tile (tx, ty) */
+static tile_cache_t *bench_midfill;
+static int32_t bench_midfill_tx;
+static int32_t bench_midfill_ty;
+static int bench_midfill_ok = 1;
+
+static tile_cache_entry_t bench_entries[256];
+static uint8_t bench_bounce[4096];
+static uint8_t bench_prefetch_bounce[4096];
+static uint8_t bench_chunk[BENCH_CHUNK];
+
+
+/* RAM-backed stand-ins for the QSPI PSRAM functions of Test2/Core/Src/main.c */
+static int PSRAM_Write(uint32_t addr, uint8_t *data, uint32_t size)
+{
+    if ((addr + size) > BENCH_PSRAM_BYTES)
+    {
+        return 1;
+    }
+
+    memcpy(&bench_psram[addr], data, size);
+
+    return 0;
+}
+
+
+static int PSRAM_Read(uint32_t addr, uint8_t *data, uint32_t size)
+{
+    if ((addr + size) > BENCH_PSRAM_BYTES)
+    {
+        return 1;
+    }
+
+    memcpy(data, &bench_psram[addr], size);
+    bench_psram_reads++;
+
+    return 0;
+}
+
+
+static int Bench_StoreRead(void *ctx, uint32_t addr, void *dst, uint32_t bytes)
+{
+    (void)ctx;
+
+    return PSRAM_Read(addr, (uint8_t *)dst, bytes);
+}
+
+
+static int Bench_StoreWrite(void *ctx, uint32_t addr, const void *src, uint32_t bytes)
+{
+    (void)ctx;
+
+    return PSRAM_Write(addr, (uint8_t *)src, bytes);
+}
+
+
+/* Byte at offset of the tile of key: depends on both */
+static uint8_t Bench_Byte(uint32_t key, uint32_t offset)
+{
+    uint32_t h = (key * 2654435761U) ^ (offset * 40503U);
+
+    return (uint8_t)(h ^ (h >> 13));
+}
+
+
+/* The card, ctx the key of the open tile (one per file handle) */
+static int32_t Bench_SourceOpen(void *ctx, uint32_t key)
+{
+    bench_card_opens++;
+
+    if (((key >> 14) & 0x3FFFU) >= BENCH_MAP_END)
+    {
+        return TILE_CACHE_ABSENT;
+    }
+
+    *(uint32_t *)ctx = key;
+
+    return (int32_t)BENCH_TILE_BYTES;
+}
+
+
+static int Bench_SourceRead(void *ctx, uint32_t offset, void *dst, uint32_t bytes)
+{
+    const uint32_t key = *(const uint32_t *)ctx;
+    uint8_t *p = (uint8_t *)dst;
+
+    for (uint32_t i = 0; i < bytes; i++)
+    {
+        p[i] = Bench_Byte(key, offset + i);
+    }
+
+    return 0;
+}
+
+static int Bench_Anchor(tile_cache_t *c, int32_t tx, int32_t ty);
+
+
+/* The card as read by the split fill: the reader set up runs after the first chunk */
+static int Bench_PrefetchRead(void *ctx, uint32_t offset, void *dst, uint32_t bytes)
+{
+    const int err = Bench_SourceRead(ctx, offset, dst, bytes);
+
+    if ((bench_midfill != 0) && (offset == 0U))
+    {
+        tile_cache_t *c = bench_midfill;
+
+        bench_midfill = 0;
+        bench_midfill_ok &= Bench_Anchor(c, bench_midfill_tx, bench_midfill_ty);
+    }
+
+    return err;
+}
+
+
+/* Anchor on the 3x3 tiles around tile (tx, ty), reading them all back */
+static int Bench_Anchor(tile_cache_t *c, int32_t tx, int32_t ty)
+{
+    int ok = 1;
+
+    for (int32_t j = ty - 1; j <= ty + 1; j++)
+    {
+        for (int32_t i = tx - 1; i <= tx + 1; i++)
+        {
+            if ((i < 0) || (j < 0))
+            {
+                continue;
+            }
+
+            const uint32_t key = TILE_CACHE_KEY(0U, i, j);
+            uint32_t bytes = 0U;
+            const int slot = TileCache_Get(c, key, &bytes);
+
+            if (slot == TILE_CACHE_ABSENT)
+            {
+                ok &= ((uint32_t)j >= BENCH_MAP_END);
+                continue;
+            }
+
+            ok &= (slot >= 0) && (bytes == BENCH_TILE_BYTES);
+
+            /* The batch correlator reads chunks of 8 rows, as on the board */
+            for (uint32_t off = 0; ok && (off < bytes); off += BENCH_CHUNK)
+            {
+                const uint32_t n = ((bytes - off) < BENCH_CHUNK) ? (bytes - off) : BENCH_CHUNK;
+
+                ok &= TileCache_Read(c, (uint32_t)slot, off, bench_chunk, n) == TILE_CACHE_OK;
+
+                for (uint32_t k = 0; ok && (k < n); k++)
+                {
+                    ok &= bench_chunk[k] == Bench_Byte(key, off + k);
+                }
+            }
+        }
+    }
+
+    return ok;
+}
+
+
+/* Prefetch by the split service, up to max tiles */
+static void Bench_ServiceSplit(tile_cache_t *c, uint32_t max, uint32_t frame)
+{
+    const tile_source_t src = { Bench_SourceOpen, Bench_PrefetchRead, 0, &bench_prefetch_key };
+    tile_cache_load_t load;
+
+    for (uint32_t k = 0; (k < max) && TileCache_ServiceBegin(c, &load); k++)
+    {
+        if ((frame % BENCH_MIDFILL_EVERY) == 0U)
+        {
+            bench_midfill = c;
+            bench_midfill_tx = (int32_t)(load.key & 0x3FFFU);
+            bench_midfill_ty = (int32_t)((load.key >> 14) & 0x3FFFU);
+        }
+
+        TileCache_ServiceFill(c, &load, &src, bench_prefetch_bounce, sizeof(bench_prefetch_bounce));
+        TileCache_ServiceCommit(c, &load);
+    }
+}
+
+
+/* One flight (prefetch 0 off, 1 TileCache_Service(), 2 split): returns 0 on a content or status mismatch */
+static int Bench_Fly(tile_cache_t *c, int prefetch, uint32_t seed, uint32_t *anchor_misses)
+{
+    float x = 100.0f * BENCH_TILE_STEP;
+    float y = 100.0f * BENCH_TILE_STEP;
+    float vx = 3.0f;
+    float vy = 1.0f;
+    int ok = 1;
+
+    srand(seed);
+    *anchor_misses = 0U;
+
+    for (uint32_t f = 0; f < BENCH_FRAMES; f++)
+    {
+        const int32_t tx = (int32_t)(x / BENCH_TILE_STEP + 0.5f);
+        const int32_t ty = (int32_t)(y / BENCH_TILE_STEP + 0.5f);
+
+        if ((f % BENCH_ANCHOR_EVERY) == 0U)
+        {
+            tile_cache_stats_t before;
+            tile_cache_stats_t after;
+
+            TileCache_GetStats(c, &before);
+            ok &= Bench_Anchor(c, tx, ty);
+            TileCache_GetStats(c, &after);
+            *anchor_misses += after.misses - before.misses;
+        }
+
+        if (prefetch)
+        {
+            for (int32_t j = ty - 1; j <= ty + 1; j++)
+            {
+                for (int32_t i = tx - 1; i <= tx + 1; i++)
+                {
+                    if ((i >= 0) && (j >= 0))
+                    {
+                        TileCache_Prefetch(c, TILE_CACHE_KEY(0U, i, j));
+                    }
+                }
+            }
+
+            if (prefetch == 2)
+            {
+                Bench_ServiceSplit(c, 2U, f);
+            }
+            else
+            {
+                (void)TileCache_Service(c, 2U);
+            }
+        }
+
+        /* Wandering flight, bouncing off the edges of the area */
+        vx += ((float)(rand() % 101) - 50.0f) / 200.0f;
+        vy += ((float)(rand() % 101) - 50.0f) / 200.0f;
+        vx = (vx > 4.0f) ? 4.0f : ((vx < -4.0f) ? -4.0f : vx);
+        vy = (vy > 4.0f) ? 4.0f : ((vy < -4.0f) ? -4.0f : vy);
+        x += vx;
+        y += vy;
+
+        if (((x < (BENCH_AREA_MIN * BENCH_TILE_STEP)) && (vx < 0.0f)) ||
+            ((x > (BENCH_AREA_MAX * BENCH_TILE_STEP)) && (vx > 0.0f)))
+        {
+            vx = -vx;
+        }
+
+        if (((y < (BENCH_AREA_MIN * BENCH_TILE_STEP)) && (vy < 0.0f)) ||
+            ((y > (BENCH_AREA_MAX * BENCH_TILE_STEP)) && (vy > 0.0f)))
+        {
+            vy = -vy;
+        }
+    }
+
+    return ok & bench_midfill_ok;
+}
+
+
+/* No key resident twice */
+static int Bench_Unique(const tile_cache_t *c)
+{
+    for (uint32_t i = 0; i < c->slots; i++)
+    {
+        for (uint32_t j = i + 1U; j < c->slots; j++)
+        {
+            if ((c->entries[i].used != 0U) && (c->entries[j].used != 0U) &&
+                (c->entries[i].key == c->entries[j].key))
+            {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+static int Bench_Run(const char *name, uint32_t slots, int prefetch, int expect_no_card)
+{
+    const tile_store_t store = { Bench_StoreRead, Bench_StoreWrite, 0 };
+    const tile_source_t src = { Bench_SourceOpen, Bench_SourceRead, 0, &bench_key };
+    tile_cache_t cache;
+    tile_cache_stats_t s;
+    int ok = 1;
+
+    if (TileCache_Init(&cache, bench_entries, slots, 0U, BENCH_SLOT_BYTES,
+                       &store, &src, bench_bounce, sizeof(bench_bounce)) != TILE_CACHE_OK)
+    {
+        return 0;
+    }
+
+    printf("%s: %u slots, prefetch %s\n", name, slots,
+           (prefetch == 2) ? "split, readers mid-fill" : (prefetch ? "on" : "off"));
+
+    for (uint32_t pass = 0; pass < 2U; pass++)
+    {
+        const uint32_t opens = bench_card_opens;
+        uint32_t anchor_misses;
+
+        TileCache_GetStats(&cache, &s);
+        const tile_cache_stats_t before = s;
+
+        ok &= Bench_Fly(&cache, prefetch, 7U, &anchor_misses);
+        TileCache_GetStats(&cache, &s);
+
+        printf("  pass %u: hits %6u  misses %5u  (at anchors %4u)  prefetched %5u  evictions %5u  "
+               "card opens %5u  card %7.1f MB\n",
+               pass + 1U, s.hits - before.hits, s.misses - before.misses, anchor_misses,
+               s.prefetched - before.prefetched, s.evictions - before.evictions,
+               bench_card_opens - opens, (double)(s.source_bytes - before.source_bytes) / 1048576.0);
+
+        if ((pass == 1U) && expect_no_card)
+        {
+            ok &= (bench_card_opens == opens);
+        }
+    }
+
+    ok &= (s.errors == 0U) && Bench_Unique(&cache);
+    printf("  %s\n", ok ? "OK" : "MISMATCH");
+
+    return ok;
+}
+
+
+int main(void)
+{
+    const uint32_t slots = BENCH_PSRAM_BYTES / BENCH_SLOT_BYTES;
+    int ok = 1;
+
+    bench_psram = malloc(BENCH_PSRAM_BYTES);
+
+    ok &= Bench_Run("full PSRAM", slots, 1, 1);
+    ok &= Bench_Run("full PSRAM", slots, 0, 1);
+    ok &= Bench_Run("small cache", 24U, 1, 0);
+    ok &= Bench_Run("full PSRAM", slots, 2, 1);
+    ok &= Bench_Run("small cache", 24U, 2, 0);
+
+    printf("PSRAM reads %u\n", bench_psram_reads);
+
+    free(bench_psram);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+/*
+ * Compression ratio and decoder speed of the Y8 tile codec (tile_codec.h).
+ *
+ *   tile_codec_bench [mosaic.pgm]
+ *
+ * Without a mosaic a 2048 x 2048 fractal texture is used, once clean and
+ * once with +-2 grey levels of sensor-like noise. The image is cut into
+ * non-overlapping 128 and 256 pixel tiles; every tile is packed, unpacked
+ * (whole buffer, and streamed through a 512-byte buffer as the SD reader
+ * does) and compared with the original.
+ *
+ * Decoding is reported in cycles (TSC on x86) and ns per output byte. The
+ * SD card is read over polled SPI at 200 MHz / 256: 8 bit clocks, about
+ * 4100 CPU cycles at 400 MHz, per byte, so any decoder below a few hundred
+ * cycles per byte wins by the full ratio.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES()   __rdtsc()
+#else
+#define BENCH_CYCLES()   0ULL
+#endif
+
+#include "tile_codec.h"
+#include "map_file.h"
+#include "host_util.h"
+
+#define BENCH_SIZE        2048U
+#define BENCH_STREAM      512U
+#define BENCH_ROUNDS      5U
+
+typedef struct
+{
+    const uint8_t *src;
+    uint32_t       pos;
+} bench_reader_t;
+
+
+static int Bench_Read(void *ctx, void *dst, uint32_t bytes)
+{
+    bench_reader_t *r = (bench_reader_t *)ctx;
+
+    memcpy(dst, &r->src[r->pos], bytes);
+    r->pos += bytes;
+
+    return 0;
+}
+
+
+static int Bench_Image(const char *name, const uint8_t *img, uint32_t w, uint32_t h, uint32_t tile)
+{
+    const uint32_t cols = w / tile;
+    const uint32_t rows = h / tile;
+    const uint32_t count = cols * rows;
+    const uint32_t raw = tile * tile;
+    const uint32_t max = TILE_CODEC_MAX_BYTES(tile, tile);
+    uint8_t *tiles = malloc((size_t)count * raw);
+    uint8_t *packed = malloc((size_t)count * max);
+    int32_t *sizes = malloc(count * sizeof(int32_t));
+    uint8_t *out = malloc(raw);
+    static uint8_t chunk[BENCH_STREAM];
+    uint64_t total = 0U;
+    uint64_t sectors_raw = 0U;
+    uint64_t sectors_packed = 0U;
+    uint32_t stored_raw = 0U;
+    int ok = 1;
+
+    for (uint32_t t = 0; t < count; t++)
+    {
+        for (uint32_t y = 0; y < tile; y++)
+        {
+            memcpy(&tiles[(size_t)t * raw + y * tile],
+                   &img[((t / cols) * tile + y) * w + (t % cols) * tile], tile);
+        }
+    }
+
+    double t0 = Host_NowMs();
+
+    for (uint32_t t = 0; t < count; t++)
+    {
+        sizes[t] = TileCodec_Encode(&tiles[(size_t)t * raw], tile, tile, &packed[(size_t)t * max], raw - 1U);
+    }
+
+    const double ms_enc = Host_NowMs() - t0;
+
+    for (uint32_t t = 0; t < count; t++)
+    {
+        const uint32_t bytes = (sizes[t] > 0) ? (uint32_t)sizes[t] : raw;
+
+        stored_raw += (sizes[t] > 0) ? 0U : 1U;
+        total += bytes;
+        sectors_raw += MAP_FILE_ALIGN_UP(MAP_TILE_HEADER_BYTES + raw, MAP_FILE_ALIGN) / MAP_FILE_ALIGN;
+        sectors_packed += MAP_FILE_ALIGN_UP(MAP_TILE_HEADER_BYTES + bytes, MAP_FILE_ALIGN) / MAP_FILE_ALIGN;
+
+        if (sizes[t] <= 0)
+        {
+            continue;
+        }
+
+        /* Whole buffer and streamed */
+        bench_reader_t rd = { &packed[(size_t)t * max], 0U };
+        tile_codec_stream_t s;
+
+        memset(out, 0, raw);
+        ok &= TileCodec_DecodeBuffer(&packed[(size_t)t * max], bytes, out, tile, tile) == TILE_CODEC_OK;
+        ok &= memcmp(out, &tiles[(size_t)t * raw], raw) == 0;
+
+        memset(out, 0, raw);
+        TileCodec_InitStream(&s, bytes, 0, 0U, chunk, sizeof(chunk), Bench_Read, &rd);
+        ok &= TileCodec_Decode(&s, out, tile, tile) == TILE_CODEC_OK;
+        ok &= memcmp(out, &tiles[(size_t)t * raw], raw) == 0;
+
+        /* Truncated data must be caught */
+        ok &= TileCodec_DecodeBuffer(&packed[(size_t)t * max], bytes / 2U, out, tile, tile) == TILE_CODEC_BAD_DATA;
+    }
+
+    /* Decoder timing over all packed tiles, streamed as on target */
+    uint64_t decoded = 0U;
+    uint64_t c0 = BENCH_CYCLES();
+
+    t0 = Host_NowMs();
+
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++)
+    {
+        for (uint32_t t = 0; t < count; t++)
+        {
+            if (sizes[t] > 0)
+            {
+                bench_reader_t rd = { &packed[(size_t)t * max], 0U };
+                tile_codec_stream_t s;
+
+                TileCodec_InitStream(&s, (uint32_t)sizes[t], 0, 0U, chunk, sizeof(chunk), Bench_Read, &rd);
+                (void)TileCodec_Decode(&s, out, tile, tile);
+                decoded += raw;
+            }
+        }
+    }
+
+    const double ms_dec = Host_NowMs() - t0;
+    const uint64_t cycles = BENCH_CYCLES() - c0;
+
+    printf("%-22s %3u px: ratio %.2f:1 (%u/%u raw)  sectors read %.2f:1  enc %6.1f MB/s  "
+           "dec %5.2f cycles/B  %5.2f ns/B  %s\n",
+           name, tile, (double)count * raw / (double)total, stored_raw, count,
+           (double)sectors_raw / (double)sectors_packed,
+           (double)count * raw / 1e3 / ms_enc,
+           decoded ? (double)cycles / (double)decoded : 0.0,
+           decoded ? ms_dec * 1e6 / (double)decoded : 0.0,
+           ok ? "OK" : "MISMATCH");
+
+    free(tiles);
+    free(packed);
+    free(sizes);
+    free(out);
+
+    return ok;
+}
+
+
+int main(int argc, char **argv)
+{
+    uint32_t w = BENCH_SIZE;
+    uint32_t h = BENCH_SIZE;
+    int ok = 1;
+
+    if (argc > 1)
+    {
+        uint8_t *img = Host_ReadPGM(argv[1], &w, &h);
+
+        if (img == NULL)
+        {
+            fprintf(stderr, "cannot read %s (8-bit binary PGM expected)\n", argv[1]);
+            return 1;
+        }
+
+        ok &= Bench_Image(argv[1], img, w, h, 128U);
+        ok &= Bench_Image(argv[1], img, w, h, 256U);
+        free(img);
+
+        return ok ? 0 : 1;
+    }
+
+    uint8_t *img = malloc(w * h);
+    uint32_t state = 99U;
+
+    Host_MakeTexture(img, w, h, 5U);
+    ok &= Bench_Image("texture", img, w, h, 128U);
+    ok &= Bench_Image("texture", img, w, h, 256U);
+
+    for (uint32_t i = 0; i < w * h; i++)
+    {
+        int32_t v;
+
+        state = state * 1664525U + 1013904223U;
+        v = (int32_t)img[i] + (int32_t)((state >> 24) % 5U) - 2;
+        img[i] = (uint8_t)((v < 0) ? 0 : ((v > 255) ? 255 : v));
+    }
+
+    ok &= Bench_Image("texture + noise", img, w, h, 128U);
+    ok &= Bench_Image("texture + noise", img, w, h, 256U);
+
+    free(img);
+
+    return ok ? 0 : 1;
+}
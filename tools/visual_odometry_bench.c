@@ -0,0 +1,188 @@
+/*
+ * Host benchmark for the frame-to-frame tracking mode.
+ *
+ * Flies a 640x480 camera over a synthetic 4096x4096 map along a curved
+ * track and localises every frame twice: with the absolute pyramid search
+ * alone, and with VisualOdometry_Process() re-anchoring on the pyramid
+ * search every K frames. Reports the time per frame (and so the fix rate
+ * reachable for the same CPU budget) and the position error.
+ *
+ *   make -C tools && tools/build/visual_odometry_bench
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pyramid_search.h"
+#include "visual_odometry.h"
+#include "host_util.h"
+
+#define BENCH_MAP_SIZE     4096U
+#define BENCH_FRAME_W      640U
+#define BENCH_FRAME_H      480U
+#define BENCH_N_ABS        256U
+#define BENCH_N_TRACK      128U
+#define BENCH_POOL         2U
+#define BENCH_ANCHOR_EVERY 10U
+#define BENCH_FRAMES       200U
+
+typedef struct
+{
+    pyramid_search_t *ps;
+    pyramid_result_t  res;
+} bench_absolute_t;
+
+
+static int Bench_Absolute(void *ctx, const image_t *frame, const position_fix_t *prior, position_fix_t *fix)
+{
+    bench_absolute_t *ba = (bench_absolute_t *)ctx;
+
+    (void)prior;
+
+    if (PyramidSearch_Run(ba->ps, frame, &ba->res) != PYRAMID_OK)
+    {
+        return -1;
+    }
+
+    fix->x = (float)ba->res.x;
+    fix->y = (float)ba->res.y;
+    fix->peak = ba->res.peak;
+    fix->psr = ba->res.psr;
+
+    return 0;
+}
+
+
+/* Frame centre of frame i: ~15 px/frame, turning slowly */
+static void Bench_Track(uint32_t i, int32_t *cx, int32_t *cy)
+{
+    const double t = (double)i;
+
+    *cx = 800 + (int32_t)lround(12.0 * t + 300.0 * sin(t / 40.0));
+    *cy = 1200 + (int32_t)lround(6.0 * t + 250.0 * (1.0 - cos(t / 55.0)));
+}
+
+
+static void Bench_Cut(const uint8_t *map, uint8_t *frame, int32_t cx, int32_t cy)
+{
+    for (uint32_t y = 0; y < BENCH_FRAME_H; y++)
+    {
+        memcpy(&frame[y * BENCH_FRAME_W],
+               &map[(uint32_t)(cy - (int32_t)BENCH_FRAME_H / 2 + (int32_t)y) * BENCH_MAP_SIZE +
+                    (uint32_t)(cx - (int32_t)BENCH_FRAME_W / 2)],
+               BENCH_FRAME_W);
+    }
+}
+
+
+int main(void)
+{
+    uint8_t *map_px = malloc((size_t)BENCH_MAP_SIZE * BENCH_MAP_SIZE);
+    uint8_t *frame_px = malloc(BENCH_FRAME_W * BENCH_FRAME_H);
+    const uint32_t levels = Pyramid_LevelsFor(BENCH_MAP_SIZE, BENCH_MAP_SIZE, BENCH_N_ABS);
+    uint8_t *map_buf = malloc(Pyramid_BufBytes(BENCH_MAP_SIZE, BENCH_MAP_SIZE, levels) + 1U);
+    uint8_t *scratch = malloc(PyramidSearch_ScratchBytes(BENCH_FRAME_W, BENCH_FRAME_H, BENCH_N_ABS, levels));
+    float *abs_a = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N_ABS) * sizeof(float));
+    float *abs_b = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N_ABS) * sizeof(float));
+    float *trk_corr = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N_TRACK) * sizeof(float));
+    float *trk_a = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N_TRACK) * sizeof(float));
+    float *trk_b = malloc(PHASE_CORR_WORK_FLOATS(BENCH_N_TRACK) * sizeof(float));
+    static phase_corr_t pc_abs;
+    static phase_corr_t pc_trk;
+    static pyramid_search_t ps;
+    static visual_odometry_t vo;
+    image_t map_levels[PYRAMID_MAX_LEVELS];
+    bench_absolute_t ba = { .ps = &ps };
+    const visual_odometry_config_t cfg =
+    {
+        .anchor_every = BENCH_ANCHOR_EVERY,
+        .pool = BENCH_POOL,
+        .min_track_psr = 8.0f,
+        .min_anchor_psr = 8.0f,
+    };
+    position_fix_t fix;
+    int32_t cx;
+    int32_t cy;
+
+    Host_MakeTexture(map_px, BENCH_MAP_SIZE, BENCH_MAP_SIZE, 11U);
+
+    image_t map = { .w = BENCH_MAP_SIZE, .h = BENCH_MAP_SIZE, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = map_px };
+    image_t frame = { .w = BENCH_FRAME_W, .h = BENCH_FRAME_H, .bpp = IMAGE_BPP_GRAYSCALE, .pixels = frame_px };
+
+    (void)Pyramid_Build(&map, map_levels, levels, map_buf);
+    (void)PhaseCorr_Init(&pc_abs, BENCH_N_ABS, abs_a, abs_b);
+    (void)PyramidSearch_Init(&ps, &pc_abs, map_levels, levels, scratch, 0);
+    (void)PhaseCorr_Init(&pc_trk, BENCH_N_TRACK, trk_corr, 0);
+
+    if (VisualOdometry_Init(&vo, &pc_trk, &cfg, trk_a, trk_b, Bench_Absolute, &ba) != VISUAL_ODOMETRY_OK)
+    {
+        printf("init failed\n");
+        return 1;
+    }
+
+    /* Absolute search on every frame */
+    double abs_ms = 0.0;
+    double abs_err = 0.0;
+
+    for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+    {
+        Bench_Track(i, &cx, &cy);
+        Bench_Cut(map_px, frame_px, cx, cy);
+
+        double t0 = Host_NowMs();
+        (void)Bench_Absolute(&ba, &frame, 0, &fix);
+        abs_ms += Host_NowMs() - t0;
+        abs_err = fmax(abs_err, hypot(fix.x - cx, fix.y - cy));
+    }
+
+    abs_ms /= BENCH_FRAMES;
+
+    /* Tracking with re-anchoring */
+    double vo_ms = 0.0;
+    double vo_err = 0.0;
+    double vo_err_sum = 0.0;
+
+    for (uint32_t i = 0; i < BENCH_FRAMES; i++)
+    {
+        Bench_Track(i, &cx, &cy);
+        Bench_Cut(map_px, frame_px, cx, cy);
+
+        double t0 = Host_NowMs();
+        (void)VisualOdometry_Process(&vo, &frame, &fix);
+        vo_ms += Host_NowMs() - t0;
+
+        double e = hypot(fix.x - cx, fix.y - cy);
+
+        vo_err = fmax(vo_err, e);
+        vo_err_sum += e;
+    }
+
+    vo_ms /= BENCH_FRAMES;
+
+    printf("%u frames, 640x480 over %ux%u, ~15 px/frame\n", BENCH_FRAMES, BENCH_MAP_SIZE, BENCH_MAP_SIZE);
+    printf("absolute every frame   %7.2f ms/frame  %6.1f fix/s  max error %5.1f px\n",
+           abs_ms, 1000.0 / abs_ms, abs_err);
+    printf("tracking, K = %-2u       %7.2f ms/frame  %6.1f fix/s  max error %5.1f px  mean %4.1f px\n",
+           BENCH_ANCHOR_EVERY, vo_ms, 1000.0 / vo_ms, vo_err, vo_err_sum / BENCH_FRAMES);
+    printf("    %u absolute, %u incremental, %u dropped increments\n",
+           vo.absolute_runs, vo.incremental_runs, vo.dropped);
+    printf("    speed-up %.1fx\n", abs_ms / vo_ms);
+
+    int ok = (abs_err < 1.0) && (vo_err <= 2.0 * BENCH_ANCHOR_EVERY) && (vo.dropped == 0U);
+
+    printf("%s\n", ok ? "OK" : "WRONG");
+
+    free(map_px);
+    free(frame_px);
+    free(map_buf);
+    free(scratch);
+    free(abs_a);
+    free(abs_b);
+    free(trk_corr);
+    free(trk_a);
+    free(trk_b);
+
+    return ok ? 0 : 1;
+}